@@ -0,0 +1,32 @@
+#version 450
+
+// packs the non-empty buckets for vkCmdDrawIndexedIndirectCount, see VK::IndirectScene (VK_INDIRECT.h).
+
+layout(local_size_x = 64) in;
+
+// VkDrawIndexedIndirectCommand
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(std430, binding = 2) readonly buffer Buckets { DrawCommand buckets[]; };
+layout(std430, binding = 4) writeonly buffer Draws { DrawCommand draws[]; };
+layout(std430, binding = 5) buffer Count { uint count; };
+
+layout(push_constant) uniform Cull {
+    vec4 planes[6];
+    vec4 camera;
+    uint instanceCount;
+    uint bucketCount;
+} cull;
+
+void main() {
+    uint b = gl_GlobalInvocationID.x;
+    if (b >= cull.bucketCount || buckets[b].instanceCount == 0) return;
+
+    draws[atomicAdd(count, 1)] = buckets[b];
+}
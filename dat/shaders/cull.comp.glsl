@@ -0,0 +1,73 @@
+#version 450
+
+// frustum culling & lod selection, one instance per invocation, see VK::IndirectScene (VK_INDIRECT.h).
+// a visible instance is appended to the bucket of its mesh & lod: the bucket's instanceCount grows, the instance
+// index is listed at firstInstance + its slot.
+
+layout(local_size_x = 256) in;
+
+struct Instance {
+    vec4 positionScale;
+    uint mesh;
+    uint reserved0;
+    uint reserved1;
+    uint reserved2;
+};
+
+struct MeshInfo {
+    vec4 sphere;
+    vec4 decodeScale;
+    vec4 decodeBias;
+    uint firstBucket;
+    uint lodCount;
+    uint reserved0;
+    uint reserved1;
+    vec4 lodError;
+};
+
+// VkDrawIndexedIndirectCommand
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(std430, binding = 0) readonly buffer Instances { Instance instances[]; };
+layout(std430, binding = 1) readonly buffer Meshes { MeshInfo meshes[]; };
+layout(std430, binding = 2) buffer Buckets { DrawCommand buckets[]; };
+layout(std430, binding = 3) writeonly buffer Visible { uint visible[]; };
+
+layout(push_constant) uniform Cull {
+    vec4 planes[6];
+    vec4 camera;
+    uint instanceCount;
+    uint bucketCount;
+} cull;
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= cull.instanceCount) return;
+
+    Instance instance = instances[i];
+    MeshInfo mesh = meshes[instance.mesh];
+
+    float scale = instance.positionScale.w;
+    vec3 center = instance.positionScale.xyz + mesh.sphere.xyz * scale;
+    float radius = mesh.sphere.w * scale;
+
+    for (int p = 0; p < 6; p++) {
+        if (dot(cull.planes[p].xyz, center) + cull.planes[p].w < -radius) return;
+    }
+
+    // the coarsest lod whose error, projected from the nearest point of the sphere, stays within a pixel.
+    float distance = max(length(center - cull.camera.xyz) - radius, 1e-4);
+    float pixels = scale * cull.camera.w / distance;
+    uint lod = 0;
+    while (lod + 1 < mesh.lodCount && mesh.lodError[lod + 1] * pixels <= 1.0) lod++;
+
+    uint bucket = mesh.firstBucket + lod;
+    uint slot = atomicAdd(buckets[bucket].instanceCount, 1);
+    visible[buckets[bucket].firstInstance + slot] = i;
+}
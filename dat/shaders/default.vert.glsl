@@ -5,8 +5,18 @@ layout(location = 0) out vec3 fragColor;
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 
+// VertexFormat::Decode: quantized positions come in [-1, 1], scaled back to the mesh bounds.
+layout(push_constant) uniform Decode {
+    vec4 scale;
+    vec4 bias;
+} decode;
+
+// per frame, from VK::frameData (VK_FRAMEDATA.h): the target's aspect ratio, undone so the mesh keeps its proportions.
+layout(set = 0, binding = 0) uniform Frame {
+    vec4 scale;
+} frame;
 
 void main() {
-    gl_Position = vec4(inPosition, 1.0);
+    gl_Position = vec4((inPosition * decode.scale.xyz + decode.bias.xyz) * frame.scale.xyz, 1.0);
     fragColor = inColor;
-}
\ No newline at end of file
+}
@@ -0,0 +1,46 @@
+#version 450
+
+// gpu driven instances, see VK::IndirectScene (VK_INDIRECT.h): gl_InstanceIndex counts from the bucket's
+// firstInstance into the visible list written by cull.comp.
+
+layout(location = 0) out vec3 fragColor;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+
+struct Instance {
+    vec4 positionScale;
+    uint mesh;
+    uint reserved0;
+    uint reserved1;
+    uint reserved2;
+};
+
+struct MeshInfo {
+    vec4 sphere;
+    vec4 decodeScale;
+    vec4 decodeBias;
+    uint firstBucket;
+    uint lodCount;
+    uint reserved0;
+    uint reserved1;
+    vec4 lodError;
+};
+
+layout(std430, binding = 0) readonly buffer Instances { Instance instances[]; };
+layout(std430, binding = 1) readonly buffer Meshes { MeshInfo meshes[]; };
+layout(std430, binding = 3) readonly buffer Visible { uint visible[]; };
+
+layout(push_constant) uniform Draw {
+    mat4 viewProjection;
+} draw;
+
+void main() {
+    Instance instance = instances[visible[gl_InstanceIndex]];
+    MeshInfo mesh = meshes[instance.mesh];
+
+    // VertexFormat::Decode of the mesh, then the instance's scale & position.
+    vec3 position = inPosition * mesh.decodeScale.xyz + mesh.decodeBias.xyz;
+    gl_Position = draw.viewProjection * vec4(position * instance.positionScale.w + instance.positionScale.xyz, 1.0);
+    fragColor = inColor;
+}
@@ -0,0 +1,52 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// indirect.vert with the scene's buffers read from the bindless table, see VK::BindlessTable (VK_DESCRIPTOR.h): the
+// draw pushes their indices, the same for the whole draw.
+
+layout(location = 0) out vec3 fragColor;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+
+struct Instance {
+    vec4 positionScale;
+    uint mesh;
+    uint reserved0;
+    uint reserved1;
+    uint reserved2;
+};
+
+struct MeshInfo {
+    vec4 sphere;
+    vec4 decodeScale;
+    vec4 decodeBias;
+    uint firstBucket;
+    uint lodCount;
+    uint reserved0;
+    uint reserved1;
+    vec4 lodError;
+};
+
+// one array of storage buffers, seen through the type of each.
+layout(std430, set = 0, binding = 1) readonly buffer Instances { Instance instances[]; } instanceBuffers[];
+layout(std430, set = 0, binding = 1) readonly buffer Meshes { MeshInfo meshes[]; } meshBuffers[];
+layout(std430, set = 0, binding = 1) readonly buffer Visible { uint visible[]; } visibleBuffers[];
+
+layout(push_constant) uniform Draw {
+    mat4 viewProjection;
+    uint instances;
+    uint meshes;
+    uint visible;
+} draw;
+
+void main() {
+    uint index = visibleBuffers[draw.visible].visible[gl_InstanceIndex];
+    Instance instance = instanceBuffers[draw.instances].instances[index];
+    MeshInfo mesh = meshBuffers[draw.meshes].meshes[instance.mesh];
+
+    // VertexFormat::Decode of the mesh, then the instance's scale & position.
+    vec3 position = inPosition * mesh.decodeScale.xyz + mesh.decodeBias.xyz;
+    gl_Position = draw.viewProjection * vec4(position * instance.positionScale.w + instance.positionScale.xyz, 1.0);
+    fragColor = inColor;
+}
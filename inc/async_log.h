@@ -0,0 +1,412 @@
+#pragma once
+
+#include "build_profile.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// the lowest level compiled in, a spdlog level: 0 trace, 1 debug, 2 info, 3 warn, 4 error. the fixed level calls
+// below it compile to nothing.
+#ifndef V3RSE_LOG_LEVEL
+#define V3RSE_LOG_LEVEL 0
+#endif
+
+// Logging off the caller's thread, for hot paths and driver callbacks.
+//
+// every thread that logs owns a ring buffer, one producer one consumer and lock free: a call copies its level, a
+// timestamp, the format string's address and its arguments in binary form (strings inline), and returns. nothing
+// is formatted on the caller's thread and it never waits: when its ring is full, the record is dropped and counted.
+// a background thread drains the rings every flushInterval, formats the records in timestamp order and hands them
+// to the sinks of spdlog's default logger. a message repeated within dedupWindow is written once, then counted, and
+// the count written when the window ends. until start() and after stop(), calls log synchronously through spdlog.
+class AsyncLogger {
+public:
+    using Level = spdlog::level::level_enum;
+
+    static constexpr auto minLevel = static_cast<Level>(V3RSE_LOG_LEVEL);
+    static constexpr size_t ringSize = 1 << 18; // bytes per thread, a power of two
+    static constexpr auto flushInterval = std::chrono::milliseconds(2);
+    static constexpr auto dedupWindow = std::chrono::seconds(1);
+
+    // a string literal: records keep its address, not a copy.
+    struct Format {
+        template<size_t N>
+        consteval Format(const char (& literal)[N]) : text(literal) {}
+
+        const char* text;
+    };
+
+    struct Stats {
+        uint64_t written = 0;
+        uint64_t dropped = 0; // rings full
+        uint64_t suppressed = 0; // repeats
+    };
+
+    AsyncLogger() = default;
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+    ~AsyncLogger() { stop(); }
+
+    // starts the background thread. stop() before spdlog's logger goes away: it writes what is left.
+    void start() {
+        if (running()) return;
+        stopping = false;
+        thread = std::thread([this] { drainLoop(); });
+        active.store(true, std::memory_order_release);
+    }
+
+    void stop() {
+        if (!running()) return;
+        active.store(false, std::memory_order_release);
+        stopping = true;
+        thread.join();
+
+        // a call that saw the logger running may have committed after the last drain.
+        std::lock_guard lock(drainMutex);
+        drain(true);
+    }
+
+    [[nodiscard]] bool running() const {
+        return active.load(std::memory_order_acquire);
+    }
+
+    template<typename... Args>
+    void trace(Format format, const Args& ... args) {
+        if constexpr (Level::trace >= minLevel) log(Level::trace, format, args...);
+    }
+
+    template<typename... Args>
+    void debug(Format format, const Args& ... args) {
+        if constexpr (Level::debug >= minLevel) log(Level::debug, format, args...);
+    }
+
+    template<typename... Args>
+    void info(Format format, const Args& ... args) {
+        if constexpr (Level::info >= minLevel) log(Level::info, format, args...);
+    }
+
+    template<typename... Args>
+    void warn(Format format, const Args& ... args) {
+        if constexpr (Level::warn >= minLevel) log(Level::warn, format, args...);
+    }
+
+    template<typename... Args>
+    void error(Format format, const Args& ... args) {
+        if constexpr (Level::err >= minLevel) log(Level::err, format, args...);
+    }
+
+    // arguments are numbers, enums, pointers or strings: whatever is copied as bytes, and strings by value.
+    template<typename... Args>
+    void log(Level level, Format format, const Args& ... args) {
+        if (level < minLevel) return;
+        if (!running()) {
+            spdlog::log(level, fmt::runtime(format.text), args...);
+            return;
+        }
+
+        Ring& r = ring();
+        uint32_t size = align(sizeof(Header) + (encodedSize(args) + ... + 0));
+        std::byte* at = r.reserve(size);
+        if (!at) {
+            r.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        Header header {size, level, now(), format.text, &decode<std::decay_t<Args>...>};
+        memcpy(at, &header, sizeof(Header));
+        at += sizeof(Header);
+        (encode(at, args), ...);
+        r.commit(size);
+    }
+
+    // writes what the rings hold now, from any thread. the background thread does it every flushInterval.
+    void flush() {
+        std::lock_guard lock(drainMutex);
+        drain(false);
+    }
+
+    [[nodiscard]] Stats stats() const {
+        Stats s {written.load(std::memory_order_relaxed), 0, suppressed.load(std::memory_order_relaxed)};
+        std::lock_guard lock(ringsMutex);
+        s.dropped = droppedClosed;
+        for (const auto& r: rings) s.dropped += r->dropped.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    using Decode = void (*)(const std::byte* args, const char* format, fmt::memory_buffer& out);
+
+    struct Header {
+        uint32_t size; // header & arguments, 8 byte aligned. with skipBit, the rest of the ring is unused.
+        Level level;
+        int64_t time; // ns since the system clock's epoch
+        const char* format;
+        Decode decode;
+    };
+
+    static constexpr uint32_t skipBit = 1u << 31;
+
+    struct Ring {
+        alignas(64) std::atomic<uint64_t> head = 0; // producer
+        alignas(64) std::atomic<uint64_t> tail = 0; // consumer
+        alignas(64) std::atomic<uint64_t> dropped = 0;
+        std::atomic<bool> closed = false; // the thread exited, removed once drained
+        std::unique_ptr<std::byte[]> bytes = std::make_unique<std::byte[]>(ringSize);
+
+        // size contiguous bytes, null when they don't fit. a record never wraps: the end of the ring is skipped.
+        std::byte* reserve(uint32_t size) {
+            uint64_t h = head.load(std::memory_order_relaxed);
+            uint64_t used = h - tail.load(std::memory_order_acquire);
+            size_t offset = h & (ringSize - 1);
+            size_t contiguous = ringSize - offset;
+            size_t needed = contiguous < size ? contiguous + size : size;
+            if (ringSize - used < needed) return nullptr;
+
+            if (contiguous < size) {
+                auto skip = static_cast<uint32_t>(contiguous) | skipBit;
+                memcpy(bytes.get() + offset, &skip, sizeof(skip));
+                head.store(h + contiguous, std::memory_order_release);
+                offset = 0;
+            }
+            return bytes.get() + offset;
+        }
+
+        void commit(uint32_t size) {
+            head.store(head.load(std::memory_order_relaxed) + size, std::memory_order_release);
+        }
+    };
+
+    struct Entry {
+        int64_t time;
+        Level level;
+        std::string text;
+    };
+
+    struct Repeat {
+        int64_t windowEnd;
+        uint64_t count = 0;
+        Level level;
+    };
+
+    std::atomic<bool> active = false;
+    std::atomic<bool> stopping = false;
+    std::thread thread;
+
+    mutable std::mutex ringsMutex;
+    std::vector<std::shared_ptr<Ring>> rings;
+    uint64_t droppedClosed = 0; // by rings removed since
+
+    std::mutex drainMutex;
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, Repeat> repeats;
+    std::atomic<uint64_t> written = 0;
+    std::atomic<uint64_t> suppressed = 0;
+
+    // the calling thread's ring, registered on its first record, closed when it exits.
+    Ring& ring() {
+        struct Owner {
+            std::shared_ptr<Ring> ring = std::make_shared<Ring>();
+            ~Owner() { ring->closed.store(true, std::memory_order_release); }
+        };
+        thread_local Owner owner;
+        thread_local bool registered = false;
+        if (!registered) {
+            std::lock_guard lock(ringsMutex);
+            rings.push_back(owner.ring);
+            registered = true;
+        }
+        return *owner.ring;
+    }
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static constexpr uint32_t align(size_t size) {
+        return static_cast<uint32_t>((size + 7) & ~size_t(7));
+    }
+
+    template<typename T>
+    static constexpr bool isString = std::is_same_v<std::decay_t<T>, const char*> ||
+                                     std::is_same_v<std::decay_t<T>, char*> ||
+                                     std::is_same_v<std::decay_t<T>, std::string> ||
+                                     std::is_same_v<std::decay_t<T>, std::string_view>;
+
+    template<typename T>
+    static std::string_view view(const T& s) {
+        if constexpr (std::is_pointer_v<T>) return s ? std::string_view(s) : std::string_view("(null)");
+        else return std::string_view(s);
+    }
+
+    template<typename T>
+    static size_t encodedSize(const T& value) {
+        if constexpr (isString<T>) return sizeof(uint32_t) + view(value).size();
+        else {
+            static_assert(std::is_trivially_copyable_v<T>, "async log arguments are copied as bytes!");
+            return sizeof(T);
+        }
+    }
+
+    template<typename T>
+    static void encode(std::byte*& at, const T& value) {
+        if constexpr (isString<T>) {
+            std::string_view s = view(value);
+            auto length = static_cast<uint32_t>(s.size());
+            memcpy(at, &length, sizeof(length));
+            memcpy(at + sizeof(length), s.data(), length);
+            at += sizeof(length) + length;
+        } else {
+            memcpy(at, &value, sizeof(T));
+            at += sizeof(T);
+        }
+    }
+
+    template<typename T>
+    static auto read(const std::byte*& at) {
+        if constexpr (isString<T>) {
+            uint32_t length;
+            memcpy(&length, at, sizeof(length));
+            std::string_view s(reinterpret_cast<const char*>(at + sizeof(length)), length);
+            at += sizeof(length) + length;
+            return s;
+        } else {
+            std::array<std::byte, sizeof(T)> raw;
+            memcpy(raw.data(), at, sizeof(T));
+            at += sizeof(T);
+            return std::bit_cast<T>(raw);
+        }
+    }
+
+    template<typename... Args>
+    static void decode(const std::byte* at, const char* format, fmt::memory_buffer& out) {
+        // braced: read in order
+        std::tuple<decltype(read<Args>(at))...> values {read<Args>(at)...};
+        std::apply([&](const auto& ... v) { fmt::format_to(std::back_inserter(out), fmt::runtime(format), v...); },
+                   values);
+    }
+
+    void drainLoop() {
+        for (;;) {
+            bool last = stopping.load(std::memory_order_acquire);
+            {
+                std::lock_guard lock(drainMutex);
+                drain(last);
+            }
+            if (last) return;
+            std::this_thread::sleep_for(flushInterval);
+        }
+    }
+
+    // with drainMutex held. the last one also writes the repeats of windows still open.
+    void drain(bool last) {
+        std::vector<std::shared_ptr<Ring>> current;
+        {
+            std::lock_guard lock(ringsMutex);
+            current = rings;
+        }
+
+        entries.clear();
+        fmt::memory_buffer buffer;
+        for (const auto& r: current) {
+            bool closed = r->closed.load(std::memory_order_acquire); // before head: nothing is written after
+            uint64_t t = r->tail.load(std::memory_order_relaxed);
+            uint64_t h = r->head.load(std::memory_order_acquire);
+            while (t < h) {
+                const std::byte* at = r->bytes.get() + (t & (ringSize - 1));
+                uint32_t size;
+                memcpy(&size, at, sizeof(size));
+                if (size & skipBit) {
+                    t += size & ~skipBit;
+                    continue;
+                }
+
+                Header header;
+                memcpy(&header, at, sizeof(Header));
+                buffer.clear();
+                try {
+                    header.decode(at + sizeof(Header), header.format, buffer);
+                } catch (const std::exception& e) {
+                    buffer.clear();
+                    fmt::format_to(std::back_inserter(buffer), "bad log format \"{}\": {}", header.format, e.what());
+                }
+                entries.push_back({header.time, header.level, fmt::to_string(buffer)});
+                t += size;
+            }
+            r->tail.store(t, std::memory_order_release);
+
+            if (closed) {
+                std::lock_guard lock(ringsMutex);
+                droppedClosed += r->dropped.load(std::memory_order_relaxed);
+                std::erase(rings, r);
+            }
+        }
+
+        // the rings are each in order, not with each other.
+        std::stable_sort(entries.begin(), entries.end(),
+                         [](const Entry& a, const Entry& b) { return a.time < b.time; });
+        for (Entry& e: entries) {
+            int64_t windowEnd = e.time + std::chrono::nanoseconds(dedupWindow).count();
+            auto [it, first] = repeats.try_emplace(e.text, Repeat {windowEnd, 0, e.level});
+            if (!first && e.time < it->second.windowEnd) {
+                it->second.count++;
+                suppressed.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (!first && it->second.count) write(e.time, e.level, repeated(it->first, it->second.count));
+            it->second = {windowEnd, 0, e.level};
+            write(e.time, e.level, e.text);
+        }
+
+        // windows that ended report their repeats, the window of a message starts again with its next record.
+        int64_t t = now();
+        for (auto it = repeats.begin(); it != repeats.end();) {
+            if (t < it->second.windowEnd && !last) {
+                ++it;
+                continue;
+            }
+            if (it->second.count) write(t, it->second.level, repeated(it->first, it->second.count));
+            it = repeats.erase(it);
+        }
+
+        if (!entries.empty()) {
+            for (const auto& sink: spdlog::default_logger_raw()->sinks()) sink->flush();
+        }
+    }
+
+    static std::string repeated(std::string_view text, uint64_t count) {
+        return fmt::format("{} (repeated {} more times)", text, count);
+    }
+
+    void write(int64_t time, Level level, std::string_view text) {
+        spdlog::logger& logger = *spdlog::default_logger_raw();
+        if (!logger.should_log(level)) return;
+
+        spdlog::details::log_msg msg(spdlog::log_clock::time_point(
+                                         std::chrono::duration_cast<spdlog::log_clock::duration>(
+                                             std::chrono::nanoseconds(time))),
+                                     spdlog::source_loc {}, logger.name(), level, text);
+        for (const auto& sink: logger.sinks()) {
+            if (sink->should_log(level)) sink->log(msg);
+        }
+        written.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+inline AsyncLogger asyncLog;
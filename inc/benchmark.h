@@ -26,7 +26,24 @@ public:
         this->count++;
     }
 
+    void reset() {
+        this->average = 0;
+        this->count = 0;
+    }
+
+    [[nodiscard]] int64_t total() const {
+        return this->average;
+    }
+
+    [[nodiscard]] int64_t samples() const {
+        return this->count;
+    }
+
+    [[nodiscard]] int64_t mean() const {
+        return this->count ? this->average / this->count : 0;
+    }
+
     void print() {
-        info("average: {} ns", this->average / this->count);
+        info("average: {} ns", mean());
     }
 };
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "logging.h"
+
+#include <cstdlib>
+#include <stdexcept>
+#include <string_view>
+
+// Build profiles, picked by CMake (V3RSE_BUILD_PROFILE, from CMAKE_BUILD_TYPE by default):
+// - debug: validation layers & messenger, debug utils labels, cpu & gpu profilers and assertions.
+// - profile: labels & profilers, validation off unless asked for at runtime, no assertions.
+// - release: none of it compiled in, debug & trace logs stripped.
+// what a profile compiles in can be turned off at runtime through the environment, see BuildProfile.
+#define V3RSE_PROFILE_DEBUG 0
+#define V3RSE_PROFILE_PROFILE 1
+#define V3RSE_PROFILE_RELEASE 2
+
+#ifndef V3RSE_BUILD_PROFILE
+#define V3RSE_BUILD_PROFILE V3RSE_PROFILE_DEBUG
+#endif
+
+#define V3RSE_VALIDATION (V3RSE_BUILD_PROFILE != V3RSE_PROFILE_RELEASE)
+#define V3RSE_DEBUG_LABELS (V3RSE_BUILD_PROFILE != V3RSE_PROFILE_RELEASE)
+#define V3RSE_PROFILING (V3RSE_BUILD_PROFILE != V3RSE_PROFILE_RELEASE)
+#define V3RSE_ASSERTS (V3RSE_BUILD_PROFILE == V3RSE_PROFILE_DEBUG)
+
+// the async logger's level floor (async_log.h), a spdlog level.
+#if !defined(V3RSE_LOG_LEVEL) && V3RSE_BUILD_PROFILE == V3RSE_PROFILE_RELEASE
+#define V3RSE_LOG_LEVEL 2
+#endif
+
+// checks of the engine's own invariants on hot paths, e.g. stale handles. gone outside of debug builds.
+#if V3RSE_ASSERTS
+#define V3RSE_ASSERT(condition, message) do { if (!(condition)) throw std::runtime_error(message); } while (0)
+#else
+#define V3RSE_ASSERT(condition, message) ((void) 0)
+#endif
+
+// what is on in this run: the profile's defaults, overridden by V3RSE_VALIDATION (0, 1 or verbose),
+// V3RSE_DEBUG_LABELS (0 or 1) and V3RSE_PROFILING (0 or 1). what the build left out can't be turned on.
+struct BuildProfile {
+    static constexpr const char* name = V3RSE_BUILD_PROFILE == V3RSE_PROFILE_DEBUG ? "debug" :
+                                        V3RSE_BUILD_PROFILE == V3RSE_PROFILE_PROFILE ? "profile" : "release";
+
+    bool validation = V3RSE_BUILD_PROFILE == V3RSE_PROFILE_DEBUG;
+    bool verboseValidation = false; // verbose & info messages too, not just warnings & errors
+    bool debugLabels = V3RSE_DEBUG_LABELS;
+    bool profiling = V3RSE_PROFILING;
+
+    // constant false when compiled out: whatever they guard is dead code.
+    [[nodiscard]] bool validationEnabled() const { return V3RSE_VALIDATION && validation; }
+    [[nodiscard]] bool debugLabelsEnabled() const { return V3RSE_DEBUG_LABELS && debugLabels; }
+    [[nodiscard]] bool profilingEnabled() const { return V3RSE_PROFILING && profiling; }
+    [[nodiscard]] static constexpr bool assertsEnabled() { return V3RSE_ASSERTS; }
+
+    void readEnvironment() {
+        if (const char* value = std::getenv("V3RSE_VALIDATION")) {
+            std::string_view v = value;
+            validation = v != "0";
+            verboseValidation = v == "verbose";
+            if (validation && !V3RSE_VALIDATION) spdlog::warn("V3RSE_VALIDATION: validation is not in {} builds", name);
+        }
+        read("V3RSE_DEBUG_LABELS", debugLabels, V3RSE_DEBUG_LABELS);
+        read("V3RSE_PROFILING", profiling, V3RSE_PROFILING);
+    }
+
+private:
+    static void read(const char* variable, bool& flag, bool compiled) {
+        const char* value = std::getenv(variable);
+        if (!value) return;
+        flag = std::string_view(value) != "0";
+        if (flag && !compiled) spdlog::warn("{}: not in {} builds", variable, name);
+    }
+};
+
+inline BuildProfile buildProfile;
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+// Fixed simulation ticks out of a variable frame rate: every frame adds the wall time since the previous one to an
+// accumulator, steps() takes the whole ticks out of it, and what is left, as a fraction of a tick, is alpha(): how
+// far the frame lies between the last two simulated states. a frame runs maxSteps ticks at most, the rest of a
+// longer backlog is dropped: a tick slower than its period can't make every next frame run more of them (the spiral
+// of death), the simulation slows down instead. without a rate, every frame is one tick of the frame's length.
+class FixedTimestep {
+public:
+    using clock = std::chrono::steady_clock;
+
+    void setRate(double hz, uint32_t maxStepsPerFrame) {
+        period = hz > 0.0 ? std::chrono::nanoseconds((int64_t) (1e9 / hz)) : std::chrono::nanoseconds(0);
+        maxSteps = std::max(maxStepsPerFrame, 1u);
+        reset();
+    }
+
+    [[nodiscard]] bool enabled() const {
+        return period.count() != 0;
+    }
+
+    // forgets the time since the last frame, e.g. after a pause.
+    void reset() {
+        last = clock::now();
+        accumulator = std::chrono::nanoseconds(0);
+        delta = std::chrono::nanoseconds(0);
+    }
+
+    // the ticks due this frame.
+    uint32_t steps() {
+        auto now = clock::now();
+        delta = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last);
+        last = now;
+        if (!enabled()) {
+            ticks++;
+            return 1;
+        }
+
+        accumulator += delta;
+        auto due = static_cast<uint64_t>(accumulator / period);
+        accumulator %= period; // the fraction of a tick left
+        if (due > maxSteps) {
+            dropped += static_cast<int64_t>(due - maxSteps) * period;
+            due = maxSteps;
+        }
+        ticks += due;
+        return static_cast<uint32_t>(due);
+    }
+
+    // length of one tick, in seconds.
+    [[nodiscard]] double seconds() const {
+        return (double) (enabled() ? period : delta).count() / 1e9;
+    }
+
+    // 0 at the last tick's state, 1 at the one after it.
+    [[nodiscard]] double alpha() const {
+        return enabled() ? (double) accumulator.count() / (double) period.count() : 1.0;
+    }
+
+    [[nodiscard]] uint64_t tickCount() const {
+        return ticks;
+    }
+
+    // simulation time given up by the catch up limit.
+    [[nodiscard]] std::chrono::nanoseconds droppedTime() const {
+        return dropped;
+    }
+
+private:
+    std::chrono::nanoseconds period {0};
+    uint32_t maxSteps = 1;
+    clock::time_point last = clock::now();
+    std::chrono::nanoseconds accumulator {0};
+    std::chrono::nanoseconds delta {0};
+    std::chrono::nanoseconds dropped {0};
+    uint64_t ticks = 0;
+};
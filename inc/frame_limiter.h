@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+// Caps the frame rate by sleeping until the next frame is due, as late as possible: the OS sleep oversleeps by a
+// varying amount, so the limiter sleeps until the deadline minus its measured oversleep, and only busy-waits the
+// last few hundred microseconds. input sampled right after wait() is then as fresh as the cap allows.
+class FrameLimiter {
+public:
+    using clock = std::chrono::steady_clock;
+
+    void setRate(double hz) {
+        period = hz > 0.0 ? std::chrono::nanoseconds((int64_t) (1e9 / hz)) : std::chrono::nanoseconds(0);
+        next = clock::now();
+    }
+
+    [[nodiscard]] bool enabled() const {
+        return period.count() != 0;
+    }
+
+    // returns the time spent waiting.
+    std::chrono::nanoseconds wait() {
+        if (!enabled()) return std::chrono::nanoseconds(0);
+
+        auto start = clock::now();
+        next += period;
+        if (next < start - period) next = start; // fell behind: no burst of catch-up frames
+
+        auto wake = next - oversleep - spin;
+        if (wake > start) {
+            std::this_thread::sleep_until(wake);
+            auto late = clock::now() - wake;
+
+            // exponential average, kept within a frame so a single hiccup can't disable the sleep.
+            oversleep += (std::chrono::duration_cast<std::chrono::nanoseconds>(late) - oversleep) / 8;
+            oversleep = std::clamp(oversleep, std::chrono::nanoseconds(0), period);
+        }
+
+        while (clock::now() < next) std::this_thread::yield();
+
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+    }
+
+private:
+    static constexpr std::chrono::nanoseconds spin = std::chrono::microseconds(200);
+
+    std::chrono::nanoseconds period {0};
+    std::chrono::nanoseconds oversleep = std::chrono::microseconds(500);
+    clock::time_point next = clock::now();
+};
@@ -4,9 +4,11 @@
 
 #include <GLFW/glfw3.h>
 
-#define GLFW_EXPOSE_NATIVE_WIN32
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
+    #define GLFW_EXPOSE_NATIVE_WIN32
 
-#include <GLFW/glfw3native.h>
+    #include <GLFW/glfw3native.h>
+#endif
 
 // TODO: check that the compilers are actually inlining the code and that it actually makes
 //  a difference in performance.
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+
+    #include <windows.h>
+    #include <psapi.h>
+#endif
+
+// Resident memory of the process, in bytes. peak is the high water mark since the last resetPeak(), anonymous the
+// private memory (heap & stacks) currently resident, i.e. what a file mapping doesn't count towards.
+struct MemoryUsage {
+    uint64_t resident = 0;
+    uint64_t peak = 0;
+    uint64_t anonymous = 0;
+
+    static MemoryUsage sample() {
+        MemoryUsage usage {};
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS_EX counters {};
+        if (GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+                                 sizeof(counters))) {
+            usage.resident = counters.WorkingSetSize;
+            usage.peak = counters.PeakWorkingSetSize;
+            usage.anonymous = counters.PrivateUsage;
+        }
+#else
+        FILE* status = fopen("/proc/self/status", "r");
+        if (!status) return usage;
+
+        char line[256];
+        while (fgets(line, sizeof(line), status)) {
+            unsigned long long kb;
+            if (sscanf(line, "VmRSS: %llu kB", &kb) == 1) usage.resident = kb * 1024;
+            else if (sscanf(line, "VmHWM: %llu kB", &kb) == 1) usage.peak = kb * 1024;
+            else if (sscanf(line, "RssAnon: %llu kB", &kb) == 1) usage.anonymous = kb * 1024;
+        }
+        fclose(status);
+#endif
+        return usage;
+    }
+
+    // restarts the peak from the current resident size. linux only (clear_refs), windows keeps the process peak.
+    static void resetPeak() {
+#if !defined(_WIN32)
+        FILE* clearRefs = fopen("/proc/self/clear_refs", "w");
+        if (!clearRefs) return;
+        fputs("5", clearRefs);
+        fclose(clearRefs);
+#endif
+    }
+};
@@ -0,0 +1,358 @@
+#pragma once
+
+#include "build_profile.h"
+#include "logging.h"
+
+#include <array>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+
+// Per-frame CPU timings: every frame keeps the duration of its phases (acquire, record, submit, present), and
+// every timed scope is kept as an event so the whole run can be exported as a Chrome trace (chrome://tracing,
+// ui.perfetto.dev). percentiles & histograms are computed over the recorded frames, not averaged on the fly.
+// GPU times arrive a few frames late (VK_QUERY.h) and are attached to the frame that recorded them.
+class FrameProfiler {
+public:
+    enum Phase : uint32_t {
+        ACQUIRE,
+        RECORD,
+        SUBMIT,
+        PRESENT,
+        PHASE_COUNT
+    };
+
+    static constexpr const char* phaseNames[PHASE_COUNT] = {"acquire", "record", "submit", "present"};
+
+    struct Frame {
+        uint64_t index = 0;
+        int64_t start = 0; // ns since the profiler was created
+        int64_t input = 0; // when its input was sampled, before start when another thread produced the frame
+        int64_t total = 0;
+        std::array<int64_t, PHASE_COUNT> phases {};
+        int64_t gpu = -1; // -1 until the gpu profiler has read it back
+        int64_t latency = -1; // input sampled to the end of its gpu work
+        uint32_t ticks = 0; // simulation ticks run for it
+    };
+
+    // pseudo phases for percentiles() & histogram(). TICK is the duration of every simulation tick, not per frame.
+    static constexpr int32_t TOTAL = -1;
+    static constexpr int32_t GPU = -2;
+    static constexpr int32_t LATENCY = -3;
+    static constexpr int32_t TICK = -4;
+
+    // trace track of gpu events, far from the cpu thread ids.
+    static constexpr uint32_t gpuTrack = 1000;
+
+    struct Event {
+        const char* name;
+        const char* category;
+        uint32_t thread;
+        int64_t start;
+        int64_t duration;
+    };
+
+    struct Percentiles {
+        int64_t p50 = 0;
+        int64_t p95 = 0;
+        int64_t p99 = 0;
+        int64_t max = 0;
+    };
+
+    // histogram bucket width and count, the last bucket collects everything above.
+    static constexpr int64_t histogramBucketNs = 250000;
+    static constexpr uint32_t histogramBuckets = 68;
+
+    bool enabled = true; // from buildProfile, set by RenderEngine::init()
+    bool tracing = false; // keep individual events for the chrome trace export
+    size_t maxFrames = 1 << 20;
+
+    class Scope {
+    public:
+        Scope(FrameProfiler& profiler, const char* name, const char* category, int32_t phase)
+            : profiler(profiler), name(name), category(category), phase(phase),
+              start(profiler.active() ? profiler.now() : 0) {}
+
+        Scope(const Scope&) = delete;
+
+        ~Scope() {
+            if (profiler.active()) profiler.record(name, category, phase, start, profiler.now() - start);
+        }
+
+    private:
+        FrameProfiler& profiler;
+        const char* name;
+        const char* category;
+        int32_t phase;
+        int64_t start;
+    };
+
+    FrameProfiler() : epoch(std::chrono::steady_clock::now()) {}
+
+    // never in release builds: the recording calls below compile to nothing.
+    [[nodiscard]] bool active() const {
+        return V3RSE_PROFILING && enabled;
+    }
+
+    [[nodiscard]] int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    // converts a steady_clock time point to the profiler's timeline.
+    [[nodiscard]] int64_t toProfilerTime(std::chrono::steady_clock::time_point time) const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch).count();
+    }
+
+    Scope scope(const char* name, const char* category = "cpu") {
+        return {*this, name, category, -1};
+    }
+
+    // input: when the frame's input was sampled, on the profiler timeline. the frame start by default. ticks: the
+    // simulation ticks run for it, already recorded with tick().
+    void beginFrame(int64_t input = -1, uint32_t ticks = 0) {
+        if (!active()) return;
+        current = Frame {};
+        current.index = frameIndex++;
+        current.start = now();
+        current.input = input < 0 ? current.start : input;
+        current.ticks = ticks;
+    }
+
+    // a simulation tick, from the thread that simulates: frames may be rendered on another one.
+    void tick(int64_t start, int64_t duration) {
+        if (!active()) return;
+        {
+            std::lock_guard lock(mutex);
+            if (ticks.size() < maxFrames) ticks.push_back(duration);
+        }
+        event("tick", "simulation", start, duration);
+    }
+
+    [[nodiscard]] uint64_t tickCount() const {
+        std::lock_guard lock(mutex);
+        return ticks.size();
+    }
+
+    // ends the running phase and starts the next one: the phases of a frame run back to back, and the last one
+    // ends with the frame, whichever way the frame returns.
+    void phase(Phase next) {
+        if (!active()) return;
+        int64_t t = now();
+        endPhase(t);
+        running = (int32_t) next;
+        runningStart = t;
+    }
+
+    void endFrame() {
+        if (!active()) return;
+        int64_t t = now();
+        endPhase(t);
+        current.total = t - current.start;
+
+        if (frames.size() < maxFrames) frames.push_back(current);
+        if (tracing) event("frame", "frame", current.start, current.total);
+    }
+
+    [[nodiscard]] uint64_t currentFrame() const {
+        return current.index;
+    }
+
+    [[nodiscard]] uint64_t nextFrame() const {
+        return frameIndex;
+    }
+
+    // gpu time of a frame that already ended, looked up from the most recent one. end is on the profiler timeline.
+    void gpuFrame(uint64_t index, int64_t duration, int64_t end) {
+        for (auto it = frames.rbegin(); it != frames.rend() && it->index >= index; ++it) {
+            if (it->index == index) {
+                it->gpu = duration;
+                it->latency = end - it->input;
+                return;
+            }
+        }
+    }
+
+    // adds an event with explicit timestamps, from any thread.
+    void event(const char* name, const char* category, int64_t start, int64_t duration) {
+        event(name, category, start, duration, threadId());
+    }
+
+    void event(const char* name, const char* category, int64_t start, int64_t duration, uint32_t track) {
+        if (!active() || !tracing) return;
+        std::lock_guard lock(mutex);
+        events.push_back({name, category, track, start, duration});
+    }
+
+    void record(const char* name, const char* category, int32_t phase, int64_t start, int64_t duration) {
+        if (!active()) return;
+        if (phase >= 0) current.phases[phase] += duration;
+        event(name, category, start, duration);
+    }
+
+    void clear() {
+        std::lock_guard lock(mutex);
+        frames.clear();
+        events.clear();
+        ticks.clear();
+    }
+
+    [[nodiscard]] const std::vector<Frame>& recordedFrames() const {
+        return frames;
+    }
+
+    // percentiles of a per-frame value: a phase, TOTAL, GPU or LATENCY, over the frames from index since. of the
+    // ticks from index since for TICK.
+    [[nodiscard]] Percentiles percentiles(int32_t phase = TOTAL, uint64_t since = 0) const {
+        std::vector<int64_t> values = collect(phase, since);
+        if (values.empty()) return {};
+
+        std::sort(values.begin(), values.end());
+        auto at = [&](double p) {
+            return values[std::min(values.size() - 1, (size_t) (p * (double) values.size()))];
+        };
+        return {at(0.50), at(0.95), at(0.99), values.back()};
+    }
+
+    [[nodiscard]] std::array<uint32_t, histogramBuckets> histogram(int32_t phase = TOTAL) const {
+        std::array<uint32_t, histogramBuckets> buckets {};
+        for (int64_t v: collect(phase, 0)) {
+            buckets[std::min<int64_t>(v / histogramBucketNs, histogramBuckets - 1)]++;
+        }
+        return buckets;
+    }
+
+    void print() const {
+        if (frames.empty()) return;
+
+        auto line = [&](const char* name, int32_t phase) {
+            Percentiles p = percentiles(phase);
+            info("{:>8}: p50 {:8.3f} ms  p95 {:8.3f} ms  p99 {:8.3f} ms  max {:8.3f} ms", name, p.p50 / 1e6,
+                 p.p95 / 1e6, p.p99 / 1e6, p.max / 1e6);
+        };
+
+        info("{} frames:", frames.size());
+        line("frame", TOTAL);
+        for (uint32_t i = 0; i < PHASE_COUNT; i++) line(phaseNames[i], (int32_t) i);
+
+        // acquire is spent waiting on the gpu, the rest of the frame is the cpu's own work.
+        uint32_t cpuBound = 0;
+        uint32_t gpuBound = 0;
+        for (const Frame& f: frames) {
+            if (f.gpu < 0) continue;
+            if (f.gpu > f.total - f.phases[ACQUIRE]) gpuBound++;
+            else cpuBound++;
+        }
+        if (cpuBound + gpuBound) {
+            line("gpu", GPU);
+            line("latency", LATENCY);
+            info("{} cpu-bound frames, {} gpu-bound frames", cpuBound, gpuBound);
+        }
+        if (tickCount()) {
+            line("tick", TICK);
+            info("{} simulation ticks, {:.2f} per frame", tickCount(), (double) tickCount() / (double) frames.size());
+        }
+
+        std::array<uint32_t, histogramBuckets> buckets = histogram();
+        uint32_t highest = *std::max_element(buckets.begin(), buckets.end());
+        for (uint32_t i = 0; i < histogramBuckets; i++) {
+            if (buckets[i] == 0) continue;
+            info("{:6.2f}{} ms | {:<50} {}", (double) (i * histogramBucketNs) / 1e6,
+                 i == histogramBuckets - 1 ? "+" : " ",
+                 std::string(std::max<size_t>(1, (size_t) buckets[i] * 50 / highest), '#'), buckets[i]);
+        }
+    }
+
+    bool exportCSV(const std::string& path) const {
+        std::ofstream file(path);
+        if (!file.is_open()) return false;
+        file << std::fixed << std::setprecision(3);
+
+        file << "frame,start_us,total_us";
+        for (const char* name: phaseNames) file << "," << name << "_us";
+        file << ",gpu_us,latency_us,ticks\n";
+
+        for (const Frame& f: frames) {
+            file << f.index << "," << f.start / 1e3 << "," << f.total / 1e3;
+            for (int64_t phase: f.phases) file << "," << phase / 1e3;
+            file << ",";
+            if (f.gpu >= 0) file << f.gpu / 1e3;
+            file << ",";
+            if (f.latency >= 0) file << f.latency / 1e3;
+            file << "," << f.ticks << "\n";
+        }
+        return true;
+    }
+
+    // trace event format, complete ("X") events in microseconds.
+    bool exportChromeTrace(const std::string& path) const {
+        std::ofstream file(path);
+        if (!file.is_open()) return false;
+
+        std::lock_guard lock(mutex);
+        file << std::fixed << std::setprecision(3);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << gpuTrack
+             << ",\"args\":{\"name\":\"gpu\"}},\n";
+        for (size_t i = 0; i < events.size(); i++) {
+            const Event& e = events[i];
+            file << "{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                 << e.thread << ",\"ts\":" << e.start / 1e3 << ",\"dur\":" << e.duration / 1e3 << "}"
+                 << (i + 1 < events.size() ? ",\n" : "\n");
+        }
+        file << "]}\n";
+        return true;
+    }
+
+private:
+    std::chrono::steady_clock::time_point epoch;
+
+    Frame current {};
+    uint64_t frameIndex = 0;
+    int32_t running = -1;
+    int64_t runningStart = 0;
+    std::vector<Frame> frames;
+
+    mutable std::mutex mutex;
+    std::vector<Event> events;
+    std::vector<int64_t> ticks;
+
+    void endPhase(int64_t t) {
+        if (running < 0) return;
+        record(phaseNames[running], "frame", running, runningStart, t - runningStart);
+        running = -1;
+    }
+
+    // small sequential ids, the trace viewer sorts threads by them.
+    static uint32_t threadId() {
+        static std::atomic<uint32_t> next = 0;
+        thread_local uint32_t id = next++;
+        return id;
+    }
+
+    [[nodiscard]] std::vector<int64_t> collect(int32_t phase, uint64_t since) const {
+        std::vector<int64_t> values;
+        if (phase == TICK) {
+            std::lock_guard lock(mutex);
+            if (since < ticks.size()) values.assign(ticks.begin() + (ptrdiff_t) since, ticks.end());
+            return values;
+        }
+
+        values.reserve(frames.size());
+        for (const Frame& f: frames) {
+            if (f.index < since) continue;
+            if (phase == GPU) {
+                if (f.gpu >= 0) values.push_back(f.gpu);
+            } else if (phase == LATENCY) {
+                if (f.latency >= 0) values.push_back(f.latency);
+            } else values.push_back(phase == TOTAL ? f.total : f.phases[phase]);
+        }
+        return values;
+    }
+};
+
+inline FrameProfiler frameProfiler;
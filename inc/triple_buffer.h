@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock free handoff of the latest value from one producer thread to one consumer thread.
+//
+// three slots: the producer fills its back slot, the consumer reads its front slot, and the third sits in between.
+// publish() swaps the back slot with the middle one and marks it fresh, take() swaps the front slot with the middle
+// one when it is fresh. neither swap waits on the other side: a value published twice before being taken is
+// replaced by the newer one. the blocking waits are for a side with nothing to do, on the middle slot's atomic.
+template<typename T>
+class TripleBuffer {
+public:
+    // the slot the producer fills, holding whatever it held three publishes ago.
+    T& back() {
+        return slots[backIndex];
+    }
+
+    // hands back() over to the consumer. false when it replaced a value that was never taken.
+    bool publish() {
+        uint8_t previous = middle.exchange(backIndex | fresh, std::memory_order_acq_rel);
+        backIndex = previous & indexMask;
+        middle.notify_all();
+        return !(previous & fresh);
+    }
+
+    // the consumer's value, from its last take().
+    const T& front() const {
+        return slots[frontIndex];
+    }
+
+    // makes front() the latest published value. false when nothing was published since the last take().
+    bool take() {
+        if (!(middle.load(std::memory_order_relaxed) & fresh)) return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & indexMask;
+        middle.notify_all();
+        return true;
+    }
+
+    // take(), once something is published. only the consumer clears the fresh bit: once seen, it stays.
+    void waitPublished() {
+        uint8_t current;
+        while (!((current = middle.load(std::memory_order_acquire)) & fresh)) middle.wait(current);
+        take();
+    }
+
+    // for the producer: returns once the last published value was taken, so the next publish replaces nothing.
+    void waitTaken() const {
+        uint8_t current;
+        while ((current = middle.load(std::memory_order_acquire)) & fresh) middle.wait(current);
+    }
+
+private:
+    static constexpr uint8_t indexMask = 3;
+    static constexpr uint8_t fresh = 4;
+
+    std::array<T, 3> slots {};
+    uint8_t backIndex = 0; // producer only
+    uint8_t frontIndex = 1; // consumer only
+    alignas(64) std::atomic<uint8_t> middle = 2;
+};
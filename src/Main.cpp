@@ -1,15 +1,49 @@
-
 #include "RenderEngine/RenderEngine.h"
 #include "logging.h"
+#include "async_log.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <string_view>
 
 class App {
 public:
+    bool benchmark = false;
+    uint64_t frames = 0;
+    const char* capture = nullptr;
+    const char* profileCSV = nullptr;
+    const char* profileTrace = nullptr;
+
     void run() {
         RenderEngine::init();
 
-        //RenderEngine::loop();
+        if (benchmark) {
+            RenderEngine::benchmark_frames_in_flight();
+            RenderEngine::benchmark_recording();
+            RenderEngine::benchmark_jobs();
+            RenderEngine::benchmark_present_policies();
+            RenderEngine::benchmark_vertex_fetch();
+            RenderEngine::benchmark_mesh_loading();
+            RenderEngine::benchmark_indirect();
+            RenderEngine::benchmark_scene();
+            RenderEngine::benchmark_culling();
+            RenderEngine::benchmark_render_graph();
+            RenderEngine::benchmark_dynamic_rendering();
+            RenderEngine::benchmark_render_thread();
+            RenderEngine::benchmark_fixed_timestep();
+            RenderEngine::benchmark_logging();
+            RenderEngine::benchmark_build_profile();
+            RenderEngine::benchmark_frame_data();
+        } else RenderEngine::loop(frames);
+
+        if (capture) RenderEngine::capture_frame(capture);
+
+        frameProfiler.print();
+        if (profileCSV && !frameProfiler.exportCSV(profileCSV)) spdlog::warn("failed to write {}", profileCSV);
+        if (profileTrace && !frameProfiler.exportChromeTrace(profileTrace))
+            spdlog::warn("failed to write {}", profileTrace);
 
-        //exit();
+        exit();
     }
 
 private:
@@ -25,16 +59,51 @@ private:
     }
 };
 
-int main() {
+int main(int argc, char** argv) {
     App app {};
 
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+
+        if (arg == "--benchmark") app.benchmark = true;
+        else if (arg == "--headless") RenderEngine::headless = true;
+        else if (arg == "--frames" && i + 1 < argc) app.frames = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--capture" && i + 1 < argc) app.capture = argv[++i];
+        else if (arg == "--legacy-render-pass") RenderEngine::legacyRenderPass = true;
+        else if (arg == "--render-thread") RenderEngine::renderThread = true;
+        else if (arg == "--async-log") RenderEngine::asyncLogging = true;
+        else if (arg == "--mesh" && i + 1 < argc) RenderEngine::meshPath = argv[++i];
+        else if (arg == "--profile-csv" && i + 1 < argc) app.profileCSV = argv[++i];
+        else if (arg == "--profile-trace" && i + 1 < argc) {
+            app.profileTrace = argv[++i];
+            frameProfiler.tracing = true;
+        } else if (arg == "--job-threads" && i + 1 < argc)
+            RenderEngine::jobThreads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--record-threads" && i + 1 < argc)
+            RenderEngine::recordThreads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--frames-in-flight" && i + 1 < argc)
+            RenderEngine::framesInFlight = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--fps-limit" && i + 1 < argc) RenderEngine::frameRateLimit = std::atof(argv[++i]);
+        else if (arg == "--tick-rate" && i + 1 < argc) RenderEngine::tickRate = std::atof(argv[++i]);
+        else if (arg == "--max-ticks" && i + 1 < argc)
+            RenderEngine::maxTicksPerFrame = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--present-policy" && i + 1 < argc) {
+            std::string_view policy = argv[++i];
+            if (policy == "low-latency") RenderEngine::presentPolicy = RenderEngine::PresentPolicy::LOW_LATENCY;
+            else if (policy == "throughput") RenderEngine::presentPolicy = RenderEngine::PresentPolicy::THROUGHPUT;
+            else if (policy == "power-saving") RenderEngine::presentPolicy = RenderEngine::PresentPolicy::POWER_SAVING;
+            else spdlog::warn("unknown present policy {}", policy);
+        }
+    }
+
     try {
         app.run();
     } catch (const std::exception& e) {
+        asyncLog.stop();
         spdlog::error(e.what());
         spdlog::error("\n");
         return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
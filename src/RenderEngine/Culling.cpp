@@ -0,0 +1,361 @@
+#include "Culling.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CULLING_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CULLING_NEON
+#include <arm_neon.h>
+#endif
+
+// avx2 kernels are compiled for avx2 whatever the target, and only called once the cpu is known to support it.
+#if defined(CULLING_X86) && !defined(_MSC_VER)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+Culling::Frustum Culling::Frustum::fromMatrix(const mat4x4& viewProjection) {
+    mat4x4 t = glm::transpose(viewProjection);
+    Frustum frustum {{t[3] + t[0], t[3] - t[0], t[3] + t[1], t[3] - t[1], t[2], t[3] - t[2]}};
+    for (vec4& plane: frustum.planes) plane /= glm::length(vec3(plane));
+    return frustum;
+}
+
+Culling::Spheres Culling::spheres(const Scene::Bounds& bounds) {
+    return {bounds.centerX.data(), bounds.centerY.data(), bounds.centerZ.data(), bounds.radius.data(),
+            static_cast<uint32_t>(bounds.radius.size())};
+}
+
+Culling::Boxes Culling::boxes(const Scene::Bounds& bounds) {
+    return {bounds.centerX.data(), bounds.centerY.data(), bounds.centerZ.data(), bounds.extentX.data(),
+            bounds.extentY.data(), bounds.extentZ.data(), static_cast<uint32_t>(bounds.centerX.size())};
+}
+
+// appends the lanes set in mask, lowest first.
+static inline uint32_t compact(uint32_t mask, uint32_t first, uint32_t* visible, uint32_t count) {
+    while (mask) {
+#ifdef _MSC_VER
+        unsigned long lane;
+        _BitScanForward(&lane, mask);
+#else
+        uint32_t lane = __builtin_ctz(mask);
+#endif
+        visible[count++] = first + lane;
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// scalar, also the tail of the wider kernels
+
+static uint32_t cullScalar(const Culling::Frustum& frustum, const Culling::Spheres& s, uint32_t first,
+                           uint32_t* visible, uint32_t count) {
+    for (uint32_t i = first; i < s.count; i++) {
+        bool inside = true;
+        for (const vec4& p: frustum.planes) {
+            inside &= p.x * s.centerX[i] + p.y * s.centerY[i] + p.z * s.centerZ[i] + p.w >= -s.radius[i];
+        }
+        if (inside) visible[count++] = i;
+    }
+    return count;
+}
+
+static uint32_t cullScalar(const Culling::Frustum& frustum, const Culling::Boxes& b, uint32_t first,
+                           uint32_t* visible, uint32_t count) {
+    for (uint32_t i = first; i < b.count; i++) {
+        bool inside = true;
+        for (const vec4& p: frustum.planes) {
+            float radius = std::abs(p.x) * b.extentX[i] + std::abs(p.y) * b.extentY[i] + std::abs(p.z) * b.extentZ[i];
+            inside &= p.x * b.centerX[i] + p.y * b.centerY[i] + p.z * b.centerZ[i] + p.w >= -radius;
+        }
+        if (inside) visible[count++] = i;
+    }
+    return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// sse & avx2: a lane per volume, a broadcast per plane component. products & sums stay separate (no fma), in the
+// scalar kernel's order: every kernel rounds alike.
+
+#ifdef CULLING_X86
+static uint32_t cullSSE(const Culling::Frustum& frustum, const Culling::Spheres& s, uint32_t* visible) {
+    uint32_t count = 0;
+    uint32_t i = 0;
+    for (; i + 4 <= s.count; i += 4) {
+        __m128 x = _mm_loadu_ps(s.centerX + i);
+        __m128 y = _mm_loadu_ps(s.centerY + i);
+        __m128 z = _mm_loadu_ps(s.centerZ + i);
+        __m128 r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(s.radius + i));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const vec4& p: frustum.planes) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x), x),
+                                                        _mm_mul_ps(_mm_set1_ps(p.y), y)),
+                                             _mm_mul_ps(_mm_set1_ps(p.z), z)), _mm_set1_ps(p.w));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, r));
+        }
+        count = compact(_mm_movemask_ps(inside), i, visible, count);
+    }
+    return cullScalar(frustum, s, i, visible, count);
+}
+
+static uint32_t cullSSE(const Culling::Frustum& frustum, const Culling::Boxes& b, uint32_t* visible) {
+    uint32_t count = 0;
+    uint32_t i = 0;
+    for (; i + 4 <= b.count; i += 4) {
+        __m128 x = _mm_loadu_ps(b.centerX + i);
+        __m128 y = _mm_loadu_ps(b.centerY + i);
+        __m128 z = _mm_loadu_ps(b.centerZ + i);
+        __m128 ex = _mm_loadu_ps(b.extentX + i);
+        __m128 ey = _mm_loadu_ps(b.extentY + i);
+        __m128 ez = _mm_loadu_ps(b.extentZ + i);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const vec4& p: frustum.planes) {
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(p.x)), ex),
+                                                  _mm_mul_ps(_mm_set1_ps(std::abs(p.y)), ey)),
+                                       _mm_mul_ps(_mm_set1_ps(std::abs(p.z)), ez));
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x), x),
+                                                        _mm_mul_ps(_mm_set1_ps(p.y), y)),
+                                             _mm_mul_ps(_mm_set1_ps(p.z), z)), _mm_set1_ps(p.w));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_sub_ps(_mm_setzero_ps(), radius)));
+        }
+        count = compact(_mm_movemask_ps(inside), i, visible, count);
+    }
+    return cullScalar(frustum, b, i, visible, count);
+}
+
+TARGET_AVX2 static uint32_t cullAVX2(const Culling::Frustum& frustum, const Culling::Spheres& s, uint32_t* visible) {
+    uint32_t count = 0;
+    uint32_t i = 0;
+    for (; i + 8 <= s.count; i += 8) {
+        __m256 x = _mm256_loadu_ps(s.centerX + i);
+        __m256 y = _mm256_loadu_ps(s.centerY + i);
+        __m256 z = _mm256_loadu_ps(s.centerZ + i);
+        __m256 r = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(s.radius + i));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const vec4& p: frustum.planes) {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.x), x),
+                                                                 _mm256_mul_ps(_mm256_set1_ps(p.y), y)),
+                                                   _mm256_mul_ps(_mm256_set1_ps(p.z), z)), _mm256_set1_ps(p.w));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, r, _CMP_GE_OQ));
+        }
+        count = compact(_mm256_movemask_ps(inside), i, visible, count);
+    }
+    return cullScalar(frustum, s, i, visible, count);
+}
+
+TARGET_AVX2 static uint32_t cullAVX2(const Culling::Frustum& frustum, const Culling::Boxes& b, uint32_t* visible) {
+    uint32_t count = 0;
+    uint32_t i = 0;
+    for (; i + 8 <= b.count; i += 8) {
+        __m256 x = _mm256_loadu_ps(b.centerX + i);
+        __m256 y = _mm256_loadu_ps(b.centerY + i);
+        __m256 z = _mm256_loadu_ps(b.centerZ + i);
+        __m256 ex = _mm256_loadu_ps(b.extentX + i);
+        __m256 ey = _mm256_loadu_ps(b.extentY + i);
+        __m256 ez = _mm256_loadu_ps(b.extentZ + i);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const vec4& p: frustum.planes) {
+            __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::abs(p.x)), ex),
+                                                        _mm256_mul_ps(_mm256_set1_ps(std::abs(p.y)), ey)),
+                                          _mm256_mul_ps(_mm256_set1_ps(std::abs(p.z)), ez));
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.x), x),
+                                                                 _mm256_mul_ps(_mm256_set1_ps(p.y), y)),
+                                                   _mm256_mul_ps(_mm256_set1_ps(p.z), z)), _mm256_set1_ps(p.w));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_sub_ps(_mm256_setzero_ps(), radius), _CMP_GE_OQ));
+        }
+        count = compact(_mm256_movemask_ps(inside), i, visible, count);
+    }
+    return cullScalar(frustum, b, i, visible, count);
+}
+
+static bool cpuHasAVX2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = info[2] & (1 << 27);
+    bool avx = info[2] & (1 << 28);
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false; // the os saves the ymm registers
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// neon
+
+#ifdef CULLING_NEON
+static inline uint32_t movemask(uint32x4_t mask) {
+    static const uint32_t bits[4] = {1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(mask, vld1q_u32(bits)));
+}
+
+static uint32_t cullNEON(const Culling::Frustum& frustum, const Culling::Spheres& s, uint32_t* visible) {
+    uint32_t count = 0;
+    uint32_t i = 0;
+    for (; i + 4 <= s.count; i += 4) {
+        float32x4_t x = vld1q_f32(s.centerX + i);
+        float32x4_t y = vld1q_f32(s.centerY + i);
+        float32x4_t z = vld1q_f32(s.centerZ + i);
+        float32x4_t r = vnegq_f32(vld1q_f32(s.radius + i));
+        uint32x4_t inside = vdupq_n_u32(~0u);
+        for (const vec4& p: frustum.planes) {
+            float32x4_t d = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_n_f32(x, p.x), vmulq_n_f32(y, p.y)),
+                                                vmulq_n_f32(z, p.z)), vdupq_n_f32(p.w));
+            inside = vandq_u32(inside, vcgeq_f32(d, r));
+        }
+        count = compact(movemask(inside), i, visible, count);
+    }
+    return cullScalar(frustum, s, i, visible, count);
+}
+
+static uint32_t cullNEON(const Culling::Frustum& frustum, const Culling::Boxes& b, uint32_t* visible) {
+    uint32_t count = 0;
+    uint32_t i = 0;
+    for (; i + 4 <= b.count; i += 4) {
+        float32x4_t x = vld1q_f32(b.centerX + i);
+        float32x4_t y = vld1q_f32(b.centerY + i);
+        float32x4_t z = vld1q_f32(b.centerZ + i);
+        float32x4_t ex = vld1q_f32(b.extentX + i);
+        float32x4_t ey = vld1q_f32(b.extentY + i);
+        float32x4_t ez = vld1q_f32(b.extentZ + i);
+        uint32x4_t inside = vdupq_n_u32(~0u);
+        for (const vec4& p: frustum.planes) {
+            float32x4_t radius = vaddq_f32(vaddq_f32(vmulq_n_f32(ex, std::abs(p.x)), vmulq_n_f32(ey, std::abs(p.y))),
+                                           vmulq_n_f32(ez, std::abs(p.z)));
+            float32x4_t d = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_n_f32(x, p.x), vmulq_n_f32(y, p.y)),
+                                                vmulq_n_f32(z, p.z)), vdupq_n_f32(p.w));
+            inside = vandq_u32(inside, vcgeq_f32(d, vnegq_f32(radius)));
+        }
+        count = compact(movemask(inside), i, visible, count);
+    }
+    return cullScalar(frustum, b, i, visible, count);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// dispatch
+
+bool Culling::supported(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::SCALAR:
+            return true;
+#ifdef CULLING_X86
+        case Kernel::SSE:
+            return true;
+        case Kernel::AVX2: {
+            static const bool avx2 = cpuHasAVX2();
+            return avx2;
+        }
+#endif
+#ifdef CULLING_NEON
+        case Kernel::NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+Culling::Kernel Culling::best() {
+    for (Kernel kernel: {Kernel::AVX2, Kernel::NEON, Kernel::SSE}) {
+        if (supported(kernel)) return kernel;
+    }
+    return Kernel::SCALAR;
+}
+
+const char* Culling::name(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::SCALAR:
+            return "scalar";
+        case Kernel::SSE:
+            return "sse";
+        case Kernel::AVX2:
+            return "avx2";
+        case Kernel::NEON:
+            return "neon";
+    }
+    return "?";
+}
+
+// a kernel the cpu doesn't have falls back to the scalar one.
+template<typename Volumes>
+static uint32_t dispatch(const Culling::Frustum& frustum, const Volumes& volumes, uint32_t* visible,
+                         Culling::Kernel kernel) {
+    if (!Culling::supported(kernel)) kernel = Culling::Kernel::SCALAR;
+
+    switch (kernel) {
+#ifdef CULLING_X86
+        case Culling::Kernel::SSE:
+            return cullSSE(frustum, volumes, visible);
+        case Culling::Kernel::AVX2:
+            return cullAVX2(frustum, volumes, visible);
+#endif
+#ifdef CULLING_NEON
+        case Culling::Kernel::NEON:
+            return cullNEON(frustum, volumes, visible);
+#endif
+        default:
+            return cullScalar(frustum, volumes, 0, visible, 0);
+    }
+}
+
+uint32_t Culling::cull(const Frustum& frustum, const Spheres& spheres, uint32_t* visible, Kernel kernel) {
+    return dispatch(frustum, spheres, visible, kernel);
+}
+
+uint32_t Culling::cull(const Frustum& frustum, const Boxes& boxes, uint32_t* visible, Kernel kernel) {
+    return dispatch(frustum, boxes, visible, kernel);
+}
+
+static Culling::Spheres slice(const Culling::Spheres& s, uint32_t first, uint32_t count) {
+    return {s.centerX + first, s.centerY + first, s.centerZ + first, s.radius + first, count};
+}
+
+static Culling::Boxes slice(const Culling::Boxes& b, uint32_t first, uint32_t count) {
+    return {b.centerX + first, b.centerY + first, b.centerZ + first, b.extentX + first, b.extentY + first,
+            b.extentZ + first, count};
+}
+
+// every chunk writes its visible indices at its own offset in visible, then they are moved down in chunk order.
+template<typename Volumes>
+static uint32_t dispatchParallel(const Culling::Frustum& frustum, const Volumes& volumes, uint32_t* visible,
+                                 Culling::Kernel kernel) {
+    uint32_t chunks = (volumes.count + Culling::parallelChunk - 1) / Culling::parallelChunk;
+    if (chunks <= 1 || jobs.threadCount() == 1) return dispatch(frustum, volumes, visible, kernel);
+
+    vector<uint32_t> counts(chunks);
+    jobs.parallelFor(0, chunks, 1, [&](uint32_t firstChunk, uint32_t lastChunk) {
+        for (uint32_t c = firstChunk; c < lastChunk; c++) {
+            uint32_t first = c * Culling::parallelChunk;
+            uint32_t count = std::min(Culling::parallelChunk, volumes.count - first);
+            uint32_t* out = visible + first;
+            counts[c] = dispatch(frustum, slice(volumes, first, count), out, kernel);
+            for (uint32_t i = 0; i < counts[c]; i++) out[i] += first;
+        }
+    });
+
+    uint32_t total = counts[0];
+    for (uint32_t c = 1; c < chunks; c++) {
+        std::memmove(visible + total, visible + c * Culling::parallelChunk, counts[c] * sizeof(uint32_t));
+        total += counts[c];
+    }
+    return total;
+}
+
+uint32_t Culling::cullParallel(const Frustum& frustum, const Spheres& spheres, uint32_t* visible, Kernel kernel) {
+    return dispatchParallel(frustum, spheres, visible, kernel);
+}
+
+uint32_t Culling::cullParallel(const Frustum& frustum, const Boxes& boxes, uint32_t* visible, Kernel kernel) {
+    return dispatchParallel(frustum, boxes, visible, kernel);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "using_std.h"
+#include "using_glm.h"
+#include "Scene.h"
+
+// CPU frustum culling of bounding volume arrays.
+//
+// volumes come as structure of arrays (Scene::Bounds), tested several at a time against the six planes of the
+// frustum, and the indices of the visible ones are written in order, compacted: the list the draws are recorded
+// from. every kernel gives the same result as the scalar one, it only does more objects per instruction. the widest
+// one the CPU has is picked at runtime.
+namespace Culling {
+    enum class Kernel : uint32_t {
+        SCALAR,
+        SSE, // 4 lanes, every x86-64 cpu
+        AVX2, // 8 lanes, when the cpu & os support it
+        NEON // 4 lanes, aarch64
+    };
+
+    // world space planes, inside where dot(xyz, p) + w >= 0, normalized.
+    struct Frustum {
+        vec4 planes[6];
+
+        // Gribb & Hartmann, for a [0, 1] depth range.
+        static Frustum fromMatrix(const mat4x4& viewProjection);
+    };
+
+    struct Spheres {
+        const float* centerX;
+        const float* centerY;
+        const float* centerZ;
+        const float* radius;
+        uint32_t count;
+    };
+
+    // axis aligned boxes, as center & half extents.
+    struct Boxes {
+        const float* centerX;
+        const float* centerY;
+        const float* centerZ;
+        const float* extentX;
+        const float* extentY;
+        const float* extentZ;
+        uint32_t count;
+    };
+
+    [[nodiscard]] Spheres spheres(const Scene::Bounds& bounds);
+    [[nodiscard]] Boxes boxes(const Scene::Bounds& bounds);
+
+    // the widest kernel this cpu runs.
+    [[nodiscard]] Kernel best();
+    [[nodiscard]] bool supported(Kernel kernel);
+    [[nodiscard]] const char* name(Kernel kernel);
+
+    // writes the indices of the volumes that intersect the frustum to visible, which has room for all of them, and
+    // returns how many. a sphere is culled when it lies wholly outside one plane, a box when its projection on the
+    // normal of one plane does: both keep some volumes near the frustum's corners.
+    uint32_t cull(const Frustum& frustum, const Spheres& spheres, uint32_t* visible, Kernel kernel = best());
+    uint32_t cull(const Frustum& frustum, const Boxes& boxes, uint32_t* visible, Kernel kernel = best());
+
+    // objects per job of the parallel cull.
+    constexpr uint32_t parallelChunk = 16384;
+
+    // cull() with chunks of the arrays culled on the job system's workers (Jobs.h), same result, same order.
+    uint32_t cullParallel(const Frustum& frustum, const Spheres& spheres, uint32_t* visible, Kernel kernel = best());
+    uint32_t cullParallel(const Frustum& frustum, const Boxes& boxes, uint32_t* visible, Kernel kernel = best());
+}
@@ -0,0 +1,284 @@
+#include "Jobs.h"
+
+static thread_local const JobSystem* currentSystem = nullptr;
+static thread_local uint32_t currentWorker = JobSystem::none;
+
+bool JobSystem::Deque::push(Job* job) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t >= capacity) return false;
+
+    jobs[b & (capacity - 1)].store(job, std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_release); // the job's closure is visible to the thief that sees it
+    return true;
+}
+
+JobSystem::Job* JobSystem::Deque::pop() {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = jobs[b & (capacity - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        // the last job: a thief may be taking it too.
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+JobSystem::Job* JobSystem::Deque::steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+
+    Job* job = jobs[t & (capacity - 1)].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr; // lost to the owner or another thief
+    return job;
+}
+
+void JobSystem::init(uint32_t threads) {
+    destroy();
+
+    threads = std::max(threads, 1u);
+    stopping = false;
+    for (uint32_t i = 0; i < threads; i++) workers.push_back(std::make_unique<Worker>());
+    parkedTotal = 0;
+
+    currentSystem = this;
+    currentWorker = 0;
+    for (uint32_t i = 1; i < threads; i++) {
+        this->threads.emplace_back([this, i] { loop(i); });
+    }
+}
+
+void JobSystem::destroy() {
+    if (!running()) return;
+
+    runMainJobs();
+    {
+        std::lock_guard lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t: threads) t.join();
+    threads.clear();
+    workers.clear();
+
+    if (currentSystem == this) {
+        currentSystem = nullptr;
+        currentWorker = none;
+    }
+}
+
+uint32_t JobSystem::workerIndex() const {
+    return currentSystem == this ? currentWorker : none;
+}
+
+void JobSystem::wait(Counter& counter) {
+    uint32_t index = workerIndex();
+    while (!counter.done()) {
+        if (Job* job = find(index)) execute(job);
+        else std::this_thread::yield();
+    }
+}
+
+void JobSystem::runMainJobs() {
+    if (!mainPending.load(std::memory_order_acquire)) return;
+
+    std::deque<Job*> ready;
+    {
+        std::lock_guard lock(mainMutex);
+        ready.swap(mainJobs);
+        mainPending.store(false, std::memory_order_relaxed);
+    }
+    for (Job* job: ready) execute(job);
+}
+
+JobSystem::Stats JobSystem::stats() const {
+    Stats s {};
+    for (const auto& w: workers) {
+        s.jobs += w->executed.load(std::memory_order_relaxed);
+        s.steals += w->steals.load(std::memory_order_relaxed);
+    }
+    s.parked = parkedTotal.load(std::memory_order_relaxed);
+    return s;
+}
+
+JobSystem::Job* JobSystem::allocate() {
+    uint32_t index = workerIndex();
+    if (index == none) {
+        Job* job = new Job;
+        job->heap = true;
+        job->free.store(false, std::memory_order_relaxed);
+        return job;
+    }
+
+    // the slot's previous job may not have run yet: help until it has.
+    Worker& w = *workers[index];
+    Job* job = &w.pool[w.next++ & (poolSize - 1)];
+    while (!job->free.load(std::memory_order_acquire)) {
+        if (Job* other = find(index)) execute(other);
+        else std::this_thread::yield();
+    }
+    job->free.store(false, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::schedule(Job* job) {
+    uint32_t index = workerIndex();
+    if (index == none) {
+        std::lock_guard lock(sharedMutex);
+        sharedJobs.push_back(job);
+        sharedCount.fetch_add(1, std::memory_order_release);
+    } else if (!workers[index]->deque.push(job)) {
+        execute(job); // the deque is full, run it now
+        return;
+    }
+
+    epoch.fetch_add(1, std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard lock(sleepMutex);
+        wake.notify_one();
+    }
+}
+
+bool JobSystem::park(Job& job, Counter& dependency) {
+    std::lock_guard lock(parkMutex);
+    // counted first: whoever waits on dependency can't return while the job is being parked.
+    dependency.dependants.fetch_add(1, std::memory_order_seq_cst);
+    parkedCount.fetch_add(1, std::memory_order_seq_cst);
+    if (dependency.value.load(std::memory_order_seq_cst) == 0) {
+        parkedCount.fetch_sub(1, std::memory_order_relaxed);
+        dependency.dependants.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+
+    parked.push_back({&job, &dependency});
+    parkedTotal.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void JobSystem::execute(Job* job) {
+    job->invoke(*job);
+
+    Counter* counter = job->signal;
+    uint32_t index = workerIndex();
+    if (index != none) workers[index]->executed.fetch_add(1, std::memory_order_relaxed);
+    if (job->heap) delete job;
+    else job->free.store(true, std::memory_order_release);
+
+    if (counter) signal(*counter);
+}
+
+void JobSystem::signal(Counter& counter) {
+    if (counter.value.fetch_sub(1, std::memory_order_seq_cst) != 1) return;
+    // either this sees the parked job, or park() sees the zero.
+    if (parkedCount.load(std::memory_order_seq_cst) == 0) return;
+
+    vector<Job*> ready;
+    {
+        std::lock_guard lock(parkMutex);
+        for (size_t i = 0; i < parked.size();) {
+            Counter* dependency = parked[i].dependency;
+            if (dependency->value.load(std::memory_order_acquire) != 0) {
+                i++;
+                continue;
+            }
+            ready.push_back(parked[i].job);
+            parked[i] = parked.back();
+            parked.pop_back();
+            parkedCount.fetch_sub(1, std::memory_order_relaxed);
+            dependency->dependants.fetch_sub(1, std::memory_order_release); // may be gone after this
+        }
+    }
+    for (Job* job: ready) schedule(job);
+}
+
+JobSystem::Job* JobSystem::find(uint32_t index) {
+    if (index == 0 && mainPending.load(std::memory_order_acquire)) {
+        std::lock_guard lock(mainMutex);
+        if (!mainJobs.empty()) {
+            Job* job = mainJobs.front();
+            mainJobs.pop_front();
+            mainPending.store(!mainJobs.empty(), std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    if (index != none) {
+        if (Job* job = workers[index]->deque.pop()) return job;
+    }
+
+    if (sharedCount.load(std::memory_order_acquire) > 0) {
+        std::lock_guard lock(sharedMutex);
+        if (!sharedJobs.empty()) {
+            Job* job = sharedJobs.front();
+            sharedJobs.pop_front();
+            sharedCount.fetch_sub(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    // the next workers first, thieves spread over the victims.
+    auto count = static_cast<uint32_t>(workers.size());
+    uint32_t start = index == none ? 0 : index + 1;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t victim = (start + i) % count;
+        if (victim == index) continue;
+        if (Job* job = workers[victim]->deque.steal()) {
+            if (index != none) workers[index]->steals.fetch_add(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+bool JobSystem::localEmpty() const {
+    uint32_t index = workerIndex();
+    if (index == none) return sharedCount.load(std::memory_order_relaxed) == 0;
+    return workers[index]->deque.empty();
+}
+
+void JobSystem::loop(uint32_t index) {
+    currentSystem = this;
+    currentWorker = index;
+
+    uint32_t idle = 0;
+    while (!stopping.load(std::memory_order_acquire)) {
+        if (Job* job = find(index)) {
+            execute(job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < spinCount) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // announced before the last look: a job pushed after it wakes us.
+        uint64_t seen = epoch.load(std::memory_order_seq_cst);
+        sleeping.fetch_add(1, std::memory_order_seq_cst);
+        if (Job* job = find(index)) {
+            sleeping.fetch_sub(1, std::memory_order_relaxed);
+            execute(job);
+            idle = 0;
+            continue;
+        }
+        {
+            std::unique_lock lock(sleepMutex);
+            wake.wait(lock, [&] { return stopping.load() || epoch.load() != seen; });
+        }
+        sleeping.fetch_sub(1, std::memory_order_relaxed);
+        idle = 0;
+    }
+}
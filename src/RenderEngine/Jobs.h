@@ -0,0 +1,233 @@
+#pragma once
+
+#include "using_std.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+// Work stealing job system, shared by the whole engine.
+//
+// every worker thread owns a Chase-Lev deque: it pushes and pops its jobs at the bottom, idle workers steal from
+// the top of the others'. the thread that called init() is worker 0, it runs jobs while it waits on a counter.
+// a job decrements its signal counter when done, and a job given a dependency counter is parked until that one
+// reaches zero. main thread jobs only run on worker 0, in wait() and runMainJobs(): what has to stay on the main
+// thread (glfw, the window) can be asked for from any job. threads that aren't workers hand their jobs to a shared
+// queue, any worker picks them up.
+//
+// jobs are closures of at most Job::storageSize bytes: capture by reference, whatever they capture must outlive
+// them. before init() and after destroy(), every job runs on the spot.
+class JobSystem {
+public:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    struct Job;
+
+    // how many jobs are left, jobs & dependants included. a counter must outlive the jobs that signal it or depend
+    // on it: wait() on it before it goes away.
+    class Counter {
+    public:
+        Counter() = default;
+        Counter(const Counter&) = delete;
+        Counter& operator=(const Counter&) = delete;
+
+        [[nodiscard]] bool done() const {
+            return value.load(std::memory_order_acquire) == 0 && dependants.load(std::memory_order_acquire) == 0;
+        }
+
+    private:
+        friend class JobSystem;
+        std::atomic<uint32_t> value = 0;
+        std::atomic<uint32_t> dependants = 0; // parked jobs waiting for value to reach zero
+    };
+
+    struct Job {
+        static constexpr size_t storageSize = 64;
+
+        void (*invoke)(Job& job) = nullptr;
+        Counter* signal = nullptr;
+        bool heap = false; // allocated by a thread that isn't a worker
+        std::atomic<bool> free = true;
+        alignas(std::max_align_t) unsigned char storage[storageSize];
+    };
+
+    JobSystem() = default;
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    ~JobSystem() { destroy(); }
+
+    // threads workers, the calling thread included as worker 0. destroy() is for the same thread, once every job
+    // has been waited on.
+    void init(uint32_t threads);
+    void destroy();
+
+    [[nodiscard]] bool running() const { return !workers.empty(); }
+    [[nodiscard]] uint32_t threadCount() const { return std::max(static_cast<uint32_t>(workers.size()), 1u); }
+
+    // index of the calling thread's worker, none for other threads.
+    [[nodiscard]] uint32_t workerIndex() const;
+
+    // f runs on some worker once dependency, when given, is zero. signal, when given, counts it until it returned.
+    template<typename F>
+    void run(F&& f, Counter* signal = nullptr, Counter* dependency = nullptr) {
+        if (!running()) {
+            f();
+            return;
+        }
+        Job* job = make(std::forward<F>(f), signal);
+        if (dependency && park(*job, *dependency)) return;
+        schedule(job);
+    }
+
+    // f runs on the main thread, in wait() or runMainJobs().
+    template<typename F>
+    void runOnMain(F&& f, Counter* signal = nullptr) {
+        if (!running()) {
+            f();
+            return;
+        }
+        Job* job = make(std::forward<F>(f), signal);
+        std::lock_guard lock(mainMutex);
+        mainJobs.push_back(job);
+        mainPending.store(true, std::memory_order_release);
+    }
+
+    // runs jobs until counter is done.
+    void wait(Counter& counter);
+
+    // the main thread jobs queued so far, on the main thread.
+    void runMainJobs();
+
+    // f(begin, end) over [first, last), split in ranges of at least grain indices. splitting is lazy: a range is
+    // halved, and one half offered to thieves, only while the worker running it has nothing else left to steal.
+    // an even load is hardly split, an uneven one keeps being split where the work is. returns once all of it ran.
+    template<typename F>
+    void parallelFor(uint32_t first, uint32_t last, uint32_t grain, F&& f) {
+        if (first >= last) return;
+        grain = std::max(grain, 1u);
+        if (workers.size() <= 1 || last - first <= grain) {
+            f(first, last);
+            return;
+        }
+
+        Counter counter;
+        forRange(first, last, grain, f, counter);
+        wait(counter);
+    }
+
+    struct Stats {
+        uint64_t jobs = 0;
+        uint64_t steals = 0;
+        uint64_t parked = 0;
+    };
+
+    // since init().
+    [[nodiscard]] Stats stats() const;
+
+private:
+    static constexpr uint32_t poolSize = 1024; // jobs in flight per worker, a power of two
+    static constexpr uint32_t spinCount = 64; // steal attempts before a worker sleeps
+
+    // Chase-Lev, fixed capacity (Lê, Pop, Cohen & Zappa Nardelli, 2013).
+    struct Deque {
+        static constexpr int64_t capacity = poolSize;
+
+        alignas(64) std::atomic<int64_t> top = 0;
+        alignas(64) std::atomic<int64_t> bottom = 0;
+        array<std::atomic<Job*>, capacity> jobs {};
+
+        bool push(Job* job); // owner only, false when full
+        Job* pop(); // owner only
+        Job* steal(); // any thread
+        [[nodiscard]] bool empty() const {
+            return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+        }
+    };
+
+    struct Worker {
+        Deque deque;
+        array<Job, poolSize> pool;
+        uint32_t next = 0; // pool slot of the next job
+        alignas(64) std::atomic<uint64_t> executed = 0;
+        std::atomic<uint64_t> steals = 0;
+    };
+
+    vector<std::unique_ptr<Worker>> workers;
+    vector<std::thread> threads;
+    std::atomic<bool> stopping = false;
+
+    // sleeping workers are woken by any new job.
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<uint64_t> epoch = 0;
+    std::atomic<uint32_t> sleeping = 0;
+
+    // jobs from threads that aren't workers.
+    std::mutex sharedMutex;
+    std::deque<Job*> sharedJobs;
+    std::atomic<uint32_t> sharedCount = 0;
+
+    std::mutex mainMutex;
+    std::deque<Job*> mainJobs;
+    std::atomic<bool> mainPending = false;
+
+    // jobs whose dependency isn't zero yet.
+    struct Parked {
+        Job* job;
+        Counter* dependency;
+    };
+    std::mutex parkMutex;
+    vector<Parked> parked;
+    std::atomic<uint32_t> parkedCount = 0;
+    std::atomic<uint64_t> parkedTotal = 0;
+
+    template<typename F>
+    Job* make(F&& f, Counter* signal) {
+        using Closure = std::decay_t<F>;
+        static_assert(sizeof(Closure) <= Job::storageSize, "job closure too large, capture by reference!");
+        static_assert(alignof(Closure) <= alignof(std::max_align_t), "job closure over aligned!");
+
+        Job* job = allocate();
+        new(job->storage) Closure(std::forward<F>(f));
+        job->invoke = [](Job& j) {
+            Closure* closure = std::launder(reinterpret_cast<Closure*>(j.storage));
+            (*closure)();
+            closure->~Closure();
+        };
+        job->signal = signal;
+        if (signal) signal->value.fetch_add(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    template<typename F>
+    void forRange(uint32_t first, uint32_t last, uint32_t grain, F& f, Counter& counter) {
+        while (last - first > grain) {
+            if (last - first >= 2 * grain && localEmpty()) {
+                uint32_t middle = first + (last - first) / 2;
+                run([this, middle, last, grain, &f, &counter] { forRange(middle, last, grain, f, counter); },
+                    &counter);
+                last = middle;
+                continue;
+            }
+            f(first, first + grain);
+            first += grain;
+        }
+        f(first, last);
+    }
+
+    Job* allocate();
+    void schedule(Job* job);
+    bool park(Job& job, Counter& dependency); // false when dependency is already zero
+    void execute(Job* job);
+    void signal(Counter& counter);
+    Job* find(uint32_t index);
+    [[nodiscard]] bool localEmpty() const;
+    void loop(uint32_t index);
+};
+
+inline JobSystem jobs;
@@ -0,0 +1,179 @@
+#include "Mesh.h"
+
+#include <fstream>
+
+static uint64_t alignUp(uint64_t value) {
+    return (value + MeshFormat::alignment - 1) & ~(MeshFormat::alignment - 1);
+}
+
+void MeshFormat::write(const std::string& path, Header header, vector<Section> sections, const Fill& fill) {
+    uint64_t offset = alignUp(sizeof(Header) + sizeof(Section) * sections.size());
+    for (Section& s: sections) {
+        s.offset = offset;
+        offset = alignUp(offset + s.size);
+    }
+
+    header.magic = magic;
+    header.version = version;
+    header.sectionCount = static_cast<uint32_t>(sections.size());
+    header.fileSize = offset;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) throw std::runtime_error("failed to open mesh file for writing!");
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    file.write(reinterpret_cast<const char*>(sections.data()), (std::streamsize) (sizeof(Section) * sections.size()));
+
+    // sections are streamed through one chunk, a file of any size is written in constant memory.
+    static constexpr uint64_t chunkSize = 4ull * 1024 * 1024;
+    vector<uint8_t> chunk(chunkSize);
+    uint64_t position = sizeof(Header) + sizeof(Section) * sections.size();
+
+    for (uint32_t i = 0; i < sections.size(); i++) {
+        const Section& s = sections[i];
+        std::fill(chunk.begin(), chunk.end(), 0);
+        file.write(reinterpret_cast<const char*>(chunk.data()), (std::streamsize) (s.offset - position));
+
+        for (uint64_t done = 0; done < s.size; done += chunkSize) {
+            uint64_t size = std::min(chunkSize, s.size - done);
+            fill(i, done, chunk.data(), size);
+            file.write(reinterpret_cast<const char*>(chunk.data()), (std::streamsize) size);
+        }
+        position = s.offset + s.size;
+    }
+
+    std::fill(chunk.begin(), chunk.end(), 0);
+    file.write(reinterpret_cast<const char*>(chunk.data()), (std::streamsize) (header.fileSize - position));
+
+    if (!file.good()) throw std::runtime_error("failed to write mesh file!");
+}
+
+void MeshFormat::write(const std::string& path, uint64_t layout, const VertexFormat::Streams& streams,
+                       const vector<uint32_t>& indices, const vector<Lod>& lods, const vec3& boundsMin,
+                       const vec3& boundsMax) {
+    bool narrow = std::all_of(indices.begin(), indices.end(), [](uint32_t i) { return i <= UINT16_MAX; });
+    IndexType indexType = indices.empty() ? IndexType::NONE : narrow ? IndexType::UINT16 : IndexType::UINT32;
+
+    Header header {
+        .magic = magic,
+        .version = version,
+        .sectionCount = 0,
+        .indexType = indexType,
+        .layout = layout,
+        .fileSize = 0,
+        .vertexCount = streams.vertexCount,
+        .indexCount = static_cast<uint32_t>(indices.size()),
+        .lodCount = static_cast<uint32_t>(lods.size()),
+        .reserved = 0,
+        .boundsMin = {boundsMin.x, boundsMin.y, boundsMin.z},
+        .boundsMax = {boundsMax.x, boundsMax.y, boundsMax.z},
+        .decode = streams.decode
+    };
+
+    vector<Section> sections;
+    for (uint32_t i = 0; i < streams.streamCount; i++) {
+        uint32_t stride = streams.vertexCount ? static_cast<uint32_t>(streams.data[i].size() / streams.vertexCount)
+                                              : 0;
+        sections.push_back({SectionType::VERTEX_STREAM, i, stride, 0, 0, streams.data[i].size()});
+    }
+    if (!indices.empty()) {
+        uint32_t stride = indexSize(indexType);
+        sections.push_back({SectionType::INDICES, 0, stride, 0, 0, (uint64_t) stride * indices.size()});
+    }
+    if (!lods.empty()) {
+        sections.push_back({SectionType::LODS, 0, sizeof(Lod), 0, 0, sizeof(Lod) * lods.size()});
+    }
+
+    write(path, header, sections, [&](uint32_t section, uint64_t offset, uint8_t* dst, uint64_t size) {
+        const Section& s = sections[section];
+        switch (s.type) {
+            case SectionType::VERTEX_STREAM:
+                memcpy(dst, streams.data[s.index].data() + offset, size);
+                break;
+            case SectionType::INDICES:
+                for (uint64_t i = 0; i < size / s.stride; i++) {
+                    uint32_t index = indices[offset / s.stride + i];
+                    if (s.stride == 2) {
+                        auto narrowIndex = static_cast<uint16_t>(index);
+                        memcpy(dst + i * 2, &narrowIndex, 2);
+                    } else {
+                        memcpy(dst + i * 4, &index, 4);
+                    }
+                }
+                break;
+            case SectionType::LODS:
+                memcpy(dst, reinterpret_cast<const uint8_t*>(lods.data()) + offset, size);
+                break;
+        }
+    });
+}
+
+void MeshFile::open(const std::string& path) {
+    using namespace MeshFormat;
+
+    if (!file.open(path)) throw std::runtime_error("failed to open mesh file!");
+
+    auto fail = [this](const char* msg) {
+        file.close();
+        throw std::runtime_error(msg);
+    };
+
+    if (file.size() < sizeof(Header)) fail("mesh file is truncated!");
+    const Header& h = header();
+    if (h.magic != magic) fail("not a mesh file!");
+    if (h.version != version) fail("unsupported mesh file version!");
+    if (h.fileSize != file.size()) fail("mesh file is truncated!");
+    if (sizeof(Header) + sizeof(Section) * (uint64_t) h.sectionCount > file.size()) fail("mesh file is truncated!");
+
+    auto sections = reinterpret_cast<const Section*>(file.data() + sizeof(Header));
+    for (uint32_t i = 0; i < h.sectionCount; i++) {
+        const Section& s = sections[i];
+        if (s.offset % alignment != 0) fail("misaligned mesh section!");
+        if (s.offset > file.size() || s.size > file.size() - s.offset) fail("mesh section out of bounds!");
+    }
+
+    // the sections the engine reads must hold what the header says they do.
+    for (uint32_t i = 0; i < VertexFormat::maxStreams; i++) {
+        const Section* s = find(SectionType::VERTEX_STREAM, i);
+        if (s && s->size < (uint64_t) s->stride * h.vertexCount) fail("mesh vertex stream is too small!");
+    }
+    if (h.indexCount) {
+        const Section* s = find(SectionType::INDICES, 0);
+        if (!s || s->stride != indexSize(h.indexType) || s->size < (uint64_t) s->stride * h.indexCount)
+            fail("mesh index section doesn't match the header!");
+    }
+    if (h.lodCount) {
+        const Section* s = find(SectionType::LODS, 0);
+        if (!s || s->size < sizeof(Lod) * (uint64_t) h.lodCount) fail("mesh lod section doesn't match the header!");
+    }
+}
+
+void MeshFile::close() {
+    file.close();
+}
+
+const MeshFormat::Section* MeshFile::find(MeshFormat::SectionType type, uint32_t index) const {
+    auto sections = reinterpret_cast<const MeshFormat::Section*>(file.data() + sizeof(MeshFormat::Header));
+    for (uint32_t i = 0; i < header().sectionCount; i++) {
+        if (sections[i].type == type && sections[i].index == index) return &sections[i];
+    }
+    return nullptr;
+}
+
+MeshFile::View MeshFile::vertexStream(uint32_t stream) const {
+    const MeshFormat::Section* s = find(MeshFormat::SectionType::VERTEX_STREAM, stream);
+    if (!s) return {};
+    return {file.data() + s->offset, (uint64_t) s->stride * header().vertexCount, s->stride};
+}
+
+MeshFile::View MeshFile::indices() const {
+    const MeshFormat::Section* s = find(MeshFormat::SectionType::INDICES, 0);
+    if (!s || header().indexCount == 0) return {};
+    return {file.data() + s->offset, (uint64_t) s->stride * header().indexCount, s->stride};
+}
+
+const MeshFormat::Lod* MeshFile::lods() const {
+    const MeshFormat::Section* s = find(MeshFormat::SectionType::LODS, 0);
+    if (!s || header().lodCount == 0) return nullptr;
+    return reinterpret_cast<const MeshFormat::Lod*>(file.data() + s->offset);
+}
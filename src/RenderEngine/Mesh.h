@@ -0,0 +1,113 @@
+#pragma once
+
+#include "using_std.h"
+#include "mapped_file.h"
+#include "Vertex.h"
+
+#include <functional>
+#include <string>
+
+// Engine native mesh container, read in place through a memory mapping.
+//
+// file layout: [Header][Section x sectionCount] then the sections, every one aligned to MeshFormat::alignment so
+// vertex & index data can be handed to the staging uploader straight from the mapped pages. all fields are little
+// endian and fixed size, the reader only validates, it never parses into heap structures.
+namespace MeshFormat {
+    static constexpr uint32_t magic = 0x534d3356; // "V3MS"
+    static constexpr uint32_t version = 1;
+    static constexpr uint64_t alignment = 64;
+
+    enum class SectionType : uint32_t {
+        VERTEX_STREAM, // index = stream
+        INDICES,
+        LODS
+    };
+
+    enum class IndexType : uint32_t {
+        NONE,
+        UINT16,
+        UINT32
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t sectionCount;
+        IndexType indexType;
+        uint64_t layout; // VertexLayout::id of the vertex streams
+        uint64_t fileSize;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t lodCount;
+        uint32_t reserved;
+        float boundsMin[3];
+        float boundsMax[3];
+        VertexFormat::Decode decode;
+    };
+
+    struct Section {
+        SectionType type;
+        uint32_t index;
+        uint32_t stride;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    // lod 0 is the full mesh, every level is a range of the index section.
+    struct Lod {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error; // object space deviation from lod 0
+        uint32_t reserved;
+    };
+
+    constexpr uint32_t indexSize(IndexType type) {
+        return type == IndexType::UINT16 ? 2 : type == IndexType::UINT32 ? 4 : 0;
+    }
+
+    // fills dst with size bytes of section `section`, starting offset bytes into it. called front to back, in
+    // chunks, so sections larger than memory can be written.
+    using Fill = std::function<void(uint32_t section, uint64_t offset, uint8_t* dst, uint64_t size)>;
+
+    // assigns section offsets & the file size, then writes the file. throws on io errors.
+    void write(const std::string& path, Header header, vector<Section> sections, const Fill& fill);
+
+    // writes encoded streams, indices (uint16 when every index fits) and lods.
+    void write(const std::string& path, uint64_t layout, const VertexFormat::Streams& streams,
+               const vector<uint32_t>& indices, const vector<Lod>& lods, const vec3& boundsMin,
+               const vec3& boundsMax);
+}
+
+class MeshFile {
+public:
+    struct View {
+        const uint8_t* data = nullptr;
+        uint64_t size = 0;
+        uint32_t stride = 0;
+    };
+
+    // maps and validates path, throws if it is not a mesh file this build can read.
+    void open(const std::string& path);
+
+    void close();
+
+    [[nodiscard]] const MeshFormat::Header& header() const {
+        return *reinterpret_cast<const MeshFormat::Header*>(file.data());
+    }
+
+    [[nodiscard]] View vertexStream(uint32_t stream) const;
+
+    [[nodiscard]] View indices() const;
+
+    [[nodiscard]] const MeshFormat::Lod* lods() const;
+
+    [[nodiscard]] uint64_t size() const {
+        return file.size();
+    }
+
+private:
+    MappedFile file;
+
+    [[nodiscard]] const MeshFormat::Section* find(MeshFormat::SectionType type, uint32_t index) const;
+};
@@ -3,31 +3,300 @@
 #include "glfw_vulkan.h"
 #include "using_std.h"
 #include "logging.h"
+#include "async_log.h"
+#include "build_profile.h"
 #include "VK/VK.h"
+#include "Vertex.h"
+#include "Mesh.h"
+#include "Scene.h"
+#include "Culling.h"
+#include "Jobs.h"
 
-VkRenderPass renderPass;
-VkPipelineLayout pipelineLayout;
-VkPipeline pipeline;
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <numeric>
 
-VkCommandBuffer commandBuffer = nullptr;
 VkCommandPool commandPool = nullptr;
-VkQueue queue_graphics = nullptr;
-VkQueue queue_present = nullptr;
 
-VkFence inFlightFence;
-VkSemaphore imageAvailableSemaphores;
-VkSemaphore renderFinishedSemaphores;
+vector<Vertex> vertices = {{{0.0f,  -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}},
+                           {{0.5f,  0.5f,  0.0f}, {0.0f, 1.0f, 0.0f}},
+                           {{-0.5f, 0.5f,  0.0f}, {0.0f, 0.0f, 1.0f}}};
 
-//vector<Vertex> vertices = {{{0.0f,  -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}},
-//                           {{0.5f,  0.5f,  0.0f}, {0.0f, 1.0f, 0.0f}},
-//                           {{-0.5f, 0.5f,  0.0f}, {0.0f, 0.0f, 1.0f}}};
+// the device local vertex streams & indices of a mesh, and what its draws bind.
+struct MeshBuffers {
+    array<VkBuffer, VertexFormat::maxStreams> buffers {};
+    array<VK::Allocation, VertexFormat::maxStreams> allocations {};
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    VK::Allocation indexAllocation {};
+    VK::VertexInput input {};
+
+    // queued on the uploader, picked up by the next frame.
+    void upload(const VertexFormat::Streams& streams, VkPipelineLayout layout, const vector<uint32_t>& indices = {}) {
+        input.streamCount = streams.streamCount;
+        for (uint32_t i = 0; i < streams.streamCount; i++) {
+            buffers[i] = VK::uploader.createBuffer(streams.data[i].data(), streams.data[i].size(),
+                                                   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, allocations[i],
+                                                   VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+            input.buffers[i] = buffers[i];
+            input.offsets[i] = 0;
+        }
+
+        if (!indices.empty()) {
+            indexBuffer = VK::uploader.createBuffer(indices.data(), sizeof(uint32_t) * indices.size(),
+                                                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexAllocation,
+                                                    VK_ACCESS_INDEX_READ_BIT);
+            input.indexBuffer = indexBuffer;
+            input.indexType = VK_INDEX_TYPE_UINT32;
+        }
+
+        setDecode(streams.decode, layout);
+    }
+
+    // staged straight from the mapped pages, no copy of the file is made on the heap. the uploader has copied
+    // everything into its ring once this returns, the file may be closed.
+    void upload(const MeshFile& file, VkPipelineLayout layout) {
+        const MeshFormat::Header& header = file.header();
+        if (header.layout != DefaultVertexLayout::id) throw std::runtime_error("mesh file has another vertex layout!");
+
+        input.streamCount = DefaultVertexLayout::streamCount;
+        for (uint32_t i = 0; i < input.streamCount; i++) {
+            MeshFile::View stream = file.vertexStream(i);
+            if (stream.stride != DefaultVertexLayout::stride(i))
+                throw std::runtime_error("mesh vertex stream doesn't match the layout!");
+
+            buffers[i] = VK::uploader.createBuffer(stream.data, stream.size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                                   allocations[i], VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+            input.buffers[i] = buffers[i];
+            input.offsets[i] = 0;
+        }
+
+        MeshFile::View indices = file.indices();
+        if (indices.data) {
+            indexBuffer = VK::uploader.createBuffer(indices.data, indices.size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                                    indexAllocation, VK_ACCESS_INDEX_READ_BIT);
+            input.indexBuffer = indexBuffer;
+            input.indexType = header.indexType == MeshFormat::IndexType::UINT16 ? VK_INDEX_TYPE_UINT16
+                                                                               : VK_INDEX_TYPE_UINT32;
+        }
+
+        setDecode(header.decode, layout);
+    }
+
+    // the whole mesh: every index, or every vertex when it has none.
+    [[nodiscard]] static VK::Draw draw(const MeshFile& file) {
+        const MeshFormat::Header& header = file.header();
+        return {header.indexCount ? header.indexCount : header.vertexCount, 1, 0, 0};
+    }
+
+    void setDecode(const VertexFormat::Decode& decode, VkPipelineLayout layout) {
+        input.layout = layout;
+        input.pushConstantSize = sizeof(VertexFormat::Decode);
+        memcpy(input.pushConstants.data(), &decode, sizeof(VertexFormat::Decode));
+    }
+
+    void destroy() {
+        for (uint32_t i = 0; i < input.streamCount; i++) VK::allocator.destroyBuffer(buffers[i], allocations[i]);
+        if (indexBuffer) VK::allocator.destroyBuffer(indexBuffer, indexAllocation);
+        indexBuffer = VK_NULL_HANDLE;
+        input = {};
+    }
+};
+
+MeshBuffers mesh;
+
+// default.vert's per frame constants.
+struct FrameUniforms {
+    vec4 scale; // undoes the target's aspect ratio
+};
+
+// input plus the frame's constants for a target of extent, in the frame data ring: valid for the current frame only.
+VK::VertexInput frame_input(const VK::VertexInput& input, VkExtent2D extent) {
+    float aspect = (float) extent.width / (float) std::max(extent.height, 1u);
+    VK::VertexInput framed = input;
+    framed.frame = VK::frameData.push(FrameUniforms {
+        aspect > 1.0f ? vec4(1.0f / aspect, 1.0f, 1.0f, 1.0f) : vec4(1.0f, aspect, 1.0f, 1.0f)
+    });
+    return framed;
+}
+
+vector<VK::Draw> draws = {{3, 1, 0, 0}};
+
+// what frame() draws with, swapped by benchmark_vertex_fetch().
+VK::Pipeline* activePipeline = &VK::pipeline;
+MeshBuffers* activeMesh = &mesh;
+
+// a gpu driven scene drawn after the draw list, set by benchmark_indirect().
+VK::IndirectScene* activeScene = nullptr;
+
+void culled_draws(const uint32_t* visible, uint32_t count, vector<VK::Draw>& out);
+
+// a scene whose roots bounce around a cube, simulated on the main thread, its visible nodes drawn instead of the
+// draw list. tick() moves the roots, every frame places them between their last two ticks, updates the hierarchy and
+// culls it. set by benchmark_render_thread() & benchmark_fixed_timestep().
+struct Simulation {
+    Scene scene;
+    vector<Scene::Handle> roots;
+    vector<vec3> previous; // root positions at the tick before the last one
+    vector<vec3> current;
+    vector<vec3> velocity;
+    float halfSide = 1.0f;
+    vector<uint32_t> visible;
+    Culling::Frustum frustum {};
+
+    // busy time per tick, standing in for the game logic the engine doesn't have.
+    std::chrono::nanoseconds tickCost {0};
+
+    void addRoot(Scene::Handle root, vec3 position, vec3 rootVelocity) {
+        roots.push_back(root);
+        previous.push_back(position);
+        current.push_back(position);
+        velocity.push_back(rootVelocity);
+    }
+
+    void tick(double seconds) {
+        auto start = std::chrono::steady_clock::now();
+        previous = current;
+        for (size_t i = 0; i < roots.size(); i++) {
+            current[i] += velocity[i] * (float) seconds;
+            for (int axis = 0; axis < 3; axis++) {
+                if (std::abs(current[i][axis]) <= halfSide) continue;
+                current[i][axis] = std::clamp(current[i][axis], -halfSide, halfSide);
+                velocity[i][axis] = -velocity[i][axis];
+            }
+        }
+        while (std::chrono::steady_clock::now() - start < tickCost) {}
+    }
+
+    // alpha: 0 at the state of the tick before the last one, 1 at the last one's.
+    void draw(double alpha, vector<VK::Draw>& out) {
+        for (size_t i = 0; i < roots.size(); i++) {
+            scene.setPosition(roots[i], glm::mix(previous[i], current[i], (float) alpha));
+        }
+        scene.update();
+        visible.resize(scene.size());
+        culled_draws(visible.data(), Culling::cullParallel(frustum, Culling::spheres(scene.bounds()), visible.data()),
+                     out);
+    }
+};
+
+Simulation* activeSimulation = nullptr;
 
 #include "benchmark.h"
+#include "profiler.h"
+#include "frame_limiter.h"
+#include "fixed_timestep.h"
+#include "memory_usage.h"
+#include "triple_buffer.h"
+
+#include <fstream>
+#include <unordered_map>
+
+// time spent blocked on fences inside frame(), used to split CPU time from GPU-bound time.
+Benchmark benchmarkFenceWait;
+
+// set by capture_frame(), recorded and submitted with the next frame.
+VK::Readback* pendingReadback = nullptr;
+
+// frames submitted so far, used to know when a retired swapchain is no longer referenced.
+uint64_t frameCount = 0;
+
+struct RetiredSwapchain {
+    VK::Surface::Swapchain::Retired retired;
+    vector<VkSemaphore> renderFinished; // of its images, its presents may still wait on them
+    uint64_t frame;
+};
+vector<RetiredSwapchain> retiredSwapchains;
+
+// set when the swapchain no longer matches the surface: resize, out of date, suboptimal. from either thread.
+std::atomic<bool> swapchainDirty = false;
+
+Benchmark benchmarkResize;
+
+FrameLimiter frameLimiter;
+
+FixedTimestep timestep;
+
+// maps the present policy onto the surface, read by the next swapchain (re)creation, and onto the frame limiter.
+void apply_present_policy() {
+    using RenderEngine::PresentPolicy;
+    VK::Surface& surface = VK::surface;
+
+    switch (RenderEngine::presentPolicy) {
+        case PresentPolicy::LOW_LATENCY:
+            // mailbox replaces the queued image instead of waiting behind it, immediate never queues (but tears).
+            surface.chooseSwapPresentMode({VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR});
+            // mailbox needs a spare image to render into while one is queued, the others queue as little as possible.
+            surface.extraImages = surface.vkPresentMode == VK_PRESENT_MODE_MAILBOX_KHR ? 1 : 0;
+            frameLimiter.setRate(RenderEngine::frameRateLimit);
+            break;
+        case PresentPolicy::THROUGHPUT:
+            surface.chooseSwapPresentMode({VK_PRESENT_MODE_MAILBOX_KHR});
+            surface.extraImages = 1;
+            frameLimiter.setRate(RenderEngine::frameRateLimit);
+            break;
+        case PresentPolicy::POWER_SAVING:
+            // fifo blocks on vblank, and the limiter keeps the gpu idle between frames below the refresh rate.
+            surface.chooseSwapPresentMode({VK_PRESENT_MODE_FIFO_KHR});
+            surface.extraImages = 0;
+            frameLimiter.setRate(RenderEngine::frameRateLimit > 0.0 ? RenderEngine::frameRateLimit
+                                                                    : RenderEngine::powerSavingRate);
+            break;
+    }
+}
+
+// the framebuffer size comes from the frame's packet: glfw is only queried on the main thread.
+bool recreate_swapchain(int fb_width, int fb_height) {
+    if (fb_width == 0 || fb_height == 0) return false; // minimized, try again next frame
+
+    // the hitch: time the frame loop spends rebuilding instead of recording.
+    auto start = Clock::now();
+    benchmarkResize.start();
+    auto retired = VK::surface.swapchain.recreate(fb_width, fb_height, VK::renderPass);
+    vector<VkSemaphore> renderFinished =
+        VK::frameRing.recreateImages(VK::device, static_cast<uint32_t>(VK::surface.swapchain.frames.size()));
+    retiredSwapchains.push_back({std::move(retired), std::move(renderFinished), frameCount});
+    benchmarkResize.end();
+
+    asyncLog.info("swapchain recreated: {}x{} in {} us", VK::surface.extent.width, VK::surface.extent.height,
+                  std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+
+    swapchainDirty = false;
+    return true;
+}
+
+// a retired swapchain is safe to destroy once every frame submitted before its replacement has been waited on.
+void destroy_retired_swapchains(bool all = false) {
+    for (size_t i = 0; i < retiredSwapchains.size();) {
+        RetiredSwapchain& r = retiredSwapchains[i];
+        if (all || frameCount >= r.frame + VK::frameRing.size()) {
+            VK::Surface::Swapchain::destroyFrames(r.retired.frames);
+            vkDestroySwapchainKHR(VK::device, r.retired.swapchain, nullptr);
+            for (VkSemaphore s: r.renderFinished) vkDestroySemaphore(VK::device, s, nullptr);
+            retiredSwapchains.erase(retiredSwapchains.begin() + (long) i);
+        } else {
+            i++;
+        }
+    }
+}
 
 void RenderEngine::init() {
-    window_create(width, height, "v3rse");
+    if (asyncLogging) asyncLog.start();
+    buildProfile.readEnvironment();
+    frameProfiler.enabled = buildProfile.profilingEnabled();
+    VK::gpuProfiler.enabled = buildProfile.profilingEnabled();
+    jobs.init(jobThreads);
+    if (!headless) window_create(width, height, "v3rse");
 
     VK::init();
+    info("{} build: validation {}, debug labels {}, profilers {}, assertions {}", BuildProfile::name,
+         buildProfile.validationEnabled() ? (buildProfile.verboseValidation ? "verbose" : "on") : "off",
+         VK::debugLabels ? "on" : "off", buildProfile.profilingEnabled() ? "on" : "off",
+         BuildProfile::assertsEnabled() ? "on" : "off");
+    apply_present_policy();
 
     int fb_width;
     int fb_height;
@@ -35,144 +304,1630 @@ void RenderEngine::init() {
     window_framebuffer_size(fb_width, fb_height);
 
     VK::surface.swapchain.createSwapchain(width, height);
+    VK::surface.swapchain.create();
 
-    VK::renderPass.createRenderPass();
-    VK::pipeline.createGraphicsPipeline();
-    VK::queues.init();
+    // before the pipelines: their layouts hold the frame data set.
+    VK::frameDescriptors.create(VK::device, framesInFlight);
+    VK::bindless.create(VK::device, VK::physicalDevice, framesInFlight);
+    VK::frameData.create(VK::device, VK::physicalDevice, framesInFlight);
 
-    for (auto& f: VK::surface.swapchain.frames) {
-        f.framebuffer.create(VK::renderPass.renderPass, VK::surface.extent.width,
-                             VK::surface.extent.height, {f.view});
-    }
+    auto start = Clock::now();
+    VK::renderPass.createRenderPass(VK::surface.swapchain.frames[0].format, !legacyRenderPass);
+    VK::pipeline.createGraphicsPipeline(DefaultVertexLayout::getBindingDescriptions(),
+                                        DefaultVertexLayout::getAttributeDescriptions(),
+                                        sizeof(VertexFormat::Decode), "dat/shaders/default.vert.glsl.spv",
+                                        {VK::frameData.layout});
+    VK::surface.swapchain.createFramebuffers(VK::renderPass);
+    info("main pass through {}: {} render pass & framebuffer objects, set up in {} us", VK::renderPass.name(),
+         VK::renderPass.objectCount(VK::surface.swapchain.frames.size()),
+         std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+    VK::pipelineCache.print();
+    VK::queues.init();
 
     commandPool = VK::createCommandPool(VK::device, VK::queues);
 
-    VkCommandBufferAllocateInfo allocInfo {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .pNext{},
-        .commandPool = commandPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1
-    };
+    VK::frameRing.create(VK::device, commandPool, framesInFlight,
+                         static_cast<uint32_t>(VK::surface.swapchain.frames.size()));
+    VK::recorder.init(VK::device, VK::queues.graphics.id.value(), recordThreads, framesInFlight);
+    VK::gpuProfiler.init(VK::device, VK::physicalDevice, VK::queues.graphics.id.value(),
+                         VK::queues.graphics.vkQueue, framesInFlight);
 
-    vkAllocateCommandBuffers(VK::device, &allocInfo, &commandBuffer);
+    VK::uploader.init(VK::device, VK::queues.transfer.id.value(), VK::queues.transfer.vkQueue,
+                      VK::queues.graphics.id.value());
 
-    VkSemaphoreCreateInfo semaphoreInfo {
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
-    };
+    // geometry lives in device local memory, the copy is picked up by the first frame.
+    if (meshPath) {
+        MeshFile file;
+        file.open(meshPath);
+        mesh.upload(file, VK::pipeline.layout);
+        draws = {MeshBuffers::draw(file)};
+        info("loaded {}: {} vertices, {} indices", meshPath, file.header().vertexCount, file.header().indexCount);
+    } else {
+        mesh.upload(DefaultVertexLayout::encode(vertices), VK::pipeline.layout);
+    }
+}
 
-    VkFenceCreateInfo fenceInfo {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-        .flags = VK_FENCE_CREATE_SIGNALED_BIT
-    };
+// everything a frame is rendered from, filled on the main thread: input, the simulation's result, what to draw.
+// the render thread reads nothing else the main thread writes.
+struct FramePacket {
+    int64_t input = 0; // when input was sampled, on the frame profiler's timeline
+    uint32_t ticks = 0; // simulation ticks run since the previous packet
+    int framebufferWidth = 0;
+    int framebufferHeight = 0;
+    vector<VK::Draw> draws; // slots are reused, so is their capacity
+    VK::Pipeline* pipeline = nullptr;
+    MeshBuffers* mesh = nullptr;
+    VK::IndirectScene* scene = nullptr;
+    bool last = false; // stops the render thread
+};
+
+// time the main thread spends filling a packet, simulation ticks included.
+Benchmark benchmarkSimulate;
+
+// the ticks due since the last frame, each recorded by the frame profiler.
+uint32_t simulate() {
+    uint32_t ticks = timestep.steps();
+    if (!activeSimulation) return ticks;
 
-    if (vkCreateSemaphore(VK::device, &semaphoreInfo, nullptr, &imageAvailableSemaphores) != VK_SUCCESS ||
-        vkCreateSemaphore(VK::device, &semaphoreInfo, nullptr, &renderFinishedSemaphores) != VK_SUCCESS ||
-        vkCreateFence(VK::device, &fenceInfo, nullptr, &inFlightFence) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create synchronization objects for a frame!");
+    for (uint32_t i = 0; i < ticks; i++) {
+        int64_t start = frameProfiler.now();
+        activeSimulation->tick(timestep.seconds());
+        frameProfiler.tick(start, frameProfiler.now() - start);
     }
+    return ticks;
+}
+
+void produce_packet(FramePacket& packet) {
+    auto scope = frameProfiler.scope("simulate");
+    benchmarkSimulate.start();
+
+    packet.input = frameProfiler.now();
+    packet.framebufferWidth = RenderEngine::width;
+    packet.framebufferHeight = RenderEngine::height;
+    RenderEngine::window_framebuffer_size(packet.framebufferWidth, packet.framebufferHeight);
 
-    VkPhysicalDeviceMemoryProperties memoryProperties = VK::getPhysicalDeviceMemoryProperties(VK::physicalDevice);
-    //Vertex::createVertexBuffer(VK::device, vertices, VK_SHARING_MODE_EXCLUSIVE);
+    packet.ticks = simulate();
+    if (activeSimulation) activeSimulation->draw(timestep.alpha(), packet.draws);
+    else packet.draws.assign(draws.begin(), draws.end());
+    packet.pipeline = activePipeline;
+    packet.mesh = activeMesh;
+    packet.scene = activeScene;
+    packet.last = false;
+
+    benchmarkSimulate.end();
 }
 
-void RenderEngine::loop() {
-    auto last = Clock::now();
-    auto delta = last - Clock::now();
+void render_frame(const FramePacket& packet);
 
-    while (!window_is_closed()) {
-        delta = Clock::now() - last;
-        last = Clock::now();
+void render_packet(const FramePacket& packet) {
+    frameProfiler.beginFrame(packet.input, packet.ticks);
+    render_frame(packet);
+    frameProfiler.endFrame();
+}
 
-        auto seconds = 1e9 / std::chrono::duration_cast<std::chrono::nanoseconds>(delta).count();
+// the render thread's side: packets are produced by the main thread while the previous one renders, and handed over
+// through a triple buffer. the main thread publishes a packet once the previous one was taken, so none is dropped
+// and it never runs more than one frame ahead.
+TripleBuffer<FramePacket> packets;
+FramePacket inlinePacket;
+std::thread renderingThread;
+std::exception_ptr renderError;
+std::atomic<bool> renderFailed = false;
 
-        //info("{:02f} fps", (seconds));
+void render_thread() {
+    for (;;) {
+        packets.waitPublished();
+        const FramePacket& packet = packets.front();
+        if (packet.last) return;
+        if (renderFailed.load(std::memory_order_relaxed)) continue; // drained until the main thread stops us
 
-        frame();
+        try {
+            render_packet(packet);
+        } catch (...) {
+            renderError = std::current_exception();
+            renderFailed.store(true, std::memory_order_release);
+        }
+    }
+}
+
+void start_render_thread() {
+    renderFailed = false;
+    renderError = nullptr;
+    renderingThread = std::thread(render_thread);
+}
+
+// returns once the render thread is done with its last packet, rethrows what it threw.
+void stop_render_thread() {
+    packets.waitTaken();
+    packets.back().last = true;
+    packets.publish();
+    renderingThread.join();
+    if (renderError) std::rethrow_exception(std::exchange(renderError, nullptr));
+}
+
+void RenderEngine::loop(uint64_t maxFrames) {
+    timestep.setRate(tickRate, maxTicksPerFrame);
+
+    if (renderThread) start_render_thread();
+    for (uint64_t n = 0; !window_is_closed() && (maxFrames == 0 || n < maxFrames); n++) {
+        // wait first, then sample input: the frame starts as late as the cap allows.
+        if (frameLimiter.enabled()) {
+            auto scope = frameProfiler.scope("frame limiter");
+            frameLimiter.wait();
+        }
         window_update();
+        jobs.runMainJobs();
+        if (!renderThread) {
+            frame();
+            continue;
+        }
+
+        // simulates frame n while the render thread records & submits frame n - 1.
+        produce_packet(packets.back());
+        {
+            auto scope = frameProfiler.scope("wait render thread");
+            packets.waitTaken();
+        }
+        packets.publish();
+        if (renderFailed.load(std::memory_order_acquire)) break;
     }
+    if (renderThread) stop_render_thread();
     vkDeviceWaitIdle(VK::device);
 }
 
 void RenderEngine::frame() {
-    vkWaitForFences(VK::device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
+    produce_packet(inlinePacket);
+    render_packet(inlinePacket);
+}
+
+void render_frame(const FramePacket& packet) {
+    if (swapchainDirty) {
+        auto scope = frameProfiler.scope("recreate swapchain");
+        if (!recreate_swapchain(packet.framebufferWidth, packet.framebufferHeight)) return;
+    }
+
+    VK::FrameSync& f = VK::frameRing.slot();
+
+    // acquire: everything the frame waits on before it can record, fences included.
+    frameProfiler.phase(FrameProfiler::ACQUIRE);
+
+    benchmarkFenceWait.start();
+    vkWaitForFences(VK::device, 1, &f.inFlightFence, VK_TRUE, UINT64_MAX);
+    benchmarkFenceWait.end();
+
+    destroy_retired_swapchains();
+
+    // the slot's previous frame is done: its per frame descriptor sets, released bindless indices and frame data
+    // region are free.
+    VK::descriptorCounters.nextFrame();
+    VK::frameDescriptors.reset(VK::frameRing.current);
+    VK::bindless.beginFrame(VK::frameRing.current);
+    VK::frameData.begin(VK::frameRing.current);
 
     uint32_t imageIndex;
     VkResult result_acquireNextImage = vkAcquireNextImageKHR(VK::device, VK::surface.swapchain.swapchain, UINT64_MAX,
-                                                             imageAvailableSemaphores,
+                                                             f.imageAvailableSemaphore,
                                                              VK_NULL_HANDLE, &imageIndex);
     if (result_acquireNextImage == VK_ERROR_OUT_OF_DATE_KHR) {
-        info("window resized ? swapchain out of date.");
+        // nothing was acquired, the semaphore stays unsignaled: rebuild and render on the next call.
+        swapchainDirty = true;
+        recreate_swapchain(packet.framebufferWidth, packet.framebufferHeight);
         return;
     }
+    if (result_acquireNextImage != VK_SUCCESS && result_acquireNextImage != VK_SUBOPTIMAL_KHR) {
+        throw std::runtime_error("failed to acquire swapchain image!");
+    }
+    // suboptimal still presents correctly: render this frame, rebuild after present.
+    if (result_acquireNextImage == VK_SUBOPTIMAL_KHR) swapchainDirty = true;
+
+    benchmarkFenceWait.start();
+    VK::frameRing.acquireImage(VK::device, imageIndex);
+    benchmarkFenceWait.end();
+
+    frameProfiler.phase(FrameProfiler::RECORD);
+
+    vkResetFences(VK::device, 1, &f.inFlightFence);
+
+    vkResetCommandBuffer(f.commandBuffer, 0); /*VkCommandBufferResetFlagBits*/
+    const VK::Frame& target = VK::surface.swapchain.frames[imageIndex];
+    VK::recordCommandBuffer(f.commandBuffer, VK::renderPass, target, packet.pipeline->pipeline,
+                            frame_input(packet.mesh->input, target.extent), packet.draws, VK::frameRing.current, true,
+                            packet.scene);
+
+    VK::Uploader::Acquire upload = VK::uploader.acquire(VK::frameRing.current);
+
+    VkCommandBuffer commandBuffers[3];
+    uint32_t commandBufferCount = 0;
+    if (upload.commandBuffer != VK_NULL_HANDLE) commandBuffers[commandBufferCount++] = upload.commandBuffer;
+    commandBuffers[commandBufferCount++] = f.commandBuffer;
+    if (pendingReadback != nullptr) {
+        pendingReadback->record(VK::surface.swapchain.frames[imageIndex].image);
+        commandBuffers[commandBufferCount++] = pendingReadback->commandBuffer;
+        pendingReadback = nullptr;
+    }
 
-    vkResetFences(VK::device, 1, &inFlightFence);
+    frameProfiler.phase(FrameProfiler::SUBMIT);
 
-    vkResetCommandBuffer(commandBuffer, 0); /*VkCommandBufferResetFlagBits*/
-    VK::recordCommandBuffer(commandBuffer, renderPass, VK::surface.swapchain.frames[imageIndex].framebuffer.framebuffer,
-                            VK::surface.extent, pipeline);
+    // binary acquire semaphore, then the upload timeline when copies are still in flight.
+    VkSemaphore waitSemaphores[] = {f.imageAvailableSemaphore, upload.semaphore};
+    uint64_t waitValues[] = {0, upload.value};
+    VkPipelineStageFlags stageFlags[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                         VK::Uploader::consumerStages};
+    uint64_t signalValue = 0;
+
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+        .pNext{},
+        .waitSemaphoreValueCount = upload.value ? 2u : 1u,
+        .pWaitSemaphoreValues = waitValues,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &signalValue
+    };
 
-    VkPipelineStageFlags stageFlags[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     VkSubmitInfo submitInfo {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext{},
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &imageAvailableSemaphores,
+        .pNext = &timelineInfo,
+        .waitSemaphoreCount = upload.value ? 2u : 1u,
+        .pWaitSemaphores = waitSemaphores,
         .pWaitDstStageMask = stageFlags,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &commandBuffer,
+        .commandBufferCount = commandBufferCount,
+        .pCommandBuffers = commandBuffers,
         .signalSemaphoreCount = 1,
-        .pSignalSemaphores = &renderFinishedSemaphores
+        .pSignalSemaphores = &VK::frameRing.renderFinished[imageIndex]
     };
 
-    vkQueueSubmit(queue_graphics, 1, &submitInfo, inFlightFence);
+    vkQueueSubmit(VK::queues.graphics.vkQueue, 1, &submitInfo, f.inFlightFence);
+    VK::gpuProfiler.submitted(VK::frameRing.current);
+
+    frameProfiler.phase(FrameProfiler::PRESENT);
 
     VkPresentInfoKHR presentInfo {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
         .pNext{},
         .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &renderFinishedSemaphores,
+        .pWaitSemaphores = &VK::frameRing.renderFinished[imageIndex],
         .swapchainCount = 1,
         .pSwapchains = &VK::surface.swapchain.swapchain,
         .pImageIndices = &imageIndex,
         .pResults{}
     };
 
-    vkQueuePresentKHR(queue_present, &presentInfo);
+    VkResult result_present = vkQueuePresentKHR(VK::queues.present.vkQueue, &presentInfo);
+    if (result_present == VK_ERROR_OUT_OF_DATE_KHR || result_present == VK_SUBOPTIMAL_KHR) swapchainDirty = true;
+
+    frameCount++;
+    VK::frameRing.advance();
 }
 
-void RenderEngine::exit() {
+void RenderEngine::set_frames_in_flight(uint32_t count) {
+    vkDeviceWaitIdle(VK::device);
+    VK::frameRing.destroy(VK::device, commandPool);
+
+    framesInFlight = count;
+    VK::frameRing.create(VK::device, commandPool, framesInFlight,
+                         static_cast<uint32_t>(VK::surface.swapchain.frames.size()));
 
-    vkDestroyFence(VK::device, inFlightFence, nullptr);
-    vkDestroySemaphore(VK::device, renderFinishedSemaphores, nullptr);
-    vkDestroySemaphore(VK::device, imageAvailableSemaphores, nullptr);
+    VK::recorder.destroy();
+    VK::recorder.init(VK::device, VK::queues.graphics.id.value(), recordThreads, framesInFlight);
+
+    VK::gpuProfiler.destroy();
+    VK::gpuProfiler.init(VK::device, VK::physicalDevice, VK::queues.graphics.id.value(),
+                         VK::queues.graphics.vkQueue, framesInFlight);
+
+    VK::frameDescriptors.destroy();
+    VK::frameDescriptors.create(VK::device, framesInFlight);
+    VK::bindless.setFramesInFlight(framesInFlight);
+    VK::frameData.setFramesInFlight(framesInFlight);
+}
 
-    for (auto& f: VK::surface.swapchain.frames) {
-        f.framebuffer.destroy();
+void RenderEngine::set_present_policy(PresentPolicy policy) {
+    presentPolicy = policy;
+    apply_present_policy();
+    swapchainDirty = true;
+}
+
+const char* RenderEngine::present_policy_name(PresentPolicy policy) {
+    switch (policy) {
+        case PresentPolicy::LOW_LATENCY:
+            return "low-latency";
+        case PresentPolicy::THROUGHPUT:
+            return "throughput";
+        case PresentPolicy::POWER_SAVING:
+            return "power-saving";
     }
+    return "unknown";
+}
+
+void RenderEngine::benchmark_present_policies(uint32_t frameCount) {
+    PresentPolicy previous = presentPolicy;
+
+    for (PresentPolicy policy: {PresentPolicy::LOW_LATENCY, PresentPolicy::THROUGHPUT, PresentPolicy::POWER_SAVING}) {
+        set_present_policy(policy);
+        uint64_t first = frameProfiler.nextFrame();
+
+        // latency is only known once the gpu profiler read the frame back, framesInFlight frames later.
+        loop(frameCount + framesInFlight);
+
+        FrameProfiler::Percentiles frameTime = frameProfiler.percentiles(FrameProfiler::TOTAL, first);
+        FrameProfiler::Percentiles latency = frameProfiler.percentiles(FrameProfiler::LATENCY, first);
+        info("present policy {}: mode {}, {} images -> frame p50 {:.3f} ms p99 {:.3f} ms, "
+             "latency p50 {:.3f} ms p99 {:.3f} ms", present_policy_name(policy), (int) VK::surface.vkPresentMode,
+             VK::surface.swapchain.frames.size(), frameTime.p50 / 1e6, frameTime.p99 / 1e6, latency.p50 / 1e6,
+             latency.p99 / 1e6);
+    }
+
+    set_present_policy(previous);
+}
+
+void RenderEngine::benchmark_recording(uint32_t drawCount, uint32_t iterations) {
+    vkDeviceWaitIdle(VK::device);
+
+    vector<VK::Draw> benchmarkDraws(drawCount, VK::Draw {3, 1, 0, 0});
+    VkCommandBuffer commandBuffer = VK::frameRing.slot().commandBuffer;
+    const VK::Frame& target = VK::surface.swapchain.frames[0];
+    VK::VertexInput input = frame_input(mesh.input, target.extent);
+
+    auto recordAll = [&](bool parallel) {
+        Benchmark benchmark;
+        for (uint32_t i = 0; i < iterations; i++) {
+            vkResetCommandBuffer(commandBuffer, 0);
+            benchmark.start();
+            VK::recordCommandBuffer(commandBuffer, VK::renderPass, target, VK::pipeline.pipeline, input,
+                                    benchmarkDraws, VK::frameRing.current, parallel);
+            benchmark.end();
+        }
+        return benchmark.mean();
+    };
+
+    int64_t inlineTime = recordAll(false);
+    info("recording {} draws inline: {} us", drawCount, inlineTime / 1000);
+
+    uint32_t previous = recordThreads;
+    uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    for (uint32_t partitions = 1; partitions <= cores; partitions *= 2) {
+        recordThreads = partitions;
+        VK::recorder.destroy();
+        VK::recorder.init(VK::device, VK::queues.graphics.id.value(), recordThreads, framesInFlight);
+
+        int64_t time = recordAll(true);
+        info("recording {} draws in {} partitions on {} job threads: {} us ({:.2f}x)", drawCount, partitions,
+             jobs.threadCount(), time / 1000, time ? (double) inlineTime / (double) time : 0.0);
+    }
+
+    recordThreads = previous;
+    VK::recorder.destroy();
+    VK::recorder.init(VK::device, VK::queues.graphics.id.value(), recordThreads, framesInFlight);
+}
+
+// the baseline of benchmark_jobs: threads taking std::functions from one queue behind one mutex.
+class MutexPool {
+public:
+    explicit MutexPool(uint32_t threadCount) {
+        for (uint32_t i = 0; i < threadCount; i++) threads.emplace_back([this] { loop(); });
+    }
+
+    ~MutexPool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        available.notify_all();
+        for (auto& t: threads) t.join();
+    }
+
+    void submit(std::function<void()> f) {
+        {
+            std::lock_guard lock(mutex);
+            queue.push_back(std::move(f));
+            pending++;
+        }
+        available.notify_one();
+    }
+
+    // until every job submitted so far is done.
+    void wait() {
+        std::unique_lock lock(mutex);
+        idle.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable available;
+    std::condition_variable idle;
+    std::deque<std::function<void()>> queue;
+    uint32_t pending = 0;
+    bool stopping = false;
+
+    void loop() {
+        for (;;) {
+            std::function<void()> f;
+            {
+                std::unique_lock lock(mutex);
+                available.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) return;
+                f = std::move(queue.front());
+                queue.pop_front();
+            }
+            f();
+
+            std::lock_guard lock(mutex);
+            if (--pending == 0) idle.notify_all();
+        }
+    }
+};
+
+void RenderEngine::benchmark_jobs(uint32_t jobCount, uint32_t itemCount, uint32_t iterations) {
+    uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    auto perJob = [](const Benchmark& b, uint32_t count) { return count ? (double) b.mean() / count : 0.0; };
+
+    // scheduling overhead: jobs that do nothing, spawned from the main thread.
+    jobs.init(cores);
+    Benchmark jobTime;
+    JobSystem::Stats before = jobs.stats();
+    for (uint32_t k = 0; k < iterations; k++) {
+        jobTime.start();
+        JobSystem::Counter counter;
+        for (uint32_t i = 0; i < jobCount; i++) jobs.run([] {}, &counter);
+        jobs.wait(counter);
+        jobTime.end();
+    }
+    JobSystem::Stats after = jobs.stats();
+
+    Benchmark poolTime;
+    {
+        MutexPool pool(cores);
+        for (uint32_t k = 0; k < iterations; k++) {
+            poolTime.start();
+            for (uint32_t i = 0; i < jobCount; i++) pool.submit([] {});
+            pool.wait();
+            poolTime.end();
+        }
+    }
+
+    // a thread per task: fewer of them, or it takes seconds.
+    uint32_t asyncCount = std::max(jobCount / 100, 1u);
+    Benchmark asyncTime;
+    vector<std::future<void>> futures(asyncCount);
+    for (uint32_t k = 0; k < iterations; k++) {
+        asyncTime.start();
+        for (uint32_t i = 0; i < asyncCount; i++) futures[i] = std::async(std::launch::async, [] {});
+        for (auto& f: futures) f.wait();
+        asyncTime.end();
+    }
+
+    info("{} empty jobs on {} threads: job system {:.1f} ns/job ({} steals), mutex pool {:.1f} ns/job, "
+         "std::async {:.1f} ns/job ({} jobs)", jobCount, cores, perJob(jobTime, jobCount),
+         after.steals - before.steals, perJob(poolTime, jobCount), perJob(asyncTime, asyncCount), asyncCount);
+
+    // scaling: items of uneven cost, the last ones the heaviest, so equal static splits are unbalanced.
+    vector<float> out(itemCount);
+    auto item = [&out](uint32_t i) {
+        float x = (float) i;
+        for (uint32_t k = 0; k < (i & 255); k++) x = x * 0.999f + 1.0f;
+        out[i] = x;
+    };
+    auto items = [&item](uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; i++) item(i);
+    };
+    constexpr uint32_t grain = 1024;
+
+    Benchmark serial;
+    for (uint32_t k = 0; k < iterations; k++) {
+        serial.start();
+        items(0, itemCount);
+        serial.end();
+    }
+    auto speedup = [&serial](const Benchmark& b) {
+        return b.mean() ? (double) serial.mean() / (double) b.mean() : 0.0;
+    };
+
+    for (uint32_t threads = 1; threads <= cores; threads *= 2) {
+        jobs.init(threads);
+        Benchmark jobFor;
+        before = jobs.stats();
+        for (uint32_t k = 0; k < iterations; k++) {
+            jobFor.start();
+            jobs.parallelFor(0, itemCount, grain, items);
+            jobFor.end();
+        }
+        after = jobs.stats();
+
+        // the pool gets every grain as a job, std::async one equal range per thread.
+        Benchmark poolFor;
+        {
+            MutexPool pool(threads);
+            for (uint32_t k = 0; k < iterations; k++) {
+                poolFor.start();
+                for (uint32_t first = 0; first < itemCount; first += grain)
+                    pool.submit([&items, first, itemCount] { items(first, std::min(first + grain, itemCount)); });
+                pool.wait();
+                poolFor.end();
+            }
+        }
+
+        Benchmark asyncFor;
+        vector<std::future<void>> ranges(threads);
+        for (uint32_t k = 0; k < iterations; k++) {
+            asyncFor.start();
+            for (uint32_t t = 0; t < threads; t++) {
+                uint32_t first = (uint32_t) ((uint64_t) itemCount * t / threads);
+                uint32_t last = (uint32_t) ((uint64_t) itemCount * (t + 1) / threads);
+                ranges[t] = std::async(std::launch::async, items, first, last);
+            }
+            for (auto& r: ranges) r.wait();
+            asyncFor.end();
+        }
+
+        info("parallel for of {} items on {} threads: job system {:.3f} ms ({:.2f}x, {} jobs, {} steals), "
+             "mutex pool {:.3f} ms ({:.2f}x), std::async {:.3f} ms ({:.2f}x)", itemCount, threads,
+             (double) jobFor.mean() / 1e6, speedup(jobFor), after.jobs - before.jobs, after.steals - before.steals,
+             (double) poolFor.mean() / 1e6, speedup(poolFor), (double) asyncFor.mean() / 1e6, speedup(asyncFor));
+    }
+
+    jobs.init(jobThreads);
+}
+
+template<typename Layout>
+void benchmark_vertex_layout(const char* name, const vector<Vertex>& benchmarkVertices, uint32_t frameCount) {
+    VK::Pipeline benchmarkPipeline {};
+    benchmarkPipeline.createGraphicsPipeline(Layout::getBindingDescriptions(), Layout::getAttributeDescriptions(),
+                                             sizeof(VertexFormat::Decode), "dat/shaders/default.vert.glsl.spv",
+                                             {VK::frameData.layout});
+
+    MeshBuffers benchmarkMesh {};
+    benchmarkMesh.upload(Layout::encode(benchmarkVertices), benchmarkPipeline.layout);
+
+    vector<VK::Draw> previousDraws = std::move(draws);
+    draws = {{static_cast<uint32_t>(benchmarkVertices.size()), 1, 0, 0}};
+    activePipeline = &benchmarkPipeline;
+    activeMesh = &benchmarkMesh;
+
+    // gpu times are read back framesInFlight frames late.
+    uint64_t first = frameProfiler.nextFrame();
+    RenderEngine::loop(frameCount + RenderEngine::framesInFlight);
+    FrameProfiler::Percentiles gpu = frameProfiler.percentiles(FrameProfiler::GPU, first);
+
+    activePipeline = &VK::pipeline;
+    activeMesh = &mesh;
+    draws = std::move(previousDraws);
+
+    benchmarkMesh.destroy();
+    benchmarkPipeline.deletePipeline(VK::device, benchmarkPipeline.pipeline);
+    benchmarkPipeline.deletePipelineLayout(VK::device, benchmarkPipeline.layout);
+
+    if (gpu.p50 == 0) {
+        info("vertex fetch {}: no gpu timings", name);
+        return;
+    }
+
+    double seconds = (double) gpu.p50 / 1e9;
+    double count = (double) benchmarkVertices.size();
+    info("vertex fetch {} ({} bytes/vertex): {:.3f} ms, {:.2f} Gvertices/s, {:.1f} GB/s", name, Layout::vertexSize,
+         (double) gpu.p50 / 1e6, count / seconds / 1e9, count * Layout::vertexSize / seconds / 1e9);
+}
+
+void RenderEngine::benchmark_vertex_fetch(uint32_t triangleCount, uint32_t frameCount) {
+    // degenerate triangles are dropped before rasterization: what is left is vertex fetch and shading.
+    vector<Vertex> benchmarkVertices(triangleCount * 3ull);
+    uint32_t seed = 1;
+    auto random = [&seed] {
+        seed = seed * 1664525u + 1013904223u;
+        return (float) (seed >> 8) / (float) (1 << 24);
+    };
+
+    for (size_t t = 0; t < triangleCount; t++) {
+        Vertex v {{random() * 2.0f - 1.0f, random() * 2.0f - 1.0f, random()}, {random(), random(), random()}};
+        for (size_t k = 0; k < 3; k++) benchmarkVertices[t * 3 + k] = v;
+    }
+
+    benchmark_vertex_layout<FloatVertexLayout>("float", benchmarkVertices, frameCount);
+    benchmark_vertex_layout<DefaultVertexLayout>("quantized", benchmarkVertices, frameCount);
+}
+
+// a mesh of the default layout, about bytes large: random positions & colors, a plain uint32 triangle list.
+void write_benchmark_mesh(const char* path, uint64_t bytes) {
+    static constexpr uint64_t bytesPerVertex = DefaultVertexLayout::vertexSize + sizeof(uint32_t);
+    auto vertexCount = static_cast<uint32_t>(std::min<uint64_t>(bytes / bytesPerVertex / 3 * 3, UINT32_MAX / 3 * 3));
+
+    MeshFormat::Header header {
+        .magic = MeshFormat::magic,
+        .version = MeshFormat::version,
+        .sectionCount = 0,
+        .indexType = MeshFormat::IndexType::UINT32,
+        .layout = DefaultVertexLayout::id,
+        .fileSize = 0,
+        .vertexCount = vertexCount,
+        .indexCount = vertexCount,
+        .lodCount = 1,
+        .reserved = 0,
+        .boundsMin = {-1.0f, -1.0f, -1.0f},
+        .boundsMax = {1.0f, 1.0f, 1.0f},
+        .decode = {}
+    };
+
+    vector<MeshFormat::Section> sections;
+    for (uint32_t i = 0; i < DefaultVertexLayout::streamCount; i++) {
+        uint32_t stride = DefaultVertexLayout::stride(i);
+        sections.push_back({MeshFormat::SectionType::VERTEX_STREAM, i, stride, 0, 0, (uint64_t) stride * vertexCount});
+    }
+    sections.push_back({MeshFormat::SectionType::INDICES, 0, 4, 0, 0, 4ull * vertexCount});
+    sections.push_back({MeshFormat::SectionType::LODS, 0, sizeof(MeshFormat::Lod), 0, 0, sizeof(MeshFormat::Lod)});
+
+    uint32_t seed = 1;
+    MeshFormat::write(path, header, sections, [&](uint32_t section, uint64_t offset, uint8_t* dst, uint64_t size) {
+        switch (sections[section].type) {
+            case MeshFormat::SectionType::VERTEX_STREAM:
+                for (uint64_t i = 0; i < size; i++) {
+                    seed = seed * 1664525u + 1013904223u;
+                    dst[i] = static_cast<uint8_t>(seed >> 24);
+                }
+                break;
+            case MeshFormat::SectionType::INDICES:
+                for (uint64_t i = 0; i < size / 4; i++) {
+                    auto index = static_cast<uint32_t>(offset / 4 + i);
+                    memcpy(dst + i * 4, &index, 4);
+                }
+                break;
+            case MeshFormat::SectionType::LODS: {
+                MeshFormat::Lod lod {0, vertexCount, 0.0f, 0};
+                memcpy(dst, &lod, sizeof(lod));
+                break;
+            }
+        }
+    });
+}
+
+void RenderEngine::benchmark_mesh_loading(const char* path, uint64_t bytes) {
+    {
+        std::ifstream existing(path, std::ios::binary | std::ios::ate);
+        if (!existing.is_open() || (uint64_t) existing.tellg() < bytes / 2) {
+            info("writing {} MiB benchmark mesh to {}", bytes >> 20, path);
+            write_benchmark_mesh(path, bytes);
+        }
+    }
+
+    // both loaders end once the device local buffers hold the mesh.
+    auto finish = [](MeshBuffers& buffers, const char* name, Clock::time_point start) {
+        VK::uploader.wait(VK::uploader.flush());
+        auto time = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+        MemoryUsage usage = MemoryUsage::sample();
+
+        // a frame picks up the queue family acquires of the new buffers before they are destroyed.
+        frame();
+        vkDeviceWaitIdle(VK::device);
+        buffers.destroy();
+
+        info("mesh loading {}: {:.1f} ms, peak resident {} MiB, anonymous {} MiB", name, (double) time / 1000.0,
+             usage.peak >> 20, usage.anonymous >> 20);
+    };
+
+    // baseline: every section read into its own heap buffer, then staged from there.
+    {
+        MemoryUsage::resetPeak();
+        auto start = Clock::now();
+        MeshBuffers buffers {};
+
+        std::ifstream file(path, std::ios::binary);
+        MeshFormat::Header header {};
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        vector<MeshFormat::Section> sections(header.sectionCount);
+        auto tableSize = static_cast<std::streamsize>(sizeof(MeshFormat::Section) * sections.size());
+        file.read(reinterpret_cast<char*>(sections.data()), tableSize);
+
+        vector<vector<uint8_t>> data(sections.size());
+        for (size_t i = 0; i < sections.size(); i++) {
+            data[i].resize(sections[i].size);
+            file.seekg((std::streamoff) sections[i].offset);
+            file.read(reinterpret_cast<char*>(data[i].data()), (std::streamsize) sections[i].size);
+        }
+        if (!file.good()) throw std::runtime_error("failed to read mesh file!");
+
+        buffers.input.streamCount = 0;
+        for (size_t i = 0; i < sections.size(); i++) {
+            if (sections[i].type == MeshFormat::SectionType::VERTEX_STREAM) {
+                uint32_t s = buffers.input.streamCount++;
+                buffers.buffers[s] = VK::uploader.createBuffer(data[i].data(), data[i].size(),
+                                                               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                                               buffers.allocations[s],
+                                                               VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+            } else if (sections[i].type == MeshFormat::SectionType::INDICES) {
+                buffers.indexBuffer = VK::uploader.createBuffer(data[i].data(), data[i].size(),
+                                                                VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                                                buffers.indexAllocation, VK_ACCESS_INDEX_READ_BIT);
+            }
+        }
+
+        finish(buffers, "ifstream", start);
+    }
+
+    {
+        MemoryUsage::resetPeak();
+        auto start = Clock::now();
+        MeshBuffers buffers {};
+
+        MeshFile file;
+        file.open(path);
+        buffers.upload(file, VK::pipeline.layout);
+
+        finish(buffers, "mmap", start);
+    }
+}
+
+// an icosphere of radius 1, lod l subdivided lodCount - 1 - l times. every subdivision appends its midpoints to the
+// vertices of the coarser one: all lods index the one vertex list. triangles are clockwise seen from outside, the
+// front face of the default pipeline.
+struct Icosphere {
+    vector<Vertex> vertices;
+    vector<uint32_t> indices;
+    vector<MeshFormat::Lod> lods; // finest first
+};
+
+Icosphere make_icosphere(uint32_t lodCount) {
+    const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+    vector<vec3> positions = {{-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0}, {0, -1, t}, {0, 1, t},
+                              {0, -1, -t}, {0, 1, -t}, {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}};
+    for (vec3& p: positions) p = glm::normalize(p);
+
+    vector<vector<uint32_t>> levels = {{0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4, 11, 10, 2,
+                                        10, 7, 6, 7, 1, 8, 3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9, 4, 9, 5,
+                                        2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1}};
+    vector<uint32_t>& base = levels[0];
+    for (size_t i = 0; i < base.size(); i += 3) {
+        const vec3& a = positions[base[i]];
+        if (glm::dot(glm::cross(positions[base[i + 1]] - a, positions[base[i + 2]] - a), a) > 0.0f)
+            std::swap(base[i + 1], base[i + 2]);
+    }
+
+    std::unordered_map<uint64_t, uint32_t> midpoints;
+    auto midpoint = [&](uint32_t a, uint32_t b) {
+        uint64_t key = (uint64_t) std::min(a, b) << 32 | std::max(a, b);
+        auto [it, inserted] = midpoints.try_emplace(key, static_cast<uint32_t>(positions.size()));
+        if (inserted) positions.push_back(glm::normalize(positions[a] + positions[b]));
+        return it->second;
+    };
+
+    // each triangle splits in four of the same winding.
+    for (uint32_t s = 1; s < lodCount; s++) {
+        vector<uint32_t> fine;
+        for (size_t i = 0; i < levels.back().size(); i += 3) {
+            uint32_t a = levels.back()[i];
+            uint32_t b = levels.back()[i + 1];
+            uint32_t c = levels.back()[i + 2];
+            uint32_t ab = midpoint(a, b);
+            uint32_t bc = midpoint(b, c);
+            uint32_t ca = midpoint(c, a);
+            fine.insert(fine.end(), {a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca});
+        }
+        levels.push_back(std::move(fine));
+    }
+
+    Icosphere sphere;
+    for (const vec3& p: positions) sphere.vertices.push_back(Vertex {p, p * 0.5f + 0.5f, p});
+
+    // the error of a lod: how far its flattest triangle lies inside the sphere.
+    for (auto level = levels.rbegin(); level != levels.rend(); ++level) {
+        float error = 0.0f;
+        for (size_t i = 0; i < level->size(); i += 3) {
+            vec3 centroid = (positions[(*level)[i]] + positions[(*level)[i + 1]] + positions[(*level)[i + 2]]) / 3.0f;
+            error = std::max(error, 1.0f - glm::length(centroid));
+        }
+        sphere.lods.push_back({static_cast<uint32_t>(sphere.indices.size()), static_cast<uint32_t>(level->size()),
+                               error, 0});
+        sphere.indices.insert(sphere.indices.end(), level->begin(), level->end());
+    }
+    return sphere;
+}
+
+// one run of benchmark_indirect(): instanceCount instances of an icosphere and of a flattened one.
+void benchmark_indirect_scene(const Icosphere& sphere, uint32_t instanceCount, uint32_t frameCount, bool drawCount) {
+    VK::IndirectScene& scene = VK::indirectScene;
+    bool drawCountSupported = scene.drawIndirectCountSupported;
+    scene.drawIndirectCountSupported = drawCount;
+
+    VertexFormat::Streams streams = DefaultVertexLayout::encode(sphere.vertices);
+    MeshBuffers geometry {};
+    geometry.upload(streams, VK_NULL_HANDLE, sphere.indices);
+    geometry.input.pushConstantSize = 0; // decoded per mesh, from the scene's storage buffers
+
+    VK::IndirectScene::Mesh round {};
+    round.lodCount = static_cast<uint32_t>(sphere.lods.size());
+    for (uint32_t l = 0; l < round.lodCount; l++) {
+        round.lodFirstIndex[l] = sphere.lods[l].firstIndex;
+        round.lodIndexCount[l] = sphere.lods[l].indexCount;
+        round.lodError[l] = sphere.lods[l].error;
+    }
+    round.decodeScale = streams.decode.scale;
+    round.decodeBias = streams.decode.bias;
+
+    VK::IndirectScene::Mesh flat = round;
+    flat.decodeScale *= vec4(1.0f, 0.3f, 1.0f, 1.0f);
+    flat.decodeBias *= vec4(1.0f, 0.3f, 1.0f, 1.0f);
+
+    // about one instance per 2x2x2 cell of a cube centered on the origin.
+    uint32_t seed = 1;
+    auto random = [&seed] {
+        seed = seed * 1664525u + 1013904223u;
+        return (float) (seed >> 8) / (float) (1 << 24);
+    };
+    float side = 2.0f * std::cbrt((float) instanceCount);
+    vector<VK::IndirectScene::Instance> instances(instanceCount);
+    for (uint32_t i = 0; i < instanceCount; i++) {
+        vec3 position = (vec3(random(), random(), random()) - 0.5f) * side;
+        instances[i] = {vec4(position, 0.3f + 0.4f * random()), i & 1u, {}};
+    }
+
+    scene.create(VK::device, geometry.input, {round, flat}, instances);
+
+    VK::Pipeline pipeline {};
+    pipeline.createGraphicsPipeline(DefaultVertexLayout::getBindingDescriptions(),
+                                    DefaultVertexLayout::getAttributeDescriptions(),
+                                    sizeof(VK::IndirectScene::DrawConstants), scene.vertexShader(),
+                                    {scene.graphicsSetLayout()});
+    scene.graphicsPipeline = pipeline.pipeline;
+    scene.graphicsLayout = pipeline.layout;
+
+    // from just outside a face of the cube, towards its center: about a third of it in view.
+    VkExtent2D extent = VK::surface.extent;
+    float fovy = glm::radians(60.0f);
+    mat4x4 projection = glm::perspective(fovy, (float) extent.width / (float) extent.height, 0.1f, side * 2.0f);
+    projection[1][1] *= -1.0f; // vulkan's y points down
+    vec3 eye(0.0f, side * 0.1f, -side * 0.6f);
+    scene.setCamera(projection * glm::lookAt(eye, vec3(0.0f), vec3(0.0f, 1.0f, 0.0f)), eye,
+                    (float) extent.height / (2.0f * std::tan(fovy / 2.0f)));
+
+    vector<VK::Draw> previousDraws = std::move(draws);
+    draws = {};
+    activeScene = &scene;
+
+    // gpu times are read back framesInFlight frames late.
+    uint64_t first = frameProfiler.nextFrame();
+    RenderEngine::loop(frameCount + RenderEngine::framesInFlight);
+    FrameProfiler::Percentiles record = frameProfiler.percentiles(FrameProfiler::RECORD, first);
+    FrameProfiler::Percentiles gpu = frameProfiler.percentiles(FrameProfiler::GPU, first);
+
+    activeScene = nullptr;
+    draws = std::move(previousDraws);
+
+    // buckets are per mesh, lods in order.
+    array<uint32_t, VK::IndirectScene::maxLods> lods {};
+    uint32_t visible = 0;
+    vector<uint32_t> counts = scene.stats();
+    for (uint32_t b = 0; b < counts.size(); b++) {
+        lods[b % round.lodCount] += counts[b];
+        visible += counts[b];
+    }
+
+    info("indirect {} instances, {}: record p50 {:.3f} ms, gpu p50 {:.3f} ms, {} visible (lods {} {} {} {})",
+         instanceCount, drawCount ? "draw count" : scene.multiDrawIndirectSupported ? "multi draw" : "draw per bucket",
+         (double) record.p50 / 1e6, (double) gpu.p50 / 1e6, visible, lods[0], lods[1], lods[2], lods[3]);
+
+    scene.destroy();
+    pipeline.deletePipeline(VK::device, pipeline.pipeline);
+    pipeline.deletePipelineLayout(VK::device, pipeline.layout);
+    geometry.destroy();
+    scene.drawIndirectCountSupported = drawCountSupported;
+}
+
+void RenderEngine::benchmark_indirect(uint32_t instanceCount, uint32_t frameCount) {
+    Icosphere sphere = make_icosphere(VK::IndirectScene::maxLods);
+
+    // the cpu cost stays flat from a small scene to the full one, the fallback draws every bucket.
+    for (uint32_t count: {instanceCount / 16, instanceCount}) {
+        if (VK::indirectScene.drawIndirectCountSupported) benchmark_indirect_scene(sphere, count, frameCount, true);
+        benchmark_indirect_scene(sphere, count, frameCount, false);
+    }
+}
+
+// one draw per visible object, its index as firstInstance: what a shader would fetch the object's data with.
+void culled_draws(const uint32_t* visible, uint32_t count, vector<VK::Draw>& out) {
+    out.resize(count);
+    for (uint32_t i = 0; i < count; i++) out[i] = {3, 1, 0, visible[i]};
+}
+
+void RenderEngine::benchmark_culling(uint32_t objectCount, uint32_t iterations) {
+    // boxes scattered through a cube, a camera at one face looking at the center.
+    Scene::Bounds bounds;
+    for (vector<float>* component: {&bounds.centerX, &bounds.centerY, &bounds.centerZ, &bounds.extentX,
+                                    &bounds.extentY, &bounds.extentZ, &bounds.radius}) {
+        component->resize(objectCount);
+    }
+    uint32_t seed = 1;
+    auto random = [&seed] {
+        seed = seed * 1664525u + 1013904223u;
+        return (float) (seed >> 8) / (float) (1 << 24);
+    };
+    float side = 2.0f * std::cbrt((float) objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        bounds.centerX[i] = (random() - 0.5f) * side;
+        bounds.centerY[i] = (random() - 0.5f) * side;
+        bounds.centerZ[i] = (random() - 0.5f) * side;
+        bounds.extentX[i] = 0.2f + random();
+        bounds.extentY[i] = 0.2f + random();
+        bounds.extentZ[i] = 0.2f + random();
+        bounds.radius[i] = glm::length(vec3(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]));
+    }
+
+    mat4x4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, side * 2.0f);
+    vec3 eye(0.0f, 0.0f, -side * 0.6f);
+    Culling::Frustum frustum = Culling::Frustum::fromMatrix(projection * glm::lookAt(eye, vec3(0.0f),
+                                                                                      vec3(0.0f, 1.0f, 0.0f)));
+
+    vector<uint32_t> visible(objectCount);
+    vector<uint32_t> reference(objectCount);
+    auto throughput = [&](const Benchmark& b) { return b.mean() ? (double) objectCount / (double) b.mean() : 0.0; };
+
+    // the baseline: an array of spheres, a glm dot product per plane, out at the first plane that culls.
+    struct Sphere {
+        vec3 center;
+        float radius;
+    };
+    vector<Sphere> spheres(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        spheres[i] = {vec3(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]), bounds.radius[i]};
+    }
+
+    Benchmark naive;
+    uint32_t naiveCount = 0;
+    for (uint32_t k = 0; k < iterations; k++) {
+        naive.start();
+        naiveCount = 0;
+        for (uint32_t i = 0; i < objectCount; i++) {
+            bool inside = true;
+            for (const vec4& plane: frustum.planes) {
+                if (glm::dot(vec3(plane), spheres[i].center) + plane.w < -spheres[i].radius) {
+                    inside = false;
+                    break;
+                }
+            }
+            if (inside) visible[naiveCount++] = i;
+        }
+        naive.end();
+    }
+    info("culling {} spheres, naive glm loop: {} visible, {:.3f} objects/ns", objectCount, naiveCount,
+         throughput(naive));
+
+    Culling::Spheres sphereArrays = Culling::spheres(bounds);
+    Culling::Boxes boxArrays = Culling::boxes(bounds);
+    uint32_t sphereCount = Culling::cull(frustum, sphereArrays, reference.data(), Culling::Kernel::SCALAR);
+    uint32_t boxCount = Culling::cull(frustum, boxArrays, reference.data(), Culling::Kernel::SCALAR);
+
+    for (Culling::Kernel kernel: {Culling::Kernel::SCALAR, Culling::Kernel::SSE, Culling::Kernel::AVX2,
+                                  Culling::Kernel::NEON}) {
+        if (!Culling::supported(kernel)) continue;
+
+        Benchmark sphereTime;
+        Benchmark boxTime;
+        uint32_t count = 0;
+        for (uint32_t k = 0; k < iterations; k++) {
+            sphereTime.start();
+            count = Culling::cull(frustum, sphereArrays, visible.data(), kernel);
+            sphereTime.end();
+        }
+        if (count != sphereCount)
+            spdlog::error("culling: {} kernel disagrees with the scalar one", Culling::name(kernel));
+
+        for (uint32_t k = 0; k < iterations; k++) {
+            boxTime.start();
+            count = Culling::cull(frustum, boxArrays, visible.data(), kernel);
+            boxTime.end();
+        }
+        if (count != boxCount || !std::equal(visible.begin(), visible.begin() + count, reference.begin()))
+            spdlog::error("culling: {} kernel disagrees with the scalar one", Culling::name(kernel));
+
+        info("culling {} objects, {}{}: spheres {:.3f} objects/ns ({:.2f}x), boxes {:.3f} objects/ns, "
+             "{} & {} visible", objectCount, Culling::name(kernel), kernel == Culling::best() ? " (picked)" : "",
+             throughput(sphereTime), naive.mean() ? (double) naive.mean() / (double) sphereTime.mean() : 0.0,
+             throughput(boxTime), sphereCount, boxCount);
+    }
+
+    // the best kernel on chunks of the arrays, on the job system's workers.
+    Benchmark parallelSpheres;
+    Benchmark parallelBoxes;
+    uint32_t count = 0;
+    for (uint32_t k = 0; k < iterations; k++) {
+        parallelSpheres.start();
+        count = Culling::cullParallel(frustum, sphereArrays, visible.data());
+        parallelSpheres.end();
+    }
+    if (count != sphereCount) spdlog::error("culling: the parallel cull disagrees with the scalar one");
+
+    for (uint32_t k = 0; k < iterations; k++) {
+        parallelBoxes.start();
+        count = Culling::cullParallel(frustum, boxArrays, visible.data());
+        parallelBoxes.end();
+    }
+    if (count != boxCount || !std::equal(visible.begin(), visible.begin() + count, reference.begin()))
+        spdlog::error("culling: the parallel cull disagrees with the scalar one");
+
+    info("culling {} objects, {} on {} job threads: spheres {:.3f} objects/ns ({:.2f}x), boxes {:.3f} objects/ns",
+         objectCount, Culling::name(Culling::best()), jobs.threadCount(), throughput(parallelSpheres),
+         naive.mean() ? (double) naive.mean() / (double) parallelSpheres.mean() : 0.0, throughput(parallelBoxes));
+
+    // the visible list becomes the draw list: recording only what survived.
+    vkDeviceWaitIdle(VK::device);
+    VkCommandBuffer commandBuffer = VK::frameRing.slot().commandBuffer;
+    const VK::Frame& target = VK::surface.swapchain.frames[0];
+    VK::VertexInput input = frame_input(mesh.input, target.extent);
+    auto record = [&](const vector<VK::Draw>& recorded) {
+        Benchmark benchmark;
+        for (uint32_t k = 0; k < iterations; k++) {
+            vkResetCommandBuffer(commandBuffer, 0);
+            benchmark.start();
+            VK::recordCommandBuffer(commandBuffer, VK::renderPass, target, VK::pipeline.pipeline, input,
+                                    recorded, VK::frameRing.current);
+            benchmark.end();
+        }
+        return benchmark.mean();
+    };
+
+    vector<uint32_t> all(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) all[i] = i;
+    vector<VK::Draw> recorded;
+    culled_draws(all.data(), objectCount, recorded);
+    int64_t allTime = record(recorded);
+
+    Benchmark cullTime;
+    cullTime.start();
+    culled_draws(visible.data(), Culling::cullParallel(frustum, boxArrays, visible.data()), recorded);
+    cullTime.end();
+    int64_t culledTime = record(recorded);
+
+    info("recording {} draws: {} us, culled to {} draws: {} us + {} us culling", objectCount, allTime / 1000,
+         recorded.size(), culledTime / 1000, cullTime.mean() / 1000);
+}
+
+void RenderEngine::benchmark_scene(uint32_t iterations) {
+    for (uint32_t nodeCount: {10000u, 100000u, 1000000u}) {
+        for (bool parallel: {false, true}) {
+            // a forest of nodeCount / 64 roots, every other node under a random earlier one.
+            Scene scene(parallel);
+            vector<Scene::Handle> nodes(nodeCount);
+            uint32_t rootCount = std::max(nodeCount / 64, 1u);
+            uint32_t seed = 1;
+            auto random = [&seed] {
+                seed = seed * 1664525u + 1013904223u;
+                return seed >> 8;
+            };
+            for (uint32_t i = 0; i < nodeCount; i++) {
+                Scene::Transform local {vec3(1.0f, 0.0f, 0.0f), glm::angleAxis(0.1f, vec3(0.0f, 1.0f, 0.0f)),
+                                        vec3(0.9f)};
+                nodes[i] = scene.create(i < rootCount ? Scene::none : nodes[random() % i], local, vec3(0.0f),
+                                        vec3(0.5f), i % 16, 0);
+            }
+
+            Benchmark first;
+            first.start();
+            scene.update(); // sorts, then builds every node
+            first.end();
+
+            // moving every root rebuilds the whole hierarchy, moving 1% of the nodes rebuilds their subtrees.
+            Benchmark all;
+            Benchmark some;
+            uint32_t someUpdated = 0;
+            for (uint32_t k = 0; k < iterations; k++) {
+                for (uint32_t r = 0; r < rootCount; r++) scene.setPosition(nodes[r], vec3((float) k, 0.0f, 0.0f));
+                all.start();
+                scene.update();
+                all.end();
+
+                for (uint32_t n = 0; n < nodeCount / 100; n++) scene.setScale(nodes[random() % nodeCount], vec3(0.8f));
+                some.start();
+                scene.update();
+                some.end();
+                someUpdated += scene.updatedCount();
+            }
+
+            info("scene {} nodes, {} depths, {} threads: first update {:.3f} ms, all moved {:.3f} ms "
+                 "({:.1f} ns/node), 1% moved {:.3f} ms ({} nodes)", nodeCount, scene.depthCount(), scene.threadCount(),
+                 (double) first.mean() / 1e6, (double) all.mean() / 1e6, (double) all.mean() / nodeCount,
+                 (double) some.mean() / 1e6, someUpdated / std::max(iterations, 1u));
+
+            if (jobs.threadCount() == 1) break; // one run is enough
+        }
+    }
+}
+
+// a deferred frame: shadows, depth prepass, g-buffer, ssao, lighting, bloom & tonemap, plus a debug overlay
+// nothing reads. the passes record nothing, only the graph's barriers & memory are of interest.
+static void build_deferred_graph(VK::RenderGraph& graph, VkExtent2D extent) {
+    using Graph = VK::RenderGraph;
+    auto nothing = [](VkCommandBuffer, const Graph&) {};
+    VkExtent2D half = {std::max(extent.width / 2, 1u), std::max(extent.height / 2, 1u)};
+
+    Graph::Resource shadow = graph.createImage("shadow map", VK_FORMAT_D32_SFLOAT, {2048, 2048});
+    Graph::Resource depth = graph.createImage("depth", VK_FORMAT_D32_SFLOAT, extent);
+    Graph::Resource albedo = graph.createImage("albedo", VK_FORMAT_R8G8B8A8_UNORM, extent);
+    Graph::Resource normal = graph.createImage("normal", VK_FORMAT_R16G16B16A16_SFLOAT, extent);
+    Graph::Resource ao = graph.createImage("ao", VK_FORMAT_R8_UNORM, extent);
+    Graph::Resource hdr = graph.createImage("hdr", VK_FORMAT_R16G16B16A16_SFLOAT, extent);
+    Graph::Resource bloom = graph.createImage("bloom", VK_FORMAT_R16G16B16A16_SFLOAT, half);
+    Graph::Resource overlay = graph.createImage("debug overlay", VK_FORMAT_R8G8B8A8_UNORM, extent);
+    Graph::Resource ldr = graph.createImage("ldr", VK_FORMAT_R8G8B8A8_UNORM, extent);
+    graph.output(ldr);
+
+    graph.addPass("shadows", Graph::Type::GRAPHICS, nothing).write(shadow, Graph::DEPTH_ATTACHMENT);
+    graph.addPass("depth prepass", Graph::Type::GRAPHICS, nothing).write(depth, Graph::DEPTH_ATTACHMENT);
+    graph.addPass("debug overlay", Graph::Type::GRAPHICS, nothing).write(overlay, Graph::COLOR_ATTACHMENT);
+    graph.addPass("gbuffer", Graph::Type::GRAPHICS, nothing)
+        .read(depth, Graph::DEPTH_READ)
+        .write(albedo, Graph::COLOR_ATTACHMENT)
+        .write(normal, Graph::COLOR_ATTACHMENT);
+    graph.addPass("ssao", Graph::Type::COMPUTE, nothing)
+        .read(depth, Graph::SAMPLED)
+        .read(normal, Graph::SAMPLED)
+        .write(ao, Graph::STORAGE_WRITE);
+    graph.addPass("lighting", Graph::Type::GRAPHICS, nothing)
+        .read(albedo, Graph::SAMPLED)
+        .read(normal, Graph::SAMPLED)
+        .read(ao, Graph::SAMPLED)
+        .read(shadow, Graph::SAMPLED)
+        .write(hdr, Graph::COLOR_ATTACHMENT);
+    graph.addPass("bloom", Graph::Type::COMPUTE, nothing)
+        .read(hdr, Graph::SAMPLED)
+        .write(bloom, Graph::STORAGE_WRITE);
+    graph.addPass("tonemap", Graph::Type::GRAPHICS, nothing)
+        .read(hdr, Graph::SAMPLED)
+        .read(bloom, Graph::SAMPLED)
+        .write(ldr, Graph::COLOR_ATTACHMENT);
+}
+
+void RenderEngine::benchmark_render_graph(uint32_t iterations) {
+    vkDeviceWaitIdle(VK::device);
+
+    Benchmark build;
+    Benchmark compile;
+    for (uint32_t i = 0; i < iterations; i++) {
+        VK::RenderGraph graph;
+        build.start();
+        build_deferred_graph(graph, VK::surface.extent);
+        build.end();
+
+        compile.start();
+        graph.compile(VK::device);
+        compile.end();
+
+        if (i == 0) graph.print();
+    }
+    info("render graph: declared in {} us, compiled in {} us (images created & placed)", build.mean() / 1000,
+         compile.mean() / 1000);
+
+    // executed once, under the validation layer: the barriers are checked against what the passes declared.
+    VK::RenderGraph graph;
+    build_deferred_graph(graph, VK::surface.extent);
+    graph.compile(VK::device);
+
+    VkCommandBuffer commandBuffer = VK::frameRing.slot().commandBuffer;
+    vkResetCommandBuffer(commandBuffer, 0);
+    VkCommandBufferBeginInfo beginInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext{},
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo{}
+    };
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    VK::gpuProfiler.beginFrame(commandBuffer, VK::frameRing.current);
+    graph.execute(commandBuffer);
+    VK::gpuProfiler.endFrame(commandBuffer);
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext{},
+        .waitSemaphoreCount{},
+        .pWaitSemaphores{},
+        .pWaitDstStageMask{},
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBuffer,
+        .signalSemaphoreCount{},
+        .pSignalSemaphores{}
+    };
+    vkQueueSubmit(VK::queues.graphics.vkQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    vkDeviceWaitIdle(VK::device);
+}
+
+void RenderEngine::benchmark_dynamic_rendering(uint32_t drawCount, uint32_t iterations) {
+    vkDeviceWaitIdle(VK::device);
+
+    vector<VK::Draw> benchmarkDraws(drawCount, VK::Draw {3, 1, 0, 0});
+    VkCommandBuffer commandBuffer = VK::frameRing.slot().commandBuffer;
+    VkFormat format = VK::surface.swapchain.frames[0].format;
+
+    // without the pipeline cache, both paths compile their pipeline.
+    VkPipelineCache cache = std::exchange(VK::pipelineCache.cache, VK_NULL_HANDLE);
+
+    for (bool dynamic: {false, true}) {
+        if (dynamic && !VK::RenderPass::dynamicRenderingSupported) {
+            info("dynamic rendering: not supported by the device");
+            continue;
+        }
+
+        // the swapchain's images & views, with framebuffers of their own.
+        vector<VK::Frame> targets = VK::surface.swapchain.frames;
+        for (auto& t: targets) t.framebuffer = {};
+
+        VK::RenderPass pass {};
+        VK::Pipeline benchmarkPipeline {};
+        Benchmark setup;
+        setup.start();
+        pass.createRenderPass(format, dynamic);
+        benchmarkPipeline.createGraphicsPipeline(DefaultVertexLayout::getBindingDescriptions(),
+                                                 DefaultVertexLayout::getAttributeDescriptions(),
+                                                 sizeof(VertexFormat::Decode), "dat/shaders/default.vert.glsl.spv",
+                                                 {VK::frameData.layout}, pass);
+        if (!pass.dynamic) {
+            for (auto& t: targets) t.framebuffer.create(pass.renderPass, t.extent.width, t.extent.height, {t.view});
+        }
+        setup.end();
+
+        Benchmark record;
+        VK::VertexInput input = frame_input(mesh.input, targets[0].extent);
+        for (uint32_t i = 0; i < iterations; i++) {
+            vkResetCommandBuffer(commandBuffer, 0);
+            record.start();
+            VK::recordCommandBuffer(commandBuffer, pass, targets[i % targets.size()], benchmarkPipeline.pipeline,
+                                    input, benchmarkDraws, VK::frameRing.current);
+            record.end();
+        }
+
+        // a resize recreates the framebuffers, the views only with dynamic rendering.
+        info("main pass through {}: {} render pass & framebuffer objects ({} per resize), 1 pipeline, set up in {} "
+             "us; {} draws recorded in {} us", pass.name(), pass.objectCount(targets.size()),
+             pass.dynamic ? 0 : targets.size(), setup.mean() / 1000, drawCount, record.mean() / 1000);
+
+        for (auto& t: targets) t.framebuffer.destroy();
+        pass.destroy();
+        benchmarkPipeline.deletePipeline(VK::device, benchmarkPipeline.pipeline);
+        benchmarkPipeline.deletePipelineLayout(VK::device, benchmarkPipeline.layout);
+    }
+
+    VK::pipelineCache.cache = cache;
+}
+
+// roots scattered through a cube, moving at a few units a second, every other node under a random earlier one, and
+// a camera at one face of the cube.
+static void build_simulation(Simulation& simulation, uint32_t nodeCount) {
+    uint32_t rootCount = std::max(nodeCount / 64, 1u);
+    uint32_t seed = 1;
+    auto random = [&seed] {
+        seed = seed * 1664525u + 1013904223u;
+        return (float) (seed >> 8) / (float) (1 << 24);
+    };
+    float side = 2.0f * std::cbrt((float) nodeCount);
+    simulation.halfSide = side * 0.5f;
+
+    vector<Scene::Handle> nodes(nodeCount);
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        bool root = i < rootCount;
+        vec3 position = root ? (vec3(random(), random(), random()) - 0.5f) * side : vec3(1.0f, 0.0f, 0.0f);
+        Scene::Transform local {position, glm::angleAxis(random(), vec3(0.0f, 1.0f, 0.0f)), vec3(0.9f)};
+        auto parent = root ? Scene::none : nodes[(uint32_t) (random() * (float) i)];
+        nodes[i] = simulation.scene.create(parent, local, vec3(0.0f), vec3(0.5f));
+        if (root) simulation.addRoot(nodes[i], position, (vec3(random(), random(), random()) - 0.5f) * 8.0f);
+    }
+
+    mat4x4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, side * 2.0f);
+    simulation.frustum = Culling::Frustum::fromMatrix(projection * glm::lookAt(vec3(0.0f, 0.0f, -side * 0.6f),
+                                                                                vec3(0.0f), vec3(0.0f, 1.0f, 0.0f)));
+}
+
+void RenderEngine::benchmark_render_thread(uint32_t nodeCount, uint32_t frameCount) {
+    Simulation simulation;
+    build_simulation(simulation, nodeCount);
+
+    bool previous = renderThread;
+    activeSimulation = &simulation;
+    for (bool threaded: {false, true}) {
+        renderThread = threaded;
+        benchmarkSimulate.reset();
+        uint64_t since = frameProfiler.nextFrame();
+
+        auto start = Clock::now();
+        loop(frameCount);
+        double seconds = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()
+                         / 1e9;
+
+        // the main thread's time per frame bounds the inline frame rate, the longer of both threads the threaded one.
+        uint64_t frames = frameProfiler.nextFrame() - since;
+        FrameProfiler::Percentiles render = frameProfiler.percentiles(FrameProfiler::TOTAL, since);
+        FrameProfiler::Percentiles latency = frameProfiler.percentiles(FrameProfiler::LATENCY, since);
+        info("render thread {}: {} frames of {} nodes, {:.1f} fps, main thread {:.3f} ms/frame, render p50 {:.3f} ms, "
+             "input to gpu done p50 {:.3f} ms, p95 {:.3f} ms", threaded ? "on" : "off", frames, nodeCount,
+             seconds > 0.0 ? (double) frames / seconds : 0.0, (double) benchmarkSimulate.mean() / 1e6,
+             (double) render.p50 / 1e6, (double) latency.p50 / 1e6, (double) latency.p95 / 1e6);
+    }
+    activeSimulation = nullptr;
+    renderThread = previous;
+}
+
+void RenderEngine::benchmark_fixed_timestep(uint32_t nodeCount, uint32_t frameCount, double tickCostMs) {
+    Simulation simulation;
+    build_simulation(simulation, nodeCount);
+    simulation.tickCost = std::chrono::nanoseconds((int64_t) (tickCostMs * 1e6));
+
+    double previous = tickRate;
+    activeSimulation = &simulation;
+    for (double rate: {0.0, 30.0, 120.0}) {
+        tickRate = rate;
+        uint64_t since = frameProfiler.nextFrame();
+        uint64_t ticksSince = frameProfiler.tickCount();
+        uint64_t timestepTicks = timestep.tickCount();
+        auto dropped = timestep.droppedTime();
+
+        auto start = Clock::now();
+        loop(frameCount);
+        double seconds = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()
+                         / 1e9;
+
+        uint64_t frames = frameProfiler.nextFrame() - since;
+        uint64_t ticks = timestep.tickCount() - timestepTicks;
+        FrameProfiler::Percentiles tick = frameProfiler.percentiles(FrameProfiler::TICK, ticksSince);
+        FrameProfiler::Percentiles frame = frameProfiler.percentiles(FrameProfiler::TOTAL, since);
+        info("ticks of {:.1f} ms, {}: {:.1f} fps, {} ticks ({:.2f} per frame, {:.1f} per second), tick p50 {:.3f} "
+             "ms, frame p50 {:.3f} ms, {:.1f} ms of simulation dropped", tickCostMs,
+             rate > 0.0 ? std::to_string((int) rate) + " per second" : std::string("one per frame"),
+             seconds > 0.0 ? (double) frames / seconds : 0.0, ticks,
+             frames ? (double) ticks / (double) frames : 0.0, seconds > 0.0 ? (double) ticks / seconds : 0.0,
+             (double) tick.p50 / 1e6, (double) frame.p50 / 1e6,
+             (double) (timestep.droppedTime() - dropped).count() / 1e6);
+    }
+    activeSimulation = nullptr;
+    tickRate = previous;
+}
+
+void RenderEngine::benchmark_logging(uint32_t callsPerThread) {
+    const char* path = "benchmark.log";
+    std::shared_ptr<spdlog::logger> previous = spdlog::default_logger();
+    bool wasRunning = asyncLog.running();
+    asyncLog.stop();
+
+    // the async logger writes to the default logger's sinks: the same file for both.
+    std::shared_ptr<spdlog::logger> file = spdlog::basic_logger_mt("benchmark_logging", path, true);
+    spdlog::set_default_logger(file);
+
+    uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    for (uint32_t threads = 1; threads <= cores; threads *= 2) {
+        for (bool async: {false, true}) {
+            if (async) asyncLog.start();
+            uint64_t dropped = asyncLog.stats().dropped;
+
+            vector<vector<int64_t>> times(threads, vector<int64_t>(callsPerThread));
+            std::atomic<bool> go = false;
+            vector<std::thread> loggers;
+            for (uint32_t t = 0; t < threads; t++) {
+                loggers.emplace_back([&, t] {
+                    while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                    for (uint32_t i = 0; i < callsPerThread; i++) {
+                        auto start = Clock::now();
+                        if (async) asyncLog.info("thread {} message {}: {} {:.3f}", t, i, "payload", i * 0.5);
+                        else file->info("thread {} message {}: {} {:.3f}", t, i, "payload", i * 0.5);
+                        times[t][i] = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start)
+                            .count();
+                    }
+                });
+            }
+            go.store(true, std::memory_order_release);
+            for (auto& l: loggers) l.join();
+            if (async) asyncLog.stop(); // writes what is left
+            dropped = asyncLog.stats().dropped - dropped;
+
+            vector<int64_t> all;
+            all.reserve((size_t) threads * callsPerThread);
+            for (const auto& t: times) all.insert(all.end(), t.begin(), t.end());
+            double mean = (double) std::accumulate(all.begin(), all.end(), int64_t(0)) / (double) all.size();
+            std::sort(all.begin(), all.end());
+            previous->info("logging from {} threads, {}: {:.1f} ns/call, p50 {} ns, p99 {} ns, {} dropped", threads,
+                           async ? "async" : "spdlog", mean, all[all.size() / 2], all[all.size() * 99 / 100],
+                           dropped);
+        }
+    }
+
+    spdlog::set_default_logger(previous);
+    spdlog::drop("benchmark_logging");
+    file.reset();
+    std::remove(path);
+    if (wasRunning) asyncLog.start();
+}
+
+void RenderEngine::benchmark_build_profile(uint32_t frameCount) {
+    struct Config {
+        const char* name;
+        bool labels;
+        bool profiling;
+        int64_t cpuTime = 0;
+        int64_t frameTime = 0;
+    };
+
+    // validation & assertions are fixed for the run: other profiles are other builds, compared by their lines.
+    bool labels = VK::debugLabels;
+    bool profiling = buildProfile.profilingEnabled();
+    vector<Config> configs = {{"as configured", labels, profiling}};
+    if (labels) configs.push_back({"no debug labels", false, profiling});
+    if (profiling) configs.push_back({"no profilers", labels, false});
+    if (labels || profiling) configs.push_back({"bare", false, false});
+
+    for (Config& config: configs) {
+        VK::debugLabels = config.labels;
+        frameProfiler.enabled = config.profiling;
+        VK::gpuProfiler.enabled = config.profiling;
+
+        for (uint32_t i = 0; i < frameCount / 10 && !window_is_closed(); i++) {
+            frame();
+            window_update();
+        }
+        vkDeviceWaitIdle(VK::device);
+
+        Benchmark benchmarkFrame;
+        benchmarkFenceWait.reset();
+        for (uint32_t i = 0; i < frameCount && !window_is_closed(); i++) {
+            benchmarkFrame.start();
+            frame();
+            benchmarkFrame.end();
+            window_update();
+        }
+        vkDeviceWaitIdle(VK::device);
+
+        config.frameTime = benchmarkFrame.mean();
+        config.cpuTime = config.frameTime -
+                         benchmarkFenceWait.total() / std::max<int64_t>(benchmarkFrame.samples(), 1);
+    }
+
+    VK::debugLabels = labels;
+    frameProfiler.enabled = profiling;
+    VK::gpuProfiler.enabled = profiling;
+
+    const Config& bare = configs.back();
+    for (const Config& config: configs) {
+        int64_t overhead = config.cpuTime - bare.cpuTime;
+        info("{} build, validation {}, assertions {}, {}: cpu {:.1f} us/frame, frame {:.1f} us/frame, "
+             "instrumentation {:+.1f} us/frame ({:+.1f}%)", BuildProfile::name,
+             buildProfile.validationEnabled() ? "on" : "off", BuildProfile::assertsEnabled() ? "on" : "off",
+             config.name, (double) config.cpuTime / 1e3, (double) config.frameTime / 1e3, (double) overhead / 1e3,
+             bare.cpuTime ? 100.0 * (double) overhead / (double) bare.cpuTime : 0.0);
+    }
+}
+
+void RenderEngine::benchmark_frame_data(uint32_t frameCount) {
+    vkDeviceWaitIdle(VK::device);
+
+    // about three regions of per draw constants a frame: the ring grows on the first frames, and each buffer it
+    // replaced is destroyed once every slot began a frame since. nothing is submitted, the device stays idle.
+    VK::FrameDataRing& ring = VK::frameData;
+    VkDeviceSize regionSize = ring.regionSize;
+    uint32_t grows = ring.stats.grows;
+    auto rangesPerFrame = static_cast<uint32_t>(
+        3 * regionSize / std::max<VkDeviceSize>(ring.uniformAlignment, sizeof(FrameUniforms)));
+
+    Benchmark allocation;
+    uint32_t retiredPeak = 0;
+    for (uint32_t i = 0; i < frameCount; i++) {
+        uint32_t slot = (VK::frameRing.current + i) % framesInFlight;
+        VK::frameDescriptors.reset(slot);
+        ring.begin(slot);
+
+        allocation.start();
+        for (uint32_t r = 0; r < rangesPerFrame; r++) (void) ring.push(FrameUniforms {vec4((float) r)});
+        allocation.end();
+        retiredPeak = std::max(retiredPeak, ring.retiredBuffers());
+    }
+
+    info("frame data: {} ranges per frame, {:.1f} ns per range, {} -> {} KiB regions after {} grows, {} buffers "
+         "retired at most, {} left", rangesPerFrame, (double) allocation.mean() / std::max(rangesPerFrame, 1u),
+         regionSize / 1024, ring.regionSize / 1024, ring.stats.grows - grows, retiredPeak, ring.retiredBuffers());
+    if (frameCount > framesInFlight * 2 && ring.retiredBuffers() != 0)
+        spdlog::error("frame data: retired buffers outlived every frame in flight");
+}
+
+void RenderEngine::benchmark_frames_in_flight(uint32_t frameCount) {
+    uint32_t previous = framesInFlight;
+
+    for (uint32_t n = 1; n <= 3; n++) {
+        set_frames_in_flight(n);
+
+        Benchmark benchmarkFrame;
+        benchmarkFenceWait.reset();
+
+        for (uint32_t i = 0; i < frameCount && !window_is_closed(); i++) {
+            benchmarkFrame.start();
+            frame();
+            benchmarkFrame.end();
+            window_update();
+        }
+        vkDeviceWaitIdle(VK::device);
+
+        // the wall time per frame is what the GPU lets us reach, the rest of it is the CPU's own work.
+        int64_t frameTime = benchmarkFrame.mean();
+        int64_t cpuTime = frameTime - benchmarkFenceWait.total() / std::max<int64_t>(benchmarkFrame.samples(), 1);
+        info("frames in flight: {} -> cpu: {} ns/frame, gpu-bound: {} ns/frame ({:.1f} fps)",
+             n, cpuTime, frameTime, frameTime ? 1e9 / (double) frameTime : 0.0);
+    }
+
+    set_frames_in_flight(previous);
+}
+
+void RenderEngine::capture_frame(const char* path) {
+    // the frame is copied out of the swapchain image.
+    if (!VK::surface.swapchain.readback) throw std::runtime_error("surface does not support readback!");
+
+    VK::Readback readback {};
+    readback.create(VK::device, commandPool, VK::surface.extent);
+
+    pendingReadback = &readback;
+    frame();
+    vkDeviceWaitIdle(VK::device);
+
+    if (pendingReadback != nullptr) { // frame() bailed out before submitting
+        pendingReadback = nullptr;
+        readback.destroy(VK::device, commandPool);
+        throw std::runtime_error("failed to capture frame!");
+    }
+
+    vector<uint8_t> pixels = readback.read();
+    readback.destroy(VK::device, commandPool);
+
+    // swapchain images are bgra or rgba, ppm wants rgb.
+    bool bgr = VK::surface.vkSurfaceFormat.format == VK_FORMAT_B8G8R8A8_SRGB ||
+               VK::surface.vkSurfaceFormat.format == VK_FORMAT_B8G8R8A8_UNORM;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("failed to open capture file!");
+
+    file << "P6\n" << readback.extent.width << " " << readback.extent.height << "\n255\n";
+    for (size_t i = 0; i < pixels.size(); i += VK::Readback::bytesPerPixel) {
+        char rgb[3] = {(char) pixels[i + (bgr ? 2 : 0)], (char) pixels[i + 1], (char) pixels[i + (bgr ? 0 : 2)]};
+        file.write(rgb, 3);
+    }
+
+    info("captured frame {}x{} to {}", readback.extent.width, readback.extent.height, path);
+}
+
+void RenderEngine::exit() {
+
+    VK::frameRing.destroy(VK::device, commandPool);
+    VK::recorder.destroy();
+    VK::gpuProfiler.print();
+    VK::gpuProfiler.destroy();
+
+    destroy_retired_swapchains(true);
+    if (benchmarkResize.samples()) info("swapchain recreation: {} us on average", benchmarkResize.mean() / 1000);
 
-    VK::surface.destroy();
     VK::deleteCommandPool(VK::device, commandPool);
     VK::renderPass.destroy();
-    VK::pipeline.deletePipelineLayout(VK::device, pipelineLayout);
-    VK::pipeline.deletePipeline(VK::device, pipeline);
+    VK::pipeline.deletePipelineLayout(VK::device, VK::pipeline.layout);
+    VK::pipeline.deletePipeline(VK::device, VK::pipeline.pipeline);
+    VK::pipelineCache.save(VK::device, VK::physicalDevice);
+    VK::pipelineCache.destroy(VK::device);
+    VK::descriptorCounters.print();
+    VK::frameDescriptors.printStats();
+    VK::frameDescriptors.destroy();
+    VK::bindless.destroy();
+    VK::frameData.printStats();
+    VK::frameData.destroy();
+    VK::uploader.printStats();
+    VK::uploader.destroy();
+    mesh.destroy();
+    VK::allocator.printStats();
+    VK::allocator.destroy();
     VK::surface.destroy();
     VK::deleteLogicalDevice();
+    if (VK::vkDebugUtilsMessengerEXT != VK_NULL_HANDLE) VK::deleteDebugMessenger(VK::instance);
     VK::deleteInstance();
+    jobs.destroy();
+    asyncLog.stop();
 }
 
 void RenderEngine::window_create(int width, int height, const char* title) {
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
-    VK::window = glfwCreateWindow(width, height, title, nullptr, nullptr);
-    //glfwSetWindowUserPointer(window, this);
-    //glfwSetFramebufferSizeCallback(window, window_callback_resize);
+    VK::window = window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+    glfwSetFramebufferSizeCallback(window, window_callback_resize);
 }
 
 void RenderEngine::window_callback_resize(GLFWwindow* window, int width, int height) {
     RenderEngine::width = width;
     RenderEngine::height = height;
+    swapchainDirty = true;
 }
 
 void RenderEngine::window_destroy() {
@@ -188,5 +1943,6 @@ void RenderEngine::window_is_fullscreen() {
 }
 
 bool RenderEngine::window_is_closed() {
+    if (headless) return false;
     return glfwWindowShouldClose(window);
 }
\ No newline at end of file
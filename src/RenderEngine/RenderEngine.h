@@ -8,6 +8,9 @@
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <thread>
+
 using glm::vec3;
 
 namespace RenderEngine {
@@ -15,23 +18,152 @@ namespace RenderEngine {
     inline int width = 480;
     inline int height = 480;
 
+    // render without a window, through VK_EXT_headless_surface. must be set before init().
+    inline bool headless = false;
+
+    // number of frames the CPU may record ahead of the GPU.
+    inline uint32_t framesInFlight = 2;
+
+    // threads of the job system (Jobs.h), the main thread included. must be set before init().
+    inline uint32_t jobThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    // at most this many partitions of a large draw list are recorded into secondary command buffers, as jobs.
+    inline uint32_t recordThreads = std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+
+    // what presentation optimizes for: present mode, swapchain image count and frame rate cap.
+    enum class PresentPolicy {
+        LOW_LATENCY, // mailbox or immediate, shortest present queue
+        THROUGHPUT, // mailbox, one spare image
+        POWER_SAVING // fifo, shortest present queue, capped rate
+    };
+
+    inline PresentPolicy presentPolicy = PresentPolicy::THROUGHPUT;
+
+    // frame rate cap in hz, 0 for none. power saving caps at powerSavingRate when none is set.
+    inline double frameRateLimit = 0.0;
+    inline double powerSavingRate = 30.0;
+
+    // loop() records & submits on a render thread, fed frame packets by the main thread, which simulates the next
+    // frame meanwhile. the render thread only runs inside loop(): frame(), captures & benchmarks render inline.
+    inline bool renderThread = false;
+
+    // simulation ticks per second, 0 for one tick per frame, of the frame's length. with a rate, frames are drawn
+    // between the last two ticks' states, and a frame runs maxTicksPerFrame ticks at most: after a stall, or with
+    // ticks slower than their period, the backlog is dropped rather than caught up. read by loop().
+    inline double tickRate = 0.0;
+    inline uint32_t maxTicksPerFrame = 4;
+
+    // keep the render pass & framebuffers even when the device has dynamic rendering. must be set before init().
+    inline bool legacyRenderPass = false;
+
+    // hot path logs (swapchain recreation, validation messages) go through the async logger (async_log.h), started
+    // by init() and stopped by exit(). otherwise they are formatted & written on the calling thread.
+    inline bool asyncLogging = false;
+
+    // mesh file (Mesh.h) drawn instead of the built in triangle, loaded by init().
+    inline const char* meshPath = nullptr;
+
     // render engine
     void init();
 
-    void loop();
+    // runs until the window is closed, or for maxFrames frames when maxFrames != 0.
+    void loop(uint64_t maxFrames = 0);
 
     void frame();
 
+    void set_frames_in_flight(uint32_t count);
+
+    // takes effect on the next frame, through a swapchain recreation.
+    void set_present_policy(PresentPolicy policy);
+
+    const char* present_policy_name(PresentPolicy policy);
+
+    // renders frameCount frames with every present policy and reports frame times & frame start to gpu done latency.
+    void benchmark_present_policies(uint32_t frameCount = 600);
+
+    // renders frameCount frames with 1, 2 and 3 frames in flight and reports cpu & gpu-bound frame times.
+    void benchmark_frames_in_flight(uint32_t frameCount = 1000);
+
+    // draws triangleCount degenerate triangles with the float and the default (quantized) vertex layout and reports
+    // gpu vertex fetch throughput.
+    void benchmark_vertex_fetch(uint32_t triangleCount = 1 << 20, uint32_t frameCount = 100);
+
+    // loads a mesh file of about bytes bytes (written to path first if it isn't one) into device local buffers,
+    // read with an ifstream then through a memory mapping, and reports load times & peak resident memory.
+    void benchmark_mesh_loading(const char* path = "benchmark.mesh", uint64_t bytes = 1ull << 30);
+
+    // renders instanceCount / 16 then instanceCount icosphere instances through the gpu driven path (VK_INDIRECT.h),
+    // with the draw count written by the gpu when supported and with the fallback, and reports record & gpu times
+    // and the instances drawn per lod.
+    void benchmark_indirect(uint32_t instanceCount = 1 << 20, uint32_t frameCount = 20);
+
+    // updates scenes (Scene.h) of 10k, 100k and 1M nodes on one thread then on the job system, with every node and
+    // with 1% of the nodes moved, and reports update times.
+    void benchmark_scene(uint32_t iterations = 10);
+
+    // culls objectCount random spheres & boxes (Culling.h) with every kernel the cpu has, against a per-object glm
+    // loop, then with the best one on the job system, and records the draws of all of them then of the visible ones.
+    void benchmark_culling(uint32_t objectCount = 1 << 20, uint32_t iterations = 20);
+
+    // declares & compiles a deferred frame's render graph (VK_GRAPH.h) iterations times, reports the time taken,
+    // the passes culled, the barriers and the transient memory saved by aliasing, then executes it once.
+    void benchmark_render_graph(uint32_t iterations = 100);
+
+    // creates the main pass with the render pass & framebuffers then with dynamic rendering, when supported, and
+    // reports the objects each path creates, its setup time with a cold pipeline and the time to record drawCount
+    // draws into it.
+    void benchmark_dynamic_rendering(uint32_t drawCount = 100000, uint32_t iterations = 20);
+
+    // moves, updates & culls a scene of nodeCount nodes on the main thread every frame and draws the visible ones,
+    // for frameCount frames rendered inline then on the render thread, and reports frame rate, main thread time per
+    // frame and input to gpu done latency.
+    void benchmark_render_thread(uint32_t nodeCount = 100000, uint32_t frameCount = 300);
+
+    // simulates a scene of nodeCount nodes with ticks of tickCostMs, for frameCount frames with a tick per frame,
+    // 30 ticks a second and 120 ticks a second (slower than their period: the catch up limit), and reports frame
+    // rates, ticks per frame, tick & frame times and the simulation time dropped.
+    void benchmark_fixed_timestep(uint32_t nodeCount = 100000, uint32_t frameCount = 300, double tickCostMs = 10.0);
+
+    // records drawCount draws inline, then in 1, 2, 4 .. cores partitions, and reports recording times.
+    void benchmark_recording(uint32_t drawCount = 100000, uint32_t iterations = 20);
+
+    // runs jobCount empty jobs, then a parallel for of itemCount uneven items on 1, 2, 4 .. cores threads, through
+    // the job system (Jobs.h), a pool of threads behind one mutex & queue, and std::async, and reports the
+    // scheduling overhead per job, the speedups and the job system's steals.
+    void benchmark_jobs(uint32_t jobCount = 100000, uint32_t itemCount = 1 << 20, uint32_t iterations = 10);
+
+    // logs callsPerThread messages from 1, 2, 4 .. cores threads at once, into a file through spdlog then through the
+    // async logger, and reports the time a call takes on the caller's side, p50 & p99, and the messages dropped.
+    void benchmark_logging(uint32_t callsPerThread = 100000);
+
+    // frameCount frames as the build profile (build_profile.h) & environment configured them, then without debug
+    // labels, without the cpu & gpu profilers and without both, and reports cpu & wall time per frame and the
+    // instrumentation's overhead over the bare run. validation & assertions can't change in a run: build the other
+    // profiles and compare their lines.
+    void benchmark_build_profile(uint32_t frameCount = 600);
+
+    // allocates about three regions of per draw constants a frame from the frame data ring (VK_FRAMEDATA.h) for
+    // frameCount frames, and reports the time per range, the ring's growth and the buffers it retired. the ring
+    // keeps its size: run it last.
+    void benchmark_frame_data(uint32_t frameCount = 100);
+
     void exit();
 
+    // renders one frame, reads it back and writes it to path as a binary ppm. throws when the surface's images can't
+    // be copied from (no VK_IMAGE_USAGE_TRANSFER_SRC_BIT).
+    void capture_frame(const char* path);
+
     // window
     void window_create(int width, int height, const char* title);
 
     void window_callback_resize(GLFWwindow* window, int width, int height);
 
-    inline void window_update() { glfwPollEvents(); }
+    inline void window_update() {
+        if (!headless) glfwPollEvents();
+    }
 
     inline void window_framebuffer_size(int& width, int& height) {
+        if (headless) return;
         return glfwGetFramebufferSize(window, &width, &height);
     }
 
@@ -0,0 +1,280 @@
+#include "Scene.h"
+
+#include "glm/simd/platform.h"
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include "glm/simd/matrix.h"
+#elif GLM_ARCH & GLM_ARCH_NEON_BIT
+#include <arm_neon.h>
+#endif
+
+static inline mat4x4 compose(const vec3& position, const quat& rotation, const vec3& scale) {
+    mat3x3 r = glm::mat3_cast(rotation);
+    return {vec4(r[0] * scale.x, 0.0f), vec4(r[1] * scale.y, 0.0f), vec4(r[2] * scale.z, 0.0f), vec4(position, 1.0f)};
+}
+
+// out = a * b, a column per register.
+static inline void multiply(const mat4x4& a, const mat4x4& b, mat4x4& out) {
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+    // glm's own kernel, unaligned loads: vector<mat4x4> only promises 4 byte alignment.
+    glm_vec4 in1[4] = {_mm_loadu_ps(&a[0][0]), _mm_loadu_ps(&a[1][0]), _mm_loadu_ps(&a[2][0]), _mm_loadu_ps(&a[3][0])};
+    glm_vec4 in2[4] = {_mm_loadu_ps(&b[0][0]), _mm_loadu_ps(&b[1][0]), _mm_loadu_ps(&b[2][0]), _mm_loadu_ps(&b[3][0])};
+    glm_vec4 result[4];
+    glm_mat4_mul(in1, in2, result);
+    for (int c = 0; c < 4; c++) _mm_storeu_ps(&out[c][0], result[c]);
+#elif GLM_ARCH & GLM_ARCH_NEON_BIT
+    float32x4_t a0 = vld1q_f32(&a[0][0]);
+    float32x4_t a1 = vld1q_f32(&a[1][0]);
+    float32x4_t a2 = vld1q_f32(&a[2][0]);
+    float32x4_t a3 = vld1q_f32(&a[3][0]);
+    for (int c = 0; c < 4; c++) {
+        float32x4_t r = vmulq_n_f32(a0, b[c][0]);
+        r = vmlaq_n_f32(r, a1, b[c][1]);
+        r = vmlaq_n_f32(r, a2, b[c][2]);
+        r = vmlaq_n_f32(r, a3, b[c][3]);
+        vst1q_f32(&out[c][0], r);
+    }
+#else
+    out = a * b;
+#endif
+}
+
+template<typename T>
+static void permute(vector<T>& values, const vector<uint32_t>& order) {
+    vector<T> permuted(order.size());
+    for (size_t i = 0; i < order.size(); i++) permuted[i] = values[order[i]];
+    values = std::move(permuted);
+}
+
+Scene::Handle Scene::create(Handle parent) {
+    return create(parent, Transform {});
+}
+
+Scene::Handle Scene::create(Handle parent, const Transform& local, vec3 boundsCenter, vec3 boundsExtent,
+                            uint32_t mesh, uint32_t material, uint32_t flags) {
+    if (parent != none && !contains(parent)) throw std::runtime_error("parent node doesn't exist!");
+
+    auto i = static_cast<uint32_t>(handles.size());
+    Handle node;
+    if (!freeHandles.empty()) {
+        node = freeHandles.back();
+        freeHandles.pop_back();
+        indices[node] = i;
+    } else {
+        node = static_cast<Handle>(indices.size());
+        indices.push_back(i);
+    }
+
+    uint32_t parentIndex = parent == none ? none : indices[parent];
+    uint32_t depth = parent == none ? 0 : depths[parentIndex] + 1;
+
+    handles.push_back(node);
+    parents.push_back(parentIndex);
+    depths.push_back(depth);
+    positions.push_back(local.position);
+    rotations.push_back(local.rotation);
+    scales.push_back(local.scale);
+    localCenters.push_back(boundsCenter);
+    localExtents.push_back(boundsExtent);
+    worldMatrices.emplace_back(1.0f);
+    for (vector<float>* component: {&worldBounds.centerX, &worldBounds.centerY, &worldBounds.centerZ,
+                                    &worldBounds.extentX, &worldBounds.extentY, &worldBounds.extentZ,
+                                    &worldBounds.radius}) {
+        component->push_back(0.0f);
+    }
+    nodeFlags.push_back(flags);
+    meshIds.push_back(mesh);
+    materialIds.push_back(material);
+    dirty.push_back(1);
+    anyDirty = true;
+
+    // appended in depth order, the depth ranges simply grow. otherwise update() sorts.
+    if (orderStale || depth + 1 < depthCount()) {
+        orderStale = true;
+    } else {
+        if (depth == depthCount()) depthStart.push_back(depthStart.back());
+        depthStart.back()++;
+    }
+    return node;
+}
+
+void Scene::remove(Handle node) {
+    if (!contains(node)) throw std::runtime_error("node doesn't exist!");
+
+    // parents always come before their children, whether the order is stale or not: one pass finds the subtree.
+    // removed nodes are marked by their depth, and leave the arrays at the next sort.
+    uint32_t first = indices[node];
+    depths[first] = none;
+    for (uint32_t i = first + 1; i < size(); i++) {
+        if (parents[i] != none && depths[parents[i]] == none) depths[i] = none;
+    }
+    for (uint32_t i = first; i < size(); i++) {
+        if (depths[i] == none && indices[handles[i]] == i) { // not yet freed, nor reused
+            indices[handles[i]] = none;
+            freeHandles.push_back(handles[i]);
+        }
+    }
+    orderStale = true;
+}
+
+void Scene::markDirty(Handle node) {
+    dirty[at(node)] = 1;
+    anyDirty = true;
+}
+
+void Scene::setLocal(Handle node, const Transform& local) {
+    uint32_t i = at(node);
+    positions[i] = local.position;
+    rotations[i] = local.rotation;
+    scales[i] = local.scale;
+    markDirty(node);
+}
+
+void Scene::setPosition(Handle node, vec3 position) {
+    positions[at(node)] = position;
+    markDirty(node);
+}
+
+void Scene::setRotation(Handle node, quat rotation) {
+    rotations[at(node)] = rotation;
+    markDirty(node);
+}
+
+void Scene::setScale(Handle node, vec3 scale) {
+    scales[at(node)] = scale;
+    markDirty(node);
+}
+
+void Scene::setFlags(Handle node, uint32_t flags) {
+    nodeFlags[at(node)] = flags;
+}
+
+void Scene::setMesh(Handle node, uint32_t mesh, uint32_t material) {
+    uint32_t i = at(node);
+    meshIds[i] = mesh;
+    materialIds[i] = material;
+}
+
+bool Scene::contains(Handle node) const {
+    return node < indices.size() && indices[node] != none;
+}
+
+Scene::Transform Scene::local(Handle node) const {
+    uint32_t i = at(node);
+    return {positions[i], rotations[i], scales[i]};
+}
+
+const mat4x4& Scene::world(Handle node) const {
+    return worldMatrices[at(node)];
+}
+
+// breadth first: the nodes of a depth are contiguous, siblings are next to each other, and the parents of a depth
+// are read in the order they were written, a forward walk through memory. removed nodes are dropped.
+void Scene::sort() {
+    vector<uint32_t> childStart(size() + 1, 0);
+    for (uint32_t i = 0; i < size(); i++) {
+        if (depths[i] != none && parents[i] != none) childStart[parents[i] + 1]++;
+    }
+    for (uint32_t i = 0; i < size(); i++) childStart[i + 1] += childStart[i];
+
+    vector<uint32_t> children(childStart.back());
+    vector<uint32_t> fill(childStart.begin(), childStart.end() - 1);
+    vector<uint32_t> order;
+    order.reserve(size());
+    for (uint32_t i = 0; i < size(); i++) {
+        if (depths[i] == none) continue;
+        if (parents[i] == none) order.push_back(i);
+        else children[fill[parents[i]]++] = i;
+    }
+
+    depthStart.clear();
+    for (size_t k = 0; k < order.size(); k++) {
+        uint32_t i = order[k];
+        if (depths[i] == depthStart.size()) depthStart.push_back(static_cast<uint32_t>(k));
+        order.insert(order.end(), children.begin() + childStart[i], children.begin() + childStart[i + 1]);
+    }
+    depthStart.push_back(static_cast<uint32_t>(order.size()));
+
+    vector<uint32_t> remap(size(), none);
+    for (uint32_t k = 0; k < order.size(); k++) remap[order[k]] = k;
+
+    permute(handles, order);
+    permute(parents, order);
+    permute(depths, order);
+    permute(positions, order);
+    permute(rotations, order);
+    permute(scales, order);
+    permute(localCenters, order);
+    permute(localExtents, order);
+    permute(worldMatrices, order);
+    for (vector<float>* component: {&worldBounds.centerX, &worldBounds.centerY, &worldBounds.centerZ,
+                                    &worldBounds.extentX, &worldBounds.extentY, &worldBounds.extentZ,
+                                    &worldBounds.radius}) {
+        permute(*component, order);
+    }
+    permute(nodeFlags, order);
+    permute(meshIds, order);
+    permute(materialIds, order);
+    permute(dirty, order);
+
+    for (uint32_t i = 0; i < size(); i++) {
+        if (parents[i] != none) parents[i] = remap[parents[i]];
+        indices[handles[i]] = i;
+    }
+    orderStale = false;
+}
+
+uint32_t Scene::updateRange(uint32_t first, uint32_t last) {
+    uint32_t count = 0;
+    for (uint32_t i = first; i < last; i++) {
+        uint32_t parent = parents[i];
+        if (!dirty[i] && (parent == none || !dirty[parent])) continue;
+        dirty[i] = 1; // read by the children, at the next depth
+
+        mat4x4& world = worldMatrices[i];
+        mat4x4 local = compose(positions[i], rotations[i], scales[i]);
+        if (parent == none) world = local;
+        else multiply(worldMatrices[parent], local, world);
+
+        // Arvo: the box of the transformed box, from the absolute values of the rotation & scale.
+        const vec3& extent = localExtents[i];
+        vec3 center = vec3(world * vec4(localCenters[i], 1.0f));
+        vec3 worldExtent = glm::abs(vec3(world[0])) * extent.x + glm::abs(vec3(world[1])) * extent.y +
+                           glm::abs(vec3(world[2])) * extent.z;
+
+        worldBounds.centerX[i] = center.x;
+        worldBounds.centerY[i] = center.y;
+        worldBounds.centerZ[i] = center.z;
+        worldBounds.extentX[i] = worldExtent.x;
+        worldBounds.extentY[i] = worldExtent.y;
+        worldBounds.extentZ[i] = worldExtent.z;
+        worldBounds.radius[i] = glm::length(worldExtent);
+        count++;
+    }
+    return count;
+}
+
+void Scene::update() {
+    if (orderStale) sort();
+
+    updated = 0;
+    if (!anyDirty) return;
+
+    std::atomic<uint32_t> count = 0;
+    for (uint32_t d = 0; d < depthCount(); d++) {
+        uint32_t first = depthStart[d];
+        uint32_t last = depthStart[d + 1];
+
+        if (!parallel) {
+            count += updateRange(first, last);
+            continue;
+        }
+        jobs.parallelFor(first, last, minNodesPerWorker, [&](uint32_t begin, uint32_t end) {
+            count.fetch_add(updateRange(begin, end), std::memory_order_relaxed);
+        });
+    }
+
+    updated = count;
+    std::fill(dirty.begin(), dirty.end(), 0);
+    anyDirty = false;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "using_std.h"
+#include "using_glm.h"
+#include "Jobs.h"
+#include "build_profile.h"
+
+#include "glm/gtc/quaternion.hpp"
+
+using glm::quat;
+
+// Transform hierarchy of many nodes, stored as structure of arrays.
+//
+// every per node value lives in its own array, all indexed alike and ordered by depth in the hierarchy: parents
+// come before their children, and the nodes of one depth are contiguous. update() walks the depths in order, each
+// one split across the job system's workers, and rebuilds the world matrix & bounds of every node whose local
+// transform, or whose parent's world matrix, changed since the last update: a node only reads its parent, computed
+// by an earlier depth.
+//
+// nodes are named by handles, stable while the arrays are reordered. creating or removing nodes only marks the
+// order stale, it is rebuilt (one counting sort by depth) by the next update().
+class Scene {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle none = UINT32_MAX;
+    static constexpr uint32_t noMesh = UINT32_MAX;
+
+    enum Flags : uint32_t {
+        VISIBLE = 1 << 0,
+        CASTS_SHADOWS = 1 << 1,
+        STATIC = 1 << 2 // never moves once placed, a hint for the renderer
+    };
+
+    struct Transform {
+        vec3 position {0.0f};
+        quat rotation {1.0f, 0.0f, 0.0f, 0.0f};
+        vec3 scale {1.0f};
+    };
+
+    // world space bounds of every node, one array per component: an axis aligned box as center & half extents,
+    // and the sphere around it, of the same center.
+    struct Bounds {
+        vector<float> centerX, centerY, centerZ;
+        vector<float> extentX, extentY, extentZ;
+        vector<float> radius;
+    };
+
+    // nodes of one depth updated by one job, at least: smaller depths are updated on the calling thread.
+    static constexpr uint32_t minNodesPerWorker = 4096;
+
+    // parallel: depths are spread over the job system's workers (Jobs.h), the calling thread alone updates otherwise.
+    explicit Scene(bool parallel = true) : parallel(parallel) {}
+
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    // the node and the local space box its world bounds are built from.
+    Handle create(Handle parent = none);
+    Handle create(Handle parent, const Transform& local, vec3 boundsCenter = vec3(0.0f),
+                  vec3 boundsExtent = vec3(0.0f), uint32_t mesh = noMesh, uint32_t material = 0,
+                  uint32_t flags = VISIBLE);
+
+    // removes the node and all of its descendants.
+    void remove(Handle node);
+
+    void setLocal(Handle node, const Transform& local);
+    void setPosition(Handle node, vec3 position);
+    void setRotation(Handle node, quat rotation);
+    void setScale(Handle node, vec3 scale);
+    void setFlags(Handle node, uint32_t flags);
+    void setMesh(Handle node, uint32_t mesh, uint32_t material);
+
+    // brings every world matrix & bound up to date.
+    void update();
+
+    [[nodiscard]] bool contains(Handle node) const;
+    [[nodiscard]] Transform local(Handle node) const;
+    [[nodiscard]] const mat4x4& world(Handle node) const;
+
+    // the arrays, in update order: index i of one is index i of every other. the order changes when nodes are
+    // created or removed, handle(i) and index(node) map between the two.
+    [[nodiscard]] uint32_t size() const { return static_cast<uint32_t>(handles.size()); }
+    [[nodiscard]] uint32_t depthCount() const { return static_cast<uint32_t>(depthStart.size()) - 1; }
+    [[nodiscard]] Handle handle(uint32_t i) const { return handles[i]; }
+    [[nodiscard]] uint32_t index(Handle node) const { return indices[node]; }
+    [[nodiscard]] const vector<mat4x4>& worlds() const { return worldMatrices; }
+    [[nodiscard]] const Bounds& bounds() const { return worldBounds; }
+    [[nodiscard]] const vector<uint32_t>& flags() const { return nodeFlags; }
+    [[nodiscard]] const vector<uint32_t>& meshes() const { return meshIds; }
+    [[nodiscard]] const vector<uint32_t>& materials() const { return materialIds; }
+
+    // nodes rebuilt by the last update().
+    [[nodiscard]] uint32_t updatedCount() const { return updated; }
+
+    // threads update() runs on, the calling thread included.
+    [[nodiscard]] uint32_t threadCount() const { return parallel ? jobs.threadCount() : 1; }
+
+private:
+    // per node, by index.
+    vector<Handle> handles;
+    vector<uint32_t> parents; // index of the parent, none for roots
+    vector<uint32_t> depths;
+    vector<vec3> positions;
+    vector<quat> rotations;
+    vector<vec3> scales;
+    vector<vec3> localCenters;
+    vector<vec3> localExtents;
+    vector<mat4x4> worldMatrices;
+    Bounds worldBounds;
+    vector<uint32_t> nodeFlags;
+    vector<uint32_t> meshIds;
+    vector<uint32_t> materialIds;
+    vector<uint8_t> dirty;
+
+    // per handle.
+    vector<uint32_t> indices; // none once removed
+    vector<Handle> freeHandles;
+
+    // [depthStart[d], depthStart[d + 1]) are the nodes of depth d.
+    vector<uint32_t> depthStart {0};
+    bool orderStale = false;
+    bool anyDirty = false;
+    uint32_t updated = 0;
+
+    bool parallel = true;
+
+    // index of a live node. stale handles are only caught in debug builds (build_profile.h).
+    [[nodiscard]] uint32_t at(Handle node) const {
+        V3RSE_ASSERT(contains(node), "node doesn't exist!");
+        return indices[node];
+    }
+
+    void sort();
+    uint32_t updateRange(uint32_t first, uint32_t last);
+    void markDirty(Handle node);
+};
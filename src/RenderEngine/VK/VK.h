@@ -20,6 +20,17 @@
 #include "VK_DFL.h"
 #include "VK_DBG.h"
 #include "VK_MEM.h"
+#include "VK_FRAME.h"
+#include "VK_READBACK.h"
+#include "VK_CACHE.h"
+#include "VK_SHADER.h"
+#include "VK_UPLOAD.h"
+#include "VK_DESCRIPTOR.h"
+#include "VK_FRAMEDATA.h"
+#include "VK_RECORD.h"
+#include "VK_QUERY.h"
+#include "VK_GRAPH.h"
+#include "VK_INDIRECT.h"
 
 namespace VK {
 
@@ -101,6 +112,7 @@ namespace VK {
             };
 
             vkCreateImageView(VK::device, &vkImageViewCreateInfo, nullptr, &view);
+            return view;
         }
 
 
@@ -124,13 +136,17 @@ namespace VK {
     struct Queues {
         Queue graphics;
         Queue present;
+        Queue transfer; // a transfer-only (dma) family when the device has one, graphics otherwise.
 
         void init() {
             vkGetDeviceQueue(VK::device, graphics.id.value(), 0, &graphics.vkQueue);
             vkGetDeviceQueue(VK::device, present.id.value(), 0, &present.vkQueue);
+            vkGetDeviceQueue(VK::device, transfer.id.value(), 0, &transfer.vkQueue);
 
             if (graphics.vkQueue == present.vkQueue)
                 info("using same queue for graphics and presentation");
+            if (transfer.id != graphics.id)
+                info("using dedicated transfer queue family {}", transfer.id.value());
         }
 
         [[nodiscard]] bool isComplete() const {
@@ -138,18 +154,19 @@ namespace VK {
         }
 
         [[nodiscard]] set<uint32_t> unique_set() const {
-            return set<uint32_t> {graphics.id.value(), present.id.value()};
+            return set<uint32_t> {graphics.id.value(), present.id.value(), transfer.id.value()};
         }
 
         // select the first queue that has present & graphics abilities
         force_inline void getQueueFamilyIndices(VkPhysicalDevice vkPhysicalDevice, VkSurfaceKHR vkSurface,
-                                                vector<VkQueueFamilyProperties> vkQueueFamilyProperties =
-                                                vector<VkQueueFamilyProperties> {0}) {
+                                                vector<VkQueueFamilyProperties> vkQueueFamilyProperties = {}) {
             uint32_t count;
             vkGetPhysicalDeviceQueueFamilyProperties(vkPhysicalDevice, &count, nullptr);
             vector<VkQueueFamilyProperties> queueFamilyProperties(count);
             vkGetPhysicalDeviceQueueFamilyProperties(vkPhysicalDevice, &count, queueFamilyProperties.data());
 
+            if (vkQueueFamilyProperties.empty()) vkQueueFamilyProperties = queueFamilyProperties;
+
             int i = 0;
             for (const auto& queueFamily: vkQueueFamilyProperties) {
                 VkBool32 presentSupport = false;
@@ -160,18 +177,26 @@ namespace VK {
                 if (isComplete()) break;
                 i++;
             }
+
+            transfer.id = graphics.id;
+            for (uint32_t j = 0; j < vkQueueFamilyProperties.size(); j++) {
+                VkQueueFlags flags = vkQueueFamilyProperties[j].queueFlags;
+                if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                    transfer.id = j;
+                    break;
+                }
+            }
         }
 
         force_inline void
-        getQueueFamilyIndices(VkSurfaceKHR vkSurfaceKHR, vector<VkQueueFamilyProperties> vkQueueFamilyProperties =
-        vector<VkQueueFamilyProperties> {0}) {
+        getQueueFamilyIndices(VkSurfaceKHR vkSurfaceKHR, vector<VkQueueFamilyProperties> vkQueueFamilyProperties = {}) {
             getQueueFamilyIndices(physicalDevice, vkSurfaceKHR, vkQueueFamilyProperties);
         }
 
         force_inline vector<VkDeviceQueueCreateInfo> getQueueCreateInfos() {
             vector<VkDeviceQueueCreateInfo> vkDeviceQueueCreateInfos {};
 
-            float queuePriority = 0.5f;
+            static float queuePriority = 0.5f; // referenced by the returned create infos
             for (uint32_t queueFamilyIndex: unique_set()) {
                 vkDeviceQueueCreateInfos.push_back(VkDeviceQueueCreateInfo {
                     .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
@@ -204,105 +229,265 @@ namespace VK {
         vkDestroyCommandPool(vkDevice, vkCommandPool, nullptr);
     }
 
-    force_inline void recordCommandBuffer(VkCommandBuffer vkCommandBuffer, VkRenderPass vkRenderPass,
-                                          VkFramebuffer vkFramebuffer,
-                                          VkExtent2D extent, VkPipeline vkPipeline) {
-        VkCommandBufferBeginInfo beginInfo {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            .pNext{},
-            .flags{},
-            .pInheritanceInfo{}
+    force_inline void setViewport(VkCommandBuffer vkCommandBuffer, VkExtent2D extent) {
+        VkViewport viewport {
+            .x = 0.0f,
+            .y = 0.0f,
+            .width = (float) extent.width,
+            .height = (float) extent.height,
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f
         };
-        vkBeginCommandBuffer(vkCommandBuffer, &beginInfo);
 
-        VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-        VkRenderPassBeginInfo renderPassInfo {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            .pNext{},
-            .renderPass = vkRenderPass,
-            .framebuffer = vkFramebuffer,
-            .renderArea {
-                .offset = {0, 0},
-                .extent = extent
-            },
-            .clearValueCount = 1,
-            .pClearValues = &clearColor
+        VkRect2D scissor {
+            .offset = {0, 0},
+            .extent = extent
         };
 
-        vkCmdBeginRenderPass(vkCommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdSetViewport(vkCommandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(vkCommandBuffer, 0, 1, &scissor);
+    }
 
-        vkCmdBindPipeline(vkCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipeline);
-        vkCmdDraw(vkCommandBuffer, 3, 1, 0, 0);
+    // the main pass: one color attachment, cleared, left in PRESENT_SRC_KHR.
+    //
+    // with dynamic rendering (VK_KHR_dynamic_rendering) there is no render pass or framebuffer object: the pass is
+    // begun on the image view itself, pipelines are created against the attachment formats and the layout
+    // transitions the render pass did are barriers around it. an attachment change rebuilds no framebuffer, and a
+    // swapchain recreation only creates views. the render pass & its framebuffers remain for devices without it.
+    struct RenderPass {
+        static inline bool dynamicRenderingSupported = false; // set by init()
 
-        vkCmdEndRenderPass(vkCommandBuffer);
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+        bool dynamic = false;
 
-        if (vkEndCommandBuffer(vkCommandBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to record command buffer!");
-        }
-    }
+        force_inline void createRenderPass(VkFormat format, bool dynamicRendering = true) {
+            colorFormat = format;
+            dynamic = dynamicRendering && dynamicRenderingSupported;
+            if (dynamic) return;
 
-    // TODO: Delete these, and put it in a shader class.
-    static std::vector<char> readFile(const std::string& filename) {
-        std::ifstream file(filename, std::ios::ate | std::ios::binary);
+            VkAttachmentDescription colorAttachment {
+                .flags{},
+                .format = format,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+            };
+
+            VkAttachmentReference colorAttachmentRef {
+                .attachment = 0,
+                .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+            };
+
+            VkSubpassDescription vkSubpassDescription {
+                .flags{},
+                .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+                .inputAttachmentCount{},
+                .pInputAttachments{},
+                .colorAttachmentCount = 1,
+                .pColorAttachments = &colorAttachmentRef,
+                .pResolveAttachments{},
+                .pDepthStencilAttachment{},
+                .preserveAttachmentCount{},
+                .pPreserveAttachments{}
+            };
+
+            VkSubpassDependency vkSubpassDependency {
+                .srcSubpass = VK_SUBPASS_EXTERNAL,
+                .dstSubpass = 0,
+                .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // waiting for operation start
+                .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // operations that should wait for end
+                .srcAccessMask = 0, // access
+                .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, // we need to be able to write to this stage
+                .dependencyFlags{}
+            };
+
+            VkRenderPassCreateInfo renderPassInfo {
+                .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+                .pNext{},
+                .flags{},
+                .attachmentCount = 1,
+                .pAttachments = &colorAttachment,
+                .subpassCount = 1,
+                .pSubpasses = &vkSubpassDescription,
+                .dependencyCount = 1,
+                .pDependencies = &vkSubpassDependency,
+            };
 
-        if (!file.is_open()) {
-            throw std::runtime_error("failed to open file!");
+            vkCreateRenderPass(VK::device, &renderPassInfo, nullptr, &renderPass);
         }
 
-        size_t fileSize = (size_t) file.tellg();
-        std::vector<char> buffer(fileSize);
+        // secondaries: the draws are recorded into secondary command buffers executed inside the pass.
+        force_inline void begin(VkCommandBuffer vkCommandBuffer, const Frame& target, bool secondaries) const {
+            VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+            VkRect2D renderArea {{0, 0}, target.extent};
 
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
+            if (!dynamic) {
+                VkRenderPassBeginInfo renderPassInfo {
+                    .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                    .pNext{},
+                    .renderPass = renderPass,
+                    .framebuffer = target.framebuffer.framebuffer,
+                    .renderArea = renderArea,
+                    .clearValueCount = 1,
+                    .pClearValues = &clearColor
+                };
+                VkSubpassContents contents = secondaries ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                                         : VK_SUBPASS_CONTENTS_INLINE;
+                vkCmdBeginRenderPass(vkCommandBuffer, &renderPassInfo, contents);
+                return;
+            }
 
-        file.close();
+            // the render pass' external dependency: after the acquire semaphore wait, the old contents discarded.
+            transition(vkCommandBuffer, target.image, VK_IMAGE_LAYOUT_UNDEFINED,
+                       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
 
-        return buffer;
-    }
+            VkRenderingAttachmentInfoKHR colorAttachment {
+                .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+                .pNext{},
+                .imageView = target.view,
+                .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .resolveMode = VK_RESOLVE_MODE_NONE,
+                .resolveImageView{},
+                .resolveImageLayout{},
+                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                .clearValue = clearColor
+            };
+            VkRenderingInfoKHR renderingInfo {
+                .sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+                .pNext{},
+                .flags = secondaries ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0u,
+                .renderArea = renderArea,
+                .layerCount = 1,
+                .viewMask = 0,
+                .colorAttachmentCount = 1,
+                .pColorAttachments = &colorAttachment,
+                .pDepthAttachment{},
+                .pStencilAttachment{}
+            };
+            CmdBeginRenderingKHR(vkCommandBuffer, &renderingInfo);
+        }
 
-    force_inline VkShaderModule createShaderModule(VkDevice vkDevice, const std::vector<char>& code) {
-        VkShaderModuleCreateInfo createInfo {
-            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-            .codeSize = code.size(),
-            .pCode = reinterpret_cast<const uint32_t*>(code.data())
-        };
+        force_inline void end(VkCommandBuffer vkCommandBuffer, const Frame& target) const {
+            if (!dynamic) {
+                vkCmdEndRenderPass(vkCommandBuffer);
+                return;
+            }
 
-        VkShaderModule shaderModule;
-        vkCreateShaderModule(vkDevice, &createInfo, nullptr, &shaderModule);
-        return shaderModule;
-    }
+            CmdEndRenderingKHR(vkCommandBuffer);
+            // the render pass' final layout, made visible to the presentation engine by the submit's semaphore.
+            transition(vkCommandBuffer, target.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                       VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                       VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+        }
 
-    force_inline VkDescriptorSetLayout createDescriptorSetLayout(VkDevice vkDevice) {
-        VkDescriptorSetLayoutBinding uboLayoutBinding {
-            .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .descriptorCount = 1,
-            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-            .pImmutableSamplers = nullptr,
-        };
+        // chained to a graphics pipeline's create info when dynamic: the formats it renders to.
+        [[nodiscard]] force_inline VkPipelineRenderingCreateInfoKHR pipelineRenderingInfo(const void* pNext) const {
+            return VkPipelineRenderingCreateInfoKHR {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+                .pNext = pNext,
+                .viewMask = 0,
+                .colorAttachmentCount = 1,
+                .pColorAttachmentFormats = &colorFormat,
+                .depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+                .stencilAttachmentFormat = VK_FORMAT_UNDEFINED
+            };
+        }
 
-        VkDescriptorSetLayoutBinding samplerLayoutBinding {
-            .binding = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = 1,
-            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .pImmutableSamplers = nullptr,
-        };
+        // render pass & framebuffer objects the path creates, for swapchainImages images.
+        [[nodiscard]] force_inline uint32_t objectCount(size_t swapchainImages) const {
+            return dynamic ? 0 : 1 + static_cast<uint32_t>(swapchainImages);
+        }
 
-        std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
-        VkDescriptorSetLayoutCreateInfo layoutInfo {
-            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        [[nodiscard]] force_inline const char* name() const {
+            return dynamic ? "dynamic rendering" : "render pass";
+        }
+
+        force_inline void destroy() {
+            vkDestroyRenderPass(VK::device, renderPass, nullptr);
+            renderPass = VK_NULL_HANDLE;
+        }
+
+    private:
+        static force_inline void transition(VkCommandBuffer vkCommandBuffer, VkImage image, VkImageLayout oldLayout,
+                                            VkImageLayout newLayout, VkPipelineStageFlags srcStage,
+                                            VkAccessFlags srcAccess, VkPipelineStageFlags dstStage,
+                                            VkAccessFlags dstAccess) {
+            VkImageMemoryBarrier barrier {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext{},
+                .srcAccessMask = srcAccess,
+                .dstAccessMask = dstAccess,
+                .oldLayout = oldLayout,
+                .newLayout = newLayout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = image,
+                .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+            };
+            vkCmdPipelineBarrier(vkCommandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+    } renderPass;
+
+    // records draws into vkCommandBuffer. large draw lists are split across the recorder's workers into
+    // secondary command buffers of frames in flight slot `slot`, small ones are recorded inline.
+    // the gpu profiler times the frame, the render pass and, when recorded inline, the draws. pipeline statistics only
+    // cover inline recording.
+    // a gpu driven scene is culled before the render pass and drawn after the draw list, which is then recorded
+    // inline. target is the swapchain image the pass renders to.
+    force_inline void recordCommandBuffer(VkCommandBuffer vkCommandBuffer, const RenderPass& pass,
+                                          const Frame& target, VkPipeline vkPipeline, const VertexInput& input,
+                                          const vector<Draw>& draws, uint32_t slot,
+                                          bool parallel = true, IndirectScene* scene = nullptr) {
+        VkCommandBufferBeginInfo beginInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
             .pNext{},
             .flags{},
-            .bindingCount = static_cast<uint32_t>(bindings.size()),
-            .pBindings = bindings.data(),
+            .pInheritanceInfo{}
         };
+        vkBeginCommandBuffer(vkCommandBuffer, &beginInfo);
+        gpuProfiler.beginFrame(vkCommandBuffer, slot);
+        if (scene) scene->record(vkCommandBuffer);
+
+        VkExtent2D extent = target.extent;
+
+        gpuProfiler.begin(vkCommandBuffer, "render pass");
 
-        VkDescriptorSetLayout vkDescriptorSetLayout;
-        if (vkCreateDescriptorSetLayout(vkDevice, &layoutInfo, nullptr, &vkDescriptorSetLayout) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create descriptor set layout!");
+        bool secondaries = parallel && !scene && recorder.workersFor(draws.size()) > 1;
+        if (secondaries) {
+            // no timestamps in the primary while the render pass executes secondaries, and no statistics: the
+            // secondaries don't inherit the query (inheritedQueries).
+            pass.begin(vkCommandBuffer, target, true);
+            recorder.record(vkCommandBuffer, slot, pass.renderPass, target.framebuffer.framebuffer, pass.colorFormat,
+                            vkPipeline, input, extent, draws);
+        } else {
+            gpuProfiler.beginStatistics(vkCommandBuffer);
+            pass.begin(vkCommandBuffer, target, false);
+
+            vkCmdBindPipeline(vkCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipeline);
+            bindVertexInput(vkCommandBuffer, input);
+            setViewport(vkCommandBuffer, extent);
+            gpuProfiler.begin(vkCommandBuffer, "draws");
+            for (const Draw& d: draws) draw(vkCommandBuffer, input, d);
+            if (scene) scene->draw(vkCommandBuffer);
+            gpuProfiler.end(vkCommandBuffer);
+        }
+
+        pass.end(vkCommandBuffer, target);
+
+        if (!secondaries) gpuProfiler.endStatistics(vkCommandBuffer);
+        gpuProfiler.end(vkCommandBuffer);
+        gpuProfiler.endFrame(vkCommandBuffer);
+
+        if (vkEndCommandBuffer(vkCommandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
         }
-        return vkDescriptorSetLayout;
     }
 
     class Surface {
@@ -315,9 +500,29 @@ namespace VK {
         VkSurfaceFormatKHR vkSurfaceFormat {};
         VkPresentModeKHR vkPresentMode {};
 
+        // swapchain images requested above minImageCount: every extra image is one more frame the presentation
+        // engine can queue, more throughput but more latency.
+        uint32_t extraImages = 1;
+
         VkExtent2D extent {};
 
+        // without a window, present to a VK_EXT_headless_surface: the swapchain path stays the same but nothing
+        // is ever displayed. works on software ICDs such as lavapipe.
+        force_inline void createHeadless() {
+            VkHeadlessSurfaceCreateInfoEXT vkCreateInfo {
+                .sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT,
+                .pNext{},
+                .flags{}
+            };
+
+            CHECK(CreateHeadlessSurfaceEXT(VK::instance, &vkCreateInfo, nullptr, &surface),
+                  "failed to create headless surface!");
+        }
+
         force_inline void create() {
+            if (VK::window == nullptr) return createHeadless();
+
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
             VkWin32SurfaceCreateInfoKHR vkCreateInfo = {
                 .sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR,
                 .pNext{},
@@ -326,8 +531,11 @@ namespace VK {
                 .hwnd = glfwGetWin32Window(VK::window)
             };
 
-            /*if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) { throw std::runtime_error("failed to create window surface!"); }*/
             vkCreateWin32SurfaceKHR(VK::instance, &vkCreateInfo, nullptr, &surface);
+#else
+            CHECK(glfwCreateWindowSurface(VK::instance, VK::window, nullptr, &surface),
+                  "failed to create window surface!");
+#endif
         }
 
         force_inline void destroy() const {
@@ -357,7 +565,7 @@ namespace VK {
                                                                 = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
             for (const auto& availableFormat: availableFormats) {
                 if (availableFormat.format == format && availableFormat.colorSpace == colorSpace) {
-                    return availableFormat;
+                    return vkSurfaceFormat = availableFormat;
                 }
             }
 
@@ -380,10 +588,28 @@ namespace VK {
             return vkPresentMode = VK_PRESENT_MODE_FIFO_KHR;
         }
 
+        // first supported mode of preferred, fifo when none is (the only mode every device must support).
+        force_inline VkPresentModeKHR chooseSwapPresentMode(const vector<VkPresentModeKHR>& preferred) {
+            for (VkPresentModeKHR mode: preferred) {
+                if (std::find(presentModes.begin(), presentModes.end(), mode) != presentModes.end()) {
+                    return vkPresentMode = mode;
+                }
+            }
+
+            return vkPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+        }
+
+        [[nodiscard]] force_inline uint32_t chooseImageCount() const {
+            uint32_t imageCount = vkSurfaceCapabilities.minImageCount + extraImages;
+            if (vkSurfaceCapabilities.maxImageCount > 0) // 0 is a special case for no limits
+                imageCount = std::min(imageCount, vkSurfaceCapabilities.maxImageCount);
+            return imageCount;
+        }
+
         force_inline VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities,
                                                  uint32_t width, uint32_t height) {
             if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
-                return capabilities.currentExtent;
+                return extent = capabilities.currentExtent;
             } else {
                 VkExtent2D actualExtent = {width, height};
 
@@ -411,15 +637,15 @@ namespace VK {
 
             vector<Frame> frames;
 
+            bool readback = false; // images created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT, the surface may not allow it
+
             VkSwapchainKHR createSwapchain(VkPhysicalDevice vkPhysicalDevice, VkDevice vkDevice,
                                            VkSurfaceKHR vkSurface, uint32_t width, uint32_t height,
                                            VkSurfaceFormatKHR surfaceFormat,
-                                           VkPresentModeKHR presentMode) {
-                uint32_t imageCount = surface->vkSurfaceCapabilities.minImageCount + 1;
-                if (surface->vkSurfaceCapabilities.maxImageCount > 0 // 0 is a special case for no limits
-                    && imageCount > surface->vkSurfaceCapabilities.maxImageCount) {
-                    imageCount = surface->vkSurfaceCapabilities.maxImageCount;
-                }
+                                           VkPresentModeKHR presentMode,
+                                           VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE) {
+                uint32_t imageCount = surface->chooseImageCount();
+                readback = surface->vkSurfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 
                 VkSwapchainCreateInfoKHR vkSwapchainCreateInfoKHR {
                     .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
@@ -431,7 +657,8 @@ namespace VK {
                     .imageColorSpace = surfaceFormat.colorSpace,
                     .imageExtent = surface->extent,
                     .imageArrayLayers = 1,
-                    .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                    .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                  (readback ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0u), // frame readback
                     .imageSharingMode{},
                     .queueFamilyIndexCount{},
                     .pQueueFamilyIndices{},
@@ -439,7 +666,7 @@ namespace VK {
                     .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
                     .presentMode = presentMode,
                     .clipped = VK_TRUE,
-                    .oldSwapchain{}
+                    .oldSwapchain = oldSwapchain // lets the presentation engine hand over without a blank frame
                 };
 
                 uint32_t idx[] = {queues.graphics.id.value(), queues.present.id.value()};
@@ -456,11 +683,11 @@ namespace VK {
                 return swapchain;
             }
 
-            VkSwapchainKHR createSwapchain(uint32_t width, uint32_t height) {
+            VkSwapchainKHR createSwapchain(uint32_t width, uint32_t height, VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE) {
                 surface->chooseSwapExtent(surface->vkSurfaceCapabilities, width, height);
                 return createSwapchain(physicalDevice, device, surface->surface, width, height,
                                        surface->vkSurfaceFormat,
-                                       surface->vkPresentMode);
+                                       surface->vkPresentMode, oldSwapchain);
             }
 
             force_inline void create() {
@@ -472,96 +699,74 @@ namespace VK {
                 frames.resize(count);
                 for (int i = 0; i < frames.size(); i++) {
                     frames[i].image = vkImages[i];
+                    frames[i].format = surface->vkSurfaceFormat.format;
+                    frames[i].extent = surface->extent;
                     frames[i].createView(VK_IMAGE_ASPECT_COLOR_BIT);
                 }
             }
 
-            void destroy() {
-                vkDestroySwapchainKHR(device, swapchain, nullptr);
-
-                for (const auto& iv: frames) {
-                    //VK::image.deleteImageView(VK::device, iv);
+            // none with dynamic rendering, the pass renders to the views.
+            force_inline void createFramebuffers(const RenderPass& pass) {
+                if (pass.dynamic) return;
+                for (auto& f: frames) {
+                    f.framebuffer.create(pass.renderPass, surface->extent.width, surface->extent.height, {f.view});
                 }
             }
-        } swapchain;
 
-        force_inline void destroy() {
-            swapchain.destroy();
-            vkDestroySurfaceKHR(VK::instance, surface, nullptr);
-        }
-    } surface;
-
-    struct RenderPass {
-        VkRenderPass renderPass;
+            // swapchain images belong to the swapchain, only our views & framebuffers are destroyed.
+            static force_inline void destroyFrames(vector<Frame>& vkFrames) {
+                for (auto& f: vkFrames) {
+                    f.framebuffer.destroy();
+                    vkDestroyImageView(device, f.view, nullptr);
+                }
+                vkFrames.clear();
+            }
 
-        force_inline void createRenderPass() {
-            VkAttachmentDescription colorAttachment {
-                .flags{},
-                .format = surface.swapchain.frames[0].format,
-                .samples = VK_SAMPLE_COUNT_1_BIT,
-                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-                .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-                .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+            // rebuilds the swapchain for the current surface extent, handing the old one over through oldSwapchain.
+            // the old swapchain and its frames are returned instead of destroyed: frames in flight may still
+            // reference them, the caller destroys them once those have retired.
+            struct Retired {
+                VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+                vector<Frame> frames;
             };
 
-            VkAttachmentReference colorAttachmentRef {
-                .attachment = 0,
-                .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-            };
+            force_inline Retired recreate(uint32_t width, uint32_t height, const RenderPass& pass) {
+                Retired retired {swapchain, std::move(frames)};
+                frames.clear();
 
-            VkSubpassDescription vkSubpassDescription {
-                .flags{},
-                .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-                .inputAttachmentCount{},
-                .pInputAttachments{},
-                .colorAttachmentCount = 1,
-                .pColorAttachments = &colorAttachmentRef,
-                .pResolveAttachments{},
-                .pDepthStencilAttachment{},
-                .preserveAttachmentCount{},
-                .pPreserveAttachments{}
-            };
-
-            VkSubpassDependency vkSubpassDependency {
-                .srcSubpass = VK_SUBPASS_EXTERNAL,
-                .dstSubpass = 0,
-                .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // waiting for operation start
-                .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // operations that should wait for end
-                .srcAccessMask = 0, // access
-                .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, // we need to be able to write to this stage
-                .dependencyFlags{}
-            };
-
-            VkRenderPassCreateInfo renderPassInfo {
-                .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-                .pNext{},
-                .flags{},
-                .attachmentCount = 1,
-                .pAttachments = &colorAttachment,
-                .subpassCount = 1,
-                .pSubpasses = &vkSubpassDescription,
-                .dependencyCount = 1,
-                .pDependencies = &vkSubpassDependency,
-            };
+                vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface->surface,
+                                                          &surface->vkSurfaceCapabilities);
+                createSwapchain(width, height, retired.swapchain);
+                create();
+                createFramebuffers(pass);
+                return retired;
+            }
 
-            vkCreateRenderPass(VK::device, &renderPassInfo, nullptr, &renderPass);
-        }
+            void destroy() {
+                destroyFrames(frames);
+                vkDestroySwapchainKHR(device, swapchain, nullptr);
+            }
+        } swapchain;
 
         force_inline void destroy() {
-            vkDestroyRenderPass(VK::device, renderPass, nullptr);
+            swapchain.destroy();
+            vkDestroySurfaceKHR(VK::instance, surface, nullptr);
         }
-
-    } renderPass;
+    } surface;
 
     struct Pipeline {
         VkPipelineLayout layout;
         VkPipeline pipeline;
 
-        force_inline void createGraphicsPipeline() {
-            auto vertShaderCode = readFile("dat/shaders/default.vert.glsl.spv");
+        // vertex input comes from a VertexLayout (Vertex.h), pushConstantSize bytes of vertex push constants. the
+        // pipeline is created for target: its render pass, or its attachment formats with dynamic rendering.
+        force_inline void createGraphicsPipeline(const vector<VkVertexInputBindingDescription>& bindings,
+                                                 const vector<VkVertexInputAttributeDescription>& attributes,
+                                                 uint32_t pushConstantSize = 0,
+                                                 const char* vertexShader = "dat/shaders/default.vert.glsl.spv",
+                                                 const vector<VkDescriptorSetLayout>& setLayouts = {},
+                                                 const RenderPass& target = renderPass) {
+            auto vertShaderCode = readFile(vertexShader);
             auto fragShaderCode = readFile("dat/shaders/default.frag.glsl.spv");
 
             VkShaderModule vertShaderModule = createShaderModule(device, vertShaderCode);
@@ -586,14 +791,11 @@ namespace VK {
             VkPipelineVertexInputStateCreateInfo vertexInputInfo {};
             vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-            void* bindingDescription = nullptr;//Vertex::getBindingDescription();
-            void* attributeDescriptions = nullptr; //Vertex::getAttributeDescriptions();
-
-            vertexInputInfo.vertexBindingDescriptionCount = 0;
-            vertexInputInfo.pVertexBindingDescriptions = nullptr;
+            vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
+            vertexInputInfo.pVertexBindingDescriptions = bindings.data();
 
-            vertexInputInfo.vertexAttributeDescriptionCount = 0;
-            vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+            vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+            vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
 
             VkPipelineInputAssemblyStateCreateInfo inputAssembly {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
@@ -601,26 +803,22 @@ namespace VK {
                 .primitiveRestartEnable = VK_FALSE
             };
 
-            VkViewport viewport {
-                .x = 0.0f,
-                .y = 0.0f,
-                .width = (float) surface.extent.width,
-                .height = (float) surface.extent.height,
-                .minDepth = 0.0f,
-                .maxDepth = 1.0f
-            };
-
-            VkRect2D scissor {
-                .offset = {0, 0},
-                .extent = surface.extent
-            };
-
+            // viewport & scissor are dynamic so the pipeline survives swapchain resizes.
             VkPipelineViewportStateCreateInfo viewportState {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
                 .viewportCount = 1,
-                .pViewports = &viewport,
+                .pViewports = nullptr,
                 .scissorCount = 1,
-                .pScissors = &scissor
+                .pScissors = nullptr
+            };
+
+            VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+            VkPipelineDynamicStateCreateInfo dynamicState {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+                .pNext{},
+                .flags{},
+                .dynamicStateCount = 2,
+                .pDynamicStates = dynamicStates
             };
 
             VkPipelineRasterizationStateCreateInfo rasterizer {
@@ -683,21 +881,35 @@ namespace VK {
                 .blendConstants {0.0f, 0.0f, 0.0f, 0.0f}
             };
 
+            VkPushConstantRange pushConstantRange {
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+                .offset = 0,
+                .size = pushConstantSize
+            };
+
             VkPipelineLayoutCreateInfo pipelineLayoutInfo {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
                 .pNext{},
                 .flags{},
-                .setLayoutCount{}, // 1
-                .pSetLayouts{}, // &vkDescriptorSetLayout,
-                .pushConstantRangeCount{},
-                .pPushConstantRanges{},
+                .setLayoutCount = static_cast<uint32_t>(setLayouts.size()),
+                .pSetLayouts = setLayouts.data(),
+                .pushConstantRangeCount = pushConstantSize ? 1u : 0u,
+                .pPushConstantRanges = &pushConstantRange,
             };
 
             vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout);
 
+            const void* pNext = nullptr;
+            PipelineCache::Feedback feedback;
+            pipelineCache.begin(feedback, pNext);
+
+            // with dynamic rendering the pipeline only knows the attachment formats, no render pass object.
+            VkPipelineRenderingCreateInfoKHR renderingInfo = target.pipelineRenderingInfo(pNext);
+            if (target.dynamic) pNext = &renderingInfo;
+
             VkGraphicsPipelineCreateInfo pipelineCreateInfo {
                 .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-                .pNext{},
+                .pNext = pNext,
                 .flags{},
                 .stageCount = 2,
                 .pStages = shaderStages,
@@ -709,16 +921,17 @@ namespace VK {
                 .pMultisampleState = &multisampling,
                 .pDepthStencilState = &depthStencil,
                 .pColorBlendState = &colorBlending,
-                .pDynamicState{},
+                .pDynamicState = &dynamicState,
                 .layout = layout,
-                .renderPass = renderPass.renderPass,
+                .renderPass = target.renderPass, // VK_NULL_HANDLE with dynamic rendering
                 .subpass = 0,
                 .basePipelineHandle = VK_NULL_HANDLE,
                 .basePipelineIndex{}
             };
 
-            CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline),
+            CHECK(vkCreateGraphicsPipelines(device, pipelineCache.cache, 1, &pipelineCreateInfo, nullptr, &pipeline),
                   "failed to create graphics pipeline.");
+            pipelineCache.record(feedback);
 
             vkDestroyShaderModule(device, fragShaderModule, nullptr);
             vkDestroyShaderModule(device, vertShaderModule, nullptr);
@@ -735,15 +948,20 @@ namespace VK {
     } pipeline;
 
     force_inline VkInstance createInstance(vector<const char*> extensions = {},
-                                           vector<const char*> layers = {"VK_LAYER_KHRONOS_validation"},
+                                           vector<const char*> layers = validationLayers(),
                                            const char* appName = "",
                                            VkDebugUtilsMessengerCreateInfoEXT vkDebugUtilsMessengerCreateInfoEXT = vkDefaultDebugUtilsMessengerCreateInfoEXT) {
 
-        uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        if (VK::window != nullptr) {
+            uint32_t glfwExtensionCount = 0;
+            const char** glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-        extensions.insert(extensions.end(), glfwExtensions, glfwExtensions + glfwExtensionCount);
+            extensions.insert(extensions.end(), glfwExtensions, glfwExtensions + glfwExtensionCount);
+        } else {
+            extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+            extensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+        }
 
         VkInstanceCreateInfo vkInstanceCreateInfo {};
         vkInstanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -789,9 +1007,11 @@ namespace VK {
                                               vector<VkDeviceQueueCreateInfo> queueCreateInfos,
                                               vector<const char*> extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME},
                                               VkPhysicalDeviceFeatures* features = nullptr,
-                                              vector<const char*> validationLayers = {"VK_LAYER_KHRONOS_validation"}) {
+                                              vector<const char*> layers = validationLayers(),
+                                              const void* pNext = nullptr) {
         VkDeviceCreateInfo createInfo {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = pNext;
 
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -801,9 +1021,9 @@ namespace VK {
         createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
         createInfo.ppEnabledExtensionNames = extensions.data();
 
-        if (!validationLayers.empty()) {
-            createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-            createInfo.ppEnabledLayerNames = validationLayers.data();
+        if (!layers.empty()) {
+            createInfo.enabledLayerCount = static_cast<uint32_t>(layers.size());
+            createInfo.ppEnabledLayerNames = layers.data();
         } else {
             createInfo.enabledLayerCount = 0;
         }
@@ -816,8 +1036,10 @@ namespace VK {
 
     force_inline VkDevice createLogicalDevice(vector<const char*> extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME},
                                               VkPhysicalDeviceFeatures* features = nullptr,
-                                              vector<const char*> validationLayers = {"VK_LAYER_KHRONOS_validation"}) {
-        createLogicalDevice(VK::physicalDevice, queues.getQueueCreateInfos(), extensions, features, validationLayers);
+                                              vector<const char*> layers = validationLayers(),
+                                              const void* pNext = nullptr) {
+        return createLogicalDevice(VK::physicalDevice, queues.getQueueCreateInfos(), extensions, features, layers,
+                                   pNext);
     }
 
     force_inline void deleteLogicalDevice(VkDevice vkDevice) {
@@ -836,6 +1058,22 @@ namespace VK {
         return availableLayers;
     }
 
+    force_inline bool supportsInstanceExtensions(vector<const char*> extensions) {
+        uint32_t count;
+        vkEnumerateInstanceExtensionProperties(nullptr, &count, nullptr);
+
+        vector<VkExtensionProperties> availableExtensions(count);
+        vkEnumerateInstanceExtensionProperties(nullptr, &count, availableExtensions.data());
+
+        set<std::string> requiredExtensions(extensions.begin(), extensions.end());
+
+        for (const auto& extension: availableExtensions) {
+            requiredExtensions.erase(extension.extensionName);
+        }
+
+        return requiredExtensions.empty();
+    }
+
     force_inline bool supportsLayers(vector<const char*> layers) {
         vector<VkLayerProperties> availableLayers = enumerateInstanceLayersProperties();
 
@@ -872,16 +1110,24 @@ namespace VK {
     }
 
     force_inline bool isDeviceSuitable(VkPhysicalDevice vkPhysicalDevice, VkSurfaceKHR vkSurface) {
+        Queues candidateQueues {};
+        candidateQueues.getQueueFamilyIndices(vkPhysicalDevice, vkSurface);
+
         bool extensionsSupported = supportsExtensions(vkPhysicalDevice, {VK_KHR_SWAPCHAIN_EXTENSION_NAME});
         bool swapChainAdequate = false;
         if (extensionsSupported) {
-            swapChainAdequate = !surface.surfaceFormats.empty() && !surface.presentModes.empty();
+            uint32_t formatCount = 0;
+            uint32_t presentModeCount = 0;
+            vkGetPhysicalDeviceSurfaceFormatsKHR(vkPhysicalDevice, vkSurface, &formatCount, nullptr);
+            vkGetPhysicalDeviceSurfacePresentModesKHR(vkPhysicalDevice, vkSurface, &presentModeCount, nullptr);
+            swapChainAdequate = formatCount != 0 && presentModeCount != 0;
         }
 
         VkPhysicalDeviceFeatures supportedFeatures;
         vkGetPhysicalDeviceFeatures(vkPhysicalDevice, &supportedFeatures);
 
-        return queues.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+        return candidateQueues.isComplete() && extensionsSupported && swapChainAdequate &&
+               supportedFeatures.samplerAnisotropy;
     }
 
     force_inline vector<VkPhysicalDevice> enumeratePhysicalDevices(VkInstance vkInstance) {
@@ -933,6 +1179,7 @@ namespace VK {
             }
         }
 
+        if (candidates.empty()) throw std::runtime_error("failed to find a suitable GPU!");
         return candidates.rbegin()->second;
     }
 
@@ -941,12 +1188,150 @@ namespace VK {
     }
 
     force_inline void init() {
-        VK::createInstance();
-        VK::createDebugMessenger();
+        vector<const char*> instanceExtensions;
+        bool properties2 = supportsInstanceExtensions({VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME});
+        if (properties2) instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
+        // validation, its messenger & labels as the build profile says (build_profile.h), all compiled out in
+        // release builds. a missing validation layer is a warning, not an error.
+        if (buildProfile.validationEnabled() && !supportsLayers(validationLayers())) {
+            spdlog::warn("VK_LAYER_KHRONOS_validation is not installed, running without validation");
+            buildProfile.validation = false;
+        }
+        bool debugUtils = (buildProfile.validationEnabled() || buildProfile.debugLabelsEnabled()) &&
+                          supportsInstanceExtensions({VK_EXT_DEBUG_UTILS_EXTENSION_NAME});
+        if (debugUtils) instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+        if (buildProfile.verboseValidation) {
+            vkDefaultDebugUtilsMessengerCreateInfoEXT.messageSeverity |=
+                VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+        }
+
+        VK::createInstance(instanceExtensions);
+        if (debugUtils && buildProfile.validationEnabled()) VK::createDebugMessenger();
+        VK::debugLabels = debugUtils && buildProfile.debugLabelsEnabled();
         VK::surface.create();
-        VK::getBestPhysicalDevice();
+        VK::physicalDevice = VK::getBestPhysicalDevice();
         VK::queues.getQueueFamilyIndices(surface.surface);
-        VK::device = VK::createLogicalDevice();
+
+        vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+        if (supportsExtensions(VK::physicalDevice, {VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME})) {
+            deviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+            VK::pipelineCache.feedbackSupported = true;
+        }
+
+        if (properties2 && supportsExtensions(VK::physicalDevice, {VK_EXT_MEMORY_BUDGET_EXTENSION_NAME})) {
+            deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            VK::allocator.budgetSupported = true;
+        }
+
+        // timeline semaphores track staging upload completion (VK_UPLOAD.h).
+        if (!properties2 || !supportsExtensions(VK::physicalDevice, {VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME})) {
+            throw std::runtime_error("VK_KHR_timeline_semaphore is not supported!");
+        }
+        deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+            .pNext{},
+            .timelineSemaphore = VK_TRUE
+        };
+        void** featureChain = &timelineSemaphoreFeatures.pNext; // optional feature structs are appended here
+
+        // pipeline statistics for the gpu profiler (VK_QUERY.h), when the device has them.
+        VkPhysicalDeviceFeatures supported = getPhysicalDeviceFeatures(VK::physicalDevice);
+        VkPhysicalDeviceFeatures features {};
+        features.pipelineStatisticsQuery = supported.pipelineStatisticsQuery;
+        VK::gpuProfiler.statisticsSupported = features.pipelineStatisticsQuery;
+
+        // gpu driven draws (VK_INDIRECT.h): the culling pass writes the draw count when the device can read it,
+        // every bucket is drawn otherwise. instances are found through firstInstance either way.
+        features.multiDrawIndirect = supported.multiDrawIndirect;
+        features.drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
+        VK::indirectScene.multiDrawIndirectSupported = features.multiDrawIndirect;
+        VK::indirectScene.firstInstanceSupported = features.drawIndirectFirstInstance;
+        if (supportsExtensions(VK::physicalDevice, {VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME})) {
+            deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            VK::indirectScene.drawIndirectCountSupported = true;
+        }
+
+        // bindless descriptors (VK_DESCRIPTOR.h): runtime sized, partially bound arrays written after bind.
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT
+        };
+        if (properties2 && supportsExtensions(VK::physicalDevice, {VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+                                                                   VK_KHR_MAINTENANCE3_EXTENSION_NAME})) {
+            VkPhysicalDeviceFeatures2KHR features2 {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR,
+                .pNext = &descriptorIndexingFeatures
+            };
+            GetPhysicalDeviceFeatures2KHR(VK::physicalDevice, &features2);
+
+            VkPhysicalDeviceDescriptorIndexingFeaturesEXT& indexing = descriptorIndexingFeatures;
+            bool bindless = indexing.runtimeDescriptorArray && indexing.descriptorBindingPartiallyBound &&
+                            indexing.descriptorBindingSampledImageUpdateAfterBind &&
+                            indexing.descriptorBindingStorageBufferUpdateAfterBind &&
+                            indexing.shaderSampledImageArrayNonUniformIndexing &&
+                            supported.shaderSampledImageArrayDynamicIndexing &&
+                            supported.shaderStorageBufferArrayDynamicIndexing;
+            if (bindless) {
+                // indices pushed with the draw (indirect_bindless.vert) are dynamically uniform.
+                features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+                features.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+                deviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+                deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+                *featureChain = &descriptorIndexingFeatures; // every supported feature enabled
+                featureChain = &descriptorIndexingFeatures.pNext;
+                VK::bindless.supported = true;
+            }
+        }
+
+        // render graph barriers (VK_GRAPH.h), pipeline barriers without it.
+        VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR
+        };
+        if (properties2 && supportsExtensions(VK::physicalDevice, {VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME})) {
+            VkPhysicalDeviceFeatures2KHR features2 {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR,
+                .pNext = &synchronization2Features
+            };
+            GetPhysicalDeviceFeatures2KHR(VK::physicalDevice, &features2);
+            if (synchronization2Features.synchronization2) {
+                deviceExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+                *featureChain = &synchronization2Features;
+                featureChain = &synchronization2Features.pNext;
+                RenderGraph::synchronization2 = true;
+            }
+        }
+
+        // the main pass without render pass & framebuffer objects (RenderPass). core in 1.3, the extension on the
+        // 1.0 instance: it needs depth_stencil_resolve, which needs create_renderpass2, multiview & maintenance2.
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR
+        };
+        vector<const char*> dynamicRenderingExtensions = {
+            VK_KHR_MULTIVIEW_EXTENSION_NAME, VK_KHR_MAINTENANCE2_EXTENSION_NAME,
+            VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+            VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME
+        };
+        if (properties2 && supportsExtensions(VK::physicalDevice, dynamicRenderingExtensions)) {
+            VkPhysicalDeviceFeatures2KHR features2 {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR,
+                .pNext = &dynamicRenderingFeatures
+            };
+            GetPhysicalDeviceFeatures2KHR(VK::physicalDevice, &features2);
+            if (dynamicRenderingFeatures.dynamicRendering) {
+                deviceExtensions.insert(deviceExtensions.end(), dynamicRenderingExtensions.begin(),
+                                        dynamicRenderingExtensions.end());
+                *featureChain = &dynamicRenderingFeatures;
+                featureChain = &dynamicRenderingFeatures.pNext;
+                RenderPass::dynamicRenderingSupported = true;
+            }
+        }
+
+        VK::device = VK::createLogicalDevice(deviceExtensions, &features, validationLayers(),
+                                             &timelineSemaphoreFeatures);
+        VK::allocator.init(VK::physicalDevice, VK::device);
         VK::surface.init();
+        VK::pipelineCache.create(VK::device, VK::physicalDevice);
     }
 };
\ No newline at end of file
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "glfw_vulkan.h"
+#include "using_std.h"
+#include "logging.h"
+
+#include <filesystem>
+#include <fstream>
+
+namespace VK {
+    // Pipeline cache shared by every pipeline creation, persisted between runs.
+    //
+    // file layout: [Header][vulkan cache blob]. the driver blob already starts with VkPipelineCacheHeaderVersionOne
+    // (vendor, device, cache uuid), our header adds the driver version, which the vulkan header lacks, and a hash
+    // of the blob so a truncated or corrupted file is never handed to the driver.
+    struct PipelineCache {
+        static constexpr uint32_t magic = 0x50435633; // "3VCP"
+        static constexpr uint32_t version = 1;
+
+        struct Header {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t driverVersion;
+            uint32_t reserved;
+            uint64_t dataSize;
+            uint64_t dataHash;
+        };
+
+        VkPipelineCache cache = VK_NULL_HANDLE;
+        std::string path = "pipeline.cache";
+
+        // VK_EXT_pipeline_creation_feedback tells us whether a pipeline came out of the cache.
+        bool feedbackSupported = false;
+
+        struct Stats {
+            uint64_t loadNs = 0;
+            uint64_t loadedBytes = 0;
+            uint32_t pipelines = 0;
+            uint32_t hits = 0;
+            uint32_t misses = 0;
+            uint64_t createNs = 0;
+        } stats;
+
+        static uint64_t hash(const char* data, size_t size) { // fnv-1a
+            uint64_t h = 0xcbf29ce484222325ull;
+            for (size_t i = 0; i < size; i++) {
+                h ^= (uint8_t) data[i];
+                h *= 0x100000001b3ull;
+            }
+            return h;
+        }
+
+        // returns the driver blob if the file on disk was written by this exact device & driver.
+        [[nodiscard]] vector<char> read(const VkPhysicalDeviceProperties& properties) const {
+            std::ifstream file(path, std::ios::ate | std::ios::binary);
+            if (!file.is_open()) return {};
+
+            auto fileSize = (size_t) file.tellg();
+            if (fileSize < sizeof(Header) + sizeof(VkPipelineCacheHeaderVersionOne)) return {};
+            file.seekg(0);
+
+            Header header {};
+            file.read(reinterpret_cast<char*>(&header), sizeof(Header));
+            if (header.magic != magic || header.version != version || header.dataSize != fileSize - sizeof(Header) ||
+                header.driverVersion != properties.driverVersion) {
+                info("pipeline cache: {} is stale, ignoring it", path);
+                return {};
+            }
+
+            vector<char> data(header.dataSize);
+            file.read(data.data(), (std::streamsize) data.size());
+            if (!file || hash(data.data(), data.size()) != header.dataHash) {
+                info("pipeline cache: {} is corrupted, ignoring it", path);
+                return {};
+            }
+
+            VkPipelineCacheHeaderVersionOne vkHeader {};
+            memcpy(&vkHeader, data.data(), sizeof(vkHeader));
+            if (vkHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+                vkHeader.vendorID != properties.vendorID || vkHeader.deviceID != properties.deviceID ||
+                memcmp(vkHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+                info("pipeline cache: {} was written by another device, ignoring it", path);
+                return {};
+            }
+
+            return data;
+        }
+
+        force_inline void create(VkDevice vkDevice, VkPhysicalDevice vkPhysicalDevice) {
+            auto start = Clock::now();
+
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(vkPhysicalDevice, &properties);
+            vector<char> data = read(properties);
+
+            VkPipelineCacheCreateInfo createInfo {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+                .pNext{},
+                .flags{},
+                .initialDataSize = data.size(),
+                .pInitialData = data.empty() ? nullptr : data.data()
+            };
+
+            if (vkCreatePipelineCache(vkDevice, &createInfo, nullptr, &cache) != VK_SUCCESS) {
+                // the driver refused the blob, start from scratch rather than failing.
+                createInfo.initialDataSize = 0;
+                createInfo.pInitialData = nullptr;
+                data.clear();
+                CHECK(vkCreatePipelineCache(vkDevice, &createInfo, nullptr, &cache),
+                      "failed to create pipeline cache!");
+            }
+
+            stats.loadedBytes = data.size();
+            stats.loadNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            info("pipeline cache: loaded {} bytes from {} in {} us", stats.loadedBytes, path, stats.loadNs / 1000);
+        }
+
+        // chain into VkGraphicsPipelineCreateInfo::pNext, then pass to record() once the pipeline is created.
+        struct Feedback {
+            VkPipelineCreationFeedbackEXT pipeline {};
+            VkPipelineCreationFeedbackCreateInfoEXT createInfo {};
+            Clock::time_point start;
+        };
+
+        force_inline void begin(Feedback& feedback, const void*& pNext) const {
+            feedback.start = Clock::now();
+            if (!feedbackSupported) return;
+
+            feedback.createInfo = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT,
+                .pNext = pNext,
+                .pPipelineCreationFeedback = &feedback.pipeline,
+                .pipelineStageCreationFeedbackCount = 0,
+                .pPipelineStageCreationFeedbacks = nullptr
+            };
+            pNext = &feedback.createInfo;
+        }
+
+        force_inline void record(const Feedback& feedback) {
+            stats.pipelines++;
+            stats.createNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - feedback.start).count();
+
+            if (!(feedback.pipeline.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)) return;
+            if (feedback.pipeline.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT)
+                stats.hits++;
+            else
+                stats.misses++;
+        }
+
+        force_inline void print() const {
+            if (feedbackSupported) {
+                info("pipeline cache: {} pipelines created in {} us, {} hits, {} misses", stats.pipelines,
+                     stats.createNs / 1000, stats.hits, stats.misses);
+            } else {
+                info("pipeline cache: {} pipelines created in {} us (no creation feedback)", stats.pipelines,
+                     stats.createNs / 1000);
+            }
+        }
+
+        // written to a temporary file then renamed over the old one, so a crash never leaves a torn cache.
+        force_inline void save(VkDevice vkDevice, VkPhysicalDevice vkPhysicalDevice) const {
+            size_t size = 0;
+            if (vkGetPipelineCacheData(vkDevice, cache, &size, nullptr) != VK_SUCCESS || size == 0) return;
+
+            vector<char> data(size);
+            if (vkGetPipelineCacheData(vkDevice, cache, &size, data.data()) != VK_SUCCESS) return;
+            data.resize(size);
+
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(vkPhysicalDevice, &properties);
+
+            Header header {
+                .magic = magic,
+                .version = version,
+                .driverVersion = properties.driverVersion,
+                .reserved = 0,
+                .dataSize = data.size(),
+                .dataHash = hash(data.data(), data.size())
+            };
+
+            std::string tmp = path + ".tmp";
+            std::error_code error;
+            bool written;
+            {
+                std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+                file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+                file.write(data.data(), (std::streamsize) data.size());
+                file.close();
+                written = !file.fail();
+            }
+            if (!written) {
+                spdlog::warn("pipeline cache: failed to write {}", tmp);
+                std::filesystem::remove(tmp, error);
+                return;
+            }
+
+            std::filesystem::rename(tmp, path, error);
+            if (error) {
+                spdlog::warn("pipeline cache: failed to write {}: {}", path, error.message());
+                std::filesystem::remove(tmp, error);
+                return;
+            }
+
+            info("pipeline cache: wrote {} bytes to {}", data.size(), path);
+        }
+
+        force_inline void destroy(VkDevice vkDevice) {
+            vkDestroyPipelineCache(vkDevice, cache, nullptr);
+            cache = VK_NULL_HANDLE;
+        }
+    };
+
+    inline PipelineCache pipelineCache;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "glfw_vulkan.h"
+#include "async_log.h"
+#include "build_profile.h"
 
 namespace VK {
     force_inline void CHECK(VkResult result, const char* msg = "Vulkan check failed!") {
@@ -11,12 +13,43 @@ namespace VK {
 
     force_inline bool supportsLayers(vector<const char*> layers);
 
+    // the layers createInstance() & createLogicalDevice() enable by default: validation when the build profile has
+    // it on, none in release builds.
+    force_inline vector<const char*> validationLayers() {
+        if (buildProfile.validationEnabled()) return {"VK_LAYER_KHRONOS_validation"};
+        return {};
+    }
+
+    // named command buffer regions for capture tools, set by init() when the build profile has them on and the
+    // instance has VK_EXT_debug_utils.
+    inline bool debugLabels = false;
+
+    force_inline void beginLabel(VkCommandBuffer commandBuffer, const char* name) {
+        if (!V3RSE_DEBUG_LABELS || !debugLabels) return;
+        VkDebugUtilsLabelEXT label {
+            .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT,
+            .pNext{},
+            .pLabelName = name,
+            .color{}
+        };
+        CmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
+    }
+
+    force_inline void endLabel(VkCommandBuffer commandBuffer) {
+        if (V3RSE_DEBUG_LABELS && debugLabels) CmdEndDebugUtilsLabelEXT(commandBuffer);
+    }
+
 
     VkBool32 debugCallbackDefault(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
                                   VkDebugUtilsMessageTypeFlagsEXT messageType,
                                   const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
                                   void* pUserData) {
-        if (messageSeverity >= 0) std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+        // called on whatever thread made the vulkan call: queued, not written here.
+        AsyncLogger::Level level = AsyncLogger::Level::debug;
+        if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) level = AsyncLogger::Level::err;
+        else if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) level = AsyncLogger::Level::warn;
+        else if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) level = AsyncLogger::Level::info;
+        asyncLog.log(level, "validation layer: {}", pCallbackData->pMessage);
         return VK_FALSE;
     }
 
@@ -25,10 +58,10 @@ namespace VK {
                                const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
                                void* pUserData) = debugCallbackDefault;
 
+    // warnings & errors, init() adds verbose & info messages for V3RSE_VALIDATION=verbose.
     VkDebugUtilsMessengerCreateInfoEXT vkDefaultDebugUtilsMessengerCreateInfoEXT = {
         .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
-        .messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
-                           VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+        .messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
                            VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT,
         .messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
                        VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
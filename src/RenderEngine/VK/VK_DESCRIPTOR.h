@@ -0,0 +1,364 @@
+#pragma once
+
+#include "glfw_vulkan.h"
+#include "using_std.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace VK {
+    // Descriptor writes & binds, counted per frame. every vkUpdateDescriptorSets & vkCmdBindDescriptorSets of the
+    // engine goes through updateDescriptorSets() & bindDescriptorSets() below, recorder threads included.
+    struct DescriptorCounters {
+        std::atomic<uint32_t> writes {0}; // descriptors written this frame
+        std::atomic<uint32_t> binds {0};  // sets bound this frame
+
+        uint64_t frames = 0;
+        uint64_t totalWrites = 0;
+        uint64_t totalBinds = 0;
+        uint32_t maxWrites = 0;
+        uint32_t maxBinds = 0;
+
+        // closes the frame, called once the previous frame of the slot is done.
+        force_inline void nextFrame() {
+            uint32_t w = writes.exchange(0, std::memory_order_relaxed);
+            uint32_t b = binds.exchange(0, std::memory_order_relaxed);
+            frames++;
+            totalWrites += w;
+            totalBinds += b;
+            maxWrites = std::max(maxWrites, w);
+            maxBinds = std::max(maxBinds, b);
+        }
+
+        force_inline void print() const {
+            if (frames == 0) return;
+            info("descriptors: {:.1f} writes & {:.1f} binds per frame on average, {} & {} at most",
+                 (double) totalWrites / frames, (double) totalBinds / frames, maxWrites, maxBinds);
+        }
+    };
+
+    inline DescriptorCounters descriptorCounters;
+
+    force_inline void updateDescriptorSets(VkDevice vkDevice, uint32_t writeCount, const VkWriteDescriptorSet* writes) {
+        uint32_t descriptors = 0;
+        for (uint32_t i = 0; i < writeCount; i++) descriptors += writes[i].descriptorCount;
+        descriptorCounters.writes.fetch_add(descriptors, std::memory_order_relaxed);
+        vkUpdateDescriptorSets(vkDevice, writeCount, writes, 0, nullptr);
+    }
+
+    force_inline void bindDescriptorSets(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout,
+                                         uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* sets,
+                                         uint32_t dynamicOffsetCount = 0, const uint32_t* dynamicOffsets = nullptr) {
+        descriptorCounters.binds.fetch_add(setCount, std::memory_order_relaxed);
+        vkCmdBindDescriptorSets(cmd, bindPoint, layout, firstSet, setCount, sets, dynamicOffsetCount,
+                                dynamicOffsets);
+    }
+
+    // Descriptor sets that live for one frame. each frames in flight slot owns a chain of pools the sets are carved
+    // out of, front to back, and never freed one by one: once the slot's fence has been waited on, reset() hands
+    // every pool back whole with vkResetDescriptorPool. a full pool gets a sibling, kept for the next frames.
+    //
+    // allocate() is for the thread that records the frame's primary command buffer.
+    struct FrameDescriptors {
+        static constexpr uint32_t setsPerPool = 256;
+        static constexpr array<VkDescriptorPoolSize, 5> poolSizes = {{
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 512},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 256},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 512},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 256},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 512}
+        }};
+
+        struct Slot {
+            vector<VkDescriptorPool> pools;
+            uint32_t current = 0; // the pool sets are allocated from, the ones before it are full
+            uint32_t allocated = 0;
+        };
+
+        VkDevice device = VK_NULL_HANDLE;
+        vector<Slot> slots;
+        uint32_t slot = 0;
+
+        uint32_t maxAllocated = 0; // sets allocated by one frame, at most
+
+        force_inline void create(VkDevice vkDevice, uint32_t framesInFlight) {
+            device = vkDevice;
+            slots.resize(framesInFlight);
+            slot = 0;
+            for (auto& s: slots) s.pools.push_back(createPool());
+        }
+
+        // called after the slot's fence wait: the GPU is done with every set of its previous frame.
+        force_inline void reset(uint32_t frameSlot) {
+            slot = frameSlot;
+            Slot& s = slots[slot];
+            for (uint32_t i = 0; i <= s.current && i < s.pools.size(); i++) {
+                vkResetDescriptorPool(device, s.pools[i], 0);
+            }
+            maxAllocated = std::max(maxAllocated, s.allocated);
+            s.current = 0;
+            s.allocated = 0;
+        }
+
+        [[nodiscard]] force_inline VkDescriptorSet allocate(VkDescriptorSetLayout layout) {
+            Slot& s = slots[slot];
+            VkDescriptorSetAllocateInfo allocInfo {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .pNext{},
+                .descriptorPool = s.pools[s.current],
+                .descriptorSetCount = 1,
+                .pSetLayouts = &layout
+            };
+
+            VkDescriptorSet set;
+            VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+            if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+                if (++s.current == s.pools.size()) s.pools.push_back(createPool());
+                allocInfo.descriptorPool = s.pools[s.current];
+                result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+            }
+            CHECK(result, "failed to allocate frame descriptor set!");
+
+            s.allocated++;
+            return set;
+        }
+
+        [[nodiscard]] force_inline uint32_t poolCount() const {
+            uint32_t count = 0;
+            for (auto& s: slots) count += static_cast<uint32_t>(s.pools.size());
+            return count;
+        }
+
+        force_inline void printStats() const {
+            info("frame descriptors: {} sets per frame at most, {} pools", maxAllocated, poolCount());
+        }
+
+        force_inline void destroy() {
+            for (auto& s: slots) {
+                for (VkDescriptorPool pool: s.pools) vkDestroyDescriptorPool(device, pool, nullptr);
+            }
+            slots.clear();
+        }
+
+    private:
+        force_inline VkDescriptorPool createPool() const {
+            VkDescriptorPoolCreateInfo poolInfo {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                .pNext{},
+                .flags{}, // no FREE_DESCRIPTOR_SET_BIT: the pool only ever resets
+                .maxSets = setsPerPool,
+                .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+                .pPoolSizes = poolSizes.data()
+            };
+
+            VkDescriptorPool pool;
+            CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool), "failed to create frame descriptor pool!");
+            return pool;
+        }
+    };
+
+    inline FrameDescriptors frameDescriptors;
+
+    // One descriptor set holding every texture & storage buffer, bound once per command buffer: a draw picks its
+    // resources by index (a push constant or a field of its instance data), no per material set is ever bound.
+    // shaders declare it as
+    //
+    //     #extension GL_EXT_nonuniform_qualifier : require
+    //     layout(set = 0, binding = 0) uniform sampler2D textures[];
+    //     layout(set = 0, binding = 1) readonly buffer Buffers { uint data[]; } buffers[];
+    //
+    // and index with nonuniformEXT() when the index varies within a draw. the indirect scene's draws read their
+    // storage buffers from it (VK_INDIRECT.h, indirect_bindless.vert).
+    //
+    // built on VK_EXT_descriptor_indexing: the arrays are partially bound, only the slots in use hold a descriptor,
+    // and written with update after bind, so adding a resource never waits for the frames using the set. a released
+    // index is reused once every frame in flight that may still read it has completed.
+    struct BindlessTable {
+        enum Binding : uint32_t {
+            TEXTURES,
+            BUFFERS
+        };
+
+        static constexpr uint32_t maxTextures = 16384;
+        static constexpr uint32_t maxBuffers = 16384;
+
+        bool supported = false; // set by VK::init, with the extension & its features
+
+        VkDevice device = VK_NULL_HANDLE;
+        VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+        VkDescriptorSet set = VK_NULL_HANDLE;
+
+        array<uint32_t, 2> capacity {};
+
+        force_inline void create(VkDevice vkDevice, VkPhysicalDevice vkPhysicalDevice, uint32_t framesInFlight) {
+            if (!supported) {
+                info("bindless: VK_EXT_descriptor_indexing is not supported");
+                return;
+            }
+            device = vkDevice;
+
+            VkPhysicalDeviceDescriptorIndexingPropertiesEXT limits {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT
+            };
+            VkPhysicalDeviceProperties2KHR properties {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR,
+                .pNext = &limits
+            };
+            GetPhysicalDeviceProperties2KHR(vkPhysicalDevice, &properties);
+
+            capacity[TEXTURES] = std::min({maxTextures, limits.maxDescriptorSetUpdateAfterBindSampledImages,
+                                           limits.maxPerStageDescriptorUpdateAfterBindSampledImages});
+            capacity[BUFFERS] = std::min({maxBuffers, limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                                          limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+
+            constexpr VkDescriptorBindingFlagsEXT bindingFlags =
+                VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+            array<VkDescriptorBindingFlagsEXT, 2> flags = {bindingFlags, bindingFlags};
+            VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+                .pNext{},
+                .bindingCount = static_cast<uint32_t>(flags.size()),
+                .pBindingFlags = flags.data()
+            };
+
+            array<VkDescriptorSetLayoutBinding, 2> bindings = {{
+                {TEXTURES, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity[TEXTURES], VK_SHADER_STAGE_ALL, nullptr},
+                {BUFFERS, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, capacity[BUFFERS], VK_SHADER_STAGE_ALL, nullptr}
+            }};
+            VkDescriptorSetLayoutCreateInfo layoutInfo {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                .pNext = &flagsInfo,
+                .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+                .bindingCount = static_cast<uint32_t>(bindings.size()),
+                .pBindings = bindings.data()
+            };
+            CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout),
+                  "failed to create bindless descriptor set layout!");
+
+            array<VkDescriptorPoolSize, 2> poolSizes = {{
+                {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity[TEXTURES]},
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, capacity[BUFFERS]}
+            }};
+            VkDescriptorPoolCreateInfo poolInfo {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                .pNext{},
+                .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT,
+                .maxSets = 1,
+                .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+                .pPoolSizes = poolSizes.data()
+            };
+            CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool), "failed to create bindless pool!");
+
+            VkDescriptorSetAllocateInfo allocInfo {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .pNext{},
+                .descriptorPool = pool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &layout
+            };
+            CHECK(vkAllocateDescriptorSets(device, &allocInfo, &set), "failed to allocate bindless descriptor set!");
+
+            setFramesInFlight(framesInFlight);
+            info("bindless: {} textures, {} buffers", capacity[TEXTURES], capacity[BUFFERS]);
+        }
+
+        // the index shaders read the texture at.
+        [[nodiscard]] force_inline uint32_t addTexture(VkImageView view, VkSampler sampler,
+                                                       VkImageLayout imageLayout =
+                                                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+            uint32_t index = take(TEXTURES);
+            VkDescriptorImageInfo imageInfo {sampler, view, imageLayout};
+            write(TEXTURES, index, &imageInfo, nullptr);
+            return index;
+        }
+
+        [[nodiscard]] force_inline uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset = 0,
+                                                      VkDeviceSize range = VK_WHOLE_SIZE) {
+            uint32_t index = take(BUFFERS);
+            VkDescriptorBufferInfo bufferInfo {buffer, offset, range};
+            write(BUFFERS, index, nullptr, &bufferInfo);
+            return index;
+        }
+
+        // the index is free again once the frames in flight now have completed. the descriptor itself is left in
+        // place until it is overwritten: the arrays are partially bound, nothing reads it meanwhile.
+        force_inline void release(Binding binding, uint32_t index) {
+            released[slot].emplace_back(binding, index);
+        }
+
+        // called after the slot's fence wait, as FrameDescriptors::reset().
+        force_inline void beginFrame(uint32_t frameSlot) {
+            if (!supported) return;
+            slot = frameSlot;
+            for (auto [binding, index]: released[slot]) freed[binding].push_back(index);
+            released[slot].clear();
+        }
+
+        // the device must be idle.
+        force_inline void setFramesInFlight(uint32_t framesInFlight) {
+            for (auto& r: released) {
+                for (auto [binding, index]: r) freed[binding].push_back(index);
+            }
+            released.assign(framesInFlight, {});
+            slot = 0;
+        }
+
+        force_inline void bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout,
+                               uint32_t firstSet = 0) const {
+            bindDescriptorSets(cmd, bindPoint, pipelineLayout, firstSet, 1, &set);
+        }
+
+        [[nodiscard]] force_inline uint32_t used(Binding binding) const {
+            return next[binding] - static_cast<uint32_t>(freed[binding].size());
+        }
+
+        force_inline void destroy() {
+            if (!supported) return;
+            vkDestroyDescriptorPool(device, pool, nullptr);
+            vkDestroyDescriptorSetLayout(device, layout, nullptr);
+            released.clear();
+            for (auto& f: freed) f.clear();
+            next = {};
+        }
+
+    private:
+        vector<vector<std::pair<Binding, uint32_t>>> released; // per frames in flight slot
+        array<vector<uint32_t>, 2> freed;
+        array<uint32_t, 2> next {};
+        uint32_t slot = 0;
+
+        force_inline uint32_t take(Binding binding) {
+            if (!supported) throw std::runtime_error("bindless descriptors are not supported!");
+
+            if (!freed[binding].empty()) {
+                uint32_t index = freed[binding].back();
+                freed[binding].pop_back();
+                return index;
+            }
+            if (next[binding] == capacity[binding]) throw std::runtime_error("bindless table is full!");
+            return next[binding]++;
+        }
+
+        force_inline void write(Binding binding, uint32_t index, const VkDescriptorImageInfo* imageInfo,
+                                const VkDescriptorBufferInfo* bufferInfo) const {
+            VkWriteDescriptorSet write {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext{},
+                .dstSet = set,
+                .dstBinding = binding,
+                .dstArrayElement = index,
+                .descriptorCount = 1,
+                .descriptorType = binding == TEXTURES ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+                                                      : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pImageInfo = imageInfo,
+                .pBufferInfo = bufferInfo,
+                .pTexelBufferView{}
+            };
+            updateDescriptorSets(device, 1, &write);
+        }
+    };
+
+    inline BindlessTable bindless;
+}
@@ -23,3 +23,107 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
         func(instance, debugMessenger, pAllocator);
     }
 }
+
+VkResult CreateHeadlessSurfaceEXT(VkInstance instance, const VkHeadlessSurfaceCreateInfoEXT* pCreateInfo,
+                                  const VkAllocationCallbacks* pAllocator, VkSurfaceKHR* pSurface) {
+    auto func = (PFN_vkCreateHeadlessSurfaceEXT) vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT");
+    if (func != nullptr) {
+        return func(instance, pCreateInfo, pAllocator, pSurface);
+    } else {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+}
+
+// VK_EXT_debug_utils labels, instance level
+
+void CmdBeginDebugUtilsLabelEXT(VkCommandBuffer commandBuffer, const VkDebugUtilsLabelEXT* pLabelInfo) {
+    static auto func = (PFN_vkCmdBeginDebugUtilsLabelEXT) vkGetInstanceProcAddr(VK::instance,
+                                                                                "vkCmdBeginDebugUtilsLabelEXT");
+    if (func != nullptr) {
+        func(commandBuffer, pLabelInfo);
+    }
+}
+
+void CmdEndDebugUtilsLabelEXT(VkCommandBuffer commandBuffer) {
+    static auto func = (PFN_vkCmdEndDebugUtilsLabelEXT) vkGetInstanceProcAddr(VK::instance,
+                                                                              "vkCmdEndDebugUtilsLabelEXT");
+    if (func != nullptr) {
+        func(commandBuffer);
+    }
+}
+
+// VK_KHR_timeline_semaphore, device level
+
+VkResult GetSemaphoreCounterValueKHR(VkDevice device, VkSemaphore semaphore, uint64_t* pValue) {
+    static auto func = (PFN_vkGetSemaphoreCounterValueKHR) vkGetDeviceProcAddr(device,
+                                                                               "vkGetSemaphoreCounterValueKHR");
+    if (func != nullptr) {
+        return func(device, semaphore, pValue);
+    } else {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+}
+
+VkResult WaitSemaphoresKHR(VkDevice device, const VkSemaphoreWaitInfo* pWaitInfo, uint64_t timeout) {
+    static auto func = (PFN_vkWaitSemaphoresKHR) vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+    if (func != nullptr) {
+        return func(device, pWaitInfo, timeout);
+    } else {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+}
+
+// VK_KHR_draw_indirect_count, device level
+
+void CmdDrawIndexedIndirectCountKHR(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset,
+                                    VkBuffer countBuffer, VkDeviceSize countBufferOffset, uint32_t maxDrawCount,
+                                    uint32_t stride) {
+    static auto func = (PFN_vkCmdDrawIndexedIndirectCountKHR) vkGetDeviceProcAddr(VK::device,
+                                                                                 "vkCmdDrawIndexedIndirectCountKHR");
+    if (func != nullptr) {
+        func(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+    }
+}
+
+// VK_KHR_get_physical_device_properties2, instance level
+
+void GetPhysicalDeviceFeatures2KHR(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures2* pFeatures) {
+    auto func = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(VK::instance,
+                                                                            "vkGetPhysicalDeviceFeatures2KHR");
+    if (func != nullptr) {
+        func(physicalDevice, pFeatures);
+    }
+}
+
+void GetPhysicalDeviceProperties2KHR(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties2* pProperties) {
+    auto func = (PFN_vkGetPhysicalDeviceProperties2KHR) vkGetInstanceProcAddr(VK::instance,
+                                                                              "vkGetPhysicalDeviceProperties2KHR");
+    if (func != nullptr) {
+        func(physicalDevice, pProperties);
+    }
+}
+
+// VK_KHR_synchronization2, device level
+
+void CmdPipelineBarrier2KHR(VkCommandBuffer commandBuffer, const VkDependencyInfoKHR* pDependencyInfo) {
+    static auto func = (PFN_vkCmdPipelineBarrier2KHR) vkGetDeviceProcAddr(VK::device, "vkCmdPipelineBarrier2KHR");
+    if (func != nullptr) {
+        func(commandBuffer, pDependencyInfo);
+    }
+}
+
+// VK_KHR_dynamic_rendering, device level
+
+void CmdBeginRenderingKHR(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR* pRenderingInfo) {
+    static auto func = (PFN_vkCmdBeginRenderingKHR) vkGetDeviceProcAddr(VK::device, "vkCmdBeginRenderingKHR");
+    if (func != nullptr) {
+        func(commandBuffer, pRenderingInfo);
+    }
+}
+
+void CmdEndRenderingKHR(VkCommandBuffer commandBuffer) {
+    static auto func = (PFN_vkCmdEndRenderingKHR) vkGetDeviceProcAddr(VK::device, "vkCmdEndRenderingKHR");
+    if (func != nullptr) {
+        func(commandBuffer);
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "glfw_vulkan.h"
+#include "using_std.h"
+
+namespace VK {
+    // Everything the CPU needs to record and submit one frame. While the CPU records into slot i,
+    // the GPU may still be executing slots i-1 ... i-(N-1).
+    struct FrameSync {
+        VkCommandBuffer commandBuffer = nullptr;
+        VkFence inFlightFence = nullptr;
+        VkSemaphore imageAvailableSemaphore = nullptr;
+    };
+
+    struct FrameRing {
+        vector<FrameSync> slots;
+
+        // fence of the slot that last rendered into each swapchain image. the swapchain can hand us back an
+        // image that is still being rendered by another slot (more slots than images, or out of order acquire).
+        vector<VkFence> imagesInFlight;
+
+        // signaled by the submit rendering into each swapchain image, waited on by its present. per image, not per
+        // slot: a slot's fence only says its submit is done, not that the present engine let go of the semaphore.
+        // acquiring the image again does.
+        vector<VkSemaphore> renderFinished;
+
+        uint32_t current = 0;
+
+        force_inline void create(VkDevice vkDevice, VkCommandPool vkCommandPool, uint32_t framesInFlight,
+                                 uint32_t imageCount) {
+            slots.resize(framesInFlight);
+            imagesInFlight.assign(imageCount, VK_NULL_HANDLE);
+            createImageSemaphores(vkDevice, imageCount);
+            current = 0;
+
+            vector<VkCommandBuffer> commandBuffers(framesInFlight);
+            VkCommandBufferAllocateInfo allocInfo {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .pNext{},
+                .commandPool = vkCommandPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = framesInFlight
+            };
+            CHECK(vkAllocateCommandBuffers(vkDevice, &allocInfo, commandBuffers.data()),
+                  "failed to allocate frame command buffers!");
+
+            VkSemaphoreCreateInfo semaphoreInfo {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+            };
+
+            // signaled so the first wait on every slot returns immediately
+            VkFenceCreateInfo fenceInfo {
+                .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                .flags = VK_FENCE_CREATE_SIGNALED_BIT
+            };
+
+            for (uint32_t i = 0; i < framesInFlight; i++) {
+                FrameSync& s = slots[i];
+                s.commandBuffer = commandBuffers[i];
+
+                if (vkCreateSemaphore(vkDevice, &semaphoreInfo, nullptr, &s.imageAvailableSemaphore) != VK_SUCCESS ||
+                    vkCreateFence(vkDevice, &fenceInfo, nullptr, &s.inFlightFence) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create synchronization objects for a frame!");
+                }
+            }
+        }
+
+        force_inline void destroy(VkDevice vkDevice, VkCommandPool vkCommandPool) {
+            for (auto& s: slots) {
+                vkDestroyFence(vkDevice, s.inFlightFence, nullptr);
+                vkDestroySemaphore(vkDevice, s.imageAvailableSemaphore, nullptr);
+                vkFreeCommandBuffers(vkDevice, vkCommandPool, 1, &s.commandBuffer);
+            }
+            for (VkSemaphore s: renderFinished) vkDestroySemaphore(vkDevice, s, nullptr);
+
+            slots.clear();
+            imagesInFlight.clear();
+            renderFinished.clear();
+        }
+
+        // after a swapchain recreation. returns the previous images' semaphores: presents of the retired swapchain
+        // may still wait on them, they go with it.
+        [[nodiscard]] force_inline vector<VkSemaphore> recreateImages(VkDevice vkDevice, uint32_t imageCount) {
+            vector<VkSemaphore> retired = std::move(renderFinished);
+            imagesInFlight.assign(imageCount, VK_NULL_HANDLE);
+            createImageSemaphores(vkDevice, imageCount);
+            return retired;
+        }
+
+        [[nodiscard]] force_inline uint32_t size() const {
+            return static_cast<uint32_t>(slots.size());
+        }
+
+        force_inline FrameSync& slot() {
+            return slots[current];
+        }
+
+        force_inline void advance() {
+            current = (current + 1) % size();
+        }
+
+        // wait until no other slot is still rendering into imageIndex, then hand the image to the current slot.
+        force_inline void acquireImage(VkDevice vkDevice, uint32_t imageIndex) {
+            VkFence& owner = imagesInFlight[imageIndex];
+            if (owner != VK_NULL_HANDLE && owner != slot().inFlightFence) {
+                vkWaitForFences(vkDevice, 1, &owner, VK_TRUE, UINT64_MAX);
+            }
+            owner = slot().inFlightFence;
+        }
+
+    private:
+        force_inline void createImageSemaphores(VkDevice vkDevice, uint32_t imageCount) {
+            VkSemaphoreCreateInfo semaphoreInfo {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+            };
+            renderFinished.assign(imageCount, VK_NULL_HANDLE);
+            for (VkSemaphore& s: renderFinished) {
+                CHECK(vkCreateSemaphore(vkDevice, &semaphoreInfo, nullptr, &s),
+                      "failed to create a render finished semaphore!");
+            }
+        }
+    };
+
+    inline FrameRing frameRing;
+}
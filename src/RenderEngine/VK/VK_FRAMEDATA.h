@@ -0,0 +1,275 @@
+#pragma once
+
+#include "glfw_vulkan.h"
+#include "using_std.h"
+#include "logging.h"
+
+#include <algorithm>
+
+namespace VK {
+    // Per frame uniform & storage data, written by the CPU while recording and read by the GPU the same frame.
+    //
+    // one persistently mapped buffer, split in a region per frames in flight slot. every allocation is a bump of
+    // the region's head: no buffer is created, mapped or unmapped per draw, and the whole region is free again once
+    // the slot's fence has been waited on (begin()). the ring's descriptor set has two bindings:
+    //
+    //     layout(set = N, binding = 0) uniform FrameUniforms { ... };          // dynamic offset: Range::offset
+    //     layout(set = N, binding = 1) readonly buffer FrameData { uint data[]; }; // dynamic offset: frameBase()
+    //
+    // a uniform range is addressed by its dynamic offset, one bind per draw. storage data is addressed by a push
+    // constant instead: the set is bound once with the storage offset at the range's frame base, and each draw
+    // pushes the frameOffset of its range (in bytes, a multiple of 16). the default pipeline reads its per frame
+    // constants (default.vert) from set 0, bound with the vertex input (VK_RECORD.h).
+    //
+    // a frame that doesn't fit in its region grows the ring on the spot: the buffer is replaced by one with twice
+    // the region size, the old one lives on until the frames in flight that use it have completed. ranges carry the
+    // set of their buffer, it changes after a growth and must be bound again. allocate() is for the thread that
+    // records the frame's primary command buffer.
+    struct FrameDataRing {
+        enum Binding : uint32_t {
+            UNIFORM,
+            STORAGE
+        };
+
+        struct Range {
+            void* data = nullptr;  // mapped & coherent, written before the frame is submitted
+            VkDescriptorSet set = VK_NULL_HANDLE;
+            VkBuffer buffer = VK_NULL_HANDLE;
+            uint32_t offset = 0;      // from the start of the buffer, the dynamic offset of a uniform range
+            uint32_t frameOffset = 0; // from frameBase(), pushed for a storage range
+            uint32_t size = 0;
+        };
+
+        VkDeviceSize regionSize = 1024 * 1024; // per slot, doubled on overflow
+
+        VkDevice device = VK_NULL_HANDLE;
+        VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+
+        VkDeviceSize uniformAlignment = 256;
+        VkDeviceSize storageAlignment = 16;
+        uint32_t uniformRange = 0; // bytes one dynamic uniform binding sees
+        VkDeviceSize maxRegionSize = 0;
+
+        struct Stats {
+            uint64_t allocations = 0;
+            uint64_t bytes = 0;
+            VkDeviceSize peak = 0; // bytes used by one frame, at most
+            uint32_t grows = 0;
+        } stats;
+
+        force_inline void create(VkDevice vkDevice, VkPhysicalDevice vkPhysicalDevice, uint32_t framesInFlight) {
+            device = vkDevice;
+
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(vkPhysicalDevice, &properties);
+            uniformAlignment = properties.limits.minUniformBufferOffsetAlignment;
+            storageAlignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 16);
+            uniformRange = std::min(properties.limits.maxUniformBufferRange, 64u * 1024);
+            maxRegionSize = properties.limits.maxStorageBufferRange;
+
+            array<VkDescriptorSetLayoutBinding, 2> bindings = {{
+                {UNIFORM, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_ALL, nullptr},
+                {STORAGE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_ALL, nullptr}
+            }};
+            VkDescriptorSetLayoutCreateInfo layoutInfo {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                .pNext{},
+                .flags{},
+                .bindingCount = static_cast<uint32_t>(bindings.size()),
+                .pBindings = bindings.data()
+            };
+            CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout),
+                  "failed to create frame data descriptor set layout!");
+
+            slotCount = framesInFlight;
+            slot = 0;
+            head = 0;
+            createBuffer();
+            newSet();
+        }
+
+        // called after the slot's fence wait, once FrameDescriptors::reset() ran: the region is free again.
+        force_inline void begin(uint32_t frameSlot) {
+            stats.peak = std::max(stats.peak, head);
+            slot = frameSlot;
+            head = 0;
+
+            for (auto it = retired.begin(); it != retired.end();) {
+                if (--it->framesLeft == 0) {
+                    allocator.destroyBuffer(it->buffer, it->allocation);
+                    it = retired.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            newSet();
+        }
+
+        [[nodiscard]] force_inline Range allocate(VkDeviceSize size, Binding binding = UNIFORM) {
+            if (binding == UNIFORM && size > uniformRange) {
+                throw std::runtime_error("frame uniform data larger than a uniform binding!");
+            }
+
+            VkDeviceSize alignment = binding == UNIFORM ? uniformAlignment : storageAlignment;
+            VkDeviceSize start = (head + alignment - 1) / alignment * alignment;
+            if (start + size > regionSize) {
+                grow(size);
+                start = 0;
+            }
+            head = start + size;
+
+            stats.allocations++;
+            stats.bytes += size;
+
+            VkDeviceSize offset = frameBase() + start;
+            return Range {
+                .data = static_cast<char*>(allocation.mapped) + offset,
+                .set = set,
+                .buffer = buffer,
+                .offset = static_cast<uint32_t>(offset),
+                .frameOffset = static_cast<uint32_t>(start),
+                .size = static_cast<uint32_t>(size)
+            };
+        }
+
+        // copies value into a new range.
+        template<typename T>
+        [[nodiscard]] force_inline Range push(const T& value, Binding binding = UNIFORM) {
+            Range range = allocate(sizeof(T), binding);
+            memcpy(range.data, &value, sizeof(T));
+            return range;
+        }
+
+        [[nodiscard]] force_inline uint32_t frameBase() const {
+            return static_cast<uint32_t>(slot * regionSize);
+        }
+
+        // the range's set, its uniform binding at the range and its storage binding at the range's frame base: the
+        // base of the buffer the range was allocated from, a growth since doesn't move it. any recording thread.
+        static force_inline void bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint,
+                                      VkPipelineLayout pipelineLayout, uint32_t firstSet, const Range& range) {
+            array<uint32_t, 2> offsets = {range.offset, range.offset - range.frameOffset};
+            bindDescriptorSets(cmd, bindPoint, pipelineLayout, firstSet, 1, &range.set,
+                               static_cast<uint32_t>(offsets.size()), offsets.data());
+        }
+
+        // the device must be idle: every region is free. called once FrameDescriptors was created again.
+        force_inline void setFramesInFlight(uint32_t framesInFlight) {
+            for (auto& r: retired) allocator.destroyBuffer(r.buffer, r.allocation);
+            retired.clear();
+            allocator.destroyBuffer(buffer, allocation);
+
+            slotCount = framesInFlight;
+            slot = 0;
+            head = 0;
+            createBuffer();
+            newSet();
+        }
+
+        // buffers replaced by a growth that frames in flight may still read.
+        [[nodiscard]] force_inline uint32_t retiredBuffers() const {
+            return static_cast<uint32_t>(retired.size());
+        }
+
+        force_inline void printStats() const {
+            info("frame data: {} allocations, {:.1f} MiB, {:.1f} KiB per frame at most, {} KiB regions after {} grows",
+                 stats.allocations, stats.bytes / (1024.0 * 1024.0), std::max(stats.peak, head) / 1024.0,
+                 regionSize / 1024, stats.grows);
+        }
+
+        force_inline void destroy() {
+            for (auto& r: retired) allocator.destroyBuffer(r.buffer, r.allocation);
+            retired.clear();
+            allocator.destroyBuffer(buffer, allocation);
+            vkDestroyDescriptorSetLayout(device, layout, nullptr);
+        }
+
+    private:
+        struct Retired {
+            VkBuffer buffer;
+            Allocation allocation;
+            uint32_t framesLeft; // begin() calls until every slot that used it has been waited on
+        };
+
+        VkBuffer buffer = VK_NULL_HANDLE;
+        Allocation allocation {};
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        vector<Retired> retired;
+
+        uint32_t slotCount = 0;
+        uint32_t slot = 0;
+        VkDeviceSize head = 0; // bytes used in the current slot's region
+
+        force_inline void createBuffer() {
+            // the tail leaves room for a whole uniform binding after the last range of the last region.
+            VkBufferCreateInfo bufferInfo {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                .pNext{},
+                .flags{},
+                .size = slotCount * regionSize + uniformRange,
+                .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .queueFamilyIndexCount{},
+                .pQueueFamilyIndices{}
+            };
+            // device local too when the device has such a host visible type, written straight over the bus.
+            buffer = allocator.createBuffer(bufferInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, allocation,
+                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+
+        // a new buffer for the frame's remaining ranges, the current one retired.
+        force_inline void grow(VkDeviceSize size) {
+            VkDeviceSize grown = regionSize;
+            while (grown < std::max(head, size) * 2) grown *= 2;
+            grown = std::max(grown, regionSize * 2);
+            if (grown > maxRegionSize) throw std::runtime_error("frame data ring exceeds maxStorageBufferRange!");
+            // offsets are 32 bit, dynamic ones & frameBase() alike: the whole buffer must stay addressable.
+            if (slotCount * grown + uniformRange > UINT32_MAX)
+                throw std::runtime_error("frame data ring exceeds 32 bit offsets!");
+            spdlog::warn("frame data ring overflow: {} KiB per frame, growing to {} KiB", regionSize / 1024,
+                         grown / 1024);
+
+            retired.push_back(Retired {buffer, allocation, slotCount});
+            stats.peak = std::max(stats.peak, head);
+            stats.grows++;
+
+            regionSize = grown;
+            createBuffer();
+            newSet();
+        }
+
+        // a set of the current slot for the current buffer, ranges can be allocated before the first begin() too.
+        force_inline void newSet() {
+            set = frameDescriptors.allocate(layout);
+            writeSet();
+        }
+
+        force_inline void writeSet() {
+            array<VkDescriptorBufferInfo, 2> bufferInfos = {{
+                {buffer, 0, uniformRange},
+                {buffer, 0, regionSize}
+            }};
+            array<VkWriteDescriptorSet, 2> writes {};
+            for (uint32_t i = 0; i < writes.size(); i++) {
+                writes[i] = VkWriteDescriptorSet {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .pNext{},
+                    .dstSet = set,
+                    .dstBinding = i,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = i == UNIFORM ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+                                                   : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                    .pImageInfo{},
+                    .pBufferInfo = &bufferInfos[i],
+                    .pTexelBufferView{}
+                };
+            }
+            updateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data());
+        }
+    };
+
+    inline FrameDataRing frameData;
+}
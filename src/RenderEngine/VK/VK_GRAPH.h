@@ -0,0 +1,795 @@
+#pragma once
+
+#include "glfw_vulkan.h"
+#include "using_std.h"
+#include "logging.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace VK {
+    // Frame graph: passes declare the images & buffers they read and write, compile() works out the rest.
+    //
+    // - passes run in the order they were added. those whose results nothing reads are culled, unless they have
+    //   side effects or write an output.
+    // - every pass is preceded by at most one batch of barriers, synchronization2 when the device has it: for a
+    //   read after a write, a write after a read or write, and a layout change. a read after a read in the same
+    //   layout needs none.
+    // - transient resources live from the first to the last pass that uses them, and are placed in a few memory
+    //   heaps: two whose lifetimes don't overlap may share memory. the first use of a transient discards what was
+    //   there (UNDEFINED), after the other resources of its memory, this frame's & the previous one's, are done.
+    //
+    // a graph is declared & compiled once and executed every frame, rebuilt when what it renders changes (a
+    // resize). imported resources, such as the swapchain image, are swapped with setImage() between executions.
+    // a pass that writes part of a resource another pass wrote before it reads it too.
+    class RenderGraph {
+    public:
+        using Resource = uint32_t;
+        static constexpr Resource none = UINT32_MAX;
+
+        enum class Type : uint32_t {
+            GRAPHICS, // shader accesses from the vertex & fragment stages
+            COMPUTE,
+            TRANSFER
+        };
+
+        enum Usage : uint32_t {
+            COLOR_ATTACHMENT,
+            DEPTH_ATTACHMENT,
+            DEPTH_READ, // depth test without writes
+            SAMPLED,
+            STORAGE_READ,
+            STORAGE_WRITE,
+            TRANSFER_SRC,
+            TRANSFER_DST,
+            INDIRECT_READ
+        };
+
+        using Execute = std::function<void(VkCommandBuffer, const RenderGraph&)>;
+
+        // VK_KHR_synchronization2, enabled on the device by VK::init when available. pipeline barriers otherwise.
+        static inline bool synchronization2 = false;
+
+        struct Stats {
+            uint32_t passes = 0;
+            uint32_t culled = 0;
+            uint32_t barriers = 0; // image & buffer barriers, per execution
+            uint32_t batches = 0;  // barrier commands, per execution
+            VkDeviceSize transientBytes = 0; // every transient in its own memory
+            VkDeviceSize heapBytes = 0;      // aliased
+            uint32_t heaps = 0;
+        };
+
+        struct PassBuilder {
+            RenderGraph& graph;
+            uint32_t pass;
+
+            force_inline PassBuilder& read(Resource resource, Usage usage) {
+                graph.access(pass, resource, usage, false);
+                return *this;
+            }
+
+            force_inline PassBuilder& write(Resource resource, Usage usage) {
+                graph.access(pass, resource, usage, true);
+                return *this;
+            }
+
+            // never culled, e.g. writes something outside the graph.
+            force_inline PassBuilder& sideEffects() {
+                graph.passes[pass].sideEffects = true;
+                return *this;
+            }
+        };
+
+        RenderGraph() = default;
+        RenderGraph(const RenderGraph&) = delete;
+        RenderGraph& operator=(const RenderGraph&) = delete;
+
+        ~RenderGraph() {
+            destroy();
+        }
+
+        // names are kept as given, string literals: they name the gpu profiler scopes.
+        force_inline Resource createImage(const char* name, VkFormat format, VkExtent2D extent) {
+            Node& n = addNode(name, true);
+            n.format = format;
+            n.extent = extent;
+            n.aspect = aspectOf(format);
+            return static_cast<Resource>(nodes.size() - 1);
+        }
+
+        force_inline Resource createBuffer(const char* name, VkDeviceSize size) {
+            Node& n = addNode(name, false);
+            n.size = size;
+            return static_cast<Resource>(nodes.size() - 1);
+        }
+
+        // an image the graph doesn't own: it is in initialLayout when the graph starts, left in finalLayout (unless
+        // UNDEFINED) when it ends. imported resources are outputs.
+        force_inline Resource importImage(const char* name, VkImage image, VkImageView view, VkFormat format,
+                                          VkExtent2D extent, VkImageLayout initialLayout, VkImageLayout finalLayout) {
+            Node& n = addNode(name, true);
+            n.imported = true;
+            n.output = true;
+            n.image = image;
+            n.view = view;
+            n.format = format;
+            n.extent = extent;
+            n.aspect = aspectOf(format);
+            n.initialLayout = initialLayout;
+            n.finalLayout = finalLayout;
+            return static_cast<Resource>(nodes.size() - 1);
+        }
+
+        force_inline Resource importBuffer(const char* name, VkBuffer buffer, VkDeviceSize size) {
+            Node& n = addNode(name, false);
+            n.imported = true;
+            n.output = true;
+            n.buffer = buffer;
+            n.size = size;
+            return static_cast<Resource>(nodes.size() - 1);
+        }
+
+        // a transient read after the graph, e.g. by a readback: kept alive until the end, never culled.
+        force_inline void output(Resource resource) {
+            nodes[resource].output = true;
+        }
+
+        force_inline PassBuilder addPass(const char* name, Type type, Execute execute) {
+            passes.push_back(Pass {name, type, std::move(execute)});
+            return PassBuilder {*this, static_cast<uint32_t>(passes.size() - 1)};
+        }
+
+        // culls passes, creates & places the transients, and computes every barrier.
+        force_inline void compile(VkDevice vkDevice) {
+            if (compiled) throw std::runtime_error("render graph compiled twice!");
+            device = vkDevice;
+            cull();
+            createTransients();
+            placeTransients();
+            computeBarriers();
+            compiled = true;
+        }
+
+        force_inline void execute(VkCommandBuffer cmd) {
+            V3RSE_ASSERT(compiled, "render graph executed before compile()!");
+
+            for (uint32_t i: order) {
+                Pass& p = passes[i];
+                barrier(cmd, p.barriers);
+                gpuProfiler.begin(cmd, p.name);
+                p.execute(cmd, *this);
+                gpuProfiler.end(cmd);
+            }
+            barrier(cmd, finalBarriers);
+        }
+
+        // the image of an imported resource, for the next executions.
+        force_inline void setImage(Resource resource, VkImage image, VkImageView view) {
+            nodes[resource].image = image;
+            nodes[resource].view = view;
+        }
+
+        [[nodiscard]] force_inline VkImage image(Resource resource) const { return nodes[resource].image; }
+        [[nodiscard]] force_inline VkImageView view(Resource resource) const { return nodes[resource].view; }
+        [[nodiscard]] force_inline VkBuffer buffer(Resource resource) const { return nodes[resource].buffer; }
+        [[nodiscard]] force_inline VkExtent2D extent(Resource resource) const { return nodes[resource].extent; }
+        [[nodiscard]] force_inline VkFormat format(Resource resource) const { return nodes[resource].format; }
+        [[nodiscard]] force_inline bool culled(uint32_t pass) const { return passes[pass].culled; }
+        [[nodiscard]] force_inline const Stats& stats() const { return graphStats; }
+
+        force_inline void print() const {
+            const Stats& s = graphStats;
+            info("render graph: {} passes ({} culled), {} barriers in {} batches, transients {:.1f} MiB aliased into "
+                 "{:.1f} MiB in {} heaps ({:.1f} MiB saved)", s.passes, s.culled, s.barriers, s.batches,
+                 s.transientBytes / (1024.0 * 1024.0), s.heapBytes / (1024.0 * 1024.0), s.heaps,
+                 (s.transientBytes - s.heapBytes) / (1024.0 * 1024.0));
+        }
+
+        // destroys the transients and forgets every pass & resource.
+        force_inline void destroy() {
+            for (Node& n: nodes) {
+                if (n.imported) continue;
+                if (n.view) vkDestroyImageView(device, n.view, nullptr);
+                if (n.image) vkDestroyImage(device, n.image, nullptr);
+                if (n.buffer) vkDestroyBuffer(device, n.buffer, nullptr);
+            }
+            for (Heap& h: heaps) allocator.free(h.allocation);
+
+            nodes.clear();
+            passes.clear();
+            order.clear();
+            heaps.clear();
+            finalBarriers.clear();
+            graphStats = {};
+            compiled = false;
+        }
+
+    private:
+        struct Barrier {
+            Resource resource;
+            VkPipelineStageFlags2KHR srcStages;
+            VkAccessFlags2KHR srcAccess;
+            VkPipelineStageFlags2KHR dstStages;
+            VkAccessFlags2KHR dstAccess;
+            VkImageLayout oldLayout;
+            VkImageLayout newLayout;
+        };
+
+        struct Access {
+            Resource resource;
+            VkPipelineStageFlags2KHR stages;
+            VkAccessFlags2KHR access;
+            VkImageLayout layout;
+            bool reads;
+            bool writes;
+            VkImageUsageFlags imageUsage;
+            VkBufferUsageFlags bufferUsage;
+        };
+
+        struct Pass {
+            const char* name;
+            Type type;
+            Execute execute;
+            vector<Access> accesses;
+            bool sideEffects = false;
+            bool culled = false;
+            vector<Barrier> barriers;
+        };
+
+        struct Node {
+            const char* name;
+            bool isImage;
+            bool imported = false;
+            bool output = false;
+
+            VkFormat format = VK_FORMAT_UNDEFINED;
+            VkExtent2D extent {};
+            VkImageAspectFlags aspect = 0;
+            VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkDeviceSize size = 0;
+
+            VkImageUsageFlags imageUsage = 0;
+            VkBufferUsageFlags bufferUsage = 0;
+
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            VkBuffer buffer = VK_NULL_HANDLE;
+
+            // live passes, in execution order, the transient is in use: [first, last].
+            uint32_t first = UINT32_MAX;
+            uint32_t last = 0;
+
+            VkMemoryRequirements requirements {};
+            uint32_t heap = UINT32_MAX;
+            VkDeviceSize offset = 0;
+        };
+
+        struct Heap {
+            uint32_t memoryTypeBits;
+            bool images;
+            VkDeviceSize size = 0;
+            VkDeviceSize alignment = 1;
+            Allocation allocation {};
+        };
+
+        VkDevice device = VK_NULL_HANDLE;
+        vector<Node> nodes;
+        vector<Pass> passes;
+        vector<uint32_t> order; // the passes left after culling
+        vector<Heap> heaps;
+        vector<Barrier> finalBarriers;
+        Stats graphStats;
+        bool compiled = false;
+
+        force_inline Node& addNode(const char* name, bool isImage) {
+            if (compiled) throw std::runtime_error("render graph changed after compile()!");
+            nodes.push_back(Node {name, isImage});
+            return nodes.back();
+        }
+
+        static force_inline VkImageAspectFlags aspectOf(VkFormat format) {
+            switch (format) {
+                case VK_FORMAT_D16_UNORM:
+                case VK_FORMAT_X8_D24_UNORM_PACK32:
+                case VK_FORMAT_D32_SFLOAT:
+                    return VK_IMAGE_ASPECT_DEPTH_BIT;
+                case VK_FORMAT_D16_UNORM_S8_UINT:
+                case VK_FORMAT_D24_UNORM_S8_UINT:
+                case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                    return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+                default:
+                    return VK_IMAGE_ASPECT_COLOR_BIT;
+            }
+        }
+
+        // only flags with a synchronization 1 equivalent of the same value: the fallback path casts them down.
+        static force_inline Access accessOf(Resource resource, Usage usage, Type type) {
+            VkPipelineStageFlags2KHR shaders = type == Type::COMPUTE ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR
+                                                                     : VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR |
+                                                                       VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR;
+            constexpr VkPipelineStageFlags2KHR depthTests = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR |
+                                                            VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR;
+            switch (usage) {
+                case COLOR_ATTACHMENT:
+                    return {resource, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+                            VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR,
+                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, false, false, 0, 0};
+                case DEPTH_ATTACHMENT:
+                    return {resource, depthTests, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR |
+                                                  VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, false, false, 0, 0};
+                case DEPTH_READ:
+                    return {resource, depthTests, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false, false, 0, 0};
+                case SAMPLED:
+                    return {resource, shaders, VK_ACCESS_2_SHADER_READ_BIT_KHR,
+                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, false, 0, 0};
+                case STORAGE_READ:
+                    return {resource, shaders, VK_ACCESS_2_SHADER_READ_BIT_KHR, VK_IMAGE_LAYOUT_GENERAL, false, false,
+                            0, 0};
+                case STORAGE_WRITE:
+                    return {resource, shaders, VK_ACCESS_2_SHADER_READ_BIT_KHR | VK_ACCESS_2_SHADER_WRITE_BIT_KHR,
+                            VK_IMAGE_LAYOUT_GENERAL, false, false, 0, 0};
+                case TRANSFER_SRC:
+                    return {resource, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR,
+                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false, false, 0, 0};
+                case TRANSFER_DST:
+                    return {resource, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, false, false, 0, 0};
+                case INDIRECT_READ:
+                    return {resource, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR,
+                            VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR, VK_IMAGE_LAYOUT_UNDEFINED, false, false, 0, 0};
+            }
+            throw std::runtime_error("unknown render graph usage!");
+        }
+
+        static force_inline void addUsage(Access& a, Usage usage) {
+            switch (usage) {
+                case COLOR_ATTACHMENT:
+                    a.imageUsage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+                    break;
+                case DEPTH_ATTACHMENT:
+                case DEPTH_READ:
+                    a.imageUsage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+                    break;
+                case SAMPLED:
+                    a.imageUsage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+                    break;
+                case STORAGE_READ:
+                case STORAGE_WRITE:
+                    a.imageUsage |= VK_IMAGE_USAGE_STORAGE_BIT;
+                    a.bufferUsage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+                    break;
+                case TRANSFER_SRC:
+                    a.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+                    a.bufferUsage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+                    break;
+                case TRANSFER_DST:
+                    a.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+                    a.bufferUsage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+                    break;
+                case INDIRECT_READ:
+                    a.bufferUsage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+                    break;
+            }
+        }
+
+        // a pass using a resource twice (read & write) uses it once, with both accesses.
+        force_inline void access(uint32_t pass, Resource resource, Usage usage, bool write) {
+            if (compiled) throw std::runtime_error("render graph changed after compile()!");
+            Node& n = nodes[resource];
+            if (!n.isImage && (usage == COLOR_ATTACHMENT || usage == DEPTH_ATTACHMENT || usage == DEPTH_READ ||
+                               usage == SAMPLED)) {
+                throw std::runtime_error("render graph buffer used as an image!");
+            }
+            if (n.isImage && usage == INDIRECT_READ) throw std::runtime_error("render graph image used as a buffer!");
+
+            Pass& p = passes[pass];
+            Access a = accessOf(resource, usage, p.type);
+            if (!n.isImage) a.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            a.reads = !write;
+            a.writes = write;
+            addUsage(a, usage);
+
+            for (Access& existing: p.accesses) {
+                if (existing.resource != resource) continue;
+                if (n.isImage && existing.layout != a.layout) {
+                    throw std::runtime_error("render graph pass uses an image in two layouts!");
+                }
+                existing.stages |= a.stages;
+                existing.access |= a.access;
+                existing.reads |= a.reads;
+                existing.writes |= a.writes;
+                existing.imageUsage |= a.imageUsage;
+                existing.bufferUsage |= a.bufferUsage;
+                return;
+            }
+            p.accesses.push_back(a);
+        }
+
+        // backwards from the outputs: a pass is kept when it has side effects or writes a resource a kept pass
+        // reads. a resource written without being read is defined there, earlier writers of it aren't needed.
+        force_inline void cull() {
+            vector<bool> needed(nodes.size());
+            for (Resource r = 0; r < nodes.size(); r++) needed[r] = nodes[r].output;
+
+            for (uint32_t i = static_cast<uint32_t>(passes.size()); i-- > 0;) {
+                Pass& p = passes[i];
+                bool keep = p.sideEffects;
+                for (const Access& a: p.accesses) keep |= a.writes && needed[a.resource];
+                p.culled = !keep;
+                if (!keep) continue;
+
+                for (const Access& a: p.accesses) {
+                    if (a.writes && !a.reads && !nodes[a.resource].output) needed[a.resource] = false;
+                }
+                for (const Access& a: p.accesses) {
+                    if (a.reads) needed[a.resource] = true;
+                }
+            }
+
+            order.clear();
+            for (uint32_t i = 0; i < passes.size(); i++) {
+                if (!passes[i].culled) order.push_back(i);
+            }
+            graphStats.passes = static_cast<uint32_t>(passes.size());
+            graphStats.culled = static_cast<uint32_t>(passes.size() - order.size());
+        }
+
+        force_inline void createTransients() {
+            for (uint32_t k = 0; k < order.size(); k++) {
+                for (const Access& a: passes[order[k]].accesses) {
+                    Node& n = nodes[a.resource];
+                    n.first = std::min(n.first, k);
+                    n.last = std::max(n.last, k);
+                }
+            }
+
+            // usages come from the kept passes only.
+            for (uint32_t i: order) {
+                for (const Access& a: passes[i].accesses) {
+                    nodes[a.resource].imageUsage |= a.imageUsage;
+                    nodes[a.resource].bufferUsage |= a.bufferUsage;
+                }
+            }
+
+            for (Node& n: nodes) {
+                if (n.imported || n.first == UINT32_MAX) continue;
+                if (n.output) n.last = static_cast<uint32_t>(order.size());
+
+                if (n.isImage) {
+                    VkImageCreateInfo imageInfo {
+                        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                        .pNext{},
+                        .flags{},
+                        .imageType = VK_IMAGE_TYPE_2D,
+                        .format = n.format,
+                        .extent = {n.extent.width, n.extent.height, 1},
+                        .mipLevels = 1,
+                        .arrayLayers = 1,
+                        .samples = VK_SAMPLE_COUNT_1_BIT,
+                        .tiling = VK_IMAGE_TILING_OPTIMAL,
+                        .usage = n.imageUsage,
+                        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                        .queueFamilyIndexCount{},
+                        .pQueueFamilyIndices{},
+                        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+                    };
+                    CHECK(vkCreateImage(device, &imageInfo, nullptr, &n.image), "failed to create graph image!");
+                    vkGetImageMemoryRequirements(device, n.image, &n.requirements);
+                } else {
+                    VkBufferCreateInfo bufferInfo {
+                        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                        .pNext{},
+                        .flags{},
+                        .size = n.size,
+                        .usage = n.bufferUsage,
+                        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                        .queueFamilyIndexCount{},
+                        .pQueueFamilyIndices{}
+                    };
+                    CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &n.buffer), "failed to create graph buffer!");
+                    vkGetBufferMemoryRequirements(device, n.buffer, &n.requirements);
+                }
+            }
+        }
+
+        // largest first, each at the lowest offset of a heap of its memory types where no transient whose lifetime
+        // overlaps its own lies.
+        force_inline void placeTransients() {
+            vector<Resource> transients;
+            for (Resource r = 0; r < nodes.size(); r++) {
+                if (!nodes[r].imported && (nodes[r].image || nodes[r].buffer)) transients.push_back(r);
+            }
+            std::sort(transients.begin(), transients.end(), [&](Resource a, Resource b) {
+                return nodes[a].requirements.size > nodes[b].requirements.size;
+            });
+
+            for (Resource r: transients) {
+                Node& n = nodes[r];
+                graphStats.transientBytes += n.requirements.size;
+
+                // images and buffers never share a heap, bufferImageGranularity can't be violated.
+                uint32_t h = 0;
+                while (h < heaps.size() && (heaps[h].memoryTypeBits != n.requirements.memoryTypeBits ||
+                                            heaps[h].images != n.isImage)) {
+                    h++;
+                }
+                if (h == heaps.size()) heaps.push_back(Heap {n.requirements.memoryTypeBits, n.isImage});
+
+                vector<std::pair<VkDeviceSize, VkDeviceSize>> taken;
+                for (Resource o: transients) {
+                    const Node& other = nodes[o];
+                    if (other.heap != h || other.last < n.first || n.last < other.first) continue;
+                    taken.emplace_back(other.offset, other.offset + other.requirements.size);
+                }
+                std::sort(taken.begin(), taken.end());
+
+                VkDeviceSize alignment = n.requirements.alignment;
+                VkDeviceSize offset = 0;
+                for (auto [begin, end]: taken) {
+                    if (offset + n.requirements.size <= begin) break;
+                    offset = std::max(offset, (end + alignment - 1) / alignment * alignment);
+                }
+
+                n.heap = h;
+                n.offset = offset;
+                heaps[h].size = std::max(heaps[h].size, offset + n.requirements.size);
+                heaps[h].alignment = std::max(heaps[h].alignment, alignment);
+            }
+
+            for (Heap& heap: heaps) {
+                VkMemoryRequirements requirements {heap.size, heap.alignment, heap.memoryTypeBits};
+                heap.allocation = allocator.allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                                                     heap.images ? Allocator::OPTIMAL : Allocator::LINEAR);
+                graphStats.heapBytes += heap.size;
+            }
+            graphStats.heaps = static_cast<uint32_t>(heaps.size());
+
+            for (Resource r: transients) {
+                Node& n = nodes[r];
+                const Allocation& allocation = heaps[n.heap].allocation;
+                if (n.isImage) {
+                    vkBindImageMemory(device, n.image, allocation.memory, allocation.offset + n.offset);
+                    n.view = createView(n);
+                } else {
+                    vkBindBufferMemory(device, n.buffer, allocation.memory, allocation.offset + n.offset);
+                }
+            }
+        }
+
+        [[nodiscard]] force_inline VkImageView createView(const Node& n) const {
+            VkImageViewCreateInfo viewInfo {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .pNext{},
+                .flags{},
+                .image = n.image,
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .format = n.format,
+                .components{},
+                .subresourceRange = {n.aspect, 0, 1, 0, 1}
+            };
+            VkImageView view;
+            CHECK(vkCreateImageView(device, &viewInfo, nullptr, &view), "failed to create graph image view!");
+            return view;
+        }
+
+        // walks the kept passes with the last access of every resource: stages that wrote it (and what they wrote),
+        // stages that read it since, and its layout.
+        force_inline void computeBarriers() {
+            struct State {
+                VkPipelineStageFlags2KHR writeStages = 0;
+                VkAccessFlags2KHR writeAccess = 0;
+                VkPipelineStageFlags2KHR readStages = 0;
+                VkAccessFlags2KHR visible = 0; // accesses the last write was made visible to
+                VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            };
+            vector<State> states(nodes.size());
+
+            // what each transient's memory last saw, this frame or the previous one: every access of every
+            // transient sharing some of it.
+            vector<VkPipelineStageFlags2KHR> lastStages(nodes.size(), 0);
+            vector<VkAccessFlags2KHR> lastWrites(nodes.size(), 0);
+            for (uint32_t i: order) {
+                for (const Access& a: passes[i].accesses) {
+                    lastStages[a.resource] |= a.stages;
+                    if (a.writes) lastWrites[a.resource] |= a.access;
+                }
+            }
+
+            for (Resource r = 0; r < nodes.size(); r++) {
+                Node& n = nodes[r];
+                State& s = states[r];
+                if (n.imported) {
+                    s.writeStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+                    s.writeAccess = VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+                    s.layout = n.initialLayout;
+                    continue;
+                }
+                if (n.heap == UINT32_MAX) continue;
+                for (Resource o = 0; o < nodes.size(); o++) {
+                    const Node& other = nodes[o];
+                    if (other.imported || other.heap != n.heap) continue;
+                    if (other.offset >= n.offset + n.requirements.size ||
+                        n.offset >= other.offset + other.requirements.size) {
+                        continue;
+                    }
+                    s.writeStages |= lastStages[o];
+                    s.writeAccess |= lastWrites[o];
+                }
+            }
+
+            // a read's barrier covers every read of the resource after it, up to the next write or layout change:
+            // one barrier for all the readers of a result.
+            auto laterReads = [&](uint32_t k, const Access& a, Barrier& b) {
+                for (uint32_t next = k + 1; next < order.size(); next++) {
+                    for (const Access& later: passes[order[next]].accesses) {
+                        if (later.resource != a.resource) continue;
+                        if (later.writes || later.layout != a.layout) return;
+                        b.dstStages |= later.stages;
+                        b.dstAccess |= later.access;
+                    }
+                }
+            };
+
+            graphStats.barriers = 0;
+            graphStats.batches = 0;
+            for (uint32_t k = 0; k < order.size(); k++) {
+                Pass& p = passes[order[k]];
+                p.barriers.clear();
+
+                for (const Access& a: p.accesses) {
+                    bool isImage = nodes[a.resource].isImage;
+                    State& s = states[a.resource];
+                    bool transition = isImage && s.layout != a.layout;
+
+                    Barrier b {a.resource, s.writeStages, s.writeAccess, a.stages, a.access, s.layout, a.layout};
+                    if (a.writes) {
+                        // write after write or read: wait for both, make the writes available.
+                        b.srcStages |= s.readStages;
+                        if (b.srcStages || transition) p.barriers.push_back(b);
+
+                        s.writeStages = a.stages;
+                        s.writeAccess = a.access;
+                        s.readStages = 0;
+                        s.visible = 0;
+                    } else {
+                        bool covered = (s.readStages & a.stages) == a.stages && (s.visible & a.access) == a.access;
+                        if (transition || (s.writeStages && !covered)) {
+                            if (transition) {
+                                b.srcStages |= s.readStages; // the transition writes: after the other reads too
+                                s.readStages = 0;
+                                s.visible = 0;
+                            }
+                            laterReads(k, a, b);
+                            p.barriers.push_back(b);
+                            s.readStages |= b.dstStages;
+                            s.visible |= b.dstAccess;
+                        } else {
+                            s.readStages |= a.stages;
+                        }
+                    }
+                    s.layout = isImage ? a.layout : s.layout;
+                }
+
+                graphStats.barriers += static_cast<uint32_t>(p.barriers.size());
+                graphStats.batches += p.barriers.empty() ? 0 : 1;
+            }
+
+            finalBarriers.clear();
+            for (Resource r = 0; r < nodes.size(); r++) {
+                const Node& n = nodes[r];
+                const State& s = states[r];
+                if (!n.imported || !n.isImage || n.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+                    n.finalLayout == s.layout) {
+                    continue;
+                }
+                finalBarriers.push_back(Barrier {r, s.writeStages | s.readStages, s.writeAccess,
+                                                 VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT_KHR, 0, s.layout,
+                                                 n.finalLayout});
+            }
+            graphStats.barriers += static_cast<uint32_t>(finalBarriers.size());
+            graphStats.batches += finalBarriers.empty() ? 0 : 1;
+        }
+
+        force_inline void barrier(VkCommandBuffer cmd, const vector<Barrier>& barriers) const {
+            if (barriers.empty()) return;
+
+            if (synchronization2) {
+                vector<VkImageMemoryBarrier2KHR> imageBarriers;
+                vector<VkBufferMemoryBarrier2KHR> bufferBarriers;
+                for (const Barrier& b: barriers) {
+                    const Node& n = nodes[b.resource];
+                    if (n.isImage) {
+                        imageBarriers.push_back(VkImageMemoryBarrier2KHR {
+                            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR,
+                            .pNext{},
+                            .srcStageMask = b.srcStages ? b.srcStages : VK_PIPELINE_STAGE_2_NONE_KHR,
+                            .srcAccessMask = b.srcAccess,
+                            .dstStageMask = b.dstStages,
+                            .dstAccessMask = b.dstAccess,
+                            .oldLayout = b.oldLayout,
+                            .newLayout = b.newLayout,
+                            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                            .image = n.image,
+                            .subresourceRange = {n.aspect, 0, 1, 0, 1}
+                        });
+                    } else {
+                        bufferBarriers.push_back(VkBufferMemoryBarrier2KHR {
+                            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR,
+                            .pNext{},
+                            .srcStageMask = b.srcStages ? b.srcStages : VK_PIPELINE_STAGE_2_NONE_KHR,
+                            .srcAccessMask = b.srcAccess,
+                            .dstStageMask = b.dstStages,
+                            .dstAccessMask = b.dstAccess,
+                            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                            .buffer = n.buffer,
+                            .offset = 0,
+                            .size = VK_WHOLE_SIZE
+                        });
+                    }
+                }
+
+                VkDependencyInfoKHR dependencyInfo {
+                    .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+                    .pNext{},
+                    .dependencyFlags{},
+                    .memoryBarrierCount{},
+                    .pMemoryBarriers{},
+                    .bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size()),
+                    .pBufferMemoryBarriers = bufferBarriers.data(),
+                    .imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size()),
+                    .pImageMemoryBarriers = imageBarriers.data()
+                };
+                CmdPipelineBarrier2KHR(cmd, &dependencyInfo);
+                return;
+            }
+
+            // one pipeline barrier with the union of the stages, the accesses stay per resource.
+            VkPipelineStageFlags srcStages = 0;
+            VkPipelineStageFlags dstStages = 0;
+            vector<VkImageMemoryBarrier> imageBarriers;
+            vector<VkBufferMemoryBarrier> bufferBarriers;
+            for (const Barrier& b: barriers) {
+                const Node& n = nodes[b.resource];
+                srcStages |= static_cast<VkPipelineStageFlags>(b.srcStages);
+                dstStages |= static_cast<VkPipelineStageFlags>(b.dstStages);
+                if (n.isImage) {
+                    imageBarriers.push_back(VkImageMemoryBarrier {
+                        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                        .pNext{},
+                        .srcAccessMask = static_cast<VkAccessFlags>(b.srcAccess),
+                        .dstAccessMask = static_cast<VkAccessFlags>(b.dstAccess),
+                        .oldLayout = b.oldLayout,
+                        .newLayout = b.newLayout,
+                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .image = n.image,
+                        .subresourceRange = {n.aspect, 0, 1, 0, 1}
+                    });
+                } else {
+                    bufferBarriers.push_back(VkBufferMemoryBarrier {
+                        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                        .pNext{},
+                        .srcAccessMask = static_cast<VkAccessFlags>(b.srcAccess),
+                        .dstAccessMask = static_cast<VkAccessFlags>(b.dstAccess),
+                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .buffer = n.buffer,
+                        .offset = 0,
+                        .size = VK_WHOLE_SIZE
+                    });
+                }
+            }
+            if (!srcStages) srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+            vkCmdPipelineBarrier(cmd, srcStages, dstStages, 0, 0, nullptr,
+                                 static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                                 static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+        }
+    };
+}
@@ -0,0 +1,420 @@
+#pragma once
+
+#include "glfw_vulkan.h"
+#include "using_std.h"
+#include "using_glm.h"
+#include "logging.h"
+
+namespace VK {
+    // GPU driven rendering of many instances of a few meshes: the CPU records the same handful of commands every
+    // frame whatever the instance count.
+    //
+    // instances and meshes live in storage buffers. every frame a compute pass (cull.comp) tests each instance's
+    // bounding sphere against the frustum, picks a lod from its projected error, and appends the instance to the
+    // bucket of its mesh & lod: one VkDrawIndexedIndirectCommand per bucket, its instanceCount grown atomically,
+    // its instances listed in the visible buffer from firstInstance on. the vertex shader (indirect.vert) finds its
+    // instance through gl_InstanceIndex.
+    //
+    // with bindless descriptors (VK_DESCRIPTOR.h) the draws read the instances, meshes & visible list from the bindless
+    // table instead, at the indices pushed with them (indirect_bindless.vert): the scene's own set is only bound for
+    // culling.
+    //
+    // with VK_KHR_draw_indirect_count a second pass (compact.comp) packs the non-empty buckets and the draw count is
+    // read by the GPU. without it every bucket is drawn, empty ones with zero instances, in one multi draw or one
+    // draw per bucket: either way the CPU cost depends on the bucket count, never on the instance count.
+    struct IndirectScene {
+        static constexpr uint32_t maxLods = 4;
+        static constexpr uint32_t cullGroupSize = 256; // local_size_x of cull.comp
+        static constexpr uint32_t compactGroupSize = 64; // local_size_x of compact.comp
+
+        // std430 layouts shared with the shaders.
+        struct Instance {
+            vec4 positionScale; // xyz position, w uniform scale
+            uint32_t mesh;
+            uint32_t reserved[3];
+        };
+        static_assert(sizeof(Instance) == 32);
+
+        struct MeshInfo {
+            vec4 sphere; // object space bounding sphere, xyz center, w radius
+            vec4 decodeScale; // VertexFormat::Decode
+            vec4 decodeBias;
+            uint32_t firstBucket;
+            uint32_t lodCount;
+            uint32_t reserved[2];
+            vec4 lodError; // object space error of every lod, growing with the lod
+        };
+        static_assert(sizeof(MeshInfo) == 80);
+
+        struct CullConstants {
+            vec4 planes[6]; // world space frustum planes, inside where dot(xyz, p) + w >= 0
+            vec4 camera; // xyz position, w pixels per unit of error at distance 1
+            uint32_t instanceCount;
+            uint32_t bucketCount;
+        };
+        static_assert(sizeof(CullConstants) <= 128);
+
+        struct DrawConstants {
+            mat4x4 viewProjection;
+            uint32_t instances; // bindless indices of the buffers, read by indirect_bindless.vert only
+            uint32_t meshes;
+            uint32_t visible;
+        };
+        static_assert(sizeof(DrawConstants) <= 128);
+
+        // a mesh of the shared vertex & index buffers, lods as index ranges (MeshFormat::Lod).
+        struct Mesh {
+            int32_t vertexOffset = 0;
+            uint32_t firstIndex = 0;
+            uint32_t lodCount = 1;
+            uint32_t lodFirstIndex[maxLods] {};
+            uint32_t lodIndexCount[maxLods] {};
+            float lodError[maxLods] {};
+            vec4 sphere {0.0f, 0.0f, 0.0f, 1.0f};
+            vec4 decodeScale {1.0f};
+            vec4 decodeBias {0.0f};
+        };
+
+        // set by VK::init from the device.
+        bool drawIndirectCountSupported = false;
+        bool multiDrawIndirectSupported = false;
+        bool firstInstanceSupported = false;
+
+        VkDevice device = VK_NULL_HANDLE;
+
+        VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        VkPipelineLayout computeLayout = VK_NULL_HANDLE;
+        VkPipeline cullPipeline = VK_NULL_HANDLE;
+        VkPipeline compactPipeline = VK_NULL_HANDLE;
+
+        // the caller's graphics pipeline, created with vertexShader() and graphicsSetLayout().
+        VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+        VkPipelineLayout graphicsLayout = VK_NULL_HANDLE;
+
+        VertexInput geometry {};
+
+        enum BufferIndex {
+            INSTANCES,
+            MESHES,
+            BUCKETS,
+            VISIBLE,
+            DRAWS,
+            COUNT,
+            BUCKET_TEMPLATE, // buckets with no instances, copied over BUCKETS every frame
+            STATS, // host visible copy of the last culled buckets
+            BUFFER_COUNT
+        };
+        array<VkBuffer, BUFFER_COUNT> buffers {};
+        array<Allocation, BUFFER_COUNT> allocations {};
+
+        uint32_t instanceCount = 0;
+        uint32_t bucketCount = 0;
+        CullConstants cull {};
+        DrawConstants draws {};
+        bool bindlessDraws = false;
+
+        // geometry is bound as is (streams & index buffer), it must outlive the scene.
+        force_inline void create(VkDevice vkDevice, const VertexInput& vertexInput, const vector<Mesh>& meshes,
+                                 const vector<Instance>& instances) {
+            if (!firstInstanceSupported) throw std::runtime_error("drawIndirectFirstInstance is not supported!");
+
+            device = vkDevice;
+            geometry = vertexInput;
+            instanceCount = static_cast<uint32_t>(instances.size());
+
+            // a bucket per mesh & lod, each with room for every instance of its mesh.
+            vector<uint32_t> meshInstances(meshes.size(), 0);
+            for (const Instance& instance: instances) meshInstances[instance.mesh]++;
+
+            vector<MeshInfo> meshInfos;
+            vector<VkDrawIndexedIndirectCommand> buckets;
+            uint32_t visibleCount = 0;
+            for (size_t m = 0; m < meshes.size(); m++) {
+                const Mesh& mesh = meshes[m];
+                meshInfos.push_back(MeshInfo {
+                    .sphere = mesh.sphere,
+                    .decodeScale = mesh.decodeScale,
+                    .decodeBias = mesh.decodeBias,
+                    .firstBucket = static_cast<uint32_t>(buckets.size()),
+                    .lodCount = mesh.lodCount,
+                    .reserved {},
+                    .lodError = vec4(mesh.lodError[0], mesh.lodError[1], mesh.lodError[2], mesh.lodError[3])
+                });
+
+                for (uint32_t lod = 0; lod < mesh.lodCount; lod++) {
+                    buckets.push_back(VkDrawIndexedIndirectCommand {
+                        .indexCount = mesh.lodIndexCount[lod],
+                        .instanceCount = 0,
+                        .firstIndex = mesh.firstIndex + mesh.lodFirstIndex[lod],
+                        .vertexOffset = mesh.vertexOffset,
+                        .firstInstance = visibleCount
+                    });
+                    visibleCount += meshInstances[m];
+                }
+            }
+            bucketCount = static_cast<uint32_t>(buckets.size());
+
+            auto bucketBytes = static_cast<VkDeviceSize>(sizeof(VkDrawIndexedIndirectCommand) * bucketCount);
+            VkBufferUsageFlags indirect = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+
+            buffers[INSTANCES] = uploader.createBuffer(instances.data(), sizeof(Instance) * instances.size(),
+                                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, allocations[INSTANCES],
+                                                       VK_ACCESS_SHADER_READ_BIT);
+            buffers[MESHES] = uploader.createBuffer(meshInfos.data(), sizeof(MeshInfo) * meshInfos.size(),
+                                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, allocations[MESHES],
+                                                    VK_ACCESS_SHADER_READ_BIT);
+            buffers[BUCKET_TEMPLATE] = uploader.createBuffer(buckets.data(), bucketBytes,
+                                                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                             allocations[BUCKET_TEMPLATE],
+                                                             VK_ACCESS_TRANSFER_READ_BIT);
+
+            buffers[BUCKETS] = createBuffer(bucketBytes, indirect | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT, allocations[BUCKETS]);
+            buffers[VISIBLE] = createBuffer(sizeof(uint32_t) * std::max(visibleCount, 1u),
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, allocations[VISIBLE]);
+            buffers[DRAWS] = createBuffer(bucketBytes, indirect, allocations[DRAWS]);
+            buffers[COUNT] = createBuffer(sizeof(uint32_t), indirect | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                          allocations[COUNT]);
+            buffers[STATS] = createBuffer(bucketBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT, allocations[STATS],
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+            createDescriptors();
+            bindlessDraws = bindless.supported;
+            if (bindlessDraws) {
+                draws.instances = bindless.addBuffer(buffers[INSTANCES]);
+                draws.meshes = bindless.addBuffer(buffers[MESHES]);
+                draws.visible = bindless.addBuffer(buffers[VISIBLE]);
+            }
+
+            VkPushConstantRange pushConstantRange {
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .offset = 0,
+                .size = sizeof(CullConstants)
+            };
+            VkPipelineLayoutCreateInfo layoutInfo {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                .pNext{},
+                .flags{},
+                .setLayoutCount = 1,
+                .pSetLayouts = &setLayout,
+                .pushConstantRangeCount = 1,
+                .pPushConstantRanges = &pushConstantRange
+            };
+            CHECK(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &computeLayout),
+                  "failed to create pipeline layout!");
+
+            cullPipeline = createComputePipeline(device, "dat/shaders/cull.comp.glsl.spv", computeLayout);
+            if (drawIndirectCountSupported)
+                compactPipeline = createComputePipeline(device, "dat/shaders/compact.comp.glsl.spv", computeLayout);
+
+            const char* drawCount = drawIndirectCountSupported ? "on the gpu" : multiDrawIndirectSupported
+                                                                               ? "fixed, one multi draw" : "fixed";
+            info("indirect scene: {} instances, {} meshes, {} buckets, draw count {}, buffers {}", instanceCount,
+                 meshes.size(), bucketCount, drawCount, bindlessDraws ? "bindless" : "in the scene's set");
+        }
+
+        [[nodiscard]] force_inline const char* vertexShader() const {
+            return bindlessDraws ? "dat/shaders/indirect_bindless.vert.glsl.spv" : "dat/shaders/indirect.vert.glsl.spv";
+        }
+
+        [[nodiscard]] force_inline VkDescriptorSetLayout graphicsSetLayout() const {
+            return bindlessDraws ? bindless.layout : setLayout;
+        }
+
+        // pixelsPerUnit: viewport height / (2 tan(fovy / 2)), divided by the error in pixels a lod may show.
+        force_inline void setCamera(const mat4x4& viewProjection, const vec3& position, float pixelsPerUnit) {
+            draws.viewProjection = viewProjection;
+
+            // Gribb & Hartmann: planes from the rows of the matrix, for a [0, 1] depth range.
+            mat4x4 t = glm::transpose(viewProjection);
+            vec4 planes[6] = {t[3] + t[0], t[3] - t[0], t[3] + t[1], t[3] - t[1], t[2], t[3] - t[2]};
+            for (int i = 0; i < 6; i++) cull.planes[i] = planes[i] / glm::length(vec3(planes[i]));
+
+            cull.camera = vec4(position, pixelsPerUnit);
+            cull.instanceCount = instanceCount;
+            cull.bucketCount = bucketCount;
+        }
+
+        // records culling & draw generation, outside of a render pass.
+        force_inline void record(VkCommandBuffer cmd) {
+            gpuProfiler.begin(cmd, "cull");
+
+            // the previous frame's draws may still read what is about to be rewritten.
+            barrier(cmd, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, 0);
+
+            VkBufferCopy copy {0, 0, sizeof(VkDrawIndexedIndirectCommand) * bucketCount};
+            vkCmdCopyBuffer(cmd, buffers[BUCKET_TEMPLATE], buffers[BUCKETS], 1, &copy);
+            vkCmdFillBuffer(cmd, buffers[COUNT], 0, sizeof(uint32_t), 0);
+            barrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+            bindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, computeLayout, 0, 1, &descriptorSet);
+            vkCmdPushConstants(cmd, computeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &cull);
+
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+            vkCmdDispatch(cmd, (instanceCount + cullGroupSize - 1) / cullGroupSize, 1, 1);
+
+            if (drawIndirectCountSupported) {
+                barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, compactPipeline);
+                vkCmdDispatch(cmd, (bucketCount + compactGroupSize - 1) / compactGroupSize, 1, 1);
+            }
+
+            barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+
+            // per bucket instance counts, for stats().
+            vkCmdCopyBuffer(cmd, buffers[BUCKETS], buffers[STATS], 1, &copy);
+            barrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                    VK_ACCESS_HOST_READ_BIT);
+
+            gpuProfiler.end(cmd);
+        }
+
+        // records the draws, inside the render pass, viewport & scissor set.
+        force_inline void draw(VkCommandBuffer cmd) const {
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+            if (bindlessDraws) bindless.bind(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsLayout);
+            else bindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsLayout, 0, 1, &descriptorSet);
+            bindVertexInput(cmd, geometry);
+            vkCmdPushConstants(cmd, graphicsLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &draws);
+
+            constexpr auto stride = static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand));
+            if (drawIndirectCountSupported) {
+                CmdDrawIndexedIndirectCountKHR(cmd, buffers[DRAWS], 0, buffers[COUNT], 0, bucketCount, stride);
+            } else if (multiDrawIndirectSupported) {
+                vkCmdDrawIndexedIndirect(cmd, buffers[BUCKETS], 0, bucketCount, stride);
+            } else {
+                for (uint32_t b = 0; b < bucketCount; b++)
+                    vkCmdDrawIndexedIndirect(cmd, buffers[BUCKETS], (VkDeviceSize) b * stride, 1, stride);
+            }
+        }
+
+        // instances drawn per bucket by the last frame that completed, read once the device is idle.
+        [[nodiscard]] force_inline vector<uint32_t> stats() const {
+            vector<uint32_t> counts(bucketCount);
+            const auto* commands = static_cast<const VkDrawIndexedIndirectCommand*>(allocations[STATS].mapped);
+            for (uint32_t b = 0; b < bucketCount; b++) counts[b] = commands[b].instanceCount;
+            return counts;
+        }
+
+        force_inline void destroy() {
+            if (bindlessDraws) {
+                for (uint32_t index: {draws.instances, draws.meshes, draws.visible})
+                    bindless.release(BindlessTable::BUFFERS, index);
+                bindlessDraws = false;
+            }
+            vkDestroyPipeline(device, cullPipeline, nullptr);
+            if (compactPipeline) vkDestroyPipeline(device, compactPipeline, nullptr);
+            vkDestroyPipelineLayout(device, computeLayout, nullptr);
+            vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+            vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+            for (uint32_t i = 0; i < BUFFER_COUNT; i++) allocator.destroyBuffer(buffers[i], allocations[i]);
+
+            cullPipeline = compactPipeline = VK_NULL_HANDLE;
+            computeLayout = VK_NULL_HANDLE;
+            descriptorPool = VK_NULL_HANDLE;
+            setLayout = VK_NULL_HANDLE;
+            buffers = {};
+        }
+
+    private:
+        force_inline VkBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, Allocation& allocation,
+                                           VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+            VkBufferCreateInfo bufferInfo {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                .pNext{},
+                .flags{},
+                .size = size,
+                .usage = usage,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .queueFamilyIndexCount{},
+                .pQueueFamilyIndices{}
+            };
+            return allocator.createBuffer(bufferInfo, properties, allocation);
+        }
+
+        static force_inline void barrier(VkCommandBuffer cmd, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+                                         VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+            VkMemoryBarrier memoryBarrier {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .pNext{},
+                .srcAccessMask = srcAccess,
+                .dstAccessMask = dstAccess
+            };
+            vkCmdPipelineBarrier(cmd, srcStages, dstStages, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+        }
+
+        // one set for the whole scene, bindings in BufferIndex order.
+        force_inline void createDescriptors() {
+            array<VkDescriptorSetLayoutBinding, COUNT + 1> bindings {};
+            for (uint32_t i = 0; i <= COUNT; i++) {
+                bindings[i] = VkDescriptorSetLayoutBinding {
+                    .binding = i,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .descriptorCount = 1,
+                    .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT,
+                    .pImmutableSamplers = nullptr
+                };
+            }
+
+            VkDescriptorSetLayoutCreateInfo layoutInfo {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                .pNext{},
+                .flags{},
+                .bindingCount = static_cast<uint32_t>(bindings.size()),
+                .pBindings = bindings.data()
+            };
+            CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout),
+                  "failed to create descriptor set layout!");
+
+            VkDescriptorPoolSize poolSize {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(bindings.size())};
+            VkDescriptorPoolCreateInfo poolInfo {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                .pNext{},
+                .flags{},
+                .maxSets = 1,
+                .poolSizeCount = 1,
+                .pPoolSizes = &poolSize
+            };
+            CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool),
+                  "failed to create descriptor pool!");
+
+            VkDescriptorSetAllocateInfo allocInfo {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .pNext{},
+                .descriptorPool = descriptorPool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &setLayout
+            };
+            CHECK(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet), "failed to allocate descriptor set!");
+
+            array<VkDescriptorBufferInfo, COUNT + 1> bufferInfos {};
+            array<VkWriteDescriptorSet, COUNT + 1> writes {};
+            for (uint32_t i = 0; i <= COUNT; i++) {
+                bufferInfos[i] = {buffers[i], 0, VK_WHOLE_SIZE};
+                writes[i] = VkWriteDescriptorSet {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .pNext{},
+                    .dstSet = descriptorSet,
+                    .dstBinding = i,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .pImageInfo{},
+                    .pBufferInfo = &bufferInfos[i],
+                    .pTexelBufferView{}
+                };
+            }
+            updateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data());
+        }
+    };
+
+    inline IndirectScene indirectScene;
+}
@@ -4,6 +4,9 @@
 #include "logging.h"
 
 #include <cmath>
+#include <mutex>
+
+#include "VK_TLSF.h"
 
 typedef VkPhysicalDeviceMemoryProperties VkMemoryProperties;
 
@@ -93,12 +96,330 @@ namespace VK {
         vector<uint32_t> types;
 
         for (int i = 0; i < vkMemoryProperties.memoryTypeCount; i++) {
-            if ((1 << i) & type && (vkMemoryProperties.memoryTypes->propertyFlags & propertyFlags) == propertyFlags)
+            if ((1 << i) & type && (vkMemoryProperties.memoryTypes[i].propertyFlags & propertyFlags) == propertyFlags)
                 types.push_back(i);
         }
 
         return types;
     }
 
+    // VK_KHR_get_physical_device_properties2 is an instance extension on 1.0, load it by hand.
+    force_inline void getPhysicalDeviceMemoryBudget(VkPhysicalDevice vkPhysicalDevice,
+                                                    VkPhysicalDeviceMemoryBudgetPropertiesEXT& budget) {
+        auto func = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR) vkGetInstanceProcAddr(
+            VK::instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+        if (func == nullptr) return;
+
+        budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        budget.pNext = nullptr;
+
+        VkPhysicalDeviceMemoryProperties2 properties {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+            .pNext = &budget,
+            .memoryProperties{}
+        };
+        func(vkPhysicalDevice, &properties);
+    }
+
+    // A sub-range of a VkDeviceMemory handed out by the Allocator.
+    struct Allocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        uint32_t memoryType = 0;
+        void* mapped = nullptr; // set when the memory type is host visible, persistently mapped.
+
+        // owning block, UINT32_MAX for a dedicated allocation.
+        uint32_t block = UINT32_MAX;
+        TLSF::Range range {};
+
+        [[nodiscard]] bool dedicated() const { return block == UINT32_MAX; }
+    };
+
+    // Sub-allocating device memory allocator.
+    //
+    // - memory is allocated per memory type in large blocks (blockSize), and resources are placed in them by a TLSF
+    //   range allocator honouring their alignment.
+    // - buffers & linear images never share a block with optimal images, so bufferImageGranularity can't be violated.
+    // - resources larger than half a block get their own dedicated VkDeviceMemory.
+    // - host visible blocks are mapped once at creation.
+    //
+    // keeps vkAllocateMemory calls far below maxMemoryAllocationCount: one per block instead of one per resource.
+    struct Allocator {
+        enum Kind : uint32_t {
+            LINEAR = 0,  // buffers, linear images
+            OPTIMAL = 1, // optimal tiling images
+        };
+
+        struct Block {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            uint32_t memoryType = 0;
+            Kind kind = LINEAR;
+            void* mapped = nullptr;
+            TLSF tlsf;
+        };
+
+        struct Budget {
+            VkDeviceSize usage = 0;  // bytes of this heap in use by the whole process (or by us without the ext)
+            VkDeviceSize budget = 0; // bytes the process may use before the driver starts to evict / fail
+        };
+
+        VkDevice device = VK_NULL_HANDLE;
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+        VkMemoryProperties memoryProperties {};
+        VkDeviceSize bufferImageGranularity = 1;
+        uint32_t maxAllocations = 0;
+
+        VkDeviceSize blockSize = 64ull * 1024 * 1024;
+
+        // VK_EXT_memory_budget, enabled on the device by VK::init when available.
+        bool budgetSupported = false;
+
+        vector<Block> blocks;
+        vector<uint32_t> freeBlocks;
+        uint32_t allocationCount = 0; // live vkAllocateMemory allocations
+
+        // per heap, bytes allocated from the driver and bytes handed out to resources.
+        array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heapAllocated {};
+        array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heapUsed {};
+        array<uint32_t, VK_MAX_MEMORY_HEAPS> heapDedicated {};
+
+        std::mutex mutex;
+
+        force_inline void init(VkPhysicalDevice vkPhysicalDevice, VkDevice vkDevice) {
+            physicalDevice = vkPhysicalDevice;
+            device = vkDevice;
+            memoryProperties = getPhysicalDeviceMemoryProperties(vkPhysicalDevice);
+
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(vkPhysicalDevice, &properties);
+            bufferImageGranularity = properties.limits.bufferImageGranularity;
+            maxAllocations = properties.limits.maxMemoryAllocationCount;
+        }
+
+        // picks the first allowed type with all required flags, preferring one that also has the preferred ones.
+        [[nodiscard]] force_inline uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required,
+                                                           VkMemoryPropertyFlags preferred = 0) const {
+            vector<uint32_t> types = findMemoryTypes(typeBits, required, physicalDevice);
+            if (types.empty()) throw std::runtime_error("failed to find a suitable memory type!");
+
+            for (uint32_t type: types) {
+                if ((memoryProperties.memoryTypes[type].propertyFlags & preferred) == preferred) return type;
+            }
+            return types[0];
+        }
+
+        [[nodiscard]] force_inline uint32_t heapOf(uint32_t memoryType) const {
+            return memoryProperties.memoryTypes[memoryType].heapIndex;
+        }
+
+        force_inline VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryType, void** mapped) {
+            if (allocationCount >= maxAllocations) throw std::runtime_error("maxMemoryAllocationCount reached!");
+
+            VkMemoryAllocateInfo allocInfo {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+                .pNext{},
+                .allocationSize = size,
+                .memoryTypeIndex = memoryType
+            };
+
+            VkDeviceMemory memory;
+            CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &memory), "failed to allocate device memory!");
+            allocationCount++;
+            heapAllocated[heapOf(memoryType)] += size;
+
+            *mapped = nullptr;
+            if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+                vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+            }
+            return memory;
+        }
+
+        force_inline void freeMemory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryType) {
+            vkFreeMemory(device, memory, nullptr); // implicitly unmaps
+            allocationCount--;
+            heapAllocated[heapOf(memoryType)] -= size;
+        }
+
+        force_inline Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required,
+                                         VkMemoryPropertyFlags preferred = 0, Kind kind = LINEAR) {
+            std::lock_guard lock(mutex);
+
+            Allocation allocation {};
+            allocation.memoryType = findMemoryType(requirements.memoryTypeBits, required, preferred);
+            uint32_t heap = heapOf(allocation.memoryType);
+
+            // keep small heaps (integrated, BAR) from being eaten by a single block.
+            VkDeviceSize typeBlockSize = std::min(blockSize, memoryProperties.memoryHeaps[heap].size / 8);
+
+            if (requirements.size > typeBlockSize / 2) {
+                allocation.memory = allocateMemory(requirements.size, allocation.memoryType, &allocation.mapped);
+                allocation.size = requirements.size;
+                heapUsed[heap] += allocation.size;
+                heapDedicated[heap]++;
+                return allocation;
+            }
+
+            for (uint32_t i = 0; i < blocks.size(); i++) {
+                Block& b = blocks[i];
+                if (b.memory == VK_NULL_HANDLE || b.memoryType != allocation.memoryType || b.kind != kind) continue;
+
+                TLSF::Range range = b.tlsf.allocate(requirements.size, requirements.alignment);
+                if (range.node == TLSF::invalid) continue;
+
+                return place(allocation, i, range);
+            }
+
+            uint32_t i;
+            if (!freeBlocks.empty()) {
+                i = freeBlocks.back();
+                freeBlocks.pop_back();
+            } else {
+                i = static_cast<uint32_t>(blocks.size());
+                blocks.emplace_back();
+            }
+
+            Block& b = blocks[i];
+            b.memory = allocateMemory(typeBlockSize, allocation.memoryType, &b.mapped);
+            b.memoryType = allocation.memoryType;
+            b.kind = kind;
+            b.tlsf.reset(typeBlockSize);
+
+            return place(allocation, i, b.tlsf.allocate(requirements.size, requirements.alignment));
+        }
+
+        force_inline Allocation& place(Allocation& allocation, uint32_t block, TLSF::Range range) {
+            Block& b = blocks[block];
+            allocation.memory = b.memory;
+            allocation.offset = range.offset;
+            allocation.size = range.size;
+            allocation.block = block;
+            allocation.range = range;
+            allocation.mapped = b.mapped ? static_cast<char*>(b.mapped) + range.offset : nullptr;
+            heapUsed[heapOf(b.memoryType)] += range.size;
+            return allocation;
+        }
+
+        force_inline void free(Allocation& allocation) {
+            if (allocation.memory == VK_NULL_HANDLE) return;
+            std::lock_guard lock(mutex);
+
+            uint32_t heap = heapOf(allocation.memoryType);
+            heapUsed[heap] -= allocation.size;
+
+            if (allocation.dedicated()) {
+                freeMemory(allocation.memory, allocation.size, allocation.memoryType);
+                heapDedicated[heap]--;
+            } else {
+                Block& b = blocks[allocation.block];
+                b.tlsf.free(allocation.range);
+
+                // give empty blocks back to the driver, but keep one per type around to avoid alloc/free churn.
+                if (b.tlsf.empty() && countBlocks(b.memoryType, b.kind) > 1) {
+                    freeMemory(b.memory, b.tlsf.size(), b.memoryType);
+                    b = Block {};
+                    freeBlocks.push_back(allocation.block);
+                }
+            }
+
+            allocation = Allocation {};
+        }
+
+        [[nodiscard]] force_inline uint32_t countBlocks(uint32_t memoryType, Kind kind) const {
+            uint32_t count = 0;
+            for (const auto& b: blocks) {
+                if (b.memory != VK_NULL_HANDLE && b.memoryType == memoryType && b.kind == kind) count++;
+            }
+            return count;
+        }
+
+        force_inline VkBuffer createBuffer(const VkBufferCreateInfo& createInfo, VkMemoryPropertyFlags required,
+                                           Allocation& allocation, VkMemoryPropertyFlags preferred = 0) {
+            VkBuffer buffer;
+            CHECK(vkCreateBuffer(device, &createInfo, nullptr, &buffer), "failed to create buffer!");
+
+            VkMemoryRequirements requirements;
+            vkGetBufferMemoryRequirements(device, buffer, &requirements);
+
+            allocation = allocate(requirements, required, preferred, LINEAR);
+            vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+            return buffer;
+        }
+
+        force_inline VkImage createImage(const VkImageCreateInfo& createInfo, VkMemoryPropertyFlags required,
+                                         Allocation& allocation, VkMemoryPropertyFlags preferred = 0) {
+            VkImage image;
+            CHECK(vkCreateImage(device, &createInfo, nullptr, &image), "failed to create image!");
+
+            VkMemoryRequirements requirements;
+            vkGetImageMemoryRequirements(device, image, &requirements);
+
+            allocation = allocate(requirements, required, preferred,
+                                  createInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? OPTIMAL : LINEAR);
+            vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+            return image;
+        }
+
+        force_inline void destroyBuffer(VkBuffer buffer, Allocation& allocation) {
+            vkDestroyBuffer(device, buffer, nullptr);
+            free(allocation);
+        }
+
+        force_inline void destroyImage(VkImage image, Allocation& allocation) {
+            vkDestroyImage(device, image, nullptr);
+            free(allocation);
+        }
+
+        [[nodiscard]] force_inline Budget budget(uint32_t heap) {
+            if (budgetSupported) {
+                VkPhysicalDeviceMemoryBudgetPropertiesEXT properties {};
+                getPhysicalDeviceMemoryBudget(physicalDevice, properties);
+                return {properties.heapUsage[heap], properties.heapBudget[heap]};
+            }
+
+            // without the extension only our own allocations are known, assume 80% of the heap is ours to take.
+            return {heapAllocated[heap], memoryProperties.memoryHeaps[heap].size / 10 * 8};
+        }
+
+        // per heap: driver allocations, bytes used by resources, and how fragmented the free space of the blocks is
+        // (1 - largest free range / total free; 0 means all free space is contiguous).
+        force_inline void printStats() {
+            std::lock_guard lock(mutex);
+            info("allocator: {} vkAllocateMemory allocations (max {})", allocationCount, maxAllocations);
+
+            for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+                uint32_t blockCount = 0;
+                uint32_t freeRanges = 0;
+                VkDeviceSize freeBytes = 0;
+                VkDeviceSize largestFree = 0;
+
+                for (const auto& b: blocks) {
+                    if (b.memory == VK_NULL_HANDLE || heapOf(b.memoryType) != heap) continue;
+                    blockCount++;
+                    freeRanges += b.tlsf.freeRanges();
+                    freeBytes += b.tlsf.freeBytes();
+                    largestFree = std::max(largestFree, b.tlsf.largestFreeRange());
+                }
+
+                Budget b = budget(heap);
+                double fragmentation = freeBytes ? 1.0 - (double) largestFree / (double) freeBytes : 0.0;
+
+                info("heap {}: {:.1f}/{:.1f} MiB used/allocated, {} blocks, {} dedicated, {} free ranges, "
+                     "fragmentation {:.2f}, budget {:.1f}/{:.1f} MiB",
+                     heap, heapUsed[heap] / (1024.0 * 1024.0), heapAllocated[heap] / (1024.0 * 1024.0), blockCount,
+                     heapDedicated[heap], freeRanges, fragmentation, b.usage / (1024.0 * 1024.0),
+                     b.budget / (1024.0 * 1024.0));
+            }
+        }
+
+        force_inline void destroy() {
+            for (auto& b: blocks) {
+                if (b.memory != VK_NULL_HANDLE) freeMemory(b.memory, b.tlsf.size(), b.memoryType);
+            }
+            blocks.clear();
+            freeBlocks.clear();
+        }
+    };
 
-}
\ No newline at end of file
+    inline Allocator allocator;
+}
@@ -0,0 +1,333 @@
+#pragma once
+
+#include "glfw_vulkan.h"
+#include "using_std.h"
+#include "logging.h"
+#include "profiler.h"
+
+namespace VK {
+    // GPU timings from timestamp queries, in named nested scopes, plus pipeline statistics of the render pass.
+    //
+    // every frames in flight slot owns its own queries. they are only read back when the slot comes around again,
+    // after its fence has been waited on, so vkGetQueryPoolResults never blocks: results are N frames late, never a
+    // stall. gpu ticks are moved onto the cpu timeline with a calibration taken at init and end up in frameProfiler,
+    // next to the cpu phases of the same frame. every scope is also a debug utils label (VK_DBG.h) when labels are on,
+    // timed or not. nothing is timed in release builds.
+    struct GpuProfiler {
+        static constexpr uint32_t maxScopes = 64;
+
+        static constexpr VkQueryPipelineStatisticFlags statisticFlags =
+            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+        static constexpr uint32_t statisticCount = 6;
+        static constexpr const char* statisticNames[statisticCount] = {
+            "input vertices", "input primitives", "vertex invocations", "clipping invocations",
+            "clipped primitives", "fragment invocations"
+        };
+
+        struct Scope {
+            const char* name;
+            uint32_t depth;
+            uint32_t begin; // query index
+            uint32_t end;
+        };
+
+        struct Slot {
+            VkQueryPool timestamps = VK_NULL_HANDLE;
+            VkQueryPool statistics = VK_NULL_HANDLE;
+            vector<Scope> scopes;
+            uint32_t queries = 0;
+            uint64_t frame = 0; // frameProfiler index of the frame recorded into this slot
+            bool pending = false; // submitted and not read back yet
+            bool counted = false; // the statistics query ran, not when the pass executed secondaries
+        };
+
+        struct ScopeStats {
+            int64_t total = 0;
+            int64_t max = 0;
+            uint32_t count = 0;
+        };
+
+        VkDevice device = VK_NULL_HANDLE;
+        bool enabled = true; // from buildProfile, set by RenderEngine::init()
+        bool supported = false; // timestamps on the graphics queue
+        bool statisticsSupported = false; // the pipelineStatisticsQuery feature, enabled by VK::init
+        float period = 1.0f; // ns per tick
+        uint32_t validBits = 64;
+        uint64_t validMask = ~0ull;
+
+        // cpu time (frameProfiler timeline) of gpu tick calibrationTicks.
+        int64_t calibrationCpu = 0;
+        uint64_t calibrationTicks = 0;
+
+        vector<Slot> slots;
+        vector<uint32_t> stack; // open scopes of the slot being recorded
+        uint32_t current = 0;
+
+        map<const char*, ScopeStats> stats;
+        array<uint64_t, statisticCount> statisticTotals {};
+        uint32_t statisticFrames = 0;
+
+        force_inline void init(VkDevice vkDevice, VkPhysicalDevice vkPhysicalDevice, uint32_t queueFamily,
+                               VkQueue queue, uint32_t slotCount) {
+            if constexpr (!V3RSE_PROFILING) return;
+            device = vkDevice;
+
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(vkPhysicalDevice, &properties);
+
+            uint32_t count;
+            vkGetPhysicalDeviceQueueFamilyProperties(vkPhysicalDevice, &count, nullptr);
+            vector<VkQueueFamilyProperties> families(count);
+            vkGetPhysicalDeviceQueueFamilyProperties(vkPhysicalDevice, &count, families.data());
+
+            validBits = families[queueFamily].timestampValidBits;
+            supported = validBits != 0 && properties.limits.timestampPeriod > 0.0f;
+            if (!supported) {
+                info("gpu profiler: no timestamps on queue family {}", queueFamily);
+                return;
+            }
+
+            period = properties.limits.timestampPeriod;
+            validMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+            slots.resize(slotCount);
+            for (Slot& s: slots) {
+                VkQueryPoolCreateInfo timestampInfo {
+                    .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                    .pNext{},
+                    .flags{},
+                    .queryType = VK_QUERY_TYPE_TIMESTAMP,
+                    .queryCount = maxScopes * 2,
+                    .pipelineStatistics{}
+                };
+                CHECK(vkCreateQueryPool(device, &timestampInfo, nullptr, &s.timestamps),
+                      "failed to create timestamp query pool!");
+
+                if (statisticsSupported) {
+                    VkQueryPoolCreateInfo statisticsInfo {
+                        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                        .pNext{},
+                        .flags{},
+                        .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+                        .queryCount = 1,
+                        .pipelineStatistics = statisticFlags
+                    };
+                    CHECK(vkCreateQueryPool(device, &statisticsInfo, nullptr, &s.statistics),
+                          "failed to create pipeline statistics query pool!");
+                }
+            }
+
+            calibrate(queueFamily, queue);
+        }
+
+        // one timestamp written on an idle queue, against the cpu time halfway through the submit. good to a few
+        // microseconds, enough to line up gpu scopes with the cpu frame that recorded them.
+        force_inline void calibrate(uint32_t queueFamily, VkQueue queue) {
+            VkCommandPoolCreateInfo poolInfo {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .pNext{},
+                .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+                .queueFamilyIndex = queueFamily
+            };
+            VkCommandPool pool;
+            CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &pool));
+
+            VkCommandBufferAllocateInfo allocInfo {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .pNext{},
+                .commandPool = pool,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = 1
+            };
+            VkCommandBuffer commandBuffer;
+            CHECK(vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer));
+
+            VkCommandBufferBeginInfo beginInfo {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .pNext{},
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                .pInheritanceInfo{}
+            };
+            vkBeginCommandBuffer(commandBuffer, &beginInfo);
+            vkCmdResetQueryPool(commandBuffer, slots[0].timestamps, 0, 1);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slots[0].timestamps, 0);
+            vkEndCommandBuffer(commandBuffer);
+
+            VkSubmitInfo submitInfo {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .pNext{},
+                .waitSemaphoreCount = 0,
+                .pWaitSemaphores{},
+                .pWaitDstStageMask{},
+                .commandBufferCount = 1,
+                .pCommandBuffers = &commandBuffer,
+                .signalSemaphoreCount = 0,
+                .pSignalSemaphores{}
+            };
+
+            int64_t before = frameProfiler.now();
+            vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+            int64_t after = frameProfiler.now();
+            vkQueueWaitIdle(queue);
+
+            uint64_t ticks = 0;
+            vkGetQueryPoolResults(device, slots[0].timestamps, 0, 1, sizeof(ticks), &ticks, sizeof(ticks),
+                                  VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+            calibrationTicks = ticks & validMask;
+            calibrationCpu = before + (after - before) / 2;
+
+            vkDestroyCommandPool(device, pool, nullptr);
+        }
+
+        force_inline void destroy() {
+            for (Slot& s: slots) {
+                vkDestroyQueryPool(device, s.timestamps, nullptr);
+                if (s.statistics != VK_NULL_HANDLE) vkDestroyQueryPool(device, s.statistics, nullptr);
+            }
+            slots.clear();
+        }
+
+        // reads back what the slot measured last time it was submitted, then resets its queries. the slot's fence
+        // must have been waited on. outside of a render pass.
+        force_inline void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot) {
+            if (!active()) return;
+
+            current = slot;
+            Slot& s = slots[slot];
+            if (s.pending) collect(s);
+
+            s.scopes.clear();
+            s.queries = 0;
+            s.counted = false;
+            s.frame = frameProfiler.currentFrame();
+            stack.clear();
+
+            vkCmdResetQueryPool(commandBuffer, s.timestamps, 0, maxScopes * 2);
+            if (s.statistics != VK_NULL_HANDLE) vkCmdResetQueryPool(commandBuffer, s.statistics, 0, 1);
+
+            begin(commandBuffer, "gpu frame");
+        }
+
+        force_inline void endFrame(VkCommandBuffer commandBuffer) {
+            if (!active()) return;
+            while (!stack.empty()) end(commandBuffer);
+        }
+
+        // call once the frame recorded into slot has been submitted, an unsubmitted slot is never read back.
+        force_inline void submitted(uint32_t slot) {
+            if (active()) slots[slot].pending = true;
+        }
+
+        // scopes must nest and stay within one command buffer, and cannot be written from inside a render pass that
+        // executes secondary command buffers.
+        force_inline void begin(VkCommandBuffer commandBuffer, const char* name) {
+            beginLabel(commandBuffer, name);
+            if (!active()) return;
+            Slot& s = slots[current];
+            if (s.queries + 2 > maxScopes * 2) {
+                stack.push_back(UINT32_MAX); // out of queries, the matching end() writes nothing
+                return;
+            }
+
+            stack.push_back(static_cast<uint32_t>(s.scopes.size()));
+            s.scopes.push_back({name, static_cast<uint32_t>(stack.size() - 1), s.queries, s.queries + 1});
+            s.queries += 2;
+
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, s.timestamps,
+                                s.scopes.back().begin);
+        }
+
+        force_inline void end(VkCommandBuffer commandBuffer) {
+            endLabel(commandBuffer);
+            if (!active() || stack.empty()) return;
+            uint32_t scope = stack.back();
+            stack.pop_back();
+            if (scope == UINT32_MAX) return;
+
+            Slot& s = slots[current];
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, s.timestamps,
+                                s.scopes[scope].end);
+        }
+
+        // pipeline statistics only count one query at a time, so they cover the render pass, not every scope, and only
+        // when it is recorded inline: secondaries would need the inheritedQueries feature.
+        force_inline void beginStatistics(VkCommandBuffer commandBuffer) {
+            if (!active() || slots[current].statistics == VK_NULL_HANDLE) return;
+            vkCmdBeginQuery(commandBuffer, slots[current].statistics, 0, 0);
+            slots[current].counted = true;
+        }
+
+        force_inline void endStatistics(VkCommandBuffer commandBuffer) {
+            if (active() && slots[current].counted) vkCmdEndQuery(commandBuffer, slots[current].statistics, 0);
+        }
+
+        // never in release builds.
+        [[nodiscard]] force_inline bool active() const {
+            return V3RSE_PROFILING && enabled && supported;
+        }
+
+        [[nodiscard]] force_inline int64_t toCpu(uint64_t ticks) const {
+            // the counter wraps at validBits: differences are taken modulo the mask.
+            auto delta = static_cast<int64_t>(((ticks - calibrationTicks) & validMask) << (64 - validBits))
+                         >> (64 - validBits);
+            return calibrationCpu + static_cast<int64_t>((double) delta * period);
+        }
+
+        force_inline void print() const {
+            if (!supported) return;
+
+            for (const auto& [name, scope]: stats) {
+                info("gpu {}: {:.3f} ms average, {:.3f} ms max over {} frames", name,
+                     (double) scope.total / scope.count / 1e6, (double) scope.max / 1e6, scope.count);
+            }
+            if (statisticFrames) {
+                for (uint32_t i = 0; i < statisticCount; i++) {
+                    info("gpu {}: {} per frame", statisticNames[i], statisticTotals[i] / statisticFrames);
+                }
+            }
+        }
+
+    private:
+        force_inline void collect(Slot& s) {
+            s.pending = false;
+            if (s.queries == 0) return;
+
+            vector<uint64_t> ticks(s.queries);
+            VkResult result = vkGetQueryPoolResults(device, s.timestamps, 0, s.queries,
+                                                    ticks.size() * sizeof(uint64_t), ticks.data(), sizeof(uint64_t),
+                                                    VK_QUERY_RESULT_64_BIT);
+            if (result != VK_SUCCESS) return; // VK_NOT_READY: drop the frame rather than wait
+
+            for (const Scope& scope: s.scopes) {
+                int64_t start = toCpu(ticks[scope.begin] & validMask);
+                int64_t duration = static_cast<int64_t>(
+                    (double) ((ticks[scope.end] - ticks[scope.begin]) & validMask) * period);
+
+                frameProfiler.event(scope.name, "gpu", start, duration, FrameProfiler::gpuTrack);
+                if (scope.depth == 0) frameProfiler.gpuFrame(s.frame, duration, start + duration);
+
+                ScopeStats& st = stats[scope.name];
+                st.total += duration;
+                st.max = std::max(st.max, duration);
+                st.count++;
+            }
+
+            if (s.counted) {
+                array<uint64_t, statisticCount> values {};
+                if (vkGetQueryPoolResults(device, s.statistics, 0, 1, sizeof(values), values.data(), sizeof(values),
+                                          VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+                    for (uint32_t i = 0; i < statisticCount; i++) statisticTotals[i] += values[i];
+                    statisticFrames++;
+                }
+            }
+        }
+    };
+
+    inline GpuProfiler gpuProfiler;
+}
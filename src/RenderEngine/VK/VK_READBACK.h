@@ -0,0 +1,104 @@
+#pragma once
+
+#include "glfw_vulkan.h"
+#include "using_std.h"
+
+namespace VK {
+    // Copies a rendered swapchain image into a host visible buffer. The copy is recorded into its own command
+    // buffer, submitted in the same batch as the frame so it runs before the image is handed to present.
+    // Not meant for the hot path: used for regression captures on headless machines.
+    struct Readback {
+        VkBuffer buffer = nullptr;
+        Allocation allocation {};
+        VkDeviceSize size = 0;
+        VkCommandBuffer commandBuffer = nullptr;
+        VkExtent2D extent {};
+
+        static constexpr uint32_t bytesPerPixel = 4;
+
+        force_inline void create(VkDevice vkDevice, VkCommandPool vkCommandPool, VkExtent2D vkExtent) {
+            extent = vkExtent;
+            size = static_cast<VkDeviceSize>(extent.width) * extent.height * bytesPerPixel;
+
+            VkBufferCreateInfo vkBufferCreateInfo {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                .pNext{},
+                .flags{},
+                .size = size,
+                .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .queueFamilyIndexCount{},
+                .pQueueFamilyIndices{}
+            };
+            buffer = allocator.createBuffer(vkBufferCreateInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, allocation,
+                                            VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+
+            VkCommandBufferAllocateInfo commandBufferInfo {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .pNext{},
+                .commandPool = vkCommandPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = 1
+            };
+            CHECK(vkAllocateCommandBuffers(vkDevice, &commandBufferInfo, &commandBuffer));
+        }
+
+        // image must be in PRESENT_SRC_KHR (where the main pass leaves it) and is left in it.
+        force_inline void record(VkImage image) {
+            VkCommandBufferBeginInfo beginInfo {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .pNext{},
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                .pInheritanceInfo{}
+            };
+            vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+            VkImageMemoryBarrier barrier {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext{},
+                .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = image,
+                .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+            };
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            VkBufferImageCopy region {
+                .bufferOffset = 0,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                .imageOffset = {0, 0, 0},
+                .imageExtent = {extent.width, extent.height, 1}
+            };
+            vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            CHECK(vkEndCommandBuffer(commandBuffer), "failed to record readback command buffer!");
+        }
+
+        // the submission that contains commandBuffer must have completed.
+        [[nodiscard]] force_inline vector<uint8_t> read() const {
+            vector<uint8_t> pixels(size);
+            memcpy(pixels.data(), allocation.mapped, size);
+            return pixels;
+        }
+
+        force_inline void destroy(VkDevice vkDevice, VkCommandPool vkCommandPool) {
+            vkFreeCommandBuffers(vkDevice, vkCommandPool, 1, &commandBuffer);
+            allocator.destroyBuffer(buffer, allocation);
+        }
+    };
+}
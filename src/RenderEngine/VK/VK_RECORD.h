@@ -0,0 +1,191 @@
+#pragma once
+
+#include "glfw_vulkan.h"
+#include "using_std.h"
+#include "profiler.h"
+#include "../Jobs.h"
+
+namespace VK {
+    // with an index buffer bound, vertexCount & firstVertex count indices.
+    struct Draw {
+        uint32_t vertexCount;
+        uint32_t instanceCount;
+        uint32_t firstVertex;
+        uint32_t firstInstance;
+    };
+
+    // what every draw of a list binds: vertex streams, an optional index buffer, the vertex push constants (the
+    // mesh decode) and, for pipelines that read per frame constants, their frame data range at set 0.
+    struct VertexInput {
+        static constexpr uint32_t maxStreams = 4;
+        static constexpr uint32_t maxPushConstants = 128; // the minimum maxPushConstantsSize
+
+        uint32_t streamCount = 0;
+        array<VkBuffer, maxStreams> buffers {};
+        array<VkDeviceSize, maxStreams> offsets {};
+
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        uint32_t pushConstantSize = 0;
+        array<uint8_t, maxPushConstants> pushConstants {};
+
+        FrameDataRing::Range frame {}; // VK_FRAMEDATA.h, none when set is null
+    };
+
+    force_inline void bindVertexInput(VkCommandBuffer vkCommandBuffer, const VertexInput& input) {
+        if (input.streamCount)
+            vkCmdBindVertexBuffers(vkCommandBuffer, 0, input.streamCount, input.buffers.data(), input.offsets.data());
+        if (input.indexBuffer)
+            vkCmdBindIndexBuffer(vkCommandBuffer, input.indexBuffer, 0, input.indexType);
+        if (input.pushConstantSize)
+            vkCmdPushConstants(vkCommandBuffer, input.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, input.pushConstantSize,
+                               input.pushConstants.data());
+        if (input.frame.set)
+            FrameDataRing::bind(vkCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, input.layout, 0, input.frame);
+    }
+
+    force_inline void draw(VkCommandBuffer vkCommandBuffer, const VertexInput& input, const Draw& d) {
+        if (input.indexBuffer)
+            vkCmdDrawIndexed(vkCommandBuffer, d.vertexCount, d.instanceCount, d.firstVertex, 0, d.firstInstance);
+        else
+            vkCmdDraw(vkCommandBuffer, d.vertexCount, d.instanceCount, d.firstVertex, d.firstInstance);
+    }
+
+    // Records the draw list of a render pass into secondary command buffers, on the job system's workers (Jobs.h).
+    //
+    // the draw list is split in up to `workers` contiguous partitions, one secondary each. every partition owns one
+    // command pool per frames in flight slot: once the slot's fence has been waited on, the whole pool is reset in
+    // one call (vkResetCommandPool) instead of resetting buffers one by one, and whichever thread runs the partition's
+    // job records it. the primary buffer then executes the secondaries in order.
+    struct ParallelRecorder {
+        // below this many draws per partition, threading costs more than it saves.
+        static constexpr uint32_t minDrawsPerWorker = 512;
+
+        struct WorkerFrame {
+            VkCommandPool pool = VK_NULL_HANDLE;
+            VkCommandBuffer secondary = VK_NULL_HANDLE;
+        };
+
+        VkDevice device = VK_NULL_HANDLE;
+        uint32_t workers = 1; // partitions
+        vector<vector<WorkerFrame>> frames; // [slot][partition]
+
+        force_inline void init(VkDevice vkDevice, uint32_t queueFamily, uint32_t workerCount, uint32_t slots) {
+            device = vkDevice;
+            workers = std::max(workerCount, 1u);
+            frames.assign(slots, vector<WorkerFrame>(workers));
+
+            VkCommandPoolCreateInfo poolInfo {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .pNext{},
+                .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, // no per-buffer reset, the pool is reset as a whole
+                .queueFamilyIndex = queueFamily
+            };
+
+            for (auto& slot: frames) {
+                for (auto& w: slot) {
+                    CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &w.pool), "failed to create worker pool!");
+
+                    VkCommandBufferAllocateInfo allocInfo {
+                        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                        .pNext{},
+                        .commandPool = w.pool,
+                        .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                        .commandBufferCount = 1
+                    };
+                    CHECK(vkAllocateCommandBuffers(device, &allocInfo, &w.secondary));
+                }
+            }
+        }
+
+        force_inline void destroy() {
+            for (auto& slot: frames) {
+                for (auto& w: slot) vkDestroyCommandPool(device, w.pool, nullptr);
+            }
+            frames.clear();
+        }
+
+        [[nodiscard]] force_inline uint32_t workersFor(size_t drawCount) const {
+            return static_cast<uint32_t>(std::clamp<size_t>(drawCount / minDrawsPerWorker, 1, workers));
+        }
+
+        // records draws into the secondaries of slot and executes them in primary, which must be inside a render
+        // pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, or, without vkRenderPass, inside dynamic
+        // rendering begun with VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR on a colorFormat attachment.
+        force_inline void record(VkCommandBuffer primary, uint32_t slot, VkRenderPass vkRenderPass,
+                                 VkFramebuffer vkFramebuffer, VkFormat colorFormat, VkPipeline vkPipeline,
+                                 const VertexInput& input, VkExtent2D extent, const vector<Draw>& draws) {
+            uint32_t used = workersFor(draws.size());
+            vector<WorkerFrame>& slotFrames = frames[slot];
+
+            // one partition per job: a secondary is recorded by one thread at a time.
+            jobs.parallelFor(0, used, 1, [&](uint32_t first, uint32_t last) {
+                for (uint32_t w = first; w < last; w++) {
+                    recordSecondary(slotFrames[w], w, used, vkRenderPass, vkFramebuffer, colorFormat, vkPipeline,
+                                    input, extent, draws);
+                }
+            });
+
+            vector<VkCommandBuffer> secondaries(used);
+            for (uint32_t w = 0; w < used; w++) secondaries[w] = slotFrames[w].secondary;
+            vkCmdExecuteCommands(primary, used, secondaries.data());
+        }
+
+    private:
+        force_inline void recordSecondary(WorkerFrame& wf, uint32_t w, uint32_t used, VkRenderPass vkRenderPass,
+                                          VkFramebuffer vkFramebuffer, VkFormat colorFormat, VkPipeline vkPipeline,
+                                          const VertexInput& input, VkExtent2D extent, const vector<Draw>& draws) {
+            auto scope = frameProfiler.scope("record secondary");
+            vkResetCommandPool(device, wf.pool, 0);
+
+            VkCommandBufferInheritanceRenderingInfoKHR rendering {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR,
+                .pNext{},
+                .flags{},
+                .viewMask = 0,
+                .colorAttachmentCount = 1,
+                .pColorAttachmentFormats = &colorFormat,
+                .depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+                .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+                .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+            };
+            VkCommandBufferInheritanceInfo inheritance {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+                .pNext = vkRenderPass ? nullptr : &rendering,
+                .renderPass = vkRenderPass,
+                .subpass = 0,
+                .framebuffer = vkFramebuffer,
+                .occlusionQueryEnable = VK_FALSE,
+                .queryFlags{},
+                .pipelineStatistics{}
+            };
+            VkCommandBufferBeginInfo beginInfo {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .pNext{},
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                         VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+                .pInheritanceInfo = &inheritance
+            };
+            vkBeginCommandBuffer(wf.secondary, &beginInfo);
+
+            // secondaries inherit no state, every one binds its own.
+            vkCmdBindPipeline(wf.secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipeline);
+            bindVertexInput(wf.secondary, input);
+
+            VkViewport viewport {0.0f, 0.0f, (float) extent.width, (float) extent.height, 0.0f, 1.0f};
+            VkRect2D scissor {{0, 0}, extent};
+            vkCmdSetViewport(wf.secondary, 0, 1, &viewport);
+            vkCmdSetScissor(wf.secondary, 0, 1, &scissor);
+
+            size_t first = draws.size() * w / used;
+            size_t last = draws.size() * (w + 1) / used;
+            for (size_t i = first; i < last; i++) draw(wf.secondary, input, draws[i]);
+
+            vkEndCommandBuffer(wf.secondary);
+        }
+    };
+
+    inline ParallelRecorder recorder;
+}
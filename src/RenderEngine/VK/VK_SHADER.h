@@ -0,0 +1,76 @@
+#pragma once
+
+#include "glfw_vulkan.h"
+#include "using_std.h"
+#include "logging.h"
+
+#include <fstream>
+
+namespace VK {
+    // TODO: put these in a shader class.
+    static std::vector<char> readFile(const std::string& filename) {
+        std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open file!");
+        }
+
+        size_t fileSize = (size_t) file.tellg();
+        std::vector<char> buffer(fileSize);
+
+        file.seekg(0);
+        file.read(buffer.data(), fileSize);
+
+        file.close();
+
+        return buffer;
+    }
+
+    force_inline VkShaderModule createShaderModule(VkDevice vkDevice, const std::vector<char>& code) {
+        VkShaderModuleCreateInfo createInfo {
+            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .codeSize = code.size(),
+            .pCode = reinterpret_cast<const uint32_t*>(code.data())
+        };
+
+        VkShaderModule shaderModule;
+        vkCreateShaderModule(vkDevice, &createInfo, nullptr, &shaderModule);
+        return shaderModule;
+    }
+
+    // compute pipelines go through the pipeline cache too.
+    force_inline VkPipeline createComputePipeline(VkDevice vkDevice, const std::string& shader,
+                                                  VkPipelineLayout layout) {
+        VkShaderModule module = createShaderModule(vkDevice, readFile(shader));
+
+        const void* pNext = nullptr;
+        PipelineCache::Feedback feedback;
+        pipelineCache.begin(feedback, pNext);
+
+        VkComputePipelineCreateInfo createInfo {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = pNext,
+            .flags{},
+            .stage {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .pNext{},
+                .flags{},
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = module,
+                .pName = "main",
+                .pSpecializationInfo{}
+            },
+            .layout = layout,
+            .basePipelineHandle = VK_NULL_HANDLE,
+            .basePipelineIndex{}
+        };
+
+        VkPipeline pipeline;
+        CHECK(vkCreateComputePipelines(vkDevice, pipelineCache.cache, 1, &createInfo, nullptr, &pipeline),
+              "failed to create compute pipeline.");
+        pipelineCache.record(feedback);
+
+        vkDestroyShaderModule(vkDevice, module, nullptr);
+        return pipeline;
+    }
+}
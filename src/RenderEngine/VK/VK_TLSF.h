@@ -0,0 +1,254 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <bit>
+#include <algorithm>
+
+namespace VK {
+    // Two-Level Segregated Fit range allocator. Only manages offsets: the memory itself (a VkDeviceMemory block)
+    // is never touched, so all the bookkeeping lives on the CPU side.
+    //
+    // free ranges are kept in FL x SL segregated lists: the first level is the power of two of the size, the second
+    // splits that power of two linearly into SL_COUNT classes. allocation and free are O(1): two bitmap scans to find
+    // a list, and physical neighbour links to coalesce on free.
+    class TLSF {
+    public:
+        static constexpr uint32_t invalid = UINT32_MAX;
+
+        struct Range {
+            uint64_t offset = 0;
+            uint64_t size = 0;
+            uint32_t node = invalid;
+        };
+
+        explicit TLSF(uint64_t size = 0) {
+            if (size) reset(size);
+        }
+
+        void reset(uint64_t size) {
+            nodes.clear();
+            freeNodes.clear();
+            flBitmap = 0;
+            for (auto& b: slBitmap) b = 0;
+            for (auto& l: heads) for (auto& h: l) h = invalid;
+
+            capacity = size;
+            used = 0;
+            freeCount = 0;
+
+            uint32_t n = newNode();
+            nodes[n].offset = 0;
+            nodes[n].size = size;
+            insertFree(n);
+        }
+
+        // returns a range with node == invalid when no free range is large enough.
+        Range allocate(uint64_t size, uint64_t alignment = 1) {
+            if (size == 0) size = 1;
+            if (alignment == 0) alignment = 1;
+
+            // search for a size that guarantees the alignment padding fits in the found range.
+            uint64_t search = size + (alignment > 1 ? alignment - 1 : 0);
+            uint32_t n = findFree(search);
+            if (n == invalid) return {};
+
+            removeFree(n);
+
+            uint64_t aligned = alignUp(nodes[n].offset, alignment);
+            uint64_t padding = aligned - nodes[n].offset;
+
+            // leading padding goes back to the free lists as its own range.
+            if (padding) {
+                uint32_t p = newNode();
+                nodes[p].offset = nodes[n].offset;
+                nodes[p].size = padding;
+                nodes[p].prevPhys = nodes[n].prevPhys;
+                nodes[p].nextPhys = n;
+                if (nodes[n].prevPhys != invalid) nodes[nodes[n].prevPhys].nextPhys = p;
+                nodes[n].prevPhys = p;
+                nodes[n].offset += padding;
+                nodes[n].size -= padding;
+                insertFree(p);
+            }
+
+            if (nodes[n].size > size) {
+                uint32_t t = newNode();
+                nodes[t].offset = nodes[n].offset + size;
+                nodes[t].size = nodes[n].size - size;
+                nodes[t].prevPhys = n;
+                nodes[t].nextPhys = nodes[n].nextPhys;
+                if (nodes[n].nextPhys != invalid) nodes[nodes[n].nextPhys].prevPhys = t;
+                nodes[n].nextPhys = t;
+                nodes[n].size = size;
+                insertFree(t);
+            }
+
+            used += nodes[n].size;
+            return {nodes[n].offset, nodes[n].size, n};
+        }
+
+        void free(const Range& range) {
+            uint32_t n = range.node;
+            if (n == invalid || nodes[n].free) return;
+
+            used -= nodes[n].size;
+
+            uint32_t prev = nodes[n].prevPhys;
+            if (prev != invalid && nodes[prev].free) {
+                removeFree(prev);
+                nodes[n].offset = nodes[prev].offset;
+                nodes[n].size += nodes[prev].size;
+                nodes[n].prevPhys = nodes[prev].prevPhys;
+                if (nodes[n].prevPhys != invalid) nodes[nodes[n].prevPhys].nextPhys = n;
+                releaseNode(prev);
+            }
+
+            uint32_t next = nodes[n].nextPhys;
+            if (next != invalid && nodes[next].free) {
+                removeFree(next);
+                nodes[n].size += nodes[next].size;
+                nodes[n].nextPhys = nodes[next].nextPhys;
+                if (nodes[n].nextPhys != invalid) nodes[nodes[n].nextPhys].prevPhys = n;
+                releaseNode(next);
+            }
+
+            insertFree(n);
+        }
+
+        [[nodiscard]] uint64_t size() const { return capacity; }
+
+        [[nodiscard]] uint64_t usedBytes() const { return used; }
+
+        [[nodiscard]] uint64_t freeBytes() const { return capacity - used; }
+
+        [[nodiscard]] uint32_t freeRanges() const { return freeCount; }
+
+        [[nodiscard]] bool empty() const { return used == 0; }
+
+        [[nodiscard]] uint64_t largestFreeRange() const {
+            if (flBitmap == 0) return 0;
+            uint32_t fl = 63 - std::countl_zero(flBitmap);
+            uint32_t sl = 31 - std::countl_zero(slBitmap[fl]);
+
+            uint64_t largest = 0;
+            for (uint32_t n = heads[fl][sl]; n != invalid; n = nodes[n].nextFree)
+                largest = std::max(largest, nodes[n].size);
+            return largest;
+        }
+
+    private:
+        static constexpr uint32_t SL_LOG2 = 5;
+        static constexpr uint32_t SL_COUNT = 1 << SL_LOG2;
+        static constexpr uint32_t FL_COUNT = 64 - SL_LOG2 + 1;
+
+        struct Node {
+            uint64_t offset = 0;
+            uint64_t size = 0;
+            uint32_t prevPhys = invalid;
+            uint32_t nextPhys = invalid;
+            uint32_t prevFree = invalid;
+            uint32_t nextFree = invalid;
+            bool free = false;
+        };
+
+        std::vector<Node> nodes;
+        std::vector<uint32_t> freeNodes;
+
+        uint64_t flBitmap = 0;
+        uint32_t slBitmap[FL_COUNT] {};
+        uint32_t heads[FL_COUNT][SL_COUNT] {};
+
+        uint64_t capacity = 0;
+        uint64_t used = 0;
+        uint32_t freeCount = 0;
+
+        static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        // sizes below SL_COUNT map linearly into the first level, above that each power of two is one level.
+        static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl) {
+            if (size < SL_COUNT) {
+                fl = 0;
+                sl = static_cast<uint32_t>(size);
+                return;
+            }
+
+            uint32_t msb = 63 - std::countl_zero(size);
+            fl = msb - SL_LOG2 + 1;
+            sl = static_cast<uint32_t>(size >> (msb - SL_LOG2)) ^ SL_COUNT;
+        }
+
+        uint32_t newNode() {
+            if (!freeNodes.empty()) {
+                uint32_t n = freeNodes.back();
+                freeNodes.pop_back();
+                nodes[n] = Node {};
+                return n;
+            }
+            nodes.emplace_back();
+            return static_cast<uint32_t>(nodes.size() - 1);
+        }
+
+        void releaseNode(uint32_t n) {
+            freeNodes.push_back(n);
+        }
+
+        void insertFree(uint32_t n) {
+            uint32_t fl, sl;
+            mapping(nodes[n].size, fl, sl);
+
+            nodes[n].free = true;
+            nodes[n].prevFree = invalid;
+            nodes[n].nextFree = heads[fl][sl];
+            if (heads[fl][sl] != invalid) nodes[heads[fl][sl]].prevFree = n;
+            heads[fl][sl] = n;
+
+            flBitmap |= 1ull << fl;
+            slBitmap[fl] |= 1u << sl;
+            freeCount++;
+        }
+
+        void removeFree(uint32_t n) {
+            uint32_t fl, sl;
+            mapping(nodes[n].size, fl, sl);
+
+            if (nodes[n].prevFree != invalid) nodes[nodes[n].prevFree].nextFree = nodes[n].nextFree;
+            else heads[fl][sl] = nodes[n].nextFree;
+            if (nodes[n].nextFree != invalid) nodes[nodes[n].nextFree].prevFree = nodes[n].prevFree;
+
+            if (heads[fl][sl] == invalid) {
+                slBitmap[fl] &= ~(1u << sl);
+                if (slBitmap[fl] == 0) flBitmap &= ~(1ull << fl);
+            }
+
+            nodes[n].free = false;
+            freeCount--;
+        }
+
+        // first free range whose class is guaranteed to hold size: round size up to the next class boundary.
+        uint32_t findFree(uint64_t size) const {
+            if (size >= SL_COUNT) {
+                uint32_t msb = 63 - std::countl_zero(size);
+                uint64_t round = (1ull << (msb - SL_LOG2)) - 1;
+                if (size > UINT64_MAX - round) return invalid;
+                size += round;
+            }
+
+            uint32_t fl, sl;
+            mapping(size, fl, sl);
+            if (fl >= FL_COUNT) return invalid;
+
+            uint32_t slMap = slBitmap[fl] & (~0u << sl);
+            if (slMap == 0) {
+                uint64_t flMap = fl + 1 < 64 ? flBitmap & (~0ull << (fl + 1)) : 0;
+                if (flMap == 0) return invalid;
+                fl = std::countr_zero(flMap);
+                slMap = slBitmap[fl];
+            }
+            sl = std::countr_zero(slMap);
+            return heads[fl][sl];
+        }
+    };
+}
@@ -0,0 +1,428 @@
+#pragma once
+
+#include "glfw_vulkan.h"
+#include "using_std.h"
+#include "logging.h"
+
+#include <deque>
+
+namespace VK {
+    // Staging upload path: data is written into a persistently mapped ring buffer, copies are batched into one
+    // command buffer and submitted on the transfer queue, which is a dedicated dma family when the device has one.
+    //
+    // completion is tracked with a timeline semaphore: every batch signals the next value, the ring space of a batch
+    // is reclaimed once the semaphore reaches it, and the graphics submission of a frame waits on it GPU side.
+    // nothing here ever blocks the frame loop, only an upload that doesn't fit in the ring waits for older batches.
+    //
+    // when the transfer and graphics families differ, resources are released by the transfer queue and acquired
+    // on the graphics queue by a small command buffer that runs first in the frame's batch (acquire()).
+    struct Uploader {
+        static constexpr VkDeviceSize alignment = 16; // covers texel sizes & optimalBufferCopyOffsetAlignment
+
+        // stages that may consume uploaded data, what the graphics queue waits on.
+        static constexpr VkPipelineStageFlags consumerStages =
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+        struct Batch {
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            uint64_t value = 0;     // timeline value signaled on completion
+            uint64_t ringHead = 0;  // ring position once this batch retires
+        };
+
+        // what the graphics submission of a frame has to add: an optional acquire command buffer to run first,
+        // and a timeline value to wait on.
+        struct Acquire {
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VkSemaphore semaphore = VK_NULL_HANDLE;
+            uint64_t value = 0;
+        };
+
+        VkDevice device = VK_NULL_HANDLE;
+        VkQueue queue = VK_NULL_HANDLE;
+        uint32_t transferFamily = 0;
+        uint32_t graphicsFamily = 0;
+
+        VkCommandPool transferPool = VK_NULL_HANDLE;
+        VkCommandPool graphicsPool = VK_NULL_HANDLE;
+        vector<VkCommandBuffer> acquireCommandBuffers; // one per frame in flight slot
+
+        VkSemaphore timeline = VK_NULL_HANDLE;
+        uint64_t submitted = 0; // last value submitted
+        uint64_t completed = 0; // last value known to be reached
+
+        VkBuffer ring = VK_NULL_HANDLE;
+        Allocation ringAllocation {};
+        VkDeviceSize capacity = 0;
+        uint64_t head = 0; // monotonic byte counters, offset in the ring is counter % capacity
+        uint64_t tail = 0;
+
+        Batch recording {};
+        std::deque<Batch> inFlight;
+        vector<VkCommandBuffer> freeCommandBuffers;
+
+        vector<VkBufferMemoryBarrier> pendingBufferAcquires;
+        vector<VkImageMemoryBarrier> pendingImageAcquires;
+
+        struct Stats {
+            uint64_t bytes = 0;
+            uint64_t copies = 0;
+            uint64_t batches = 0;
+            uint64_t stalls = 0; // times an upload had to wait for the ring to drain
+        } stats;
+
+        [[nodiscard]] bool ownershipTransfer() const { return transferFamily != graphicsFamily; }
+
+        force_inline void init(VkDevice vkDevice, uint32_t vkTransferFamily, VkQueue vkTransferQueue,
+                               uint32_t vkGraphicsFamily, VkDeviceSize ringSize = 64ull * 1024 * 1024) {
+            device = vkDevice;
+            queue = vkTransferQueue;
+            transferFamily = vkTransferFamily;
+            graphicsFamily = vkGraphicsFamily;
+            capacity = ringSize;
+
+            VkCommandPoolCreateInfo poolInfo {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .pNext{},
+                .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+                .queueFamilyIndex = transferFamily
+            };
+            CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &transferPool), "failed to create upload pool!");
+
+            poolInfo.queueFamilyIndex = graphicsFamily;
+            CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &graphicsPool), "failed to create acquire pool!");
+
+            VkSemaphoreTypeCreateInfoKHR typeInfo {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR,
+                .pNext{},
+                .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR,
+                .initialValue = 0
+            };
+            VkSemaphoreCreateInfo semaphoreInfo {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+                .pNext = &typeInfo,
+                .flags{}
+            };
+            CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline), "failed to create timeline!");
+
+            VkBufferCreateInfo ringInfo {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                .pNext{},
+                .flags{},
+                .size = capacity,
+                .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .queueFamilyIndexCount{},
+                .pQueueFamilyIndices{}
+            };
+            ring = allocator.createBuffer(ringInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ringAllocation);
+        }
+
+        // creates a device local buffer and queues the upload of data into it.
+        force_inline VkBuffer createBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+                                           Allocation& allocation, VkAccessFlags dstAccess) {
+            VkBufferCreateInfo bufferInfo {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                .pNext{},
+                .flags{},
+                .size = size,
+                .usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .queueFamilyIndexCount{},
+                .pQueueFamilyIndices{}
+            };
+
+            VkBuffer buffer = allocator.createBuffer(bufferInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, allocation);
+            uploadBuffer(buffer, 0, data, size, dstAccess);
+            return buffer;
+        }
+
+        // copies data into buffer, split in as many chunks as the ring requires.
+        force_inline void uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size,
+                                       VkAccessFlags dstAccess) {
+            const auto* bytes = static_cast<const char*>(data);
+
+            for (VkDeviceSize done = 0; done < size;) {
+                VkDeviceSize chunk = std::min(size - done, capacity / 2);
+                VkDeviceSize src = stage(bytes + done, chunk);
+
+                VkBufferCopy region {
+                    .srcOffset = src,
+                    .dstOffset = offset + done,
+                    .size = chunk
+                };
+                vkCmdCopyBuffer(recording.commandBuffer, ring, buffer, 1, &region);
+                done += chunk;
+            }
+
+            if (!ownershipTransfer()) return;
+
+            VkBufferMemoryBarrier release {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .pNext{},
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = 0,
+                .srcQueueFamilyIndex = transferFamily,
+                .dstQueueFamilyIndex = graphicsFamily,
+                .buffer = buffer,
+                .offset = offset,
+                .size = size
+            };
+            vkCmdPipelineBarrier(recording.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &release, 0, nullptr);
+
+            release.srcAccessMask = 0;
+            release.dstAccessMask = dstAccess;
+            pendingBufferAcquires.push_back(release);
+        }
+
+        // uploads mip 0 of a 2d image, leaving it in SHADER_READ_ONLY_OPTIMAL. the whole image must fit in the ring.
+        force_inline void uploadImage(VkImage image, VkExtent3D extent, const void* data, VkDeviceSize size) {
+            if (size > capacity / 2) throw std::runtime_error("image too large for the staging ring!");
+            VkDeviceSize src = stage(data, size);
+
+            VkImageMemoryBarrier barrier {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext{},
+                .srcAccessMask = 0,
+                .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = image,
+                .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+            };
+            vkCmdPipelineBarrier(recording.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            VkBufferImageCopy region {
+                .bufferOffset = src,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                .imageOffset = {0, 0, 0},
+                .imageExtent = extent
+            };
+            vkCmdCopyBufferToImage(recording.commandBuffer, ring, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                                   &region);
+
+            // with an ownership transfer the layout transition happens in the release/acquire pair.
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = ownershipTransfer() ? 0 : VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            if (ownershipTransfer()) {
+                barrier.srcQueueFamilyIndex = transferFamily;
+                barrier.dstQueueFamilyIndex = graphicsFamily;
+            }
+            vkCmdPipelineBarrier(recording.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 ownershipTransfer() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+                                                     : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            if (ownershipTransfer()) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                pendingImageAcquires.push_back(barrier);
+            }
+        }
+
+        // submits the batch being recorded, returns the timeline value that signals its completion.
+        force_inline uint64_t flush() {
+            if (recording.commandBuffer == VK_NULL_HANDLE) return submitted;
+
+            CHECK(vkEndCommandBuffer(recording.commandBuffer), "failed to record upload command buffer!");
+
+            recording.value = ++submitted;
+            recording.ringHead = head;
+
+            VkTimelineSemaphoreSubmitInfoKHR timelineInfo {
+                .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+                .pNext{},
+                .waitSemaphoreValueCount = 0,
+                .pWaitSemaphoreValues = nullptr,
+                .signalSemaphoreValueCount = 1,
+                .pSignalSemaphoreValues = &recording.value
+            };
+            VkSubmitInfo submitInfo {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .pNext = &timelineInfo,
+                .waitSemaphoreCount = 0,
+                .pWaitSemaphores = nullptr,
+                .pWaitDstStageMask = nullptr,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &recording.commandBuffer,
+                .signalSemaphoreCount = 1,
+                .pSignalSemaphores = &timeline
+            };
+            CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE), "failed to submit uploads!");
+
+            inFlight.push_back(recording);
+            recording = {};
+            stats.batches++;
+            return submitted;
+        }
+
+        // reclaims ring space & command buffers of every batch that completed, never waits.
+        force_inline void collect() {
+            if (inFlight.empty()) return;
+            GetSemaphoreCounterValueKHR(device, timeline, &completed);
+
+            while (!inFlight.empty() && inFlight.front().value <= completed) {
+                tail = inFlight.front().ringHead;
+                freeCommandBuffers.push_back(inFlight.front().commandBuffer);
+                inFlight.pop_front();
+            }
+        }
+
+        [[nodiscard]] force_inline bool isComplete(uint64_t value) {
+            if (value <= completed) return true;
+            GetSemaphoreCounterValueKHR(device, timeline, &completed);
+            return value <= completed;
+        }
+
+        force_inline void wait(uint64_t value) {
+            VkSemaphoreWaitInfoKHR waitInfo {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+                .pNext{},
+                .flags{},
+                .semaphoreCount = 1,
+                .pSemaphores = &timeline,
+                .pValues = &value
+            };
+            WaitSemaphoresKHR(device, &waitInfo, UINT64_MAX);
+            collect();
+        }
+
+        // called by the frame for its slot of the frames in flight ring: flushes pending uploads and returns what
+        // the frame's graphics submission must wait on and run first.
+        force_inline Acquire acquire(uint32_t slot) {
+            flush();
+            collect();
+
+            Acquire result {};
+            if (submitted > completed) {
+                result.semaphore = timeline;
+                result.value = submitted;
+            }
+
+            if (pendingBufferAcquires.empty() && pendingImageAcquires.empty()) return result;
+
+            if (slot >= acquireCommandBuffers.size()) {
+                auto first = static_cast<uint32_t>(acquireCommandBuffers.size());
+                acquireCommandBuffers.resize(slot + 1);
+                VkCommandBufferAllocateInfo allocInfo {
+                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                    .pNext{},
+                    .commandPool = graphicsPool,
+                    .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                    .commandBufferCount = slot + 1 - first
+                };
+                CHECK(vkAllocateCommandBuffers(device, &allocInfo, acquireCommandBuffers.data() + first));
+            }
+
+            // the slot's fence was waited on by the frame, its previous acquire buffer is done.
+            VkCommandBuffer commandBuffer = acquireCommandBuffers[slot];
+            VkCommandBufferBeginInfo beginInfo {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .pNext{},
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                .pInheritanceInfo{}
+            };
+            vkBeginCommandBuffer(commandBuffer, &beginInfo);
+            vkCmdPipelineBarrier(commandBuffer, consumerStages, consumerStages, 0, 0, nullptr,
+                                 static_cast<uint32_t>(pendingBufferAcquires.size()), pendingBufferAcquires.data(),
+                                 static_cast<uint32_t>(pendingImageAcquires.size()), pendingImageAcquires.data());
+            CHECK(vkEndCommandBuffer(commandBuffer), "failed to record acquire command buffer!");
+
+            pendingBufferAcquires.clear();
+            pendingImageAcquires.clear();
+
+            result.commandBuffer = commandBuffer;
+            result.semaphore = timeline;
+            result.value = submitted;
+            return result;
+        }
+
+        force_inline void printStats() const {
+            info("uploader: {:.1f} MiB in {} copies, {} batches, {} ring stalls", stats.bytes / (1024.0 * 1024.0),
+                 stats.copies, stats.batches, stats.stalls);
+        }
+
+        force_inline void destroy() {
+            flush();
+            if (submitted) wait(submitted);
+
+            vkDestroySemaphore(device, timeline, nullptr);
+            vkDestroyCommandPool(device, transferPool, nullptr);
+            vkDestroyCommandPool(device, graphicsPool, nullptr);
+            allocator.destroyBuffer(ring, ringAllocation);
+            acquireCommandBuffers.clear();
+            freeCommandBuffers.clear();
+        }
+
+    private:
+        force_inline void begin() {
+            if (recording.commandBuffer != VK_NULL_HANDLE) return;
+
+            if (!freeCommandBuffers.empty()) {
+                recording.commandBuffer = freeCommandBuffers.back();
+                freeCommandBuffers.pop_back();
+            } else {
+                VkCommandBufferAllocateInfo allocInfo {
+                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                    .pNext{},
+                    .commandPool = transferPool,
+                    .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                    .commandBufferCount = 1
+                };
+                CHECK(vkAllocateCommandBuffers(device, &allocInfo, &recording.commandBuffer));
+            }
+
+            VkCommandBufferBeginInfo beginInfo {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .pNext{},
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                .pInheritanceInfo{}
+            };
+            vkBeginCommandBuffer(recording.commandBuffer, &beginInfo);
+        }
+
+        // reserves size bytes of the ring, copies data in, returns the offset in the ring buffer.
+        force_inline VkDeviceSize stage(const void* data, VkDeviceSize size) {
+            VkDeviceSize offset = reserve(size);
+            memcpy(static_cast<char*>(ringAllocation.mapped) + offset, data, size);
+
+            stats.bytes += size;
+            stats.copies++;
+            return offset;
+        }
+
+        force_inline VkDeviceSize reserve(VkDeviceSize size) {
+            for (;;) {
+                uint64_t start = (head + alignment - 1) / alignment * alignment;
+                // never straddle the end of the ring, skip to the start instead.
+                if (start % capacity + size > capacity) start += capacity - start % capacity;
+
+                if (start + size - tail <= capacity) {
+                    head = start + size;
+                    begin(); // after any flush below, so the copy lands in the batch that owns this range
+                    return start % capacity;
+                }
+
+                // ring full: submit what is recorded and wait for the oldest batch to free its range.
+                flush();
+                collect();
+                if (start + size - tail > capacity && !inFlight.empty()) {
+                    stats.stalls++;
+                    wait(inFlight.front().value);
+                }
+            }
+        }
+    };
+
+    inline Uploader uploader;
+}
@@ -1,36 +1,82 @@
 #include "Vertex.h"
 
-//#include "VK/VK.h"
-//
-//uint32_t availableMemory = 0;
-//
-//VkBuffer Vertex::createVertexBuffer(VkDevice vkDevice, const vector <Vertex>& vertices, VkSharingMode vkSharingMode) {
-//    VkBufferCreateInfo vkBufferCreateInfo {
-//        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-//        .pNext{},
-//        .flags{},
-//        .size = sizeof(vertices[0]) * vertices.size(),
-//        .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-//        .sharingMode = vkSharingMode,
-//        .queueFamilyIndexCount{}, // pQueueFamilyIndices is a pointer to an array of queue families that will access
-//        // this buffer. It is ignored if sharingMode is not VK_SHARING_MODE_CONCURRENT.
-//        .pQueueFamilyIndices{}
-//    };
-//
-//    VkBuffer vkBuffer;
-//    vkCreateBuffer(vkDevice, &vkBufferCreateInfo, nullptr, &vkBuffer);
-//
-//    VkMemoryRequirements vkMemoryRequirements;
-//    vkGetBufferMemoryRequirements(vkDevice, vkBuffer, &vkMemoryRequirements);
-//
-//    info("memory requirements:\nsize: {}\nalignment: {}", vkMemoryRequirements.size,
-//         vkMemoryRequirements.alignment);
-//
-//    VkMemoryAllocateInfo allocInfo {
-//        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-//        .pNext{},
-//        .allocationSize = vkMemoryRequirements.size,
-//        .memoryTypeIndex = VK::findMemoryTypes(vkMemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)[0]
-//    };
-//    return vkBuffer;
-//}
\ No newline at end of file
+#include <glm/gtc/packing.hpp>
+
+// vertex buffers are created through VK::uploader (VK/VK_UPLOAD.h): staged, then copied into device local memory.
+
+// octahedral mapping: the unit sphere folded onto the [-1, 1] square, ~0.01 degree error in 2x16 bits.
+static glm::vec2 octEncode(vec3 n) {
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.0f) {
+        p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) *
+            glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return p;
+}
+
+void VertexFormat::encode(const Attribute& attribute, const Vertex& v, const Decode& decode, uint8_t* dst) {
+    vec3 value;
+    switch (attribute.semantic) {
+        case Semantic::POSITION:
+            value = v.pos;
+            break;
+        case Semantic::NORMAL:
+            value = v.normal;
+            break;
+        case Semantic::COLOR:
+            value = v.color;
+            break;
+        case Semantic::UV:
+            value = vec3(v.uv, 0.0f);
+            break;
+    }
+
+    switch (attribute.encoding) {
+        case Encoding::FLOAT2:
+            memcpy(dst, &value, 8);
+            break;
+        case Encoding::FLOAT3:
+            memcpy(dst, &value, 12);
+            break;
+        case Encoding::SNORM16x4: {
+            vec3 q = (value - vec3(decode.bias)) / vec3(decode.scale);
+            uint64_t packed = glm::packSnorm4x16(vec4(q, 1.0f));
+            memcpy(dst, &packed, 8);
+            break;
+        }
+        case Encoding::UNORM8x4: {
+            uint32_t packed = glm::packUnorm4x8(vec4(value, 1.0f));
+            memcpy(dst, &packed, 4);
+            break;
+        }
+        case Encoding::OCT16: {
+            uint32_t packed = glm::packSnorm2x16(octEncode(glm::normalize(value)));
+            memcpy(dst, &packed, 4);
+            break;
+        }
+        case Encoding::HALF2: {
+            uint32_t packed = glm::packHalf2x16(glm::vec2(value));
+            memcpy(dst, &packed, 4);
+            break;
+        }
+    }
+}
+
+VertexFormat::Decode VertexFormat::bounds(const vector<Vertex>& vertices) {
+    if (vertices.empty()) return {};
+
+    vec3 min = vertices[0].pos;
+    vec3 max = vertices[0].pos;
+    for (const Vertex& v: vertices) {
+        min = glm::min(min, v.pos);
+        max = glm::max(max, v.pos);
+    }
+
+    // a flat axis would divide by zero, any scale decodes it exactly.
+    vec3 scale = glm::max((max - min) * 0.5f, vec3(1e-20f));
+    return Decode {
+        .scale = vec4(scale, 1.0f),
+        .bias = vec4((max + min) * 0.5f, 0.0f)
+    };
+}
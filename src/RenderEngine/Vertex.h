@@ -5,37 +5,205 @@
 #include "using_glm.h"
 #include "logging.h"
 
+// full precision vertex, what meshes are authored & imported as. the GPU sees it through a VertexLayout.
 class Vertex {
+public:
     vec3 pos;
     vec3 color;
+    vec3 normal {0.0f, 0.0f, 1.0f};
+    glm::vec2 uv {};
+};
+
+namespace VertexFormat {
+    enum class Semantic : uint32_t {
+        POSITION,
+        NORMAL,
+        COLOR,
+        UV
+    };
 
-    static VkVertexInputBindingDescription getBindingDescription() {
-        return VkVertexInputBindingDescription {
-            .binding = 0,
-            .stride = sizeof(Vertex),
-            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
-        };
+    enum class Encoding : uint32_t {
+        FLOAT2,
+        FLOAT3,
+        SNORM16x4, // positions, decoded with the mesh's scale & bias (Decode)
+        UNORM8x4,  // colors
+        OCT16,     // unit normals, octahedral mapping in two snorm16
+        HALF2      // texture coordinates
+    };
+
+    constexpr uint32_t size(Encoding encoding) {
+        switch (encoding) {
+            case Encoding::FLOAT2:
+                return 8;
+            case Encoding::FLOAT3:
+                return 12;
+            case Encoding::SNORM16x4:
+                return 8;
+            case Encoding::UNORM8x4:
+                return 4;
+            case Encoding::OCT16:
+                return 4;
+            case Encoding::HALF2:
+                return 4;
+        }
+        return 0;
     }
 
-    static array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions(uint32_t binding_id) {
-        return array<VkVertexInputAttributeDescription, 2> {
-            VkVertexInputAttributeDescription {
-                .location = 0,
-                .binding = binding_id,
-                .format = VK_FORMAT_R32G32B32_SFLOAT,
-                .offset = static_cast<uint32_t>(offsetof(Vertex, pos))
-            },
-            VkVertexInputAttributeDescription {
-                .location = 1,
-                .binding = binding_id,
-                .format = VK_FORMAT_R32G32B32_SFLOAT,
-                .offset = static_cast<uint32_t>(offsetof(Vertex, pos))
+    // 3 component 16 bit formats are optional as vertex formats, positions take the padded 4 component one.
+    constexpr VkFormat format(Encoding encoding) {
+        switch (encoding) {
+            case Encoding::FLOAT2:
+                return VK_FORMAT_R32G32_SFLOAT;
+            case Encoding::FLOAT3:
+                return VK_FORMAT_R32G32B32_SFLOAT;
+            case Encoding::SNORM16x4:
+                return VK_FORMAT_R16G16B16A16_SNORM;
+            case Encoding::UNORM8x4:
+                return VK_FORMAT_R8G8B8A8_UNORM;
+            case Encoding::OCT16:
+                return VK_FORMAT_R16G16_SNORM;
+            case Encoding::HALF2:
+                return VK_FORMAT_R16G16_SFLOAT;
+        }
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    struct Attribute {
+        uint32_t location;
+        Semantic semantic;
+        Encoding encoding;
+        uint32_t stream; // vertex buffer binding
+    };
+
+    // pushed to the vertex shader: position = decoded * scale + bias. identity for float positions.
+    struct Decode {
+        vec4 scale {1.0f};
+        vec4 bias {0.0f};
+    };
+
+    static constexpr uint32_t maxStreams = 4;
+
+    // the encoded vertex buffers of a mesh, one per stream.
+    struct Streams {
+        array<vector<uint8_t>, maxStreams> data;
+        uint32_t streamCount = 0;
+        uint32_t vertexCount = 0;
+        Decode decode {};
+    };
+
+    // writes one attribute of v to dst, positions are quantized relative to decode.
+    void encode(const Attribute& attribute, const Vertex& v, const Decode& decode, uint8_t* dst);
+
+    // scale & bias mapping the bounding box of vertices onto [-1, 1].
+    Decode bounds(const vector<Vertex>& vertices);
+}
+
+// A vertex layout is declared once, as a list of attributes, e.g.
+//
+//   using Layout = VertexLayout<VertexFormat::Attribute {0, POSITION, SNORM16x4, 0},
+//                               VertexFormat::Attribute {1, COLOR, UNORM8x4, 1}>;
+//
+// strides, offsets, the pipeline's binding & attribute descriptions and the encoder are all generated from it.
+// attributes of the same stream are interleaved in declaration order.
+template<VertexFormat::Attribute... Attributes>
+struct VertexLayout {
+    static constexpr array<VertexFormat::Attribute, sizeof...(Attributes)> attributes {Attributes...};
+
+    static constexpr uint32_t streamCount = [] {
+        uint32_t count = 0;
+        for (const auto& a: attributes) count = std::max(count, a.stream + 1);
+        return count;
+    }();
+    static_assert(streamCount <= VertexFormat::maxStreams, "too many vertex streams");
+
+    static constexpr uint32_t stride(uint32_t stream) {
+        uint32_t bytes = 0;
+        for (const auto& a: attributes) if (a.stream == stream) bytes += VertexFormat::size(a.encoding);
+        return bytes;
+    }
+
+    static constexpr uint32_t offset(size_t index) {
+        uint32_t bytes = 0;
+        for (size_t i = 0; i < index; i++)
+            if (attributes[i].stream == attributes[index].stream) bytes += VertexFormat::size(attributes[i].encoding);
+        return bytes;
+    }
+
+    // identifies the layout in mesh files (Mesh.h): fnv-1a of the declaration.
+    static constexpr uint64_t id = [] {
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (const auto& a: attributes) {
+            for (uint32_t v: {a.location, (uint32_t) a.semantic, (uint32_t) a.encoding, a.stream}) {
+                h ^= v;
+                h *= 0x100000001b3ull;
             }
-        };
+        }
+        return h;
+    }();
+
+    // bytes fetched per vertex, all streams together.
+    static constexpr uint32_t vertexSize = [] {
+        uint32_t bytes = 0;
+        for (const auto& a: attributes) bytes += VertexFormat::size(a.encoding);
+        return bytes;
+    }();
+
+    static vector<VkVertexInputBindingDescription> getBindingDescriptions() {
+        vector<VkVertexInputBindingDescription> bindings;
+        for (uint32_t stream = 0; stream < streamCount; stream++) {
+            bindings.push_back(VkVertexInputBindingDescription {
+                .binding = stream,
+                .stride = stride(stream),
+                .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+            });
+        }
+        return bindings;
+    }
+
+    static vector<VkVertexInputAttributeDescription> getAttributeDescriptions() {
+        vector<VkVertexInputAttributeDescription> descriptions;
+        for (size_t i = 0; i < attributes.size(); i++) {
+            descriptions.push_back(VkVertexInputAttributeDescription {
+                .location = attributes[i].location,
+                .binding = attributes[i].stream,
+                .format = VertexFormat::format(attributes[i].encoding),
+                .offset = offset(i)
+            });
+        }
+        return descriptions;
     }
 
-    static VkBuffer createVertexBuffer(VkDevice vkDevice, const vector<Vertex>& vertices,
-                                       VkSharingMode vkSharingMode);
+    static VertexFormat::Streams encode(const vector<Vertex>& vertices) {
+        VertexFormat::Streams streams {};
+        streams.streamCount = streamCount;
+        streams.vertexCount = static_cast<uint32_t>(vertices.size());
+
+        for (const auto& a: attributes) {
+            if (a.semantic == VertexFormat::Semantic::POSITION && a.encoding == VertexFormat::Encoding::SNORM16x4)
+                streams.decode = VertexFormat::bounds(vertices);
+        }
+
+        for (uint32_t stream = 0; stream < streamCount; stream++)
+            streams.data[stream].resize(static_cast<size_t>(stride(stream)) * vertices.size());
+
+        for (size_t v = 0; v < vertices.size(); v++) {
+            for (size_t i = 0; i < attributes.size(); i++) {
+                const auto& a = attributes[i];
+                uint8_t* dst = streams.data[a.stream].data() + v * stride(a.stream) + offset(i);
+                VertexFormat::encode(a, vertices[v], streams.decode, dst);
+            }
+        }
+
+        return streams;
+    }
 };
 
+// positions and the other attributes in separate streams: depth only & shadow passes fetch 8 bytes a vertex.
+using DefaultVertexLayout = VertexLayout<
+    VertexFormat::Attribute {0, VertexFormat::Semantic::POSITION, VertexFormat::Encoding::SNORM16x4, 0},
+    VertexFormat::Attribute {1, VertexFormat::Semantic::COLOR, VertexFormat::Encoding::UNORM8x4, 1}>;
 
+// the unquantized interleaved layout, 24 bytes a vertex, kept as the reference for benchmark_vertex_fetch.
+using FloatVertexLayout = VertexLayout<
+    VertexFormat::Attribute {0, VertexFormat::Semantic::POSITION, VertexFormat::Encoding::FLOAT3, 0},
+    VertexFormat::Attribute {1, VertexFormat::Semantic::COLOR, VertexFormat::Encoding::FLOAT3, 0}>;
@@ -0,0 +1,291 @@
+// v3rse_cook: converts obj & gltf files into mesh files (src/RenderEngine/Mesh.h) of the default vertex layout.
+//
+//   v3rse_cook [-o out] [-j threads] [--force] inputs...
+//
+// inputs are files or directories, searched recursively. every asset is imported, optimised for the post transform
+// cache, overdraw and vertex fetch, and written with the narrowest index type, on all cores through the job system
+// (src/RenderEngine/Jobs.h). an asset whose content hash (the file, its external buffers and the cooker version)
+// matches the one in out/cook.manifest, and whose output exists, is skipped.
+
+#include "Import.h"
+#include "Optimize.h"
+#include "Mesh.h"
+#include "Jobs.h"
+#include "logging.h"
+#include "mapped_file.h"
+
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+
+using std::filesystem::path;
+namespace fs = std::filesystem;
+
+namespace Cook {
+    // bump when the output of an unchanged input changes, every asset is cooked again.
+    static constexpr uint64_t version = 1;
+
+    struct Asset {
+        path input;
+        std::string name; // output path relative to the output directory
+    };
+
+    struct Result {
+        enum class Status {
+            COOKED,
+            SKIPPED,
+            FAILED
+        } status = Status::FAILED;
+        std::string error;
+        uint64_t hash = 0;
+
+        double importMs = 0.0;
+        double optimizeMs = 0.0;
+        double writeMs = 0.0;
+        size_t vertexCount = 0;
+        size_t triangleCount = 0;
+        float acmrBefore = 0.0f;
+        float acmrAfter = 0.0f;
+        MeshFormat::IndexType indexType = MeshFormat::IndexType::NONE;
+    };
+}
+
+static uint64_t hashBytes(const uint8_t* data, size_t size, uint64_t h) {
+    static constexpr uint64_t k0 = 0x9e3779b97f4a7c15ull;
+    static constexpr uint64_t k1 = 0xff51afd7ed558ccdull;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ (word * k0)) * k1;
+        h ^= h >> 31;
+    }
+    uint64_t tail = size;
+    for (; i < size; i++) tail = tail << 8 | data[i];
+    h = (h ^ (tail * k0)) * k1;
+    return h ^ (h >> 33);
+}
+
+static uint64_t hashFile(const path& p, uint64_t h) {
+    MappedFile file;
+    if (!file.open(p.string())) {
+        if (fs::exists(p) && fs::file_size(p) == 0) return hashBytes(nullptr, 0, h); // empty files don't map
+        throw std::runtime_error("failed to open " + p.string());
+    }
+    return hashBytes(file.data(), file.size(), h);
+}
+
+static uint64_t contentHash(const path& input) {
+    uint64_t h = hashBytes(reinterpret_cast<const uint8_t*>(&Cook::version), sizeof(Cook::version), 0);
+    h = hashBytes(reinterpret_cast<const uint8_t*>(&DefaultVertexLayout::id), sizeof(uint64_t), h);
+    h = hashFile(input, h);
+    for (const path& dependency: Cook::dependencies(input)) h = hashFile(dependency, h);
+    return h;
+}
+
+static double millisecondsSince(Clock::time_point start) {
+    return (double) std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count() / 1000.0;
+}
+
+static void cook(const Cook::Asset& asset, const path& output, Cook::Result& result) {
+    auto start = Clock::now();
+    Cook::Mesh mesh = Cook::import(asset.input);
+    result.importMs = millisecondsSince(start);
+
+    start = Clock::now();
+    result.acmrBefore = Cook::acmr(mesh.indices, mesh.vertices.size());
+    Cook::optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    Cook::optimizeOverdraw(mesh.indices, mesh.vertices);
+    Cook::optimizeVertexFetch(mesh.vertices, mesh.indices);
+    result.acmrAfter = Cook::acmr(mesh.indices, mesh.vertices.size());
+    result.optimizeMs = millisecondsSince(start);
+
+    start = Clock::now();
+    vec3 boundsMin = mesh.vertices.empty() ? vec3(0.0f) : mesh.vertices[0].pos;
+    vec3 boundsMax = boundsMin;
+    for (const Vertex& v: mesh.vertices) {
+        boundsMin = glm::min(boundsMin, v.pos);
+        boundsMax = glm::max(boundsMax, v.pos);
+    }
+
+    vector<MeshFormat::Lod> lods = {{0, static_cast<uint32_t>(mesh.indices.size()), 0.0f, 0}};
+
+    // written aside and renamed, an interrupted cook never leaves a truncated mesh behind, a failed one no
+    // temporary either.
+    path temporary = output;
+    temporary += ".tmp";
+    fs::create_directories(output.parent_path());
+    try {
+        MeshFormat::write(temporary.string(), DefaultVertexLayout::id, DefaultVertexLayout::encode(mesh.vertices),
+                          mesh.indices, lods, boundsMin, boundsMax);
+        fs::rename(temporary, output);
+    } catch (...) {
+        std::error_code error;
+        fs::remove(temporary, error);
+        throw;
+    }
+    result.writeMs = millisecondsSince(start);
+
+    result.vertexCount = mesh.vertices.size();
+    result.triangleCount = mesh.indices.size() / 3;
+    bool narrow = std::all_of(mesh.indices.begin(), mesh.indices.end(), [](uint32_t i) { return i <= UINT16_MAX; });
+    result.indexType = mesh.indices.empty() ? MeshFormat::IndexType::NONE
+                                            : narrow ? MeshFormat::IndexType::UINT16 : MeshFormat::IndexType::UINT32;
+}
+
+// hash & relative output path per line.
+static std::unordered_map<std::string, uint64_t> readManifest(const path& p) {
+    std::unordered_map<std::string, uint64_t> manifest;
+    std::ifstream file(p);
+    std::string name;
+    uint64_t hash;
+    while (file >> std::hex >> hash && std::getline(file >> std::ws, name)) manifest[name] = hash;
+    return manifest;
+}
+
+static void writeManifest(const path& p, const std::unordered_map<std::string, uint64_t>& manifest) {
+    path temporary = p;
+    temporary += ".tmp";
+    try {
+        {
+            std::ofstream file(temporary, std::ios::trunc);
+            for (const auto& [name, hash]: manifest) file << std::hex << hash << " " << name << "\n";
+            if (!file.good()) throw std::runtime_error("failed to write " + temporary.string());
+        }
+        fs::rename(temporary, p);
+    } catch (...) {
+        std::error_code error;
+        fs::remove(temporary, error);
+        throw;
+    }
+}
+
+static vector<Cook::Asset> gather(const vector<path>& inputs) {
+    vector<Cook::Asset> assets;
+    auto add = [&](const path& input, const path& relative) {
+        path name = relative;
+        name.replace_extension(".mesh");
+        assets.push_back({input, name.generic_string()});
+    };
+
+    for (const path& input: inputs) {
+        if (fs::is_directory(input)) {
+            for (const auto& entry: fs::recursive_directory_iterator(input)) {
+                if (entry.is_regular_file() && Cook::importable(entry.path()))
+                    add(entry.path(), fs::relative(entry.path(), input));
+            }
+        } else if (Cook::importable(input)) {
+            add(input, input.filename());
+        } else {
+            spdlog::warn("skipping {}: not an obj or gltf file", input.string());
+        }
+    }
+
+    // stable order, the report reads the same on every run.
+    std::sort(assets.begin(), assets.end(), [](const auto& a, const auto& b) { return a.name < b.name; });
+    return assets;
+}
+
+static const char* indexTypeName(MeshFormat::IndexType type) {
+    switch (type) {
+        case MeshFormat::IndexType::NONE:
+            return "none";
+        case MeshFormat::IndexType::UINT16:
+            return "u16";
+        case MeshFormat::IndexType::UINT32:
+            return "u32";
+    }
+    return "?";
+}
+
+int main(int argc, char** argv) {
+    path outputDirectory = "meshes";
+    uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    bool force = false;
+    vector<path> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) outputDirectory = argv[++i];
+        else if (arg == "-j" && i + 1 < argc) threadCount = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--force") force = true;
+        else inputs.emplace_back(argv[i]);
+    }
+
+    if (inputs.empty()) {
+        spdlog::error("usage: v3rse_cook [-o out] [-j threads] [--force] inputs...");
+        return EXIT_FAILURE;
+    }
+
+    auto start = Clock::now();
+    vector<Cook::Asset> assets = gather(inputs);
+    path manifestPath = outputDirectory / "cook.manifest";
+    std::unordered_map<std::string, uint64_t> manifest = force ? decltype(manifest) {} : readManifest(manifestPath);
+    vector<Cook::Result> results(assets.size());
+
+    auto cookAsset = [&](size_t i) {
+        const Cook::Asset& asset = assets[i];
+        Cook::Result& result = results[i];
+        path output = outputDirectory / asset.name;
+
+        try {
+            result.hash = contentHash(asset.input);
+            auto previous = manifest.find(asset.name);
+            if (previous != manifest.end() && previous->second == result.hash && fs::exists(output)) {
+                result.status = Cook::Result::Status::SKIPPED;
+                return;
+            }
+
+            cook(asset, output, result);
+            result.status = Cook::Result::Status::COOKED;
+            info("{}: {} vertices, {} triangles, {} indices, acmr {:.3f} -> {:.3f}, import {:.1f} ms, "
+                 "optimize {:.1f} ms, write {:.1f} ms", asset.name, result.vertexCount, result.triangleCount,
+                 indexTypeName(result.indexType), result.acmrBefore, result.acmrAfter, result.importMs,
+                 result.optimizeMs, result.writeMs);
+        } catch (const std::exception& e) {
+            result.status = Cook::Result::Status::FAILED;
+            result.error = e.what();
+            spdlog::error("{}: {}", asset.input.string(), e.what());
+        }
+    };
+
+    // one asset per job, idle workers steal the rest: the largest assets bound the wall time.
+    threadCount = static_cast<uint32_t>(std::clamp<size_t>(assets.size(), 1, threadCount));
+    jobs.init(threadCount);
+    jobs.parallelFor(0, static_cast<uint32_t>(assets.size()), 1, [&](uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; i++) cookAsset(i);
+    });
+    jobs.destroy();
+
+    size_t cooked = 0;
+    size_t skipped = 0;
+    size_t failed = 0;
+    double cpuMs = 0.0;
+    for (size_t i = 0; i < assets.size(); i++) {
+        const Cook::Result& result = results[i];
+        switch (result.status) {
+            case Cook::Result::Status::COOKED:
+                cooked++;
+                cpuMs += result.importMs + result.optimizeMs + result.writeMs;
+                manifest[assets[i].name] = result.hash;
+                break;
+            case Cook::Result::Status::SKIPPED:
+                skipped++;
+                break;
+            case Cook::Result::Status::FAILED:
+                failed++;
+                manifest.erase(assets[i].name);
+                break;
+        }
+    }
+
+    if (cooked || failed) {
+        fs::create_directories(outputDirectory);
+        writeManifest(manifestPath, manifest);
+    }
+
+    info("cooked {}, unchanged {}, failed {} in {:.1f} ms ({:.1f} ms of work on {} threads)", cooked, skipped, failed,
+         millisecondsSince(start), cpuMs, threadCount);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
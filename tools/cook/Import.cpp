@@ -0,0 +1,499 @@
+#include "Import.h"
+#include "Json.h"
+#include "mapped_file.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <charconv>
+#include <fstream>
+#include <string_view>
+#include <unordered_map>
+
+using std::filesystem::path;
+
+static std::string extension(const path& p) {
+    std::string ext = p.extension().string();
+    for (char& c: ext) c = (char) std::tolower((unsigned char) c);
+    return ext;
+}
+
+bool Cook::importable(const path& p) {
+    std::string ext = extension(p);
+    return ext == ".obj" || ext == ".gltf" || ext == ".glb";
+}
+
+static vector<uint8_t> readFile(const path& p) {
+    std::ifstream file(p, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) throw std::runtime_error("failed to open " + p.string());
+
+    vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), (std::streamsize) data.size());
+    return data;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// obj
+
+static void skipSpace(std::string_view& s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t' || s.front() == '\r')) s.remove_prefix(1);
+}
+
+static bool parseFloat(std::string_view& s, float& value) {
+    skipSpace(s);
+    auto [end, error] = std::from_chars(s.data(), s.data() + s.size(), value);
+    if (error != std::errc()) return false;
+    s.remove_prefix(end - s.data());
+    return true;
+}
+
+static bool parseInt(std::string_view& s, int64_t& value) {
+    auto [end, error] = std::from_chars(s.data(), s.data() + s.size(), value);
+    if (error != std::errc()) return false;
+    s.remove_prefix(end - s.data());
+    return true;
+}
+
+// obj indices are 1 based, negative ones count back from the last element.
+static int64_t resolve(int64_t index, size_t count) {
+    int64_t resolved = index < 0 ? (int64_t) count + index : index - 1;
+    if (resolved < 0 || resolved >= (int64_t) count) throw std::runtime_error("obj index out of range!");
+    return resolved;
+}
+
+static Cook::Mesh importObj(const path& p) {
+    MappedFile file;
+    if (!file.open(p.string())) throw std::runtime_error("failed to open " + p.string());
+
+    vector<vec3> positions;
+    vector<vec3> colors;
+    vector<glm::vec2> uvs;
+    vector<vec3> normals;
+
+    // an obj vertex is a position/uv/normal triple, every distinct triple becomes one mesh vertex.
+    struct Key {
+        int64_t position, uv, normal;
+
+        bool operator==(const Key&) const = default;
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            uint64_t h = (uint64_t) k.position * 0x9e3779b97f4a7c15ull;
+            h ^= (uint64_t) k.uv * 0xc2b2ae3d27d4eb4full + (h >> 29);
+            h ^= (uint64_t) k.normal * 0x165667b19e3779f9ull + (h >> 32);
+            return h;
+        }
+    };
+    std::unordered_map<Key, uint32_t, KeyHash> unique;
+
+    Cook::Mesh mesh;
+    vector<uint32_t> polygon;
+
+    std::string_view text(reinterpret_cast<const char*>(file.data()), file.size());
+    while (!text.empty()) {
+        size_t lineEnd = text.find('\n');
+        std::string_view line = text.substr(0, lineEnd);
+        text.remove_prefix(lineEnd == std::string_view::npos ? text.size() : lineEnd + 1);
+
+        skipSpace(line);
+        if (line.starts_with("v ")) {
+            line.remove_prefix(2);
+            vec3 v;
+            if (!parseFloat(line, v.x) || !parseFloat(line, v.y) || !parseFloat(line, v.z))
+                throw std::runtime_error("malformed obj position!");
+            positions.push_back(v);
+
+            vec3 c(1.0f);
+            if (parseFloat(line, c.r)) {
+                parseFloat(line, c.g);
+                parseFloat(line, c.b);
+                colors.resize(positions.size(), vec3(1.0f));
+                colors.back() = c;
+            }
+        } else if (line.starts_with("vt ")) {
+            line.remove_prefix(3);
+            glm::vec2 uv {};
+            parseFloat(line, uv.x);
+            parseFloat(line, uv.y);
+            uvs.push_back(uv);
+        } else if (line.starts_with("vn ")) {
+            line.remove_prefix(3);
+            vec3 n {0.0f, 0.0f, 1.0f};
+            parseFloat(line, n.x);
+            parseFloat(line, n.y);
+            parseFloat(line, n.z);
+            normals.push_back(n);
+        } else if (line.starts_with("f ")) {
+            line.remove_prefix(2);
+            polygon.clear();
+
+            for (skipSpace(line); !line.empty(); skipSpace(line)) {
+                Key key {-1, -1, -1};
+                int64_t index;
+                if (!parseInt(line, index)) throw std::runtime_error("malformed obj face!");
+                key.position = resolve(index, positions.size());
+                if (!line.empty() && line.front() == '/') {
+                    line.remove_prefix(1);
+                    if (parseInt(line, index)) key.uv = resolve(index, uvs.size());
+                    if (!line.empty() && line.front() == '/') {
+                        line.remove_prefix(1);
+                        if (parseInt(line, index)) key.normal = resolve(index, normals.size());
+                    }
+                }
+
+                auto [it, inserted] = unique.try_emplace(key, static_cast<uint32_t>(mesh.vertices.size()));
+                if (inserted) {
+                    Vertex v {};
+                    v.pos = positions[key.position];
+                    v.color = (size_t) key.position < colors.size() ? colors[key.position] : vec3(1.0f);
+                    if (key.uv >= 0) v.uv = uvs[key.uv];
+                    if (key.normal >= 0) v.normal = normals[key.normal];
+                    mesh.vertices.push_back(v);
+                }
+                polygon.push_back(it->second);
+            }
+
+            // convex polygons, as fans.
+            for (size_t i = 2; i < polygon.size(); i++) {
+                mesh.indices.insert(mesh.indices.end(), {polygon[0], polygon[i - 1], polygon[i]});
+            }
+        }
+    }
+
+    return mesh;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// gltf
+
+namespace {
+    struct Gltf {
+        Cook::Json json;
+        vector<vector<uint8_t>> buffers;
+    };
+}
+
+static vector<uint8_t> decodeBase64(std::string_view text) {
+    auto value = [](char c) -> int {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+' || c == '-') return 62;
+        if (c == '/' || c == '_') return 63;
+        return -1;
+    };
+
+    vector<uint8_t> data;
+    data.reserve(text.size() / 4 * 3);
+    uint32_t bits = 0;
+    int count = 0;
+    for (char c: text) {
+        int v = value(c);
+        if (v < 0) continue; // padding & whitespace
+        bits = bits << 6 | (uint32_t) v;
+        if (++count == 4) {
+            data.insert(data.end(), {(uint8_t) (bits >> 16), (uint8_t) (bits >> 8), (uint8_t) bits});
+            bits = 0;
+            count = 0;
+        }
+    }
+    if (count == 3) data.insert(data.end(), {(uint8_t) (bits >> 10), (uint8_t) (bits >> 2)});
+    if (count == 2) data.push_back((uint8_t) (bits >> 4));
+    return data;
+}
+
+static bool isDataUri(const std::string& uri) {
+    return uri.rfind("data:", 0) == 0;
+}
+
+static Gltf loadGltf(const path& p) {
+    static constexpr uint32_t glbMagic = 0x46546c67; // "glTF"
+    static constexpr uint32_t jsonChunk = 0x4e4f534a;
+    static constexpr uint32_t binChunk = 0x004e4942;
+
+    vector<uint8_t> file = readFile(p);
+    std::string_view text(reinterpret_cast<const char*>(file.data()), file.size());
+    vector<uint8_t> bin;
+
+    uint32_t magic = 0;
+    if (file.size() >= 4) memcpy(&magic, file.data(), 4);
+    if (magic == glbMagic) {
+        // 12 byte header, then chunks: length, type, data.
+        text = {};
+        for (size_t offset = 12; offset + 8 <= file.size();) {
+            uint32_t chunk[2];
+            memcpy(chunk, file.data() + offset, 8);
+            if (offset + 8 + chunk[0] > file.size()) throw std::runtime_error("truncated glb chunk!");
+
+            const uint8_t* data = file.data() + offset + 8;
+            if (chunk[1] == jsonChunk) text = {reinterpret_cast<const char*>(data), chunk[0]};
+            else if (chunk[1] == binChunk) bin.assign(data, data + chunk[0]);
+            offset += 8 + ((chunk[0] + 3) & ~3u);
+        }
+    }
+
+    Gltf gltf;
+    gltf.json = Cook::Json::parse(text);
+
+    const Cook::Json& buffers = gltf.json["buffers"];
+    for (size_t i = 0; i < buffers.size(); i++) {
+        const Cook::Json& uri = buffers[i]["uri"];
+        if (uri.isNull()) gltf.buffers.push_back(i == 0 ? std::move(bin) : vector<uint8_t> {});
+        else if (isDataUri(uri.string)) gltf.buffers.push_back(decodeBase64(uri.string.substr(uri.string.find(','))));
+        else gltf.buffers.push_back(readFile(p.parent_path() / uri.string));
+    }
+    return gltf;
+}
+
+static uint32_t componentCount(const std::string& type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    if (type == "MAT4") return 16;
+    throw std::runtime_error("unsupported gltf accessor type " + type);
+}
+
+static uint32_t componentSize(uint64_t componentType) {
+    switch (componentType) {
+        case 5120: // byte
+        case 5121: // unsigned byte
+            return 1;
+        case 5122: // short
+        case 5123: // unsigned short
+            return 2;
+        case 5125: // unsigned int
+        case 5126: // float
+            return 4;
+        default:
+            throw std::runtime_error("unsupported gltf component type!");
+    }
+}
+
+// every element of an accessor as floats, integer components converted as the accessor says (normalized or not).
+static vector<float> readAccessor(const Gltf& gltf, uint64_t index, uint32_t& components) {
+    const Cook::Json& accessor = gltf.json["accessors"][index];
+    if (accessor.isNull()) throw std::runtime_error("gltf accessor out of range!");
+    if (accessor.find("sparse")) throw std::runtime_error("sparse gltf accessors are not supported!");
+
+    uint64_t count = accessor["count"].asUint();
+    uint64_t componentType = accessor["componentType"].asUint();
+    bool normalized = accessor["normalized"].asBool();
+    components = componentCount(accessor["type"].string);
+
+    vector<float> values(count * components, 0.0f);
+    if (accessor["bufferView"].isNull()) return values; // all zeros
+
+    const Cook::Json& view = gltf.json["bufferViews"][accessor["bufferView"].asUint()];
+    uint64_t bufferIndex = view["buffer"].asUint();
+    if (bufferIndex >= gltf.buffers.size()) throw std::runtime_error("gltf buffer out of range!");
+    const vector<uint8_t>& buffer = gltf.buffers[bufferIndex];
+
+    uint32_t elementSize = componentSize(componentType) * components;
+    uint64_t stride = view["byteStride"].asUint(elementSize);
+    uint64_t viewEnd = view["byteOffset"].asUint() + view["byteLength"].asUint();
+    uint64_t base = view["byteOffset"].asUint() + accessor["byteOffset"].asUint();
+    if (count && (base + stride * (count - 1) + elementSize > std::min<uint64_t>(viewEnd, buffer.size())))
+        throw std::runtime_error("gltf accessor out of bounds!");
+
+    for (uint64_t e = 0; e < count; e++) {
+        const uint8_t* element = buffer.data() + base + stride * e;
+        for (uint32_t c = 0; c < components; c++) {
+            float& v = values[e * components + c];
+            switch (componentType) {
+                case 5120: {
+                    int8_t x;
+                    memcpy(&x, element + c, 1);
+                    v = normalized ? std::max((float) x / 127.0f, -1.0f) : (float) x;
+                    break;
+                }
+                case 5121: {
+                    uint8_t x = element[c];
+                    v = normalized ? (float) x / 255.0f : (float) x;
+                    break;
+                }
+                case 5122: {
+                    int16_t x;
+                    memcpy(&x, element + c * 2, 2);
+                    v = normalized ? std::max((float) x / 32767.0f, -1.0f) : (float) x;
+                    break;
+                }
+                case 5123: {
+                    uint16_t x;
+                    memcpy(&x, element + c * 2, 2);
+                    v = normalized ? (float) x / 65535.0f : (float) x;
+                    break;
+                }
+                case 5125: {
+                    uint32_t x;
+                    memcpy(&x, element + c * 4, 4);
+                    v = (float) x;
+                    break;
+                }
+                default:
+                    memcpy(&v, element + c * 4, 4);
+                    break;
+            }
+        }
+    }
+    return values;
+}
+
+static vector<uint32_t> readIndices(const Gltf& gltf, uint64_t index) {
+    const Cook::Json& accessor = gltf.json["accessors"][index];
+    if (accessor["componentType"].asUint() == 5125) {
+        // 32 bit indices don't survive a round trip through float, read them directly.
+        const Cook::Json& view = gltf.json["bufferViews"][accessor["bufferView"].asUint()];
+        uint64_t bufferIndex = view["buffer"].asUint();
+        if (bufferIndex >= gltf.buffers.size()) throw std::runtime_error("gltf buffer out of range!");
+        const vector<uint8_t>& buffer = gltf.buffers[bufferIndex];
+
+        uint64_t count = accessor["count"].asUint();
+        uint64_t base = view["byteOffset"].asUint() + accessor["byteOffset"].asUint();
+        if (base + count * 4 > buffer.size()) throw std::runtime_error("gltf accessor out of bounds!");
+
+        vector<uint32_t> indices(count);
+        memcpy(indices.data(), buffer.data() + base, count * 4);
+        return indices;
+    }
+
+    uint32_t components;
+    vector<float> values = readAccessor(gltf, index, components);
+    vector<uint32_t> indices(values.size());
+    for (size_t i = 0; i < values.size(); i++) indices[i] = static_cast<uint32_t>(values[i]);
+    return indices;
+}
+
+static mat4x4 nodeMatrix(const Cook::Json& node) {
+    const Cook::Json& matrix = node["matrix"];
+    if (matrix.size() == 16) {
+        mat4x4 m;
+        for (int c = 0; c < 4; c++) for (int r = 0; r < 4; r++) m[c][r] = (float) matrix[c * 4 + r].asNumber();
+        return m;
+    }
+
+    const Cook::Json& t = node["translation"];
+    const Cook::Json& r = node["rotation"];
+    const Cook::Json& s = node["scale"];
+    glm::quat rotation((float) r[3].asNumber(1.0), (float) r[0].asNumber(), (float) r[1].asNumber(),
+                       (float) r[2].asNumber());
+
+    mat4x4 m = glm::translate(mat4x4(1.0f), vec3(t[0].asNumber(), t[1].asNumber(), t[2].asNumber()));
+    m = m * glm::mat4_cast(rotation);
+    return glm::scale(m, vec3(s[0].asNumber(1.0), s[1].asNumber(1.0), s[2].asNumber(1.0)));
+}
+
+static void appendMesh(Cook::Mesh& mesh, const Gltf& gltf, uint64_t meshIndex, const mat4x4& transform) {
+    const Cook::Json& primitives = gltf.json["meshes"][meshIndex]["primitives"];
+    mat3x3 normalTransform = glm::transpose(glm::inverse(mat3x3(transform)));
+    bool mirrored = glm::determinant(mat3x3(transform)) < 0.0f;
+
+    for (size_t p = 0; p < primitives.size(); p++) {
+        const Cook::Json& primitive = primitives[p];
+        if (primitive["mode"].asUint(4) != 4) continue; // triangle lists only
+
+        const Cook::Json& attributes = primitive["attributes"];
+        if (attributes["POSITION"].isNull()) continue;
+
+        uint32_t components;
+        vector<float> positions = readAccessor(gltf, attributes["POSITION"].asUint(), components);
+        if (components != 3) throw std::runtime_error("gltf positions must be vec3!");
+        size_t count = positions.size() / components;
+        auto base = static_cast<uint32_t>(mesh.vertices.size());
+        mesh.vertices.resize(base + count);
+
+        for (size_t i = 0; i < count; i++) {
+            Vertex& v = mesh.vertices[base + i];
+            v.pos = vec3(transform * vec4(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2], 1.0f));
+            v.color = vec3(1.0f);
+        }
+
+        if (!attributes["NORMAL"].isNull()) {
+            vector<float> normals = readAccessor(gltf, attributes["NORMAL"].asUint(), components);
+            for (size_t i = 0; i < count && i * 3 + 2 < normals.size(); i++) {
+                vec3 n(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2]);
+                mesh.vertices[base + i].normal = glm::normalize(normalTransform * n);
+            }
+        }
+        if (!attributes["COLOR_0"].isNull()) {
+            vector<float> colors = readAccessor(gltf, attributes["COLOR_0"].asUint(), components);
+            for (size_t i = 0; i < count && (i + 1) * components <= colors.size(); i++) {
+                const float* c = &colors[i * components];
+                mesh.vertices[base + i].color = vec3(c[0], c[1], c[2]);
+            }
+        }
+        if (!attributes["TEXCOORD_0"].isNull()) {
+            vector<float> uvs = readAccessor(gltf, attributes["TEXCOORD_0"].asUint(), components);
+            for (size_t i = 0; i < count && i * 2 + 1 < uvs.size(); i++) {
+                mesh.vertices[base + i].uv = glm::vec2(uvs[i * 2], uvs[i * 2 + 1]);
+            }
+        }
+
+        vector<uint32_t> indices;
+        if (primitive["indices"].isNull()) {
+            indices.resize(count);
+            for (size_t i = 0; i < count; i++) indices[i] = static_cast<uint32_t>(i);
+        } else {
+            indices = readIndices(gltf, primitive["indices"].asUint());
+        }
+
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            if (indices[i] >= count || indices[i + 1] >= count || indices[i + 2] >= count)
+                throw std::runtime_error("gltf index out of range!");
+            // a mirroring transform flips the winding, flip it back.
+            mesh.indices.insert(mesh.indices.end(), {base + indices[i], base + indices[i + (mirrored ? 2 : 1)],
+                                                     base + indices[i + (mirrored ? 1 : 2)]});
+        }
+    }
+}
+
+static void appendNode(Cook::Mesh& mesh, const Gltf& gltf, uint64_t nodeIndex, const mat4x4& parent, int depth) {
+    const Cook::Json& node = gltf.json["nodes"][nodeIndex];
+    if (node.isNull() || depth > 256) throw std::runtime_error("malformed gltf node hierarchy!");
+
+    mat4x4 transform = parent * nodeMatrix(node);
+    if (!node["mesh"].isNull()) appendMesh(mesh, gltf, node["mesh"].asUint(), transform);
+
+    const Cook::Json& children = node["children"];
+    for (size_t i = 0; i < children.size(); i++) appendNode(mesh, gltf, children[i].asUint(), transform, depth + 1);
+}
+
+static Cook::Mesh importGltf(const path& p) {
+    Gltf gltf = loadGltf(p);
+    Cook::Mesh mesh;
+
+    const Cook::Json& scenes = gltf.json["scenes"];
+    if (scenes.size() == 0) {
+        // no scene: every mesh, untransformed.
+        for (size_t i = 0; i < gltf.json["meshes"].size(); i++) appendMesh(mesh, gltf, i, mat4x4(1.0f));
+        return mesh;
+    }
+
+    const Cook::Json& roots = scenes[gltf.json["scene"].asUint()]["nodes"];
+    for (size_t i = 0; i < roots.size(); i++) appendNode(mesh, gltf, roots[i].asUint(), mat4x4(1.0f), 0);
+    return mesh;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Cook::Mesh Cook::import(const path& p) {
+    std::string ext = extension(p);
+    if (ext == ".obj") return importObj(p);
+    if (ext == ".gltf" || ext == ".glb") return importGltf(p);
+    throw std::runtime_error("unsupported asset " + p.string());
+}
+
+vector<path> Cook::dependencies(const path& p) {
+    if (extension(p) != ".gltf") return {};
+
+    vector<uint8_t> file = readFile(p);
+    Json json = Json::parse(std::string_view(reinterpret_cast<const char*>(file.data()), file.size()));
+
+    vector<path> files;
+    const Json& buffers = json["buffers"];
+    for (size_t i = 0; i < buffers.size(); i++) {
+        const Json& uri = buffers[i]["uri"];
+        if (!uri.isNull() && !isDataUri(uri.string)) files.push_back(p.parent_path() / uri.string);
+    }
+    return files;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "using_std.h"
+#include "Vertex.h"
+
+#include <string>
+#include <filesystem>
+
+namespace Cook {
+    // an imported mesh: full precision vertices and a triangle list, every primitive of the source merged into one.
+    struct Mesh {
+        vector<Vertex> vertices;
+        vector<uint32_t> indices;
+    };
+
+    [[nodiscard]] bool importable(const std::filesystem::path& path);
+
+    // obj (positions, optional "v x y z r g b" colors, uvs, normals, polygons), gltf & glb (triangle primitives of
+    // the default scene, node transforms applied). throws on files it can't read.
+    Mesh import(const std::filesystem::path& path);
+
+    // files the import reads besides path itself (external gltf buffers), part of the content hash.
+    vector<std::filesystem::path> dependencies(const std::filesystem::path& path);
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "using_std.h"
+
+#include <string>
+#include <string_view>
+
+namespace Cook {
+    // Just enough JSON for glTF: the whole document is parsed into a tree, numbers are doubles. throws on malformed
+    // input.
+    struct Json {
+        enum class Type {
+            NUL,
+            BOOLEAN,
+            NUMBER,
+            STRING,
+            ARRAY,
+            OBJECT
+        };
+
+        Type type = Type::NUL;
+        bool boolean = false;
+        double number = 0.0;
+        std::string string;
+        vector<Json> values;          // array elements, object values
+        vector<std::string> keys;     // object keys, parallel to values
+
+        static Json parse(std::string_view text) {
+            size_t position = 0;
+            Json json = parseValue(text, position);
+            skipSpace(text, position);
+            if (position != text.size()) throw std::runtime_error("trailing characters after json document!");
+            return json;
+        }
+
+        [[nodiscard]] const Json* find(std::string_view key) const {
+            for (size_t i = 0; i < keys.size(); i++) if (keys[i] == key) return &values[i];
+            return nullptr;
+        }
+
+        // missing keys & out of range elements read as null.
+        const Json& operator[](std::string_view key) const {
+            const Json* json = find(key);
+            return json ? *json : null();
+        }
+
+        const Json& operator[](size_t index) const {
+            return type == Type::ARRAY && index < values.size() ? values[index] : null();
+        }
+
+        [[nodiscard]] size_t size() const {
+            return type == Type::ARRAY ? values.size() : 0;
+        }
+
+        [[nodiscard]] bool isNull() const {
+            return type == Type::NUL;
+        }
+
+        [[nodiscard]] double asNumber(double fallback = 0.0) const {
+            return type == Type::NUMBER ? number : fallback;
+        }
+
+        [[nodiscard]] uint64_t asUint(uint64_t fallback = 0) const {
+            return type == Type::NUMBER ? static_cast<uint64_t>(number) : fallback;
+        }
+
+        [[nodiscard]] bool asBool(bool fallback = false) const {
+            return type == Type::BOOLEAN ? boolean : fallback;
+        }
+
+    private:
+        static const Json& null() {
+            static const Json json {};
+            return json;
+        }
+
+        static void skipSpace(std::string_view text, size_t& p) {
+            while (p < text.size() && (text[p] == ' ' || text[p] == '\t' || text[p] == '\n' || text[p] == '\r')) p++;
+        }
+
+        static void expect(std::string_view text, size_t& p, std::string_view token) {
+            if (text.substr(p, token.size()) != token) throw std::runtime_error("malformed json!");
+            p += token.size();
+        }
+
+        static Json parseValue(std::string_view text, size_t& p) {
+            skipSpace(text, p);
+            if (p >= text.size()) throw std::runtime_error("unexpected end of json!");
+
+            Json json;
+            switch (text[p]) {
+                case '{':
+                    json.type = Type::OBJECT;
+                    p++;
+                    skipSpace(text, p);
+                    if (p < text.size() && text[p] == '}') {
+                        p++;
+                        break;
+                    }
+                    for (;;) {
+                        skipSpace(text, p);
+                        json.keys.push_back(parseString(text, p));
+                        skipSpace(text, p);
+                        expect(text, p, ":");
+                        json.values.push_back(parseValue(text, p));
+                        skipSpace(text, p);
+                        if (p < text.size() && text[p] == ',') {
+                            p++;
+                            continue;
+                        }
+                        expect(text, p, "}");
+                        break;
+                    }
+                    break;
+                case '[':
+                    json.type = Type::ARRAY;
+                    p++;
+                    skipSpace(text, p);
+                    if (p < text.size() && text[p] == ']') {
+                        p++;
+                        break;
+                    }
+                    for (;;) {
+                        json.values.push_back(parseValue(text, p));
+                        skipSpace(text, p);
+                        if (p < text.size() && text[p] == ',') {
+                            p++;
+                            continue;
+                        }
+                        expect(text, p, "]");
+                        break;
+                    }
+                    break;
+                case '"':
+                    json.type = Type::STRING;
+                    json.string = parseString(text, p);
+                    break;
+                case 't':
+                    expect(text, p, "true");
+                    json.type = Type::BOOLEAN;
+                    json.boolean = true;
+                    break;
+                case 'f':
+                    expect(text, p, "false");
+                    json.type = Type::BOOLEAN;
+                    break;
+                case 'n':
+                    expect(text, p, "null");
+                    break;
+                default: {
+                    size_t end = p;
+                    while (end < text.size() && text[end] != '\0' && std::strchr("+-0123456789.eE", text[end])) end++;
+                    if (end == p) throw std::runtime_error("malformed json!");
+                    json.type = Type::NUMBER;
+                    json.number = std::strtod(std::string(text.substr(p, end - p)).c_str(), nullptr);
+                    p = end;
+                    break;
+                }
+            }
+            return json;
+        }
+
+        static std::string parseString(std::string_view text, size_t& p) {
+            expect(text, p, "\"");
+            std::string string;
+            while (p < text.size() && text[p] != '"') {
+                char c = text[p++];
+                if (c != '\\') {
+                    string += c;
+                    continue;
+                }
+                if (p >= text.size()) break;
+                switch (char e = text[p++]) {
+                    case 'n':
+                        string += '\n';
+                        break;
+                    case 't':
+                        string += '\t';
+                        break;
+                    case 'r':
+                        string += '\r';
+                        break;
+                    case 'b':
+                        string += '\b';
+                        break;
+                    case 'f':
+                        string += '\f';
+                        break;
+                    case 'u': {
+                        // utf-16 code unit to utf-8, surrogate pairs aren't joined: glTF keys & uris are ascii.
+                        uint32_t code = std::strtoul(std::string(text.substr(p, 4)).c_str(), nullptr, 16);
+                        p += 4;
+                        if (code < 0x80) {
+                            string += (char) code;
+                        } else if (code < 0x800) {
+                            string += (char) (0xc0 | (code >> 6));
+                            string += (char) (0x80 | (code & 0x3f));
+                        } else {
+                            string += (char) (0xe0 | (code >> 12));
+                            string += (char) (0x80 | ((code >> 6) & 0x3f));
+                            string += (char) (0x80 | (code & 0x3f));
+                        }
+                        break;
+                    }
+                    default:
+                        string += e;
+                        break;
+                }
+            }
+            expect(text, p, "\"");
+            return string;
+        }
+    };
+}
@@ -0,0 +1,246 @@
+#include "Optimize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+    // a fifo of cacheSize entries, vertex v is cached while fewer than cacheSize misses happened since its own.
+    struct FifoCache {
+        vector<uint64_t> timestamps;
+        uint64_t time = Cook::cacheSize + 1;
+
+        explicit FifoCache(size_t vertexCount) : timestamps(vertexCount, 0) {}
+
+        // returns true on a miss.
+        bool access(uint32_t v) {
+            if (time - timestamps[v] <= Cook::cacheSize) return false;
+            timestamps[v] = time++;
+            return true;
+        }
+    };
+}
+
+float Cook::acmr(const vector<uint32_t>& indices, size_t vertexCount) {
+    if (indices.size() < 3) return 0.0f;
+
+    FifoCache cache(vertexCount);
+    size_t misses = 0;
+    for (uint32_t v: indices) misses += cache.access(v);
+    return (float) misses / (float) (indices.size() / 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// vertex cache
+
+// Forsyth models an lru cache larger than the hardware's: the score only needs to rank vertices.
+static constexpr uint32_t lruSize = 32;
+static constexpr uint32_t maxValence = 64;
+
+namespace {
+    struct ScoreTable {
+        array<float, lruSize> cache {};
+        array<float, maxValence> valence {};
+
+        ScoreTable() {
+            for (uint32_t i = 0; i < lruSize; i++) {
+                // the last triangle's vertices score the same, whatever order they were emitted in.
+                cache[i] = i < 3 ? 0.75f : std::pow(1.0f - (float) (i - 3) / (float) (lruSize - 3), 1.5f);
+            }
+            for (uint32_t i = 1; i < maxValence; i++) valence[i] = 2.0f / std::sqrt((float) i);
+        }
+
+        // vertices with few triangles left are favoured, to finish them off and avoid lone triangles later.
+        [[nodiscard]] float score(int32_t position, uint32_t live) const {
+            if (live == 0) return -1.0f;
+            float s = position >= 0 ? cache[position] : 0.0f;
+            return s + (live < maxValence ? valence[live] : 2.0f / std::sqrt((float) live));
+        }
+    };
+}
+
+void Cook::optimizeVertexCache(vector<uint32_t>& indices, size_t vertexCount) {
+    static const ScoreTable table;
+
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // triangles of every vertex, the live ones first in its range.
+    vector<uint32_t> live(vertexCount, 0);
+    for (uint32_t v: indices) live[v]++;
+
+    vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + live[v];
+
+    vector<uint32_t> adjacency(indices.size());
+    vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (size_t k = 0; k < 3; k++) adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+    }
+
+    vector<int32_t> cachePosition(vertexCount, -1);
+    vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) vertexScore[v] = table.score(-1, live[v]);
+
+    vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        const uint32_t* tri = &indices[t * 3];
+        triangleScore[t] = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+    }
+
+    vector<uint8_t> emitted(triangleCount, 0);
+    vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    array<uint32_t, lruSize + 3> cache {};
+    array<uint32_t, lruSize + 3> next {};
+    uint32_t cacheCount = 0;
+
+    auto best = static_cast<int64_t>(std::max_element(triangleScore.begin(), triangleScore.end()) -
+                                     triangleScore.begin());
+    size_t cursor = 0;
+
+    while (output.size() < indices.size()) {
+        if (best < 0) {
+            // nothing in the cache has triangles left: start over from the first triangle not emitted.
+            while (emitted[cursor]) cursor++;
+            best = static_cast<int64_t>(cursor);
+        }
+
+        const uint32_t* tri = &indices[best * 3];
+        emitted[best] = 1;
+        output.insert(output.end(), tri, tri + 3);
+
+        for (size_t k = 0; k < 3; k++) {
+            uint32_t v = tri[k];
+            uint32_t* triangles = &adjacency[offsets[v]];
+            uint32_t* last = triangles + live[v] - 1;
+            std::iter_swap(std::find(triangles, last, (uint32_t) best), last);
+            live[v]--;
+        }
+
+        // the triangle's vertices move to the front, the rest shifts back.
+        uint32_t nextCount = 0;
+        for (size_t k = 0; k < 3; k++) {
+            if (std::find(next.begin(), next.begin() + nextCount, tri[k]) == next.begin() + nextCount)
+                next[nextCount++] = tri[k];
+        }
+        for (uint32_t i = 0; i < cacheCount; i++) {
+            if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2]) next[nextCount++] = cache[i];
+        }
+
+        for (uint32_t i = 0; i < nextCount; i++) {
+            uint32_t v = next[i];
+            cachePosition[v] = i < lruSize ? (int32_t) i : -1;
+
+            float score = table.score(cachePosition[v], live[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+            for (uint32_t j = offsets[v]; j < offsets[v] + live[v]; j++) triangleScore[adjacency[j]] += delta;
+        }
+
+        cacheCount = std::min(nextCount, lruSize);
+        std::copy(next.begin(), next.begin() + cacheCount, cache.begin());
+
+        best = -1;
+        float bestScore = -1.0f;
+        for (uint32_t i = 0; i < cacheCount; i++) {
+            uint32_t v = cache[i];
+            for (uint32_t j = offsets[v]; j < offsets[v] + live[v]; j++) {
+                uint32_t t = adjacency[j];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+    }
+
+    indices = std::move(output);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// overdraw
+
+void Cook::optimizeOverdraw(vector<uint32_t>& indices, const vector<Vertex>& vertices) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2) return;
+
+    // a cluster starts at every triangle that misses the cache on all three vertices: reordering clusters leaves
+    // the misses where they are.
+    vector<size_t> clusters;
+    FifoCache cache(vertices.size());
+    for (size_t t = 0; t < triangleCount; t++) {
+        uint32_t misses = 0;
+        for (size_t k = 0; k < 3; k++) misses += cache.access(indices[t * 3 + k]);
+        if (misses == 3 || t == 0) clusters.push_back(t);
+    }
+    if (clusters.size() < 2) return;
+    clusters.push_back(triangleCount);
+
+    struct Cluster {
+        vec3 centroid {0.0f};
+        vec3 normal {0.0f};
+        float area = 0.0f;
+    };
+    vector<Cluster> properties(clusters.size() - 1);
+
+    vec3 meshCentroid {0.0f};
+    float meshArea = 0.0f;
+    for (size_t c = 0; c + 1 < clusters.size(); c++) {
+        Cluster& cluster = properties[c];
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            const vec3& a = vertices[indices[t * 3]].pos;
+            const vec3& b = vertices[indices[t * 3 + 1]].pos;
+            const vec3& d = vertices[indices[t * 3 + 2]].pos;
+
+            vec3 normal = glm::cross(b - a, d - a); // length: twice the area
+            float area = glm::length(normal);
+            cluster.centroid += (a + b + d) * (area / 3.0f);
+            cluster.normal += normal;
+            cluster.area += area;
+        }
+        meshCentroid += cluster.centroid;
+        meshArea += cluster.area;
+        if (cluster.area > 0.0f) cluster.centroid /= cluster.area;
+    }
+    if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+    // clusters facing away from the center, on the outside of the mesh, are drawn first.
+    vector<float> keys(properties.size());
+    for (size_t c = 0; c < properties.size(); c++) {
+        float length = glm::length(properties[c].normal);
+        keys[c] = length > 0.0f ? glm::dot(properties[c].centroid - meshCentroid, properties[c].normal / length) : 0;
+    }
+
+    vector<size_t> order(properties.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (size_t c: order) {
+        output.insert(output.end(), indices.begin() + (long) clusters[c] * 3,
+                      indices.begin() + (long) clusters[c + 1] * 3);
+    }
+    indices = std::move(output);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// vertex fetch
+
+void Cook::optimizeVertexFetch(vector<Vertex>& vertices, vector<uint32_t>& indices) {
+    vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+    vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+
+    for (uint32_t& index: indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = static_cast<uint32_t>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(ordered);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Import.h"
+
+namespace Cook {
+    // the post transform cache the optimizations aim at, and that acmr() simulates.
+    static constexpr uint32_t cacheSize = 16;
+
+    // average cache miss ratio: vertices shaded per triangle through a fifo of cacheSize entries, 0.5 at best on
+    // large regular meshes, 3 at worst.
+    float acmr(const vector<uint32_t>& indices, size_t vertexCount);
+
+    // reorders triangles for the post transform cache (Forsyth's linear-speed vertex cache optimisation).
+    void optimizeVertexCache(vector<uint32_t>& indices, size_t vertexCount);
+
+    // reorders the clusters of a cache optimised list so that outward facing ones draw first, occluding what lies
+    // behind them (Sander et al., fast triangle reordering). clusters start where the cache starts over, the cache
+    // efficiency is kept.
+    void optimizeOverdraw(vector<uint32_t>& indices, const vector<Vertex>& vertices);
+
+    // renumbers vertices in order of first use and drops unreferenced ones: vertex fetch walks memory forward.
+    void optimizeVertexFetch(vector<Vertex>& vertices, vector<uint32_t>& indices);
+}